@@ -0,0 +1,48 @@
+#include <cappuccino/cappuccino.hpp>
+
+#include <iostream>
+
+int main()
+{
+    // A cache of 100 items that re-evaluates its eviction policy every 1000 finds.
+    cappuccino::adaptive_cache<uint64_t, uint64_t> cache{100, 1000};
+
+    auto access = [&](uint64_t key)
+    {
+        if (!cache.find(key).has_value())
+        {
+            cache.insert(key, key);
+        }
+    };
+
+    // Day time traffic, a small hot set interleaved with large one off scans.
+    uint64_t scan_key{1'000'000};
+    for (size_t round = 0; round < 500; ++round)
+    {
+        for (uint64_t hot = 0; hot < 50; ++hot)
+        {
+            access(hot);
+            access(hot);
+        }
+        for (size_t i = 0; i < 200; ++i)
+        {
+            access(scan_key++);
+        }
+    }
+    std::cout << "day time policy: " << cappuccino::to_string(cache.policy()) << std::endl;
+
+    // Night time traffic, a new working set that moves every so often.
+    for (uint64_t phase = 0; phase < 20; ++phase)
+    {
+        for (size_t round = 0; round < 100; ++round)
+        {
+            for (uint64_t key = 0; key < 80; ++key)
+            {
+                access(phase * 1000 + key);
+            }
+        }
+    }
+    std::cout << "night time policy: " << cappuccino::to_string(cache.policy()) << std::endl;
+
+    return 0;
+}
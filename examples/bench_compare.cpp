@@ -0,0 +1,228 @@
+#include "bench_json.hpp"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Compares two benchmark result files written by the benchmark executables, see bench_json.hpp.
+ *
+ * Every measurement present in both files is compared by its median ns/op and a two sided
+ * Mann-Whitney U test over the repetition samples.  A measurement is only flagged as a
+ * regression (or improvement) if the median moved by more than the threshold AND the change is
+ * statistically significant, this keeps noisy machines from failing on run to run jitter.
+ *
+ * Usage: cap_bench_compare <baseline.json> <candidate.json> [threshold_percent=5] [alpha=0.05]
+ *
+ * The exit code is 1 if any measurement regressed, 2 on usage or input errors and 0 otherwise.
+ */
+
+/**
+ * The number of orderings of m baseline and n candidate samples with a U statistic of exactly u,
+ * used for the exact distribution of small samples without ties.
+ */
+static auto mann_whitney_exact_counts(size_t m, size_t n) -> std::vector<double>
+{
+    // counts[i][j][u] built bottom up, only the previous row of i is needed at a time.
+    auto max_u = m * n;
+    std::vector<std::vector<double>> previous(n + 1, std::vector<double>(max_u + 1, 0.0));
+    for (size_t j = 0; j <= n; ++j)
+    {
+        previous[j][0] = 1.0;
+    }
+
+    for (size_t i = 1; i <= m; ++i)
+    {
+        std::vector<std::vector<double>> current(n + 1, std::vector<double>(max_u + 1, 0.0));
+        current[0][0] = 1.0;
+        for (size_t j = 1; j <= n; ++j)
+        {
+            for (size_t u = 0; u <= i * j; ++u)
+            {
+                // Either the largest value is a baseline sample which is larger than all j candidate
+                // samples, or it is a candidate sample which contributes nothing.
+                current[j][u] = ((u >= j) ? previous[j][u - j] : 0.0) + current[j - 1][u];
+            }
+        }
+        previous = std::move(current);
+    }
+
+    return previous[n];
+}
+
+/**
+ * @return The two sided p-value of the Mann-Whitney U test that both sample sets come from the
+ *         same distribution.
+ */
+static auto mann_whitney_p_value(const std::vector<double>& a, const std::vector<double>& b) -> double
+{
+    auto n1 = a.size();
+    auto n2 = b.size();
+    if (n1 == 0 || n2 == 0)
+    {
+        return 1.0;
+    }
+
+    // Rank the combined samples, ties get the average of their ranks.
+    std::vector<std::pair<double, bool>> combined{};
+    combined.reserve(n1 + n2);
+    for (auto v : a)
+    {
+        combined.emplace_back(v, true);
+    }
+    for (auto v : b)
+    {
+        combined.emplace_back(v, false);
+    }
+    std::sort(combined.begin(), combined.end());
+
+    double rank_sum_a{0.0};
+    double tie_correction{0.0};
+    bool   has_ties{false};
+    for (size_t i = 0; i < combined.size();)
+    {
+        auto j = i;
+        while (j < combined.size() && combined[j].first == combined[i].first)
+        {
+            ++j;
+        }
+        auto average_rank = (static_cast<double>(i + 1) + static_cast<double>(j)) / 2.0;
+        auto tied         = static_cast<double>(j - i);
+        if (j - i > 1)
+        {
+            has_ties = true;
+            tie_correction += tied * tied * tied - tied;
+        }
+        for (auto k = i; k < j; ++k)
+        {
+            if (combined[k].second)
+            {
+                rank_sum_a += average_rank;
+            }
+        }
+        i = j;
+    }
+
+    auto u_a = rank_sum_a - static_cast<double>(n1 * (n1 + 1)) / 2.0;
+    auto u   = std::min(u_a, static_cast<double>(n1 * n2) - u_a);
+
+    if (!has_ties && n1 <= 20 && n2 <= 20)
+    {
+        auto   counts = mann_whitney_exact_counts(n1, n2);
+        double total{0.0};
+        double tail{0.0};
+        for (size_t k = 0; k < counts.size(); ++k)
+        {
+            total += counts[k];
+            if (static_cast<double>(k) <= u)
+            {
+                tail += counts[k];
+            }
+        }
+        return std::min(1.0, 2.0 * tail / total);
+    }
+
+    // Normal approximation with tie and continuity corrections.
+    auto n     = static_cast<double>(n1 + n2);
+    auto mean  = static_cast<double>(n1 * n2) / 2.0;
+    auto var   = static_cast<double>(n1 * n2) / 12.0 * ((n + 1.0) - tie_correction / (n * (n - 1.0)));
+    if (var <= 0.0)
+    {
+        return 1.0;
+    }
+    auto z = (std::abs(u - mean) - 0.5) / std::sqrt(var);
+    return std::min(1.0, std::erfc(std::max(z, 0.0) / std::sqrt(2.0)));
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <baseline.json> <candidate.json> [threshold_percent=5] [alpha=0.05]\n";
+        return 2;
+    }
+
+    double threshold = (argc > 3) ? std::stod(argv[3]) / 100.0 : 0.05;
+    double alpha     = (argc > 4) ? std::stod(argv[4]) : 0.05;
+
+    std::string                baseline_name{};
+    std::string                candidate_name{};
+    std::vector<bench::result> baseline{};
+    std::vector<bench::result> candidate{};
+    try
+    {
+        baseline  = bench::read_json(argv[1], baseline_name);
+        candidate = bench::read_json(argv[2], candidate_name);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return 2;
+    }
+
+    if (baseline_name != candidate_name)
+    {
+        std::cerr << "warning: comparing results of '" << baseline_name << "' against '" << candidate_name << "'\n";
+    }
+
+    std::map<std::string, const bench::result*> candidate_by_id{};
+    for (const auto& r : candidate)
+    {
+        candidate_by_id[r.id()] = &r;
+    }
+
+    size_t regressions{0};
+    size_t improvements{0};
+    size_t missing{0};
+
+    std::cout << std::left << std::setw(48) << "measurement" << std::right << std::setw(12) << "base ns/op"
+              << std::setw(12) << "new ns/op" << std::setw(10) << "delta" << std::setw(10) << "p-value"
+              << "  verdict\n";
+
+    for (const auto& base : baseline)
+    {
+        auto found = candidate_by_id.find(base.id());
+        if (found == candidate_by_id.end())
+        {
+            ++missing;
+            std::cout << std::left << std::setw(48) << base.id() << "  missing from candidate\n";
+            continue;
+        }
+
+        const auto& cand    = *found->second;
+        auto        base_ns = base.median();
+        auto        cand_ns = cand.median();
+        auto        delta   = (base_ns > 0.0) ? (cand_ns - base_ns) / base_ns : 0.0;
+        auto        p       = mann_whitney_p_value(base.samples, cand.samples);
+
+        std::string verdict{"ok"};
+        if (p < alpha && delta > threshold)
+        {
+            verdict = "REGRESSION";
+            ++regressions;
+        }
+        else if (p < alpha && delta < -threshold)
+        {
+            verdict = "improvement";
+            ++improvements;
+        }
+        else if (std::abs(delta) > threshold)
+        {
+            verdict = "not significant";
+        }
+
+        std::cout << std::left << std::setw(48) << base.id() << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << base_ns << std::setw(12) << cand_ns << std::setw(9) << (delta * 100.0) << "%"
+                  << std::setprecision(4) << std::setw(10) << p << "  " << verdict << "\n";
+    }
+
+    std::cout << std::defaultfloat << "\n"
+              << baseline.size() << " measurements, " << regressions << " regressions, " << improvements
+              << " improvements, " << missing << " missing (threshold " << (threshold * 100.0) << "%, alpha "
+              << alpha << ")\n";
+
+    return (regressions > 0) ? 1 : 0;
+}
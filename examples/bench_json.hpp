@@ -0,0 +1,482 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Stable JSON result files shared by the benchmark executables and cap_bench_compare.
+ *
+ * A result file has the layout:
+ * {
+ *   "format_version": 1,
+ *   "benchmark": "cap_microbench",
+ *   "build": { "git_sha": "...", "compiler": "...", "build_type": "...", "compiler_flags": "..." },
+ *   "config": { "capacity": "65536", ... },
+ *   "results": [
+ *     { "structure": "lru_cache", "op": "find_hit", "batch_size": 1, "ns_per_op": 21.5,
+ *       "ops_per_sec": 46511627.9, "min": 20.9, "p50": 21.5, "p90": 23.0, "p99": 23.4, "max": 23.4,
+ *       "samples": [21.5, 20.9, 23.4, ...], "metrics": { "hit_ratio": 0.61 } }
+ *   ]
+ * }
+ *
+ * The metrics member is only present when the benchmark attached any.  Keys are always written
+ * in the same order and samples keep their repetition order so two files of the same benchmark
+ * diff cleanly.  The build information is provided by CMake at configure time through the
+ * CAPPUCCINO_BENCH_* compile definitions.
+ */
+
+#ifndef CAPPUCCINO_BENCH_GIT_SHA
+    #define CAPPUCCINO_BENCH_GIT_SHA "unknown"
+#endif
+#ifndef CAPPUCCINO_BENCH_COMPILER
+    #define CAPPUCCINO_BENCH_COMPILER "unknown"
+#endif
+#ifndef CAPPUCCINO_BENCH_BUILD_TYPE
+    #define CAPPUCCINO_BENCH_BUILD_TYPE "unknown"
+#endif
+#ifndef CAPPUCCINO_BENCH_COMPILER_FLAGS
+    #define CAPPUCCINO_BENCH_COMPILER_FLAGS ""
+#endif
+
+namespace bench
+{
+/**
+ * A single benchmark measurement, the samples are the ns/op of every repetition.  Benchmarks can
+ * attach additional named metrics to a measurement, e.g. the hit ratio.
+ */
+struct result
+{
+    std::string                                 structure;
+    std::string                                 op;
+    size_t                                      batch_size{1};
+    std::vector<double>                         samples;
+    std::vector<std::pair<std::string, double>> metrics{};
+
+    /**
+     * @param p The percentile in the range [0.0, 1.0].
+     * @return The nearest rank percentile of the samples.
+     */
+    auto percentile(double p) const -> double
+    {
+        if (samples.empty())
+        {
+            return 0.0;
+        }
+        auto sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        auto rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+        return sorted[std::min(std::max(rank, size_t{1}), sorted.size()) - 1];
+    }
+
+    /**
+     * @return The median ns/op, this is the headline number for the measurement.
+     */
+    auto median() const -> double { return percentile(0.5); }
+
+    /**
+     * @return A key unique to this measurement within a result file.
+     */
+    auto id() const -> std::string { return structure + "/" + op + "/" + std::to_string(batch_size); }
+};
+
+/**
+ * A minimal JSON document model, enough to read back the result files.
+ */
+struct json_value
+{
+    enum class kind
+    {
+        null,
+        boolean,
+        number,
+        string,
+        array,
+        object
+    };
+
+    kind                                             type{kind::null};
+    bool                                             boolean{false};
+    double                                           number{0.0};
+    std::string                                      string{};
+    std::vector<json_value>                          array{};
+    std::vector<std::pair<std::string, json_value>> object{};
+
+    /**
+     * @param key The object member to find.
+     * @return The member or nullptr if this is not an object or the member does not exist.
+     */
+    auto find(const std::string& key) const -> const json_value*
+    {
+        for (const auto& [name, value] : object)
+        {
+            if (name == key)
+            {
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+};
+
+inline auto json_escape(const std::string& s) -> std::string
+{
+    std::string out{};
+    out.reserve(s.size() + 2);
+    for (auto c : s)
+    {
+        switch (c)
+        {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    std::ostringstream ss;
+                    ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+                    out += ss.str();
+                }
+                else
+                {
+                    out += c;
+                }
+                break;
+        }
+    }
+    return out;
+}
+
+/**
+ * Parses a JSON document, throws std::runtime_error on malformed input.
+ */
+class json_parser
+{
+public:
+    explicit json_parser(const std::string& text) : m_text(text) {}
+
+    auto parse() -> json_value
+    {
+        auto value = parse_value();
+        skip_whitespace();
+        if (m_pos != m_text.size())
+        {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+private:
+    auto fail(const std::string& what) const -> void
+    {
+        throw std::runtime_error{"json parse error at offset " + std::to_string(m_pos) + ": " + what};
+    }
+
+    auto skip_whitespace() -> void
+    {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos])))
+        {
+            ++m_pos;
+        }
+    }
+
+    auto expect(char c) -> void
+    {
+        skip_whitespace();
+        if (m_pos >= m_text.size() || m_text[m_pos] != c)
+        {
+            fail(std::string{"expected '"} + c + "'");
+        }
+        ++m_pos;
+    }
+
+    auto consume(const std::string& literal) -> bool
+    {
+        if (m_text.compare(m_pos, literal.size(), literal) == 0)
+        {
+            m_pos += literal.size();
+            return true;
+        }
+        return false;
+    }
+
+    auto parse_value() -> json_value
+    {
+        skip_whitespace();
+        if (m_pos >= m_text.size())
+        {
+            fail("unexpected end of input");
+        }
+
+        json_value v{};
+        auto       c = m_text[m_pos];
+        if (c == '{')
+        {
+            v.type = json_value::kind::object;
+            ++m_pos;
+            skip_whitespace();
+            if (m_pos < m_text.size() && m_text[m_pos] == '}')
+            {
+                ++m_pos;
+                return v;
+            }
+            while (true)
+            {
+                skip_whitespace();
+                auto key = parse_string();
+                expect(':');
+                v.object.emplace_back(std::move(key), parse_value());
+                skip_whitespace();
+                if (m_pos < m_text.size() && m_text[m_pos] == ',')
+                {
+                    ++m_pos;
+                    continue;
+                }
+                expect('}');
+                return v;
+            }
+        }
+        else if (c == '[')
+        {
+            v.type = json_value::kind::array;
+            ++m_pos;
+            skip_whitespace();
+            if (m_pos < m_text.size() && m_text[m_pos] == ']')
+            {
+                ++m_pos;
+                return v;
+            }
+            while (true)
+            {
+                v.array.push_back(parse_value());
+                skip_whitespace();
+                if (m_pos < m_text.size() && m_text[m_pos] == ',')
+                {
+                    ++m_pos;
+                    continue;
+                }
+                expect(']');
+                return v;
+            }
+        }
+        else if (c == '"')
+        {
+            v.type   = json_value::kind::string;
+            v.string = parse_string();
+        }
+        else if (consume("true"))
+        {
+            v.type    = json_value::kind::boolean;
+            v.boolean = true;
+        }
+        else if (consume("false"))
+        {
+            v.type = json_value::kind::boolean;
+        }
+        else if (consume("null"))
+        {
+            v.type = json_value::kind::null;
+        }
+        else
+        {
+            auto start = m_pos;
+            while (m_pos < m_text.size() && std::string{"+-0123456789.eE"}.find(m_text[m_pos]) != std::string::npos)
+            {
+                ++m_pos;
+            }
+            if (start == m_pos)
+            {
+                fail("unexpected character");
+            }
+            v.type   = json_value::kind::number;
+            v.number = std::stod(m_text.substr(start, m_pos - start));
+        }
+        return v;
+    }
+
+    auto parse_string() -> std::string
+    {
+        expect('"');
+        std::string out{};
+        while (m_pos < m_text.size() && m_text[m_pos] != '"')
+        {
+            auto c = m_text[m_pos++];
+            if (c == '\\')
+            {
+                if (m_pos >= m_text.size())
+                {
+                    fail("unterminated escape");
+                }
+                auto e = m_text[m_pos++];
+                switch (e)
+                {
+                    case 'n':
+                        out += '\n';
+                        break;
+                    case 't':
+                        out += '\t';
+                        break;
+                    case 'u':
+                        // Only control characters are written escaped, keep the low byte.
+                        out += static_cast<char>(std::stoi(m_text.substr(m_pos, 4), nullptr, 16));
+                        m_pos += 4;
+                        break;
+                    default:
+                        out += e;
+                        break;
+                }
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        expect('"');
+        return out;
+    }
+
+    const std::string& m_text;
+    size_t             m_pos{0};
+};
+
+/**
+ * Writes a result file.
+ * @param out The stream to write the JSON document to.
+ * @param benchmark The name of the benchmark executable.
+ * @param config The benchmark's configuration as ordered name/value pairs.
+ * @param results The measurements in the order they were run.
+ */
+inline auto write_json(
+    std::ostream&                                           out,
+    const std::string&                                      benchmark,
+    const std::vector<std::pair<std::string, std::string>>& config,
+    const std::vector<result>&                              results) -> void
+{
+    out << std::setprecision(6) << std::fixed;
+    out << "{\n";
+    out << "  \"format_version\": 1,\n";
+    out << "  \"benchmark\": \"" << json_escape(benchmark) << "\",\n";
+    out << "  \"build\": {\n";
+    out << "    \"git_sha\": \"" << json_escape(CAPPUCCINO_BENCH_GIT_SHA) << "\",\n";
+    out << "    \"compiler\": \"" << json_escape(CAPPUCCINO_BENCH_COMPILER) << "\",\n";
+    out << "    \"build_type\": \"" << json_escape(CAPPUCCINO_BENCH_BUILD_TYPE) << "\",\n";
+    out << "    \"compiler_flags\": \"" << json_escape(CAPPUCCINO_BENCH_COMPILER_FLAGS) << "\"\n";
+    out << "  },\n";
+    out << "  \"config\": {";
+    for (size_t i = 0; i < config.size(); ++i)
+    {
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    \"" << json_escape(config[i].first) << "\": \"" << json_escape(config[i].second) << "\"";
+    }
+    out << "\n  },\n";
+    out << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& r      = results[i];
+        auto        median = r.median();
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"structure\": \"" << json_escape(r.structure) << "\", \"op\": \"" << json_escape(r.op)
+            << "\", \"batch_size\": " << r.batch_size << ", \"ns_per_op\": " << median
+            << ", \"ops_per_sec\": " << (median > 0.0 ? 1e9 / median : 0.0) << ", \"min\": " << r.percentile(0.0)
+            << ", \"p50\": " << median << ", \"p90\": " << r.percentile(0.9) << ", \"p99\": " << r.percentile(0.99)
+            << ", \"max\": " << r.percentile(1.0) << ", \"samples\": [";
+        for (size_t s = 0; s < r.samples.size(); ++s)
+        {
+            out << (s == 0 ? "" : ", ") << r.samples[s];
+        }
+        out << "]";
+        if (!r.metrics.empty())
+        {
+            out << ", \"metrics\": {";
+            for (size_t m = 0; m < r.metrics.size(); ++m)
+            {
+                out << (m == 0 ? "" : ", ") << "\"" << json_escape(r.metrics[m].first) << "\": " << r.metrics[m].second;
+            }
+            out << "}";
+        }
+        out << "}";
+    }
+    out << "\n  ]\n";
+    out << "}\n";
+}
+
+/**
+ * Reads the measurements back out of a result file, throws std::runtime_error on failure.
+ * @param path The result file to read.
+ * @param benchmark Set to the name of the benchmark that wrote the file.
+ */
+inline auto read_json(const std::string& path, std::string& benchmark) -> std::vector<result>
+{
+    std::ifstream in{path};
+    if (!in)
+    {
+        throw std::runtime_error{"unable to open " + path};
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    auto text = ss.str();
+
+    auto doc = json_parser{text}.parse();
+
+    if (auto* name = doc.find("benchmark"); name != nullptr)
+    {
+        benchmark = name->string;
+    }
+
+    auto* results_value = doc.find("results");
+    if (results_value == nullptr || results_value->type != json_value::kind::array)
+    {
+        throw std::runtime_error{path + " has no results array"};
+    }
+
+    std::vector<result> results{};
+    for (const auto& entry : results_value->array)
+    {
+        auto* structure  = entry.find("structure");
+        auto* op         = entry.find("op");
+        auto* batch_size = entry.find("batch_size");
+        auto* samples    = entry.find("samples");
+        if (structure == nullptr || op == nullptr || batch_size == nullptr || samples == nullptr)
+        {
+            throw std::runtime_error{path + " has a result missing structure, op, batch_size or samples"};
+        }
+
+        result r{};
+        r.structure  = structure->string;
+        r.op         = op->string;
+        r.batch_size = static_cast<size_t>(batch_size->number);
+        for (const auto& sample : samples->array)
+        {
+            r.samples.push_back(sample.number);
+        }
+        if (auto* metrics = entry.find("metrics"); metrics != nullptr)
+        {
+            for (const auto& [name, value] : metrics->object)
+            {
+                r.metrics.emplace_back(name, value.number);
+            }
+        }
+        results.push_back(std::move(r));
+    }
+    return results;
+}
+
+} // namespace bench
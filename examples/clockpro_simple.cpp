@@ -0,0 +1,43 @@
+#include <cappuccino/cappuccino.hpp>
+
+#include <iostream>
+
+int main()
+{
+    // Create a cache with 100 items.
+    cappuccino::clockpro_cache<uint64_t, uint64_t> cache{100};
+
+    size_t hits{0};
+    size_t accesses{0};
+    auto   access = [&](uint64_t key)
+    {
+        ++accesses;
+        if (cache.find(key).has_value())
+        {
+            ++hits;
+        }
+        else
+        {
+            cache.insert(key, key);
+        }
+    };
+
+    // A hot set of 50 keys, each round is followed by a scan of 150 keys that are never re-used.
+    // An lru cache would keep none of the hot keys, the scan flushes them out every round.
+    uint64_t scan_key{1'000'000};
+    for (size_t round = 0; round < 100; ++round)
+    {
+        for (uint64_t hot = 0; hot < 50; ++hot)
+        {
+            access(hot);
+        }
+        for (size_t i = 0; i < 150; ++i)
+        {
+            access(scan_key++);
+        }
+    }
+
+    std::cout << "hits " << hits << " of " << accesses << " accesses" << std::endl;
+
+    return 0;
+}
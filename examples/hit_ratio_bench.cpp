@@ -0,0 +1,303 @@
+#include "bench_json.hpp"
+
+#include <cappuccino/cappuccino.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Hit ratio versus capacity for every eviction policy.
+ *
+ * A key stream, either generated from a zipf distribution or read from a recorded trace, is fed
+ * through every bounded cache at a sweep of capacities.  Each access is a read through: find()
+ * and on a miss insert().  For every policy and capacity the hit ratio and the ns per access are
+ * reported so both sides of the trade off can be charted together.
+ *
+ * Usage: cap_hit_ratio [option=value ...]
+ *   keys=<path>            A recorded trace with one unsigned integer key per line, overrides zipf.
+ *   zipf=<alpha>           The skew of the generated key stream, default 0.99.
+ *   universe=<n>           The number of distinct keys in the generated key stream, default 100000.
+ *   accesses=<n>           The number of accesses in the generated key stream, default 1000000.
+ *   capacities=<a,b,...>   The cache capacities to sweep, default 0.1% to 20% of the distinct keys.
+ *   repetitions=<n>        The number of timed runs per policy and capacity, default 3.
+ *   json=<path>            Also write the results as json, see bench_json.hpp.
+ */
+
+using namespace cappuccino;
+using namespace std::chrono_literals;
+
+using key_stream = std::vector<uint64_t>;
+
+struct sweep_config
+{
+    std::string         keys_path{};
+    double              zipf_alpha{0.99};
+    size_t              universe{100000};
+    size_t              accesses{1000000};
+    std::vector<size_t> capacities{};
+    size_t              repetitions{3};
+    std::string         json_output_path{};
+};
+
+/// Every measurement in the order it was run.
+static std::vector<bench::result> g_results{};
+
+/**
+ * Generates a zipf distributed key stream, the ranks are scrambled so the popular keys are not
+ * also the numerically smallest keys.
+ */
+static auto make_zipf_stream(const sweep_config& config) -> key_stream
+{
+    std::vector<double> cdf(config.universe);
+    double              sum{0.0};
+    for (size_t rank = 0; rank < config.universe; ++rank)
+    {
+        sum += 1.0 / std::pow(static_cast<double>(rank + 1), config.zipf_alpha);
+        cdf[rank] = sum;
+    }
+
+    std::mt19937_64                        rng{0xcafe};
+    std::uniform_real_distribution<double> uniform{0.0, sum};
+
+    key_stream stream{};
+    stream.reserve(config.accesses);
+    for (size_t i = 0; i < config.accesses; ++i)
+    {
+        auto rank = static_cast<uint64_t>(std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin());
+        // An odd multiplier is a bijection on 64 bit integers.
+        stream.push_back(rank * 0x9E3779B97F4A7C15ull);
+    }
+    return stream;
+}
+
+static auto read_key_stream(const std::string& path) -> key_stream
+{
+    std::ifstream in{path};
+    if (!in)
+    {
+        throw std::runtime_error{"unable to open " + path};
+    }
+
+    key_stream stream{};
+    uint64_t   key{0};
+    while (in >> key)
+    {
+        stream.push_back(key);
+    }
+    return stream;
+}
+
+static auto count_distinct(const key_stream& stream) -> size_t
+{
+    auto sorted = stream;
+    std::sort(sorted.begin(), sorted.end());
+    return static_cast<size_t>(std::unique(sorted.begin(), sorted.end()) - sorted.begin());
+}
+
+template<typename cache_type>
+static auto make_sized(size_t capacity) -> std::unique_ptr<cache_type>
+{
+    return std::make_unique<cache_type>(capacity);
+}
+
+/**
+ * Feeds the key stream through a fresh cache per repetition.
+ * @param make Creates a cache with the given capacity.
+ * @param insert Inserts a key into the cache on a miss.
+ */
+template<typename make_functor, typename insert_functor>
+static auto run_policy(
+    const std::string&  name,
+    const sweep_config& config,
+    const key_stream&   stream,
+    make_functor        make,
+    insert_functor      insert) -> void
+{
+    for (auto capacity : config.capacities)
+    {
+        bench::result r{name, "access_capacity_" + std::to_string(capacity), 1, {}};
+        size_t        hits{0};
+
+        for (size_t rep = 0; rep < config.repetitions; ++rep)
+        {
+            auto cache = make(capacity);
+            hits       = 0;
+
+            auto start = std::chrono::steady_clock::now();
+            for (auto key : stream)
+            {
+                if (cache->find(key).has_value())
+                {
+                    ++hits;
+                }
+                else
+                {
+                    insert(*cache, key);
+                }
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            r.samples.push_back(static_cast<double>(ns) / static_cast<double>(stream.size()));
+        }
+
+        auto hit_ratio = static_cast<double>(hits) / static_cast<double>(stream.size());
+        r.metrics.emplace_back("capacity", static_cast<double>(capacity));
+        r.metrics.emplace_back("hit_ratio", hit_ratio);
+
+        std::cout << std::left << std::setw(16) << name << std::right << std::setw(12) << capacity << std::fixed
+                  << std::setprecision(4) << std::setw(12) << hit_ratio << std::setprecision(1) << std::setw(12)
+                  << r.median() << "\n";
+
+        g_results.push_back(std::move(r));
+    }
+}
+
+static auto parse_capacities(const std::string& value) -> std::vector<size_t>
+{
+    std::vector<size_t> capacities{};
+    std::stringstream   ss{value};
+    std::string         item{};
+    while (std::getline(ss, item, ','))
+    {
+        capacities.push_back(std::max(std::stoull(item), 1ull));
+    }
+    return capacities;
+}
+
+int main(int argc, char* argv[])
+{
+    sweep_config config{};
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg{argv[i]};
+        auto        eq = arg.find('=');
+        if (eq == std::string::npos)
+        {
+            std::cerr << "unknown argument '" << arg << "', expected option=value\n";
+            return 2;
+        }
+        auto option = arg.substr(0, eq);
+        auto value  = arg.substr(eq + 1);
+
+        if (option == "keys")
+        {
+            config.keys_path = value;
+        }
+        else if (option == "zipf")
+        {
+            config.zipf_alpha = std::stod(value);
+        }
+        else if (option == "universe")
+        {
+            config.universe = std::max(std::stoull(value), 1ull);
+        }
+        else if (option == "accesses")
+        {
+            config.accesses = std::max(std::stoull(value), 1ull);
+        }
+        else if (option == "capacities")
+        {
+            config.capacities = parse_capacities(value);
+        }
+        else if (option == "repetitions")
+        {
+            config.repetitions = std::max(std::stoull(value), 1ull);
+        }
+        else if (option == "json")
+        {
+            config.json_output_path = value;
+        }
+        else
+        {
+            std::cerr << "unknown option '" << option << "'\n";
+            return 2;
+        }
+    }
+
+    key_stream stream{};
+    try
+    {
+        stream = config.keys_path.empty() ? make_zipf_stream(config) : read_key_stream(config.keys_path);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return 2;
+    }
+    if (stream.empty())
+    {
+        std::cerr << "the key stream is empty\n";
+        return 2;
+    }
+
+    auto distinct = count_distinct(stream);
+    if (config.capacities.empty())
+    {
+        for (auto fraction : {0.001, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2})
+        {
+            auto capacity = static_cast<size_t>(fraction * static_cast<double>(distinct));
+            config.capacities.push_back(std::max(capacity, size_t{1}));
+        }
+    }
+
+    auto source = config.keys_path.empty() ? "zipf(" + std::to_string(config.zipf_alpha) + ")" : config.keys_path;
+    std::cout << "keys=" << source << " accesses=" << stream.size() << " distinct=" << distinct
+              << " repetitions=" << config.repetitions << "\n";
+    std::cout << std::left << std::setw(16) << "policy" << std::right << std::setw(12) << "capacity" << std::setw(12)
+              << "hit ratio" << std::setw(12) << "ns/access"
+              << "\n";
+
+    auto insert_kv = [](auto& c, uint64_t key) { c.insert(key, key); };
+
+    run_policy("clockpro_cache", config, stream, make_sized<clockpro_cache<uint64_t, uint64_t>>, insert_kv);
+    run_policy("fifo_cache", config, stream, make_sized<fifo_cache<uint64_t, uint64_t>>, insert_kv);
+    run_policy("hyperbolic_cache", config, stream, make_sized<hyperbolic_cache<uint64_t, uint64_t>>, insert_kv);
+    run_policy("lfu_cache", config, stream, make_sized<lfu_cache<uint64_t, uint64_t>>, insert_kv);
+    run_policy("lfuda_cache", config, stream, make_sized<lfuda_cache<uint64_t, uint64_t>>, insert_kv);
+    run_policy("lru_cache", config, stream, make_sized<lru_cache<uint64_t, uint64_t>>, insert_kv);
+    run_policy("mru_cache", config, stream, make_sized<mru_cache<uint64_t, uint64_t>>, insert_kv);
+    run_policy("rr_cache", config, stream, make_sized<rr_cache<uint64_t, uint64_t>>, insert_kv);
+    run_policy("adaptive_cache", config, stream, make_sized<adaptive_cache<uint64_t, uint64_t>>, insert_kv);
+    run_policy(
+        "tlru_cache",
+        config,
+        stream,
+        make_sized<tlru_cache<uint64_t, uint64_t>>,
+        [](auto& c, uint64_t key) { c.insert(1h, key, key); });
+    run_policy(
+        "utlru_cache",
+        config,
+        stream,
+        [](size_t capacity) { return std::make_unique<utlru_cache<uint64_t, uint64_t>>(1h, capacity); },
+        insert_kv);
+
+    if (!config.json_output_path.empty())
+    {
+        std::ofstream out{config.json_output_path};
+        bench::write_json(
+            out,
+            "cap_hit_ratio",
+            {{"keys", source},
+             {"accesses", std::to_string(stream.size())},
+             {"distinct", std::to_string(distinct)},
+             {"repetitions", std::to_string(config.repetitions)}},
+            g_results);
+        if (!out)
+        {
+            std::cerr << "failed to write " << config.json_output_path << "\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,36 @@
+#include <cappuccino/cappuccino.hpp>
+
+#include <iostream>
+
+int main()
+{
+    // Create a cache with 2 items, the 2 items are always the eviction sample.
+    cappuccino::hyperbolic_cache<uint64_t, std::string> cache{2};
+
+    // Hello is expensive to fetch again so it weighs 10 times as much as world.
+    cache.insert_weighted(1, "Hello", 10.0);
+    cache.insert(2, "World");
+
+    {
+        // Grab them
+        auto hello = cache.find(1);
+        auto world = cache.find(2);
+
+        // Lets use them!
+        std::cout << hello.value() << ", " << world.value() << "!" << std::endl;
+    }
+
+    // Insert hola, this will evict "World" since both were used as often but world is cheaper.
+    cache.insert(3, "Hola");
+
+    {
+        auto hola  = cache.find(3); // This will be in the cache.
+        auto hello = cache.find(1); // This will be in the cache.
+        auto world = cache.find(2); // This will not be in the cache.
+
+        std::cout << hola.value() << ", " << hello.value() << ", " << (world.has_value() ? "World" : "goodbye")
+                  << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,590 @@
+#include "bench_json.hpp"
+
+#include <cappuccino/cappuccino.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+/**
+ * Isolated per operation microbenchmarks for every cache and associative data structure.
+ *
+ * Each measurement builds its structure outside of the timed region, runs a single kind of
+ * operation in a tight loop and reports the nanoseconds per operation.  Every measurement is
+ * repeated and the median and minimum are reported to make run to run noise visible.
+ *
+ * Usage: cap_microbench [capacity] [operations] [repetitions] [json_output_path]
+ *
+ * When a json output path is given the results are also written there, see bench_json.hpp,
+ * and can be compared against another run with cap_bench_compare.
+ */
+
+using namespace cappuccino;
+using namespace std::chrono_literals;
+
+using key_batch = std::vector<uint64_t>;
+
+struct bench_config
+{
+    /// The capacity of the bounded caches and the number of pre-filled elements.
+    size_t capacity{65536};
+    /// The number of operations per timed run.
+    size_t operations{500000};
+    /// The number of times each measurement is repeated.
+    size_t repetitions{5};
+    /// The batch sizes to run the range variants with.
+    std::vector<size_t> batch_sizes{1, 16, 256};
+};
+
+/// Folds every lookup result in so the compiler cannot discard the timed loops.
+static uint64_t g_sink{0};
+/// The sink is stored here on exit, a volatile store the compiler must perform.
+static volatile uint64_t g_sink_observed{0};
+
+/// Every measurement in the order it was run.
+static std::vector<bench::result> g_results{};
+
+/**
+ * Runs setup() then times run(state) for every repetition.
+ * @param setup Builds the state for a single repetition, not timed.
+ * @param run Executes the operations against the state, returns the number of operations executed.
+ * @return The nanoseconds per operation of each repetition.
+ */
+template<typename setup_functor, typename run_functor>
+static auto measure(const bench_config& config, setup_functor setup, run_functor run) -> std::vector<double>
+{
+    std::vector<double> ns_per_op{};
+    ns_per_op.reserve(config.repetitions);
+
+    for (size_t rep = 0; rep < config.repetitions; ++rep)
+    {
+        auto state = setup();
+
+        auto   start   = std::chrono::steady_clock::now();
+        size_t ops     = run(*state);
+        auto   elapsed = std::chrono::steady_clock::now() - start;
+
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        ns_per_op.push_back(static_cast<double>(ns) / static_cast<double>(std::max(ops, size_t{1})));
+    }
+
+    return ns_per_op;
+}
+
+static auto report(
+    const std::string& structure, const std::string& op, size_t batch_size, std::vector<double> ns_per_op) -> void
+{
+    bench::result r{structure, op, batch_size, std::move(ns_per_op)};
+    auto          median = r.median();
+    auto          min    = r.percentile(0.0);
+
+    std::cout << std::left << std::setw(16) << structure << std::setw(24) << op << std::right << std::setw(6)
+              << batch_size << std::fixed << std::setprecision(1) << std::setw(12) << median << std::setw(12) << min
+              << std::setw(12) << std::setprecision(2) << (1000.0 / median) << "\n";
+
+    g_results.push_back(std::move(r));
+}
+
+/**
+ * The common adapter for the key value structures, each structure's adapter derives from it
+ * and replaces the calls whose signatures differ.
+ */
+template<typename cache_t>
+struct kv_adapter
+{
+    using cache_type   = cache_t;
+    using insert_batch = std::vector<std::pair<uint64_t, uint64_t>>;
+
+    /// Does the structure evict to stay within its capacity?
+    static constexpr bool bounded = true;
+    /// Does find() support peeking without updating the eviction policy?
+    static constexpr bool has_peek = false;
+    /// Does the structure support clean_expired_values()?
+    static constexpr bool has_clean_expired = false;
+    /// Does the structure support dynamically_age()?
+    static constexpr bool has_dynamically_age = false;
+
+    static auto make(size_t capacity) -> std::unique_ptr<cache_type> { return std::make_unique<cache_type>(capacity); }
+    static auto insert(cache_type& c, uint64_t key) -> bool { return c.insert(key, key); }
+    static auto make_insert_batch(const key_batch& keys) -> insert_batch
+    {
+        insert_batch batch{};
+        batch.reserve(keys.size());
+        for (auto key : keys)
+        {
+            batch.emplace_back(key, key);
+        }
+        return batch;
+    }
+    static auto insert_range(cache_type& c, insert_batch& batch) -> size_t { return c.insert_range(batch); }
+    static auto find(cache_type& c, uint64_t key) -> uint64_t { return c.find(key).value_or(0); }
+    static auto peek(cache_type& c, uint64_t key) -> uint64_t { return find(c, key); }
+    static auto erase(cache_type& c, uint64_t key) -> bool { return c.erase(key); }
+    static auto find_range(cache_type& c, const key_batch& keys) -> size_t { return c.find_range(keys).size(); }
+    static auto erase_range(cache_type& c, const key_batch& keys) -> size_t { return c.erase_range(keys); }
+};
+
+struct fifo_adapter : public kv_adapter<fifo_cache<uint64_t, uint64_t>>
+{
+    static constexpr const char* name = "fifo_cache";
+};
+
+struct lfu_adapter : public kv_adapter<lfu_cache<uint64_t, uint64_t>>
+{
+    static constexpr const char* name     = "lfu_cache";
+    static constexpr bool        has_peek = true;
+    static auto peek(cache_type& c, uint64_t key) -> uint64_t { return c.find(key, true).value_or(0); }
+};
+
+struct lfuda_adapter : public kv_adapter<lfuda_cache<uint64_t, uint64_t>>
+{
+    static constexpr const char* name                = "lfuda_cache";
+    static constexpr bool        has_peek            = true;
+    static constexpr bool        has_dynamically_age = true;
+    static auto peek(cache_type& c, uint64_t key) -> uint64_t { return c.find(key, true).value_or(0); }
+    static auto make_aging(size_t capacity) -> std::unique_ptr<cache_type>
+    {
+        return std::make_unique<cache_type>(capacity, 1ms);
+    }
+};
+
+struct lru_adapter : public kv_adapter<lru_cache<uint64_t, uint64_t>>
+{
+    static constexpr const char* name     = "lru_cache";
+    static constexpr bool        has_peek = true;
+    static auto peek(cache_type& c, uint64_t key) -> uint64_t { return c.find(key, peek::yes).value_or(0); }
+};
+
+struct mru_adapter : public kv_adapter<mru_cache<uint64_t, uint64_t>>
+{
+    static constexpr const char* name     = "mru_cache";
+    static constexpr bool        has_peek = true;
+    static auto peek(cache_type& c, uint64_t key) -> uint64_t { return c.find(key, peek::yes).value_or(0); }
+};
+
+struct rr_adapter : public kv_adapter<rr_cache<uint64_t, uint64_t>>
+{
+    static constexpr const char* name = "rr_cache";
+};
+
+struct tlru_adapter : public kv_adapter<tlru_cache<uint64_t, uint64_t>>
+{
+    using insert_batch = std::vector<std::tuple<std::chrono::milliseconds, uint64_t, uint64_t>>;
+
+    static constexpr const char* name              = "tlru_cache";
+    static constexpr bool        has_peek          = true;
+    static constexpr bool        has_clean_expired = true;
+    static auto insert(cache_type& c, uint64_t key) -> bool { return c.insert(1h, key, key); }
+    static auto make_insert_batch(const key_batch& keys) -> insert_batch
+    {
+        insert_batch batch{};
+        batch.reserve(keys.size());
+        for (auto key : keys)
+        {
+            batch.emplace_back(1h, key, key);
+        }
+        return batch;
+    }
+    static auto insert_range(cache_type& c, insert_batch& batch) -> size_t { return c.insert_range(batch); }
+    static auto peek(cache_type& c, uint64_t key) -> uint64_t { return c.find(key, peek::yes).value_or(0); }
+    static auto make_expiring(size_t capacity) -> std::unique_ptr<cache_type> { return make(capacity); }
+    static auto insert_expiring(cache_type& c, uint64_t key) -> bool { return c.insert(1ms, key, key); }
+};
+
+struct utlru_adapter : public kv_adapter<utlru_cache<uint64_t, uint64_t>>
+{
+    static constexpr const char* name              = "utlru_cache";
+    static constexpr bool        has_peek          = true;
+    static constexpr bool        has_clean_expired = true;
+    static auto make(size_t capacity) -> std::unique_ptr<cache_type>
+    {
+        return std::make_unique<cache_type>(1h, capacity);
+    }
+    static auto peek(cache_type& c, uint64_t key) -> uint64_t { return c.find(key, peek::yes).value_or(0); }
+    static auto make_expiring(size_t capacity) -> std::unique_ptr<cache_type>
+    {
+        return std::make_unique<cache_type>(1ms, capacity);
+    }
+    static auto insert_expiring(cache_type& c, uint64_t key) -> bool { return insert(c, key); }
+};
+
+struct ut_map_adapter : public kv_adapter<ut_map<uint64_t, uint64_t>>
+{
+    static constexpr const char* name              = "ut_map";
+    static constexpr bool        bounded           = false;
+    static constexpr bool        has_clean_expired = true;
+    static auto make(size_t) -> std::unique_ptr<cache_type> { return std::make_unique<cache_type>(1h); }
+    static auto make_expiring(size_t) -> std::unique_ptr<cache_type> { return std::make_unique<cache_type>(1ms); }
+    static auto insert_expiring(cache_type& c, uint64_t key) -> bool { return insert(c, key); }
+};
+
+struct ut_set_adapter : public kv_adapter<ut_set<uint64_t>>
+{
+    using insert_batch = key_batch;
+
+    static constexpr const char* name              = "ut_set";
+    static constexpr bool        bounded           = false;
+    static constexpr bool        has_clean_expired = true;
+    static auto make(size_t) -> std::unique_ptr<cache_type> { return std::make_unique<cache_type>(1h); }
+    static auto insert(cache_type& c, uint64_t key) -> bool { return c.insert(key); }
+    static auto make_insert_batch(const key_batch& keys) -> insert_batch { return keys; }
+    static auto insert_range(cache_type& c, insert_batch& batch) -> size_t { return c.insert_range(batch); }
+    static auto find(cache_type& c, uint64_t key) -> uint64_t { return c.find(key) ? 1 : 0; }
+    static auto make_expiring(size_t) -> std::unique_ptr<cache_type> { return std::make_unique<cache_type>(1ms); }
+    static auto insert_expiring(cache_type& c, uint64_t key) -> bool { return insert(c, key); }
+};
+
+/**
+ * The key streams shared by every structure so each one is measured against identical input.
+ */
+struct key_streams
+{
+    /// Uniformly random keys that are all resident after pre-filling.
+    key_batch hit_keys;
+    /// Uniformly random keys that are never inserted.
+    key_batch miss_keys;
+    /// A random permutation of the pre-filled keys, erasing these in order empties the structure.
+    key_batch erase_keys;
+    /// Unique keys that are not pre-filled, inserting these always misses.
+    key_batch insert_keys;
+};
+
+static auto make_key_streams(const bench_config& config) -> key_streams
+{
+    std::mt19937_64                         rng{0xcafe};
+    std::uniform_int_distribution<uint64_t> resident{0, config.capacity - 1};
+
+    key_streams streams{};
+    streams.hit_keys.reserve(config.operations);
+    streams.miss_keys.reserve(config.operations);
+    streams.insert_keys.reserve(config.operations);
+    for (size_t i = 0; i < config.operations; ++i)
+    {
+        streams.hit_keys.push_back(resident(rng));
+        streams.miss_keys.push_back(config.capacity * 2 + resident(rng));
+        streams.insert_keys.push_back(config.capacity + i);
+    }
+
+    streams.erase_keys.resize(config.capacity);
+    for (size_t i = 0; i < config.capacity; ++i)
+    {
+        streams.erase_keys[i] = i;
+    }
+    std::shuffle(streams.erase_keys.begin(), streams.erase_keys.end(), rng);
+
+    return streams;
+}
+
+static auto make_batches(const key_batch& keys, size_t batch_size) -> std::vector<key_batch>
+{
+    std::vector<key_batch> batches{};
+    for (size_t i = 0; i < keys.size(); i += batch_size)
+    {
+        auto last = std::min(i + batch_size, keys.size());
+        batches.emplace_back(keys.begin() + i, keys.begin() + last);
+    }
+    return batches;
+}
+
+template<typename adapter>
+static auto make_filled(const bench_config& config) -> std::unique_ptr<typename adapter::cache_type>
+{
+    auto c = adapter::make(config.capacity);
+    for (uint64_t key = 0; key < config.capacity; ++key)
+    {
+        adapter::insert(*c, key);
+    }
+    return c;
+}
+
+template<typename adapter>
+static auto run_structure(const bench_config& config, const key_streams& streams) -> void
+{
+    using cache_type = typename adapter::cache_type;
+
+    auto filled = [&]() { return make_filled<adapter>(config); };
+
+    auto insert_miss_name = adapter::bounded ? "insert_miss_evict" : "insert_miss";
+    report(
+        adapter::name,
+        insert_miss_name,
+        1,
+        measure(
+            config,
+            filled,
+            [&](cache_type& c)
+            {
+                for (auto key : streams.insert_keys)
+                {
+                    adapter::insert(c, key);
+                }
+                return streams.insert_keys.size();
+            }));
+
+    report(
+        adapter::name,
+        "insert_update",
+        1,
+        measure(
+            config,
+            filled,
+            [&](cache_type& c)
+            {
+                for (auto key : streams.hit_keys)
+                {
+                    adapter::insert(c, key);
+                }
+                return streams.hit_keys.size();
+            }));
+
+    report(
+        adapter::name,
+        "find_hit",
+        1,
+        measure(
+            config,
+            filled,
+            [&](cache_type& c)
+            {
+                for (auto key : streams.hit_keys)
+                {
+                    g_sink += adapter::find(c, key);
+                }
+                return streams.hit_keys.size();
+            }));
+
+    report(
+        adapter::name,
+        "find_miss",
+        1,
+        measure(
+            config,
+            filled,
+            [&](cache_type& c)
+            {
+                for (auto key : streams.miss_keys)
+                {
+                    g_sink += adapter::find(c, key);
+                }
+                return streams.miss_keys.size();
+            }));
+
+    if constexpr (adapter::has_peek)
+    {
+        report(
+            adapter::name,
+            "peek",
+            1,
+            measure(
+                config,
+                filled,
+                [&](cache_type& c)
+                {
+                    for (auto key : streams.hit_keys)
+                    {
+                        g_sink += adapter::peek(c, key);
+                    }
+                    return streams.hit_keys.size();
+                }));
+    }
+
+    report(
+        adapter::name,
+        "erase",
+        1,
+        measure(
+            config,
+            filled,
+            [&](cache_type& c)
+            {
+                for (auto key : streams.erase_keys)
+                {
+                    adapter::erase(c, key);
+                }
+                return streams.erase_keys.size();
+            }));
+
+    for (auto batch_size : config.batch_sizes)
+    {
+        auto insert_batches = make_batches(streams.insert_keys, batch_size);
+        auto hit_batches    = make_batches(streams.hit_keys, batch_size);
+        auto erase_batches  = make_batches(streams.erase_keys, batch_size);
+
+        std::vector<typename adapter::insert_batch> insert_ranges{};
+        insert_ranges.reserve(insert_batches.size());
+        for (const auto& batch : insert_batches)
+        {
+            insert_ranges.push_back(adapter::make_insert_batch(batch));
+        }
+
+        report(
+            adapter::name,
+            std::string{insert_miss_name} + "_range",
+            batch_size,
+            measure(
+                config,
+                filled,
+                [&](cache_type& c)
+                {
+                    for (auto& batch : insert_ranges)
+                    {
+                        adapter::insert_range(c, batch);
+                    }
+                    return streams.insert_keys.size();
+                }));
+
+        report(
+            adapter::name,
+            "find_hit_range",
+            batch_size,
+            measure(
+                config,
+                filled,
+                [&](cache_type& c)
+                {
+                    for (const auto& batch : hit_batches)
+                    {
+                        g_sink += adapter::find_range(c, batch);
+                    }
+                    return streams.hit_keys.size();
+                }));
+
+        report(
+            adapter::name,
+            "erase_range",
+            batch_size,
+            measure(
+                config,
+                filled,
+                [&](cache_type& c)
+                {
+                    for (const auto& batch : erase_batches)
+                    {
+                        adapter::erase_range(c, batch);
+                    }
+                    return streams.erase_keys.size();
+                }));
+    }
+
+    if constexpr (adapter::has_clean_expired)
+    {
+        // Every pre-filled element has expired before the timed region starts, the cost is per removed element.
+        report(
+            adapter::name,
+            "clean_expired_values",
+            1,
+            measure(
+                config,
+                [&]()
+                {
+                    auto c = adapter::make_expiring(config.capacity);
+                    for (uint64_t key = 0; key < config.capacity; ++key)
+                    {
+                        adapter::insert_expiring(*c, key);
+                    }
+                    std::this_thread::sleep_for(5ms);
+                    return c;
+                },
+                [&](cache_type& c) { return c.clean_expired_values(); }));
+    }
+
+    if constexpr (adapter::has_dynamically_age)
+    {
+        // Every pre-filled element is old enough to age before the timed region starts, the cost is per aged
+        // element.
+        report(
+            adapter::name,
+            "dynamically_age",
+            1,
+            measure(
+                config,
+                [&]()
+                {
+                    auto c = adapter::make_aging(config.capacity);
+                    for (uint64_t key = 0; key < config.capacity; ++key)
+                    {
+                        adapter::insert(*c, key);
+                    }
+                    for (auto key : streams.hit_keys)
+                    {
+                        g_sink += adapter::find(*c, key);
+                    }
+                    std::this_thread::sleep_for(5ms);
+                    return c;
+                },
+                [&](cache_type& c) { return c.dynamically_age(); }));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bench_config config{};
+    if (argc > 1)
+    {
+        config.capacity = std::max(std::stoull(argv[1]), 1ull);
+    }
+    if (argc > 2)
+    {
+        config.operations = std::max(std::stoull(argv[2]), 1ull);
+    }
+    if (argc > 3)
+    {
+        config.repetitions = std::max(std::stoull(argv[3]), 1ull);
+    }
+    std::string json_output_path{};
+    if (argc > 4)
+    {
+        json_output_path = argv[4];
+    }
+
+    std::cout << "capacity=" << config.capacity << " operations=" << config.operations
+              << " repetitions=" << config.repetitions << " <uint64_t, uint64_t> thread_safe::yes\n";
+    std::cout << std::left << std::setw(16) << "structure" << std::setw(24) << "op" << std::right << std::setw(6)
+              << "batch" << std::setw(12) << "ns/op" << std::setw(12) << "min ns/op" << std::setw(12) << "Mops/s"
+              << "\n";
+
+    auto streams = make_key_streams(config);
+
+    run_structure<fifo_adapter>(config, streams);
+    run_structure<lfu_adapter>(config, streams);
+    run_structure<lfuda_adapter>(config, streams);
+    run_structure<lru_adapter>(config, streams);
+    run_structure<mru_adapter>(config, streams);
+    run_structure<rr_adapter>(config, streams);
+    run_structure<tlru_adapter>(config, streams);
+    run_structure<utlru_adapter>(config, streams);
+    run_structure<ut_map_adapter>(config, streams);
+    run_structure<ut_set_adapter>(config, streams);
+
+    if (!json_output_path.empty())
+    {
+        std::ofstream out{json_output_path};
+        bench::write_json(
+            out,
+            "cap_microbench",
+            {{"capacity", std::to_string(config.capacity)},
+             {"operations", std::to_string(config.operations)},
+             {"repetitions", std::to_string(config.repetitions)},
+             {"key_type", "uint64_t"},
+             {"value_type", "uint64_t"},
+             {"thread_safe", "yes"}},
+            g_results);
+        if (!out)
+        {
+            std::cerr << "failed to write " << json_output_path << "\n";
+            return 1;
+        }
+    }
+
+    // Keep the lookups observable.
+    g_sink_observed = g_sink;
+    return 0;
+}
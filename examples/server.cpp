@@ -0,0 +1,1236 @@
+#include <cappuccino/cappuccino.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * A memcached protocol server over a sharded tlru_cache, meant to run as a loopback sidecar and to
+ * benchmark the cache end to end under realistic network batching, plus a load generator for it.
+ *
+ * The server runs one epoll event loop per thread, each thread pinned to a core with its own
+ * SO_REUSEPORT listening socket so the kernel spreads the connections across the loops.  Every
+ * complete command in a read is executed before the responses are written back with a single
+ * send, so pipelined requests and multi key gets are answered in one batch.  The keys of a multi
+ * key get are grouped by shard and looked up with find_range_fill() to take each shard's lock once.
+ *
+ * Supported commands:
+ *   get|gets <key>*
+ *   set <key> <flags> <exptime> <bytes> [noreply]
+ *   delete <key> [noreply]
+ *   touch <key> <exptime> [noreply]
+ *   mg <key> [v f c k s q O<opaque> T<ttl>]*
+ *   ms <key> <bytes> [F<flags> T<ttl> q k O<opaque>]*
+ *   md <key> [q k O<opaque>]*
+ *   mn, version, quit
+ *
+ * An exptime of 0 never expires, a negative exptime is already expired and an exptime over 30
+ * days is an absolute unix time, the same as memcached.  Data blocks over 1 MiB are rejected with
+ * SERVER_ERROR and discarded, also the same as memcached.
+ *
+ * Usage: cap_server serve [option=value ...]
+ *   port=<n>               The loopback port to listen on, default 11311.
+ *   threads=<n>            The number of event loops, default one per core.
+ *   shards=<n>             The number of cache shards, default four per event loop.
+ *   capacity=<n>           The total number of items across all shards, default 1000000.
+ *
+ *        cap_server load [option=value ...]
+ *   port=<n>               The loopback port to connect to, default 11311.
+ *   connections=<n>        The number of connections, each on its own thread, default 4.
+ *   seconds=<n>            How long to run, default 5.
+ *   pipeline=<n>           The number of commands sent per batch on a connection, default 32.
+ *   multiget=<n>           The number of keys per get command, default 4.
+ *   keys=<n>               The number of distinct keys, default 100000.
+ *   set_ratio=<r>          The fraction of commands that are sets, default 0.1.
+ *   value_size=<n>         The size of the set values in bytes, default 100.
+ *   ttl=<n>                The exptime of the set values in seconds, default 0.
+ *
+ * Linux only.
+ */
+
+using namespace cappuccino;
+using namespace std::chrono_literals;
+
+namespace
+{
+/// Set by SIGINT or SIGTERM, every event loop exits once it sees it.
+std::atomic<bool> g_stop{false};
+
+/// The memcached limit on key length.
+constexpr size_t max_key_length{250};
+/// Anything longer without a line end is not a command.
+constexpr size_t max_line_length{8192};
+/// The memcached default item size limit, larger data blocks are rejected and discarded.
+constexpr size_t max_item_size{1024 * 1024};
+/// Reading stops at this much buffered input, enough for the longest complete set command.
+constexpr size_t max_input_buffer{max_line_length + max_item_size + 2};
+/// Commands and reading stop while this much output is waiting for a client that does not read.
+constexpr size_t max_output_buffer{4 * 1024 * 1024};
+/// The memcached exptime above which it is an absolute unix time rather than relative seconds.
+constexpr int64_t max_relative_exptime{60 * 60 * 24 * 30};
+/// The TTL of items that never expire.
+constexpr std::chrono::milliseconds never_expires{std::chrono::hours{24 * 365 * 10}};
+
+struct item
+{
+    uint32_t    flags{0};
+    uint64_t    cas{0};
+    std::string data{};
+};
+
+/**
+ * Spreads the keys across independently locked tlru_caches so the event loops rarely contend.
+ */
+class sharded_cache
+{
+public:
+    using shard_type = tlru_cache<std::string, item>;
+
+    sharded_cache(size_t shard_count, size_t capacity)
+    {
+        m_shards.reserve(shard_count);
+        for (size_t i = 0; i < shard_count; ++i)
+        {
+            m_shards.emplace_back(std::make_unique<shard_type>(std::max(capacity / shard_count, size_t{1})));
+        }
+    }
+
+    auto shard_index(std::string_view key) const -> size_t
+    {
+        return std::hash<std::string_view>{}(key) % m_shards.size();
+    }
+
+    auto shard(size_t index) -> shard_type& { return *m_shards[index]; }
+
+    auto shard(std::string_view key) -> shard_type& { return *m_shards[shard_index(key)]; }
+
+    auto shard_count() const -> size_t { return m_shards.size(); }
+
+    auto next_cas() -> uint64_t { return m_cas.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+private:
+    std::vector<std::unique_ptr<shard_type>> m_shards{};
+    std::atomic<uint64_t>                    m_cas{0};
+};
+
+/**
+ * Converts a memcached exptime into a TTL.
+ * @return The TTL, or std::nullopt if the item is already expired.
+ */
+auto exptime_to_ttl(int64_t exptime) -> std::optional<std::chrono::milliseconds>
+{
+    if (exptime == 0)
+    {
+        return never_expires;
+    }
+    if (exptime < 0)
+    {
+        return std::nullopt;
+    }
+    if (exptime > max_relative_exptime)
+    {
+        exptime -= static_cast<int64_t>(std::time(nullptr));
+        if (exptime <= 0)
+        {
+            return std::nullopt;
+        }
+    }
+    return std::chrono::seconds{exptime};
+}
+
+template<typename integer_type>
+auto parse_number(std::string_view text, integer_type& out) -> bool
+{
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc{} && end == text.data() + text.size() && !text.empty();
+}
+
+auto split(std::string_view line, std::vector<std::string_view>& tokens) -> void
+{
+    tokens.clear();
+    size_t pos = 0;
+    while (pos < line.size())
+    {
+        auto start = line.find_first_not_of(' ', pos);
+        if (start == std::string_view::npos)
+        {
+            break;
+        }
+        auto end = line.find(' ', start);
+        if (end == std::string_view::npos)
+        {
+            end = line.size();
+        }
+        tokens.emplace_back(line.substr(start, end - start));
+        pos = end;
+    }
+}
+
+struct connection
+{
+    int         fd{-1};
+    std::string in{};
+    std::string out{};
+    size_t      out_offset{0};
+    /// The bytes of a rejected data block that are still to be discarded from the input.
+    uint64_t    swallow{0};
+    bool        closing{false};
+    /// The events the connection is registered for in epoll.
+    uint32_t    events{EPOLLIN};
+};
+
+/**
+ * Executes the commands on one connection, each event loop owns one.
+ */
+class protocol
+{
+public:
+    explicit protocol(sharded_cache& cache) : m_cache(cache) {}
+
+    /**
+     * Executes every complete command in the connection's input buffer and appends the responses
+     * to its output buffer, an incomplete trailing command is left in the input buffer.
+     * @return True if it stopped early because the output buffer is full, the remaining commands
+     *         are executed once the output has been written.
+     */
+    auto process(connection& conn) -> bool
+    {
+        std::string_view in{conn.in};
+        size_t           pos = 0;
+        bool             full{false};
+        while (!conn.closing)
+        {
+            if (conn.swallow > 0)
+            {
+                auto skipped = std::min(conn.swallow, static_cast<uint64_t>(in.size() - pos));
+                pos += skipped;
+                conn.swallow -= skipped;
+                if (conn.swallow > 0)
+                {
+                    break;
+                }
+            }
+            if (conn.out.size() - conn.out_offset >= max_output_buffer)
+            {
+                full = true;
+                break;
+            }
+
+            auto eol = in.find("\r\n", pos);
+            if (eol == std::string_view::npos)
+            {
+                if (in.size() - pos > max_line_length)
+                {
+                    conn.out.append("CLIENT_ERROR line too long\r\n");
+                    conn.closing = true;
+                }
+                break;
+            }
+
+            split(in.substr(pos, eol - pos), m_tokens);
+            size_t next = eol + 2;
+            if (m_tokens.empty())
+            {
+                conn.out.append("ERROR\r\n");
+                pos = next;
+                continue;
+            }
+
+            auto command = m_tokens[0];
+            if (command == "get" || command == "gets")
+            {
+                get(conn, command == "gets");
+            }
+            else if (command == "set" || command == "ms")
+            {
+                // Both carry a data block after the command line.
+                size_t  bytes_token = (command == "set") ? 4 : 2;
+                int64_t bytes{-1};
+                if (m_tokens.size() <= bytes_token || !parse_number(m_tokens[bytes_token], bytes) || bytes < 0)
+                {
+                    conn.out.append("CLIENT_ERROR bad command line format\r\n");
+                    conn.closing = true;
+                    break;
+                }
+                if (static_cast<uint64_t>(bytes) > max_item_size)
+                {
+                    conn.out.append("SERVER_ERROR object too large for cache\r\n");
+                    conn.swallow = static_cast<uint64_t>(bytes) + 2;
+                    pos          = next;
+                    continue;
+                }
+                auto data_end = next + static_cast<size_t>(bytes);
+                if (in.size() < data_end + 2)
+                {
+                    break;
+                }
+                if (in.substr(data_end, 2) != "\r\n")
+                {
+                    conn.out.append("CLIENT_ERROR bad data chunk\r\n");
+                    conn.closing = true;
+                    break;
+                }
+                auto data = in.substr(next, static_cast<size_t>(bytes));
+                (command == "set") ? set(conn, data) : meta_set(conn, data);
+                next = data_end + 2;
+            }
+            else if (command == "delete")
+            {
+                erase(conn);
+            }
+            else if (command == "touch")
+            {
+                touch(conn);
+            }
+            else if (command == "mg")
+            {
+                meta_get(conn);
+            }
+            else if (command == "md")
+            {
+                meta_delete(conn);
+            }
+            else if (command == "mn")
+            {
+                conn.out.append("MN\r\n");
+            }
+            else if (command == "version")
+            {
+                conn.out.append("VERSION cappuccino\r\n");
+            }
+            else if (command == "quit")
+            {
+                conn.closing = true;
+            }
+            else
+            {
+                conn.out.append("ERROR\r\n");
+            }
+            pos = next;
+        }
+        conn.in.erase(0, pos);
+        return full;
+    }
+
+private:
+    sharded_cache&                m_cache;
+    std::vector<std::string_view> m_tokens{};
+    /// The keys of a multi key get grouped by shard, reused between gets.
+    std::vector<std::vector<std::pair<std::string, std::optional<item>>>> m_shard_lookups{};
+    /// The shard and position within the shard's lookups of each key of a multi key get.
+    std::vector<std::pair<size_t, size_t>> m_key_slots{};
+
+    static auto valid_key(std::string_view key) -> bool { return !key.empty() && key.size() <= max_key_length; }
+
+    static auto noreply(const std::vector<std::string_view>& tokens, size_t index) -> bool
+    {
+        return tokens.size() > index && tokens[index] == "noreply";
+    }
+
+    auto reply(connection& conn, bool quiet, std::string_view response) -> void
+    {
+        if (!quiet)
+        {
+            conn.out.append(response);
+        }
+    }
+
+    auto get(connection& conn, bool with_cas) -> void
+    {
+        if (m_tokens.size() < 2)
+        {
+            conn.out.append("ERROR\r\n");
+            return;
+        }
+        for (size_t i = 1; i < m_tokens.size(); ++i)
+        {
+            if (!valid_key(m_tokens[i]))
+            {
+                conn.out.append("CLIENT_ERROR bad command line format\r\n");
+                return;
+            }
+        }
+
+        m_shard_lookups.resize(m_cache.shard_count());
+        for (auto& lookups : m_shard_lookups)
+        {
+            lookups.clear();
+        }
+        m_key_slots.clear();
+        for (size_t i = 1; i < m_tokens.size(); ++i)
+        {
+            auto  shard   = m_cache.shard_index(m_tokens[i]);
+            auto& lookups = m_shard_lookups[shard];
+            m_key_slots.emplace_back(shard, lookups.size());
+            lookups.emplace_back(std::string{m_tokens[i]}, std::nullopt);
+        }
+        for (size_t shard = 0; shard < m_shard_lookups.size(); ++shard)
+        {
+            if (!m_shard_lookups[shard].empty())
+            {
+                m_cache.shard(shard).find_range_fill(m_shard_lookups[shard]);
+            }
+        }
+
+        for (auto [shard, slot] : m_key_slots)
+        {
+            auto& [key, value] = m_shard_lookups[shard][slot];
+            if (value.has_value())
+            {
+                conn.out.append("VALUE ").append(key).append(" ").append(std::to_string(value->flags));
+                conn.out.append(" ").append(std::to_string(value->data.size()));
+                if (with_cas)
+                {
+                    conn.out.append(" ").append(std::to_string(value->cas));
+                }
+                conn.out.append("\r\n").append(value->data).append("\r\n");
+            }
+        }
+        conn.out.append("END\r\n");
+    }
+
+    auto set(connection& conn, std::string_view data) -> void
+    {
+        uint32_t flags{0};
+        int64_t  exptime{0};
+        if (m_tokens.size() < 5 || !valid_key(m_tokens[1]) || !parse_number(m_tokens[2], flags) ||
+            !parse_number(m_tokens[3], exptime))
+        {
+            conn.out.append("CLIENT_ERROR bad command line format\r\n");
+            return;
+        }
+
+        store(m_tokens[1], flags, exptime_to_ttl(exptime), data);
+        reply(conn, noreply(m_tokens, 5), "STORED\r\n");
+    }
+
+    auto erase(connection& conn) -> void
+    {
+        if (m_tokens.size() < 2 || !valid_key(m_tokens[1]))
+        {
+            conn.out.append("CLIENT_ERROR bad command line format\r\n");
+            return;
+        }
+
+        std::string key{m_tokens[1]};
+        bool        erased = m_cache.shard(key).erase(key);
+        reply(conn, noreply(m_tokens, 2), erased ? "DELETED\r\n" : "NOT_FOUND\r\n");
+    }
+
+    auto touch(connection& conn) -> void
+    {
+        int64_t exptime{0};
+        if (m_tokens.size() < 3 || !valid_key(m_tokens[1]) || !parse_number(m_tokens[2], exptime))
+        {
+            conn.out.append("CLIENT_ERROR bad command line format\r\n");
+            return;
+        }
+
+        reply(conn, noreply(m_tokens, 3), touch_key(m_tokens[1], exptime) ? "TOUCHED\r\n" : "NOT_FOUND\r\n");
+    }
+
+    auto meta_get(connection& conn) -> void
+    {
+        if (m_tokens.size() < 2 || !valid_key(m_tokens[1]))
+        {
+            conn.out.append("CLIENT_ERROR bad command line format\r\n");
+            return;
+        }
+
+        bool             quiet{false};
+        bool             return_value{false};
+        std::string_view opaque{};
+        std::string      return_flags{};
+        std::string      key{m_tokens[1]};
+        auto&            shard = m_cache.shard(key);
+        for (size_t i = 2; i < m_tokens.size(); ++i)
+        {
+            auto flag = m_tokens[i];
+            switch (flag[0])
+            {
+                case 'q':
+                    quiet = true;
+                    break;
+                case 'v':
+                    return_value = true;
+                    break;
+                case 'O':
+                    opaque = flag;
+                    break;
+                case 'T':
+                {
+                    int64_t exptime{0};
+                    if (parse_number(flag.substr(1), exptime))
+                    {
+                        touch_key(key, exptime);
+                    }
+                }
+                break;
+                default:
+                    break;
+            }
+        }
+
+        auto value = shard.find(key);
+        if (!value.has_value())
+        {
+            reply(conn, quiet, "EN\r\n");
+            return;
+        }
+
+        for (size_t i = 2; i < m_tokens.size(); ++i)
+        {
+            switch (m_tokens[i][0])
+            {
+                case 'f':
+                    return_flags.append(" f").append(std::to_string(value->flags));
+                    break;
+                case 'c':
+                    return_flags.append(" c").append(std::to_string(value->cas));
+                    break;
+                case 'k':
+                    return_flags.append(" k").append(key);
+                    break;
+                case 's':
+                    return_flags.append(" s").append(std::to_string(value->data.size()));
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (!opaque.empty())
+        {
+            return_flags.append(" ").append(opaque);
+        }
+
+        if (return_value)
+        {
+            conn.out.append("VA ").append(std::to_string(value->data.size())).append(return_flags).append("\r\n");
+            conn.out.append(value->data).append("\r\n");
+        }
+        else
+        {
+            conn.out.append("HD").append(return_flags).append("\r\n");
+        }
+    }
+
+    auto meta_set(connection& conn, std::string_view data) -> void
+    {
+        if (!valid_key(m_tokens[1]))
+        {
+            conn.out.append("CLIENT_ERROR bad command line format\r\n");
+            return;
+        }
+
+        bool        quiet{false};
+        uint32_t    flags{0};
+        int64_t     exptime{0};
+        std::string return_flags{};
+        for (size_t i = 3; i < m_tokens.size(); ++i)
+        {
+            auto flag = m_tokens[i];
+            switch (flag[0])
+            {
+                case 'q':
+                    quiet = true;
+                    break;
+                case 'F':
+                    parse_number(flag.substr(1), flags);
+                    break;
+                case 'T':
+                    parse_number(flag.substr(1), exptime);
+                    break;
+                case 'k':
+                    return_flags.append(" k").append(m_tokens[1]);
+                    break;
+                case 'O':
+                    return_flags.append(" ").append(flag);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        store(m_tokens[1], flags, exptime_to_ttl(exptime), data);
+        if (!quiet)
+        {
+            conn.out.append("HD").append(return_flags).append("\r\n");
+        }
+    }
+
+    auto meta_delete(connection& conn) -> void
+    {
+        if (m_tokens.size() < 2 || !valid_key(m_tokens[1]))
+        {
+            conn.out.append("CLIENT_ERROR bad command line format\r\n");
+            return;
+        }
+
+        bool        quiet{false};
+        std::string return_flags{};
+        for (size_t i = 2; i < m_tokens.size(); ++i)
+        {
+            auto flag = m_tokens[i];
+            switch (flag[0])
+            {
+                case 'q':
+                    quiet = true;
+                    break;
+                case 'k':
+                    return_flags.append(" k").append(m_tokens[1]);
+                    break;
+                case 'O':
+                    return_flags.append(" ").append(flag);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        std::string key{m_tokens[1]};
+        bool        erased = m_cache.shard(key).erase(key);
+        reply(conn, quiet, (erased ? "HD" : "NF") + return_flags + "\r\n");
+    }
+
+    auto store(
+        std::string_view                         key_view,
+        uint32_t                                 flags,
+        std::optional<std::chrono::milliseconds> ttl,
+        std::string_view                         data) -> void
+    {
+        std::string key{key_view};
+        auto&       shard = m_cache.shard(key);
+        if (!ttl.has_value())
+        {
+            // Storing an already expired item only removes the previous one.
+            shard.erase(key);
+            return;
+        }
+        shard.insert(ttl.value(), key, item{flags, m_cache.next_cas(), std::string{data}});
+    }
+
+    auto touch_key(std::string_view key_view, int64_t exptime) -> bool
+    {
+        std::string key{key_view};
+        auto&       shard = m_cache.shard(key);
+        auto        ttl   = exptime_to_ttl(exptime);
+        if (!ttl.has_value())
+        {
+            return shard.erase(key);
+        }
+        return shard.touch(key, ttl.value());
+    }
+};
+
+auto pin_to_core(size_t index) -> void
+{
+    auto cores = std::max(std::thread::hardware_concurrency(), 1u);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+auto listen_loopback(uint16_t port) -> int
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    int enable{1};
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+
+    sockaddr_in address{};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * One event loop, accepts its share of the connections and serves them until g_stop is set.
+ */
+class event_loop
+{
+public:
+    event_loop(sharded_cache& cache, int listen_fd) : m_protocol(cache), m_listen_fd(listen_fd) {}
+
+    event_loop(const event_loop&) = delete;
+    auto operator=(const event_loop&) -> event_loop& = delete;
+
+    ~event_loop()
+    {
+        for (auto& [fd, conn] : m_connections)
+        {
+            close(fd);
+        }
+        close(m_listen_fd);
+        if (m_epoll_fd >= 0)
+        {
+            close(m_epoll_fd);
+        }
+    }
+
+    auto run() -> void
+    {
+        m_epoll_fd = epoll_create1(0);
+        epoll_event event{};
+        event.events  = EPOLLIN;
+        event.data.fd = m_listen_fd;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_fd, &event);
+
+        std::vector<epoll_event> events(256);
+        while (!g_stop.load(std::memory_order_relaxed))
+        {
+            int ready = epoll_wait(m_epoll_fd, events.data(), static_cast<int>(events.size()), 100);
+            for (int i = 0; i < ready; ++i)
+            {
+                int fd = events[i].data.fd;
+                if (fd == m_listen_fd)
+                {
+                    accept_all();
+                    continue;
+                }
+
+                auto found = m_connections.find(fd);
+                if (found == m_connections.end())
+                {
+                    continue;
+                }
+                auto& conn = *found->second;
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                {
+                    disconnect(fd);
+                    continue;
+                }
+                if ((events[i].events & EPOLLIN) && !read_all(conn))
+                {
+                    disconnect(fd);
+                    continue;
+                }
+                if (!serve(conn) || (conn.closing && conn.out_offset == conn.out.size()))
+                {
+                    disconnect(fd);
+                }
+            }
+        }
+    }
+
+private:
+    protocol                                             m_protocol;
+    int                                                  m_listen_fd{-1};
+    int                                                  m_epoll_fd{-1};
+    std::unordered_map<int, std::unique_ptr<connection>> m_connections{};
+
+    auto accept_all() -> void
+    {
+        while (true)
+        {
+            int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+            if (fd < 0)
+            {
+                return;
+            }
+            int enable{1};
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+            auto conn = std::make_unique<connection>();
+            conn->fd  = fd;
+            epoll_event event{};
+            event.events  = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            m_connections.emplace(fd, std::move(conn));
+        }
+    }
+
+    /**
+     * Reads until the socket is empty or the input buffer is full, epoll is level triggered so the
+     * rest is read once the buffered commands have been executed.
+     * @return False if the peer closed the connection or it failed.
+     */
+    auto read_all(connection& conn) -> bool
+    {
+        char buffer[16384];
+        while (conn.in.size() < max_input_buffer)
+        {
+            auto bytes = recv(conn.fd, buffer, sizeof(buffer), 0);
+            if (bytes > 0)
+            {
+                conn.in.append(buffer, static_cast<size_t>(bytes));
+                continue;
+            }
+            if (bytes == 0)
+            {
+                return false;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        return true;
+    }
+
+    /**
+     * Executes the buffered commands and writes the responses.
+     * @return False if the connection failed.
+     */
+    auto serve(connection& conn) -> bool
+    {
+        while (true)
+        {
+            bool full = m_protocol.process(conn);
+            if (!flush(conn))
+            {
+                return false;
+            }
+            // Output that was written at once arms no EPOLLOUT to resume the remaining commands.
+            if (!full || !conn.out.empty())
+            {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Writes as much of the pending responses as the socket takes, waits for EPOLLOUT for the rest.
+     * Reading is paused while the pending responses are over max_output_buffer.
+     * @return False if the connection failed.
+     */
+    auto flush(connection& conn) -> bool
+    {
+        while (conn.out_offset < conn.out.size())
+        {
+            auto bytes =
+                send(conn.fd, conn.out.data() + conn.out_offset, conn.out.size() - conn.out_offset, MSG_NOSIGNAL);
+            if (bytes < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    break;
+                }
+                return false;
+            }
+            conn.out_offset += static_cast<size_t>(bytes);
+        }
+
+        bool drained = conn.out_offset == conn.out.size();
+        if (drained)
+        {
+            conn.out.clear();
+            conn.out_offset = 0;
+        }
+        bool     readable = conn.out.size() - conn.out_offset < max_output_buffer;
+        uint32_t events   = (readable ? static_cast<uint32_t>(EPOLLIN) : 0u) |
+                          (drained ? 0u : static_cast<uint32_t>(EPOLLOUT));
+        if (events != conn.events)
+        {
+            conn.events = events;
+            epoll_event event{};
+            event.events  = events;
+            event.data.fd = conn.fd;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, conn.fd, &event);
+        }
+        return true;
+    }
+
+    auto disconnect(int fd) -> void
+    {
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        m_connections.erase(fd);
+    }
+};
+
+struct server_config
+{
+    uint16_t port{11311};
+    size_t   threads{std::max(std::thread::hardware_concurrency(), 1u)};
+    size_t   shards{0};
+    size_t   capacity{1000000};
+};
+
+auto serve(const server_config& config) -> int
+{
+    auto          shards = config.shards != 0 ? config.shards : config.threads * 4;
+    sharded_cache cache{shards, config.capacity};
+
+    std::vector<std::unique_ptr<event_loop>> loops{};
+    for (size_t i = 0; i < config.threads; ++i)
+    {
+        int fd = listen_loopback(config.port);
+        if (fd < 0)
+        {
+            std::cerr << "unable to listen on 127.0.0.1:" << config.port << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+        loops.emplace_back(std::make_unique<event_loop>(cache, fd));
+    }
+
+    std::signal(SIGINT, [](int) { g_stop = true; });
+    std::signal(SIGTERM, [](int) { g_stop = true; });
+
+    std::cout << "serving " << shards << " shards of " << std::max(config.capacity / shards, size_t{1})
+              << " items on 127.0.0.1:" << config.port << " with " << config.threads << " event loops\n";
+
+    std::vector<std::thread> threads{};
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        threads.emplace_back([&, i]() {
+            pin_to_core(i);
+            loops[i]->run();
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    return 0;
+}
+
+struct load_config
+{
+    uint16_t port{11311};
+    size_t   connections{4};
+    size_t   seconds{5};
+    size_t   pipeline{32};
+    size_t   multiget{4};
+    size_t   keys{100000};
+    double   set_ratio{0.1};
+    size_t   value_size{100};
+    int64_t  ttl{0};
+};
+
+struct load_result
+{
+    uint64_t              commands{0};
+    uint64_t              keys_requested{0};
+    uint64_t              hits{0};
+    uint64_t              errors{0};
+    std::vector<uint64_t> batch_ns{};
+};
+
+/**
+ * Reads the responses to a batch of commands, every command's response ends with an END, a
+ * STORED or an error line.
+ * @return False if the connection failed.
+ */
+auto read_responses(int fd, std::string& buffer, size_t expected, load_result& result) -> bool
+{
+    size_t pos = 0;
+    char   chunk[65536];
+    while (expected > 0)
+    {
+        auto eol = buffer.find("\r\n", pos);
+        if (eol == std::string::npos)
+        {
+            buffer.erase(0, pos);
+            pos        = 0;
+            auto bytes = recv(fd, chunk, sizeof(chunk), 0);
+            if (bytes <= 0)
+            {
+                return false;
+            }
+            buffer.append(chunk, static_cast<size_t>(bytes));
+            continue;
+        }
+
+        std::string_view line{buffer.data() + pos, eol - pos};
+        if (line.substr(0, 6) == "VALUE ")
+        {
+            size_t bytes{0};
+            parse_number(line.substr(line.rfind(' ') + 1), bytes);
+            if (buffer.size() < eol + 2 + bytes + 2)
+            {
+                buffer.erase(0, pos);
+                pos        = 0;
+                auto count = recv(fd, chunk, sizeof(chunk), 0);
+                if (count <= 0)
+                {
+                    return false;
+                }
+                buffer.append(chunk, static_cast<size_t>(count));
+                continue;
+            }
+            ++result.hits;
+            pos = eol + 2 + bytes + 2;
+            continue;
+        }
+
+        if (line != "END" && line != "STORED")
+        {
+            ++result.errors;
+        }
+        --expected;
+        pos = eol + 2;
+    }
+    buffer.erase(0, pos);
+    return true;
+}
+
+auto connect_loopback(uint16_t port) -> int
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    int enable{1};
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    sockaddr_in address{};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+auto send_all(int fd, const std::string& request) -> bool
+{
+    size_t offset = 0;
+    while (offset < request.size())
+    {
+        auto bytes = send(fd, request.data() + offset, request.size() - offset, MSG_NOSIGNAL);
+        if (bytes <= 0)
+        {
+            return false;
+        }
+        offset += static_cast<size_t>(bytes);
+    }
+    return true;
+}
+
+auto run_connection(const load_config& config, size_t index, load_result& result) -> bool
+{
+    int fd = connect_loopback(config.port);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    std::mt19937_64                        rng{0xcafe + index};
+    std::uniform_int_distribution<size_t>  key_distribution{0, config.keys - 1};
+    std::uniform_real_distribution<double> command_distribution{0.0, 1.0};
+    std::string                            value(config.value_size, 'v');
+    std::string                            request{};
+    std::string                            buffer{};
+
+    bool ok       = true;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{config.seconds};
+    while (ok && std::chrono::steady_clock::now() < deadline)
+    {
+        request.clear();
+        for (size_t i = 0; i < config.pipeline; ++i)
+        {
+            if (command_distribution(rng) < config.set_ratio)
+            {
+                request.append("set key:").append(std::to_string(key_distribution(rng))).append(" 0 ");
+                request.append(std::to_string(config.ttl)).append(" ").append(std::to_string(value.size()));
+                request.append("\r\n").append(value).append("\r\n");
+            }
+            else
+            {
+                request.append("get");
+                for (size_t k = 0; k < config.multiget; ++k)
+                {
+                    request.append(" key:").append(std::to_string(key_distribution(rng)));
+                }
+                request.append("\r\n");
+                result.keys_requested += config.multiget;
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        ok         = send_all(fd, request) && read_responses(fd, buffer, config.pipeline, result);
+        auto stop  = std::chrono::steady_clock::now();
+        if (ok)
+        {
+            result.commands += config.pipeline;
+            result.batch_ns.push_back(
+                static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+        }
+    }
+
+    close(fd);
+    return ok;
+}
+
+auto load(const load_config& config) -> int
+{
+    std::vector<load_result> results(config.connections);
+    std::vector<std::thread> threads{};
+    std::atomic<size_t>      failures{0};
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < config.connections; ++i)
+    {
+        threads.emplace_back([&, i]() {
+            if (!run_connection(config, i, results[i]))
+            {
+                ++failures;
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " of " << config.connections << " connections to 127.0.0.1:" << config.port
+                  << " failed\n";
+        return 1;
+    }
+
+    load_result total{};
+    for (auto& result : results)
+    {
+        total.commands += result.commands;
+        total.keys_requested += result.keys_requested;
+        total.hits += result.hits;
+        total.errors += result.errors;
+        total.batch_ns.insert(total.batch_ns.end(), result.batch_ns.begin(), result.batch_ns.end());
+    }
+    std::sort(total.batch_ns.begin(), total.batch_ns.end());
+    auto percentile = [&](double p) -> double {
+        if (total.batch_ns.empty())
+        {
+            return 0.0;
+        }
+        auto index = static_cast<size_t>(p * static_cast<double>(total.batch_ns.size() - 1));
+        return static_cast<double>(total.batch_ns[index]) / 1000.0;
+    };
+    auto hit_ratio =
+        total.keys_requested > 0 ? static_cast<double>(total.hits) / static_cast<double>(total.keys_requested) : 0.0;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "connections=" << config.connections << " pipeline=" << config.pipeline
+              << " multiget=" << config.multiget << " keys=" << config.keys << " set_ratio=" << config.set_ratio
+              << "\n";
+    std::cout << "commands/s " << static_cast<double>(total.commands) / elapsed << "\n";
+    std::cout << "keys/s " << static_cast<double>(total.keys_requested) / elapsed << "\n";
+    std::cout << "hit ratio " << hit_ratio << "\n";
+    std::cout << "batch latency us p50 " << percentile(0.50) << " p99 " << percentile(0.99) << " p99.9 "
+              << percentile(0.999) << "\n";
+    std::cout << "errors " << total.errors << "\n";
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string mode{argc > 1 ? argv[1] : ""};
+    if (mode != "serve" && mode != "load")
+    {
+        std::cerr << "usage: " << argv[0] << " serve|load [option=value ...]\n";
+        return 2;
+    }
+
+    server_config server{};
+    load_config   client{};
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg{argv[i]};
+        auto        eq = arg.find('=');
+        if (eq == std::string::npos)
+        {
+            std::cerr << "unknown argument '" << arg << "', expected option=value\n";
+            return 2;
+        }
+        auto option = arg.substr(0, eq);
+        auto value  = arg.substr(eq + 1);
+
+        if (option == "port")
+        {
+            server.port = client.port = static_cast<uint16_t>(std::stoul(value));
+        }
+        else if (option == "threads")
+        {
+            server.threads = std::max(std::stoull(value), 1ull);
+        }
+        else if (option == "shards")
+        {
+            server.shards = std::stoull(value);
+        }
+        else if (option == "capacity")
+        {
+            server.capacity = std::max(std::stoull(value), 1ull);
+        }
+        else if (option == "connections")
+        {
+            client.connections = std::max(std::stoull(value), 1ull);
+        }
+        else if (option == "seconds")
+        {
+            client.seconds = std::max(std::stoull(value), 1ull);
+        }
+        else if (option == "pipeline")
+        {
+            client.pipeline = std::max(std::stoull(value), 1ull);
+        }
+        else if (option == "multiget")
+        {
+            client.multiget = std::max(std::stoull(value), 1ull);
+        }
+        else if (option == "keys")
+        {
+            client.keys = std::max(std::stoull(value), 1ull);
+        }
+        else if (option == "set_ratio")
+        {
+            client.set_ratio = std::stod(value);
+        }
+        else if (option == "value_size")
+        {
+            client.value_size = std::stoull(value);
+        }
+        else if (option == "ttl")
+        {
+            client.ttl = std::stoll(value);
+        }
+        else
+        {
+            std::cerr << "unknown option '" << option << "'\n";
+            return 2;
+        }
+    }
+
+    return (mode == "serve") ? serve(server) : load(client);
+}
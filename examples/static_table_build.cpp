@@ -0,0 +1,69 @@
+#include <cappuccino/cappuccino.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Builds a static_table file from a text file of unsigned integer key value pairs, one pair per
+ * line separated by whitespace.  The table can then be opened with
+ * static_table<uint64_t, uint64_t> by any number of processes.
+ *
+ * Usage: cap_static_table_build <input> <output> [key ...]
+ *   Any keys after the output are looked up in the freshly built table and printed.
+ */
+
+using namespace cappuccino;
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <input> <output> [key ...]\n";
+        return 2;
+    }
+
+    std::ifstream in{argv[1]};
+    if (!in)
+    {
+        std::cerr << "unable to open " << argv[1] << "\n";
+        return 2;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> elements{};
+    uint64_t                                   key{0};
+    uint64_t                                   value{0};
+    while (in >> key >> value)
+    {
+        elements.emplace_back(key, value);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!static_table<uint64_t, uint64_t>::build(argv[2], elements))
+    {
+        std::cerr << "failed to build " << argv[2] << ", the keys must be unique\n";
+        return 1;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "built " << argv[2] << " with " << elements.size() << " keys in " << elapsed.count() << "ms\n";
+
+    static_table<uint64_t, uint64_t> table{argv[2]};
+    if (!table.is_open())
+    {
+        std::cerr << "unable to open " << argv[2] << "\n";
+        return 1;
+    }
+
+    for (int i = 3; i < argc; ++i)
+    {
+        auto lookup = std::stoull(argv[i]);
+        auto found  = table.find(lookup);
+        std::cout << lookup << " => " << (found.has_value() ? std::to_string(found.value()) : "not found") << "\n";
+    }
+
+    return 0;
+}
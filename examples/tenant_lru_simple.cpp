@@ -0,0 +1,30 @@
+#include <cappuccino/cappuccino.hpp>
+
+#include <iostream>
+
+int main()
+{
+    // Two tenants share a cache of 4 items, by default each has a soft quota of 2.
+    cappuccino::tenant_lru_cache<uint64_t, std::string> cache{4, 2};
+
+    // The quiet tenant 0 caches its two items.
+    cache.insert(0, 1, "Hello");
+    cache.insert(0, 2, "World");
+
+    // The noisy tenant 1 inserts far more than its share, it only evicts its own items
+    // once it is over its quota.
+    for (uint64_t key = 100; key < 200; ++key)
+    {
+        cache.insert(1, key, "noise");
+    }
+
+    auto hello = cache.find(0, 1);
+    auto world = cache.find(0, 2);
+    std::cout << hello.value() << ", " << world.value() << "!" << std::endl;
+
+    auto noisy = cache.tenant_stats(1);
+    std::cout << "noisy tenant holds " << noisy.m_size << " items and had " << noisy.m_evictions << " evictions"
+              << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <cappuccino/cappuccino.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+int main()
+{
+    using namespace std::chrono_literals;
+
+    // Create a set of recently seen ids with a uniform TTL of 1 second.
+    cappuccino::ut_roaring_set<uint32_t> set{1s};
+
+    // Insert a million consecutive ids, they are stored as bitmaps rather than a node per id.
+    std::vector<uint32_t> ids(1'000'000);
+    std::iota(ids.begin(), ids.end(), 0);
+    set.insert_range(ids);
+
+    std::cout << "Tracking " << set.size() << " ids in " << set.memory_usage() << " bytes." << std::endl;
+
+    if (set.find(42) && !set.find(2'000'000))
+    {
+        std::cout << "42 has been seen recently, 2000000 has not!" << std::endl;
+    }
+
+    // Sleep for longer than the TTL to evict the ids.
+    std::this_thread::sleep_for(1200ms);
+
+    if (!set.find(42))
+    {
+        std::cout << "Everything is gone from the uniform time aware roaring set!" << std::endl;
+    }
+
+    return 0;
+}
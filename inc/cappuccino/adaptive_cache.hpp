@@ -0,0 +1,530 @@
+#pragma once
+
+#include "cappuccino/allow.hpp"
+#include "cappuccino/eviction_policy.hpp"
+#include "cappuccino/fifo_cache.hpp"
+#include "cappuccino/index_stats.hpp"
+#include "cappuccino/lfu_cache.hpp"
+#include "cappuccino/lock.hpp"
+#include "cappuccino/lru_cache.hpp"
+#include "cappuccino/peek.hpp"
+#include "cappuccino/trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace cappuccino
+{
+/**
+ * Adaptive Cache.
+ * A fixed size cache that switches its eviction policy at runtime between least recently used,
+ * least frequently used and first in first out, whichever is winning on the recent traffic.
+ *
+ * Alongside the resident key value pairs the cache runs a key only shadow simulation of every
+ * candidate policy with the existing lru_cache, lfu_cache and fifo_cache.  Every find and insert
+ * is replayed against the shadows and their hits are counted.  After every evaluation window of
+ * finds the policy with the most shadow hits in the window becomes the resident eviction policy,
+ * the resident elements keep their access metadata so the new eviction ordering is rebuilt in
+ * place without losing any elements.
+ *
+ * This costs the memory of three key only caches plus an ordered set for the eviction order, and
+ * every operation is O(log n) rather than O(1).  It pays off when the traffic mix changes over
+ * time and no single static policy is right for all of it.
+ *
+ * This cache is thread_safe aware and can be used concurrently from multiple threads safely.
+ * To remove locks/synchronization use NO when creating the cache.
+ *
+ * @tparam key_type The key type.  Must support std::hash().
+ * @tparam value_type The value type.  This is returned by copy on a find, so if your data
+ *                   structure value is large it is advisable to store in a shared ptr.
+ * @tparam thread_safe_type By default this cache is thread safe, can be disabled for caches specific
+ *                  to a single thread.
+ */
+template<typename key_type, typename value_type, thread_safe thread_safe_type = thread_safe::yes>
+class adaptive_cache
+{
+private:
+    using keyed_iterator = typename std::unordered_map<key_type, size_t>::iterator;
+    /// An element's position in the eviction order, the smallest rank is evicted first.
+    using rank_type = std::tuple<uint64_t, uint64_t, size_t>;
+
+    /// The shadow simulations only track keys.
+    struct shadow_value
+    {
+    };
+
+public:
+    /// The number of candidate policies.
+    static constexpr size_t policy_count = 3;
+
+    /**
+     * @param capacity The maximum number of key value pairs allowed in the cache.
+     * @param evaluation_window The number of finds between policy evaluations, 0 defaults to the capacity.
+     * @param initial_policy The eviction policy to start with.
+     * @param max_load_factor The load factor for the hash map, generally 1 is a good default.
+     */
+    explicit adaptive_cache(
+        size_t          capacity,
+        size_t          evaluation_window = 0,
+        eviction_policy initial_policy    = eviction_policy::lru,
+        float           max_load_factor   = 1.0f)
+        : m_policy(initial_policy),
+          m_evaluation_window((evaluation_window == 0) ? std::max(capacity, size_t{1}) : evaluation_window),
+          m_elements(capacity),
+          m_lru_shadow(capacity, max_load_factor),
+          m_lfu_shadow(capacity, max_load_factor),
+          m_fifo_shadow(capacity, max_load_factor)
+    {
+        m_open_slots.reserve(capacity);
+        for (size_t i = capacity; i > 0; --i)
+        {
+            m_open_slots.push_back(i - 1);
+        }
+
+        m_keyed_elements.max_load_factor(max_load_factor);
+        m_keyed_elements.reserve(capacity);
+    }
+
+    /**
+     * Inserts or updates the given key value pair.
+     * @param key The key to store the value under.
+     * @param value The value of the data to store.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return True if the operation was successful based on `allow`.
+     */
+    auto insert(const key_type& key, value_type value, allow a = allow::insert_or_update) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        return do_insert_update(key, std::move(value), a);
+    }
+
+    /**
+     * Inserts or updates a range of key value pairs.  This expects a container
+     * that has 2 values in the {key_type, value_type} ordering.
+     * @tparam range_type A container with two items, key_type, value_type.
+     * @param key_value_range The elements to insert or update into the cache.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return The number of elements inserted based on `allow`.
+     */
+    template<typename range_type>
+    auto insert_range(range_type&& key_value_range, allow a = allow::insert_or_update) -> size_t
+    {
+        size_t inserted{0};
+
+        {
+            std::lock_guard guard{m_lock};
+            for (auto& [key, value] : key_value_range)
+            {
+                if (do_insert_update(key, std::move(value), a))
+                {
+                    ++inserted;
+                }
+            }
+        }
+
+        return inserted;
+    }
+
+    /**
+     * Attempts to delete the given key.
+     * @param key The key to delete from the cache.
+     * @return True if the key was deleted, false if the key does not exist.
+     */
+    auto erase(const key_type& key) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        return do_erase_key(key);
+    }
+
+    /**
+     * Attempts to delete all given keys.
+     * @tparam range_type A container with the set of keys to delete, e.g. vector<key_type>, set<key_type>.
+     * @param key_range The keys to delete from the cache.
+     * @return The number of items deleted from the cache.
+     */
+    template<typename range_type>
+    auto erase_range(const range_type& key_range) -> size_t
+    {
+        size_t deleted_elements{0};
+
+        std::lock_guard guard{m_lock};
+        for (auto& key : key_range)
+        {
+            if (do_erase_key(key))
+            {
+                ++deleted_elements;
+            }
+        }
+
+        return deleted_elements;
+    }
+
+    /**
+     * Attempts to find the given key's value.
+     * @param key The key to lookup its value.
+     * @param peek Should the find act like the item wasn't used?  Peeks are not replayed
+     *             against the shadow policies.
+     * @return An optional with the key's value if it exists, or an empty optional if it does not.
+     */
+    auto find(const key_type& key, peek peek = peek::no) -> std::optional<value_type>
+    {
+        std::lock_guard guard{m_lock};
+        return do_find(key, peek);
+    }
+
+    /**
+     * Attempts to find all the given keys values.
+     * @tparam range_type A container with the set of keys to find their values, e.g. vector<key_type>.
+     * @param key_range The keys to lookup their pairs.
+     * @param peek Should the find act like all the items were not used?
+     * @return The full set of keys to std::nullopt if the key wasn't found, or the value if found.
+     */
+    template<typename range_type>
+    auto find_range(const range_type& key_range, peek peek = peek::no)
+        -> std::vector<std::pair<key_type, std::optional<value_type>>>
+    {
+        std::vector<std::pair<key_type, std::optional<value_type>>> output;
+        output.reserve(std::size(key_range));
+
+        {
+            std::lock_guard guard{m_lock};
+            for (auto& key : key_range)
+            {
+                output.emplace_back(key, do_find(key, peek));
+            }
+        }
+
+        return output;
+    }
+
+    /**
+     * Attempts to find all the given keys values.
+     *
+     * The user should initialize this container with the keys to lookup with the values as all
+     * empty optionals.  The keys that are found will have the optionals filled in with the
+     * appropriate values from the cache.
+     *
+     * @tparam range_type A container with a pair of optional items,
+     *                   e.g. vector<pair<key_type, optional<value_type>>>
+     *                   or map<key_type, optional<value_type>>
+     * @param key_optional_value_range The keys to optional values to fill out.
+     * @param peek Should the find act like all the items were not used?
+     */
+    template<typename range_type>
+    auto find_range_fill(range_type& key_optional_value_range, peek peek = peek::no) -> void
+    {
+        std::lock_guard guard{m_lock};
+        for (auto& [key, optional_value] : key_optional_value_range)
+        {
+            optional_value = do_find(key, peek);
+        }
+    }
+
+    /**
+     * @return The eviction policy currently in use.
+     */
+    auto policy() -> eviction_policy
+    {
+        std::lock_guard guard{m_lock};
+        return m_policy;
+    }
+
+    /**
+     * @return The number of times the eviction policy has been switched.
+     */
+    auto policy_switches() -> size_t
+    {
+        std::lock_guard guard{m_lock};
+        return m_policy_switches;
+    }
+
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
+    /**
+     * @return If this cache is currenty empty.
+     */
+    auto empty() const -> bool { return m_keyed_elements.empty(); }
+
+    /**
+     * @return The number of elements inside the cache.
+     */
+    auto size() const -> size_t { return m_keyed_elements.size(); }
+
+    /**
+     * @return The maximum capacity of this cache.
+     */
+    auto capacity() const -> size_t { return m_elements.size(); }
+
+private:
+    struct element
+    {
+        /// The iterator into the keyed data structure.
+        keyed_iterator m_keyed_position;
+        /// The tick the element was inserted at, the fifo ordering.
+        uint64_t m_insert_tick;
+        /// The tick the element was last used at, the lru ordering.
+        uint64_t m_access_tick;
+        /// The number of times the element was used, the lfu ordering.
+        uint64_t m_use_count;
+        /// The element's value.
+        value_type m_value;
+    };
+
+    auto do_insert_update(const key_type& key, value_type&& value, allow a) -> bool
+    {
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            if (update_allowed(a))
+            {
+                do_update(keyed_position, std::move(value));
+                do_shadow_insert(key);
+                return true;
+            }
+        }
+        else
+        {
+            if (insert_allowed(a) && !m_elements.empty())
+            {
+                do_insert(key, std::move(value));
+                do_shadow_insert(key);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    auto do_insert(const key_type& key, value_type&& value) -> void
+    {
+        if (m_open_slots.empty())
+        {
+            do_prune();
+        }
+
+        CAPPUCCINO_PROBE3(insert, "adaptive_cache", this, &key);
+
+        auto element_idx = m_open_slots.back();
+        m_open_slots.pop_back();
+
+        element& e         = m_elements[element_idx];
+        e.m_keyed_position = m_keyed_elements.emplace(key, element_idx).first;
+        e.m_insert_tick    = ++m_tick;
+        e.m_access_tick    = e.m_insert_tick;
+        e.m_use_count      = 1;
+        e.m_value          = std::move(value);
+
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
+
+        m_eviction_order.insert(do_rank(element_idx));
+    }
+
+    auto do_update(keyed_iterator keyed_position, value_type&& value) -> void
+    {
+        CAPPUCCINO_PROBE3(update, "adaptive_cache", this, &keyed_position->first);
+
+        auto element_idx                = keyed_position->second;
+        m_elements[element_idx].m_value = std::move(value);
+        do_access(element_idx);
+    }
+
+    auto do_erase_key(const key_type& key) -> bool
+    {
+        // Keep the shadows in step with the resident store so an erased key is a miss everywhere.
+        m_lru_shadow.erase(key);
+        m_lfu_shadow.erase(key);
+        m_fifo_shadow.erase(key);
+
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            do_erase(keyed_position->second);
+            return true;
+        }
+        return false;
+    }
+
+    auto do_erase(size_t element_idx) -> void
+    {
+        element& e = m_elements[element_idx];
+        m_eviction_order.erase(do_rank(element_idx));
+        m_keyed_elements.erase(e.m_keyed_position);
+        m_open_slots.push_back(element_idx);
+    }
+
+    auto do_find(const key_type& key, peek peek) -> std::optional<value_type>
+    {
+        if (peek == peek::no)
+        {
+            do_shadow_find(key);
+        }
+
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            auto element_idx = keyed_position->second;
+            // Don't update the elements access if peeking.
+            if (peek == peek::no)
+            {
+                do_access(element_idx);
+            }
+            CAPPUCCINO_PROBE3(find_hit, "adaptive_cache", this, &key);
+            return {m_elements[element_idx].m_value};
+        }
+
+        CAPPUCCINO_PROBE3(find_miss, "adaptive_cache", this, &key);
+        return {};
+    }
+
+    auto do_access(size_t element_idx) -> void
+    {
+        element& e = m_elements[element_idx];
+        m_eviction_order.erase(do_rank(element_idx));
+        e.m_access_tick = ++m_tick;
+        ++e.m_use_count;
+        m_eviction_order.insert(do_rank(element_idx));
+    }
+
+    auto do_prune() -> void
+    {
+        if (!m_eviction_order.empty())
+        {
+            auto victim_idx = std::get<2>(*m_eviction_order.begin());
+            CAPPUCCINO_PROBE4(
+                evict,
+                "adaptive_cache",
+                this,
+                &m_elements[victim_idx].m_keyed_position->first,
+                static_cast<int>(evict_reason::capacity));
+            do_erase(victim_idx);
+        }
+    }
+
+    /**
+     * @return The element's position in the current policy's eviction order.
+     */
+    auto do_rank(size_t element_idx) const -> rank_type
+    {
+        const element& e = m_elements[element_idx];
+        switch (m_policy)
+        {
+            case eviction_policy::lfu:
+                return {e.m_use_count, e.m_access_tick, element_idx};
+            case eviction_policy::fifo:
+                return {e.m_insert_tick, 0, element_idx};
+            case eviction_policy::lru:
+            default:
+                return {e.m_access_tick, 0, element_idx};
+        }
+    }
+
+    auto do_shadow_insert(const key_type& key) -> void
+    {
+        m_lru_shadow.insert(key, shadow_value{});
+        m_lfu_shadow.insert(key, shadow_value{});
+        m_fifo_shadow.insert(key, shadow_value{});
+    }
+
+    auto do_shadow_find(const key_type& key) -> void
+    {
+        if (m_lru_shadow.find(key).has_value())
+        {
+            ++m_window_hits[static_cast<size_t>(eviction_policy::lru)];
+        }
+        if (m_lfu_shadow.find(key).has_value())
+        {
+            ++m_window_hits[static_cast<size_t>(eviction_policy::lfu)];
+        }
+        if (m_fifo_shadow.find(key).has_value())
+        {
+            ++m_window_hits[static_cast<size_t>(eviction_policy::fifo)];
+        }
+
+        if (++m_window_finds >= m_evaluation_window)
+        {
+            do_evaluate();
+        }
+    }
+
+    /**
+     * Switches to the policy with the most shadow hits in the window, the current policy is kept on ties.
+     */
+    auto do_evaluate() -> void
+    {
+        auto best = m_policy;
+        for (size_t p = 0; p < policy_count; ++p)
+        {
+            if (m_window_hits[p] > m_window_hits[static_cast<size_t>(best)])
+            {
+                best = static_cast<eviction_policy>(p);
+            }
+        }
+
+        if (best != m_policy)
+        {
+            m_policy = best;
+            ++m_policy_switches;
+
+            // Every resident element already has the metadata for every policy, only the order changes.
+            m_eviction_order.clear();
+            for (const auto& [key, element_idx] : m_keyed_elements)
+            {
+                m_eviction_order.insert(do_rank(element_idx));
+            }
+        }
+
+        m_window_hits.fill(0);
+        m_window_finds = 0;
+    }
+
+    /// Cache lock for all mutations if thread_safe is enabled.
+    mutex<thread_safe_type> m_lock;
+
+    /// The eviction policy currently ordering 'm_eviction_order'.
+    eviction_policy m_policy;
+    /// The number of times the policy was switched.
+    size_t m_policy_switches{0};
+    /// The number of finds between policy evaluations.
+    size_t m_evaluation_window;
+    /// The number of finds in the current window.
+    size_t m_window_finds{0};
+    /// The shadow hits per policy in the current window.
+    std::array<uint64_t, policy_count> m_window_hits{};
+    /// Incremented on every insert and access, orders the elements for lru and fifo.
+    uint64_t m_tick{0};
+
+    /// The main store for the key value pairs and metadata for each element.
+    std::vector<element> m_elements;
+    /// The indexes into 'm_elements' that are not in use.
+    std::vector<size_t> m_open_slots;
+    /// The keyed lookup data structure, the value is the index into 'm_elements'.
+    std::unordered_map<key_type, size_t> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
+    /// The resident elements ordered by the current policy, the first element is the next victim.
+    std::set<rank_type> m_eviction_order;
+
+    /// Key only simulations of each candidate policy at the same capacity.
+    lru_cache<key_type, shadow_value, thread_safe::no>  m_lru_shadow;
+    lfu_cache<key_type, shadow_value, thread_safe::no>  m_lfu_shadow;
+    fifo_cache<key_type, shadow_value, thread_safe::no> m_fifo_shadow;
+};
+
+} // namespace cappuccino
@@ -1,12 +1,27 @@
 #pragma once
 
+#include "cappuccino/adaptive_cache.hpp"
+#include "cappuccino/clockpro_cache.hpp"
+#include "cappuccino/counting_bloom_filter.hpp"
+#include "cappuccino/eviction_policy.hpp"
+#include "cappuccino/eviction_stats.hpp"
 #include "cappuccino/fifo_cache.hpp"
+#include "cappuccino/hyperbolic_cache.hpp"
+#include "cappuccino/index_stats.hpp"
+#include "cappuccino/inline_key.hpp"
+#include "cappuccino/journal.hpp"
 #include "cappuccino/lfu_cache.hpp"
 #include "cappuccino/lfuda_cache.hpp"
 #include "cappuccino/lru_cache.hpp"
 #include "cappuccino/mru_cache.hpp"
+#include "cappuccino/mutation_sink.hpp"
+#include "cappuccino/rebuildable.hpp"
+#include "cappuccino/replication.hpp"
 #include "cappuccino/rr_cache.hpp"
+#include "cappuccino/static_table.hpp"
+#include "cappuccino/tenant_lru_cache.hpp"
 #include "cappuccino/tlru_cache.hpp"
 #include "cappuccino/ut_map.hpp"
+#include "cappuccino/ut_roaring_set.hpp"
 #include "cappuccino/ut_set.hpp"
 #include "cappuccino/utlru_cache.hpp"
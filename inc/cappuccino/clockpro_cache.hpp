@@ -0,0 +1,582 @@
+#pragma once
+
+#include "cappuccino/allow.hpp"
+#include "cappuccino/index_stats.hpp"
+#include "cappuccino/lock.hpp"
+#include "cappuccino/trace.hpp"
+
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace cappuccino
+{
+/**
+ * CLOCK-Pro Cache.
+ * Each key value pair is either hot or cold, cold pages that are evicted are remembered as non
+ * resident test pages for a while so a re-use shortly after being evicted promotes them straight
+ * to hot.  Three clock hands sweep a circular ring of slots to demote hot pages, evict cold pages
+ * and expire test pages.  The number of cold pages adapts to the workload, which makes this
+ * policy resistant to sequential scans in the same way LIRS is.
+ *
+ * Unlike the lru_cache a hit never re-orders anything, it only sets the page's reference bit.
+ * The ring is only re-linked on insertions and evictions.
+ *
+ * This cache is thread_safe aware and can be used concurrently from multiple threads safely.
+ * To remove locks/synchronization used NO when creating the cache.
+ *
+ * @tparam key_type The key type.  Must support std::hash().
+ * @tparam value_type The value type.  This is returned by copy on a find, so if your data
+ *                   structure value is large it is advisable to store in a shared ptr.
+ * @tparam thread_safe_type By default this cache is thread safe, can be disabled for caches
+ *                  specific to a single thread.
+ */
+template<typename key_type, typename value_type, thread_safe thread_safe_type = thread_safe::yes>
+class clockpro_cache
+{
+private:
+    using keyed_iterator = typename std::unordered_map<key_type, size_t>::iterator;
+
+    /// Sentinel ring position for an empty ring.
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+public:
+    /**
+     * @param capacity The maximum number of key value pairs allowed in the cache, up to the same
+     *                 number of recently evicted keys are remembered as test pages.
+     * @param max_load_factor The load factor for the hash map, generally 1 is a good default.
+     */
+    explicit clockpro_cache(size_t capacity, float max_load_factor = 1.0f)
+        : m_capacity(capacity),
+          m_cold_target(max_cold_target(capacity)),
+          m_elements(capacity * 2),
+          m_open_list(capacity * 2)
+    {
+        std::iota(m_open_list.begin(), m_open_list.end(), 0);
+
+        m_keyed_elements.max_load_factor(max_load_factor);
+        m_keyed_elements.reserve(capacity * 2);
+    }
+
+    /**
+     * Inserts or updates the given key value pair.
+     * @param key The key to store the value under.
+     * @param value The value of the data to store.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return True if the operation was successful based on `allow`.
+     */
+    auto insert(const key_type& key, value_type value, allow a = allow::insert_or_update) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        return do_insert_update(key, std::move(value), a);
+    }
+
+    /**
+     * Inserts or updates a range of key value pairs.  This expects a container
+     * that has 2 values in the {key_type, value_type} ordering.
+     * @tparam range_type A container with two items, key_type, value_type.
+     * @param key_value_range The elements to insert or update into the cache.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return The number of elements inserted based on `allow`.
+     */
+    template<typename range_type>
+    auto insert_range(range_type&& key_value_range, allow a = allow::insert_or_update) -> size_t
+    {
+        size_t inserted{0};
+
+        {
+            std::lock_guard guard{m_lock};
+            for (auto& [key, value] : key_value_range)
+            {
+                if (do_insert_update(key, std::move(value), a))
+                {
+                    ++inserted;
+                }
+            }
+        }
+
+        return inserted;
+    }
+
+    /**
+     * Attempts to delete the given key.
+     * @param key The key to delete from the cache.
+     * @return True if the key was deleted, false if the key does not exist.
+     */
+    auto erase(const key_type& key) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        return do_erase(key);
+    }
+
+    /**
+     * Attempts to delete all given keys.
+     * @tparam range_type A container with the set of keys to delete, e.g. vector<key_type>, set<key_type>.
+     * @param key_range The keys to delete from the cache.
+     * @return The number of items deleted from the cache.
+     */
+    template<typename range_type>
+    auto erase_range(const range_type& key_range) -> size_t
+    {
+        size_t deleted_elements{0};
+
+        std::lock_guard guard{m_lock};
+        for (auto& key : key_range)
+        {
+            if (do_erase(key))
+            {
+                ++deleted_elements;
+            }
+        }
+
+        return deleted_elements;
+    }
+
+    /**
+     * Attempts to find the given key's value.
+     * @param key The key to lookup its value.
+     * @return An optional with the key's value if it exists, or an empty optional if it does not.
+     */
+    auto find(const key_type& key) -> std::optional<value_type>
+    {
+        std::lock_guard guard{m_lock};
+        return do_find(key);
+    }
+
+    /**
+     * Attempts to find all the given keys values.
+     * @tparam range_type A container with the set of keys to find their values, e.g. vector<key_type>.
+     * @param key_range The keys to lookup their pairs.
+     * @return The full set of keys to std::nullopt if the key wasn't found, or the value if found.
+     */
+    template<typename range_type>
+    auto find_range(const range_type& key_range) -> std::vector<std::pair<key_type, std::optional<value_type>>>
+    {
+        std::vector<std::pair<key_type, std::optional<value_type>>> output;
+        output.reserve(std::size(key_range));
+
+        {
+            std::lock_guard guard{m_lock};
+            for (auto& key : key_range)
+            {
+                output.emplace_back(key, do_find(key));
+            }
+        }
+
+        return output;
+    }
+
+    /**
+     * Attempts to find all the given keys values.
+     *
+     * The user should initialize this container with the keys to lookup with the values as all
+     * empty optionals.  The keys that are found will have the optionals filled in with the
+     * appropriate values from the cache.
+     *
+     * @tparam range_type A container with a pair of optional items,
+     *                   e.g. vector<pair<key_type, optional<value_type>>>
+     *                   or map<key_type, optional<value_type>>
+     * @param key_optional_value_range The keys to optional values to fill out.
+     */
+    template<typename range_type>
+    auto find_range_fill(range_type& key_optional_value_range) -> void
+    {
+        std::lock_guard guard{m_lock};
+        for (auto& [key, optional_value] : key_optional_value_range)
+        {
+            optional_value = do_find(key);
+        }
+    }
+
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
+    /**
+     * @return If this cache is currenty empty.
+     */
+    auto empty() const -> bool { return (size() == 0); }
+
+    /**
+     * @return The number of elements inside the cache, this does not include the test pages.
+     */
+    auto size() const -> size_t { return m_hot_count + m_cold_count; }
+
+    /**
+     * @return The maximum capacity of this cache.
+     */
+    auto capacity() const -> size_t { return m_capacity; }
+
+private:
+    enum class page : uint8_t
+    {
+        /// The key value pair has been re-used within its test period and is protected.
+        hot,
+        /// The key value pair is resident but is the next to be evicted if not re-used.
+        cold,
+        /// The key was recently evicted, only its key is remembered.
+        test
+    };
+
+    struct element
+    {
+        keyed_iterator m_keyed_position;
+        /// The previous slot in the clock ring.
+        size_t m_prev{npos};
+        /// The next slot in the clock ring.
+        size_t m_next{npos};
+        page   m_page{page::cold};
+        /// Set on every hit, cleared as the clock hands sweep past.
+        bool       m_referenced{false};
+        value_type m_value;
+    };
+
+    auto do_insert_update(const key_type& key, value_type&& value, allow a) -> bool
+    {
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end() && m_elements[keyed_position->second].m_page != page::test)
+        {
+            if (update_allowed(a))
+            {
+                do_update(keyed_position, std::move(value));
+                return true;
+            }
+        }
+        else
+        {
+            if (insert_allowed(a))
+            {
+                if (keyed_position != m_keyed_elements.end())
+                {
+                    do_insert_test(keyed_position, std::move(value));
+                }
+                else
+                {
+                    do_insert(key, std::move(value));
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    auto do_insert(const key_type& key, value_type&& value) -> void
+    {
+        do_prune();
+
+        CAPPUCCINO_PROBE3(insert, "clockpro_cache", this, &key);
+
+        auto element_idx = m_open_list[m_open_list_end];
+        ++m_open_list_end;
+
+        element& e         = m_elements[element_idx];
+        e.m_keyed_position = m_keyed_elements.emplace(key, element_idx).first;
+        e.m_page           = page::cold;
+        e.m_referenced     = false;
+        e.m_value          = std::move(value);
+        ++m_cold_count;
+
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
+
+        do_link(element_idx);
+    }
+
+    /**
+     * The key is a test page, it was evicted recently enough that it comes back as a hot page and
+     * the cold target grows since a larger cold area would have kept it resident.
+     */
+    auto do_insert_test(keyed_iterator keyed_position, value_type&& value) -> void
+    {
+        CAPPUCCINO_PROBE3(insert, "clockpro_cache", this, &keyed_position->first);
+
+        auto element_idx = keyed_position->second;
+        do_unlink(element_idx);
+        --m_test_count;
+
+        if (m_cold_target < max_cold_target(m_capacity))
+        {
+            ++m_cold_target;
+        }
+
+        // Unlinked the page cannot be visited by the hands while room is made for it.
+        do_prune();
+
+        element& e     = m_elements[element_idx];
+        e.m_page       = page::hot;
+        e.m_referenced = false;
+        e.m_value      = std::move(value);
+        ++m_hot_count;
+
+        do_link(element_idx);
+    }
+
+    auto do_update(keyed_iterator keyed_position, value_type&& value) -> void
+    {
+        CAPPUCCINO_PROBE3(update, "clockpro_cache", this, &keyed_position->first);
+
+        element& e     = m_elements[keyed_position->second];
+        e.m_value      = std::move(value);
+        e.m_referenced = true;
+    }
+
+    auto do_erase(const key_type& key) -> bool
+    {
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position == m_keyed_elements.end())
+        {
+            return false;
+        }
+
+        auto element_idx = keyed_position->second;
+        auto p           = m_elements[element_idx].m_page;
+        do_remove(element_idx);
+        // Test pages are only metadata, the key is not in the cache.
+        return (p != page::test);
+    }
+
+    auto do_find(const key_type& key) -> std::optional<value_type>
+    {
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            element& e = m_elements[keyed_position->second];
+            if (e.m_page != page::test)
+            {
+                CAPPUCCINO_PROBE3(find_hit, "clockpro_cache", this, &key);
+                e.m_referenced = true;
+                return {e.m_value};
+            }
+        }
+
+        CAPPUCCINO_PROBE3(find_miss, "clockpro_cache", this, &key);
+        return {};
+    }
+
+    /**
+     * The cold target never reaches the capacity so there is always room for a hot page, a
+     * capacity of 1 has a single page that alternates between hot and cold.
+     */
+    static constexpr auto max_cold_target(size_t capacity) -> size_t { return (capacity > 1) ? capacity - 1 : 1; }
+
+    /**
+     * Runs the cold hand until there is room for one more resident page.  Each hand only ever
+     * advances itself, the hot pages are demoted down to their target first so the cold hand
+     * always has a cold page to stop at.
+     */
+    auto do_prune() -> void
+    {
+        while (size() >= m_capacity && m_hand_cold != npos)
+        {
+            while (m_hot_count > m_capacity - m_cold_target)
+            {
+                do_run_hand_hot();
+            }
+            do_run_hand_cold();
+        }
+    }
+
+    /**
+     * Evicts an unreferenced cold page into a test page, a referenced cold page is promoted to hot.
+     * Advances the cold hand by one page.
+     */
+    auto do_run_hand_cold() -> void
+    {
+        element& e = m_elements[m_hand_cold];
+        if (e.m_page == page::cold)
+        {
+            if (e.m_referenced)
+            {
+                e.m_page       = page::hot;
+                e.m_referenced = false;
+                --m_cold_count;
+                ++m_hot_count;
+            }
+            else
+            {
+                CAPPUCCINO_PROBE4(
+                    evict,
+                    "clockpro_cache",
+                    this,
+                    &e.m_keyed_position->first,
+                    static_cast<int>(evict_reason::capacity));
+                e.m_page  = page::test;
+                e.m_value = value_type{};
+                --m_cold_count;
+                ++m_test_count;
+
+                while (m_test_count > m_capacity)
+                {
+                    do_run_hand_test();
+                }
+            }
+        }
+
+        m_hand_cold = m_elements[m_hand_cold].m_next;
+    }
+
+    /**
+     * Demotes an unreferenced hot page to cold, a referenced hot page gets its reference bit
+     * cleared.  Advances the hot hand by one page.
+     */
+    auto do_run_hand_hot() -> void
+    {
+        element& e = m_elements[m_hand_hot];
+        if (e.m_page == page::hot)
+        {
+            if (e.m_referenced)
+            {
+                e.m_referenced = false;
+            }
+            else
+            {
+                e.m_page = page::cold;
+                --m_hot_count;
+                ++m_cold_count;
+            }
+        }
+
+        m_hand_hot = m_elements[m_hand_hot].m_next;
+    }
+
+    /**
+     * Forgets a test page whose test period ended without a re-use, the cold target shrinks since a
+     * larger cold area would not have helped.  Advances the test hand by one page.
+     */
+    auto do_run_hand_test() -> void
+    {
+        auto element_idx = m_hand_test;
+        m_hand_test      = m_elements[element_idx].m_next;
+
+        if (m_elements[element_idx].m_page == page::test)
+        {
+            do_remove(element_idx);
+            if (m_cold_target > 1)
+            {
+                --m_cold_target;
+            }
+        }
+    }
+
+    /**
+     * Unlinks the slot from the ring and the keyed lookup and returns it to the open list.
+     */
+    auto do_remove(size_t element_idx) -> void
+    {
+        element& e = m_elements[element_idx];
+        switch (e.m_page)
+        {
+            case page::hot:
+                --m_hot_count;
+                break;
+            case page::cold:
+                --m_cold_count;
+                break;
+            case page::test:
+                --m_test_count;
+                break;
+        }
+
+        do_unlink(element_idx);
+        m_keyed_elements.erase(e.m_keyed_position);
+        e.m_value = value_type{};
+
+        --m_open_list_end;
+        m_open_list[m_open_list_end] = element_idx;
+    }
+
+    /**
+     * Links the slot into the ring just behind the hot hand, the position of the newest page.
+     */
+    auto do_link(size_t element_idx) -> void
+    {
+        element& e = m_elements[element_idx];
+        if (m_hand_hot == npos)
+        {
+            e.m_prev    = element_idx;
+            e.m_next    = element_idx;
+            m_hand_hot  = element_idx;
+            m_hand_cold = element_idx;
+            m_hand_test = element_idx;
+            return;
+        }
+
+        e.m_next                      = m_hand_hot;
+        e.m_prev                      = m_elements[m_hand_hot].m_prev;
+        m_elements[e.m_prev].m_next   = element_idx;
+        m_elements[m_hand_hot].m_prev = element_idx;
+
+        if (m_hand_cold == m_hand_hot)
+        {
+            m_hand_cold = element_idx;
+        }
+    }
+
+    auto do_unlink(size_t element_idx) -> void
+    {
+        element& e = m_elements[element_idx];
+        if (e.m_next == element_idx)
+        {
+            m_hand_hot  = npos;
+            m_hand_cold = npos;
+            m_hand_test = npos;
+        }
+        else
+        {
+            for (auto* hand : {&m_hand_hot, &m_hand_cold, &m_hand_test})
+            {
+                if (*hand == element_idx)
+                {
+                    *hand = e.m_next;
+                }
+            }
+            m_elements[e.m_prev].m_next = e.m_next;
+            m_elements[e.m_next].m_prev = e.m_prev;
+        }
+
+        e.m_prev = npos;
+        e.m_next = npos;
+    }
+
+    /// Cache lock for all mutations if thread_safe is enabled.
+    mutex<thread_safe_type> m_lock;
+
+    /// The maximum number of resident pages.
+    size_t m_capacity{0};
+    /// The adaptive number of cold pages, the hot pages may use the remainder of the capacity.
+    size_t m_cold_target{0};
+    size_t m_hot_count{0};
+    size_t m_cold_count{0};
+    size_t m_test_count{0};
+
+    /// The main store for the key value pairs and the test pages, twice the capacity.
+    std::vector<element> m_elements;
+    /// The keyed lookup data structure, this value is the index into 'm_elements'.
+    std::unordered_map<key_type, size_t> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
+    /// The open list of free elements to use, the value is the index into 'm_elements'.
+    std::vector<size_t> m_open_list;
+    /// This is the partition point in the m_open_list, the number of slots in the ring.
+    size_t m_open_list_end{0};
+
+    /// The hand that demotes hot pages.
+    size_t m_hand_hot{npos};
+    /// The hand that evicts cold pages.
+    size_t m_hand_cold{npos};
+    /// The hand that expires test pages.
+    size_t m_hand_test{npos};
+};
+
+} // namespace cappuccino
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cappuccino
+{
+/**
+ * A blocked counting bloom filter over 64 bit hashes that can be read concurrently with its
+ * writers without any locks.  Every hash maps to a single cache line sized block of 8 bit
+ * counters and sets a few counters within it, so a lookup is one cache miss.  Counters are
+ * incremented on add() and decremented on remove(), so deletions do not need a rebuild.  A
+ * counter that saturates is never decremented again, which can only cause false positives.
+ *
+ * Writers must be serialized externally, e.g. by the owning cache's lock, readers can call
+ * may_contain() at any time.
+ */
+class counting_bloom_filter
+{
+public:
+    /// The number of counters per block, one cache line.
+    static constexpr size_t block_size = 64;
+    /// The number of counters set per hash.
+    static constexpr size_t probe_count = 4;
+
+    /**
+     * @param expected_elements The number of elements the filter is sized for.
+     * @param counters_per_element The number of counters per expected element, 8 gives roughly
+     *                             a 3% false positive rate at the expected number of elements.
+     */
+    counting_bloom_filter(size_t expected_elements, size_t counters_per_element = 8);
+
+    /**
+     * @param hash The hash of the element to add.
+     */
+    auto add(uint64_t hash) -> void;
+
+    /**
+     * @param hash The hash of a previously added element to remove.
+     */
+    auto remove(uint64_t hash) -> void;
+
+    /**
+     * @param hash The hash of the element to check.
+     * @return False if the element was definitely not added, true if it might have been.
+     */
+    auto may_contain(uint64_t hash) const -> bool;
+
+    /**
+     * Resets every counter to zero, this must not run concurrently with readers that expect
+     * previously added elements to still be present.
+     */
+    auto clear() -> void;
+
+    /**
+     * @return The number of cache line sized blocks in the filter.
+     */
+    auto block_count() const -> size_t { return m_blocks.size(); }
+
+private:
+    struct alignas(64) block
+    {
+        std::atomic<uint8_t> m_counters[block_size];
+    };
+
+    /**
+     * @return The block for the hash, the counters within the block are taken from the low bits.
+     */
+    auto block_for(uint64_t hash) const -> size_t;
+
+    /// The counter blocks, value initialized to zero.
+    std::vector<block> m_blocks;
+};
+
+} // namespace cappuccino
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+namespace cappuccino
+{
+/**
+ * The eviction policies the adaptive cache can switch between.
+ */
+enum class eviction_policy
+{
+    /// Least recently used.
+    lru = 0,
+    /// Least frequently used, ties are broken by least recently used.
+    lfu = 1,
+    /// First in first out.
+    fifo = 2
+};
+
+auto to_string(eviction_policy p) -> const std::string&;
+
+} // namespace cappuccino
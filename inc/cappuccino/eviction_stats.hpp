@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace cappuccino
+{
+/**
+ * A histogram with power of two sized buckets.  Bucket 0 counts the value 0 and bucket i
+ * counts values in the range [2^(i-1), 2^i).  Recording is a couple of instructions and
+ * histograms can be merged, so each thread or cache shard can record into its own histogram
+ * and the results combined when reporting.
+ */
+class log2_histogram
+{
+public:
+    /// One bucket for zero plus one for every possible highest set bit of a 64 bit value.
+    static constexpr size_t bucket_count = 65;
+
+    /**
+     * @param value The value to record into its bucket.
+     */
+    auto record(uint64_t value) -> void;
+
+    /**
+     * Adds all of the other histogram's counts into this histogram.
+     * @param other The histogram to merge into this one.
+     */
+    auto merge(const log2_histogram& other) -> void;
+
+    /**
+     * Resets all buckets to zero.
+     */
+    auto clear() -> void;
+
+    /**
+     * @return The total number of values recorded.
+     */
+    auto count() const -> uint64_t { return m_count; }
+
+    /**
+     * @param idx The bucket to retrieve, must be less than bucket_count.
+     * @return The number of values recorded into the bucket.
+     */
+    auto bucket(size_t idx) const -> uint64_t { return m_buckets[idx]; }
+
+    /**
+     * @param idx The bucket to retrieve the range for, must be less than bucket_count.
+     * @return The smallest value that is counted in the bucket.
+     */
+    static auto bucket_lower_bound(size_t idx) -> uint64_t;
+
+    /**
+     * @param idx The bucket to retrieve the range for, must be less than bucket_count.
+     * @return The largest value that is counted in the bucket.
+     */
+    static auto bucket_upper_bound(size_t idx) -> uint64_t;
+
+    /**
+     * @param p The percentile to find in the range [0.0, 1.0].
+     * @return The upper bound of the bucket containing the given percentile, 0 if empty.
+     */
+    auto percentile(double p) const -> uint64_t;
+
+private:
+    /// The counts per bucket.
+    std::array<uint64_t, bucket_count> m_buckets{};
+    /// The total number of recorded values.
+    uint64_t m_count{0};
+};
+
+/**
+ * Statistics about the elements a cache evicted, either to make room for new elements or
+ * because their TTL elapsed.  Elements removed by an explicit erase are not recorded.
+ */
+class eviction_stats
+{
+public:
+    /**
+     * Records a single eviction.
+     * @param residency The amount of time the element was in the cache.
+     * @param hits The number of find hits the element had while in the cache.
+     * @param idle The amount of time since the element was last inserted, updated or found.
+     */
+    auto record(
+        std::chrono::steady_clock::duration residency, uint64_t hits, std::chrono::steady_clock::duration idle)
+        -> void;
+
+    /**
+     * Adds all of the other statistics into this one.
+     * @param other The statistics to merge into this one.
+     */
+    auto merge(const eviction_stats& other) -> void;
+
+    /**
+     * Resets all statistics.
+     */
+    auto clear() -> void;
+
+    /**
+     * @return Microseconds between an element being inserted and evicted.
+     */
+    auto residency_us() const -> const log2_histogram& { return m_residency_us; }
+
+    /**
+     * @return The number of find hits elements received before eviction, zero is a wasted admission.
+     */
+    auto hits_before_eviction() const -> const log2_histogram& { return m_hits_before_eviction; }
+
+    /**
+     * @return Microseconds between an element's last access and its eviction.
+     */
+    auto idle_us() const -> const log2_histogram& { return m_idle_us; }
+
+private:
+    /// Microseconds between insert and eviction.
+    log2_histogram m_residency_us{};
+    /// Find hits before eviction.
+    log2_histogram m_hits_before_eviction{};
+    /// Microseconds between the last access and eviction.
+    log2_histogram m_idle_us{};
+};
+
+} // namespace cappuccino
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "cappuccino/allow.hpp"
+#include "cappuccino/index_stats.hpp"
 #include "cappuccino/lock.hpp"
+#include "cappuccino/trace.hpp"
 
 #include <list>
 #include <mutex>
@@ -260,6 +262,18 @@ public:
         return find_range_fill(std::begin(key_optional_value_range), std::end(key_optional_value_range));
     }
 
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
     /**
      * @return If this cache is currenty empty.
      */
@@ -320,6 +334,12 @@ private:
         // structure it needs to be deleted first.
         if (e.m_keyed_position.has_value())
         {
+            CAPPUCCINO_PROBE4(
+                evict,
+                "fifo_cache",
+                this,
+                &e.m_keyed_position.value()->first,
+                static_cast<int>(evict_reason::capacity));
             m_keyed_elements.erase(e.m_keyed_position.value());
         }
         else
@@ -328,12 +348,17 @@ private:
             ++m_used_size;
         }
 
+        CAPPUCCINO_PROBE3(insert, "fifo_cache", this, &key);
+
         e.m_value          = std::move(value);
         e.m_keyed_position = m_keyed_elements.emplace(key, last_element_position).first;
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
     }
 
     auto do_update(keyed_iterator keyed_position, value_type&& value) -> void
     {
+        CAPPUCCINO_PROBE3(update, "fifo_cache", this, &keyed_position->first);
+
         element& e = *keyed_position->second;
         e.m_value  = std::move(value);
 
@@ -367,9 +392,11 @@ private:
         {
             fifo_iterator fifo_position = keyed_position->second;
             element&      e             = *fifo_position;
+            CAPPUCCINO_PROBE3(find_hit, "fifo_cache", this, &key);
             return {e.m_value};
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "fifo_cache", this, &key);
         return {};
     }
 
@@ -383,6 +410,8 @@ private:
     std::list<element> m_fifo_list;
     /// The keyed lookup data structure, the value is the index into 'm_elements'.
     std::unordered_map<key_type, fifo_iterator> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
 };
 
 } // namespace cappuccino
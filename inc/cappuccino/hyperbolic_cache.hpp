@@ -0,0 +1,439 @@
+#pragma once
+
+#include "cappuccino/allow.hpp"
+#include "cappuccino/index_stats.hpp"
+#include "cappuccino/lock.hpp"
+#include "cappuccino/trace.hpp"
+
+#include <numeric>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace cappuccino
+{
+/**
+ * Hyperbolic Cache.
+ * Each key value pair has a priority of cost * hits / age, where the age is the number of cache
+ * operations since it was inserted.  On eviction a handful of key value pairs are sampled at
+ * random and the one with the lowest priority is evicted.  No ordering is maintained at all, so
+ * like the rr_cache a hit is O(1) and only bumps a counter, yet unlike the lfu_cache a key that
+ * was popular long ago decays on its own as its age grows.
+ *
+ * This cache is thread_safe aware and can be used concurrently from multiple threads safely.
+ * To remove locks/synchronization used NO when creating the cache.
+ *
+ * @tparam key_type The key type.  Must support std::hash().
+ * @tparam value_type The value type.  This is returned by copy on a find, so if your data
+ *                   structure value is large it is advisable to store in a shared ptr.
+ * @tparam thread_safe_type By default this cache is thread safe, can be disabled for caches
+ *                  specific to a single thread.
+ */
+template<typename key_type, typename value_type, thread_safe thread_safe_type = thread_safe::yes>
+class hyperbolic_cache
+{
+private:
+    using keyed_iterator = typename std::unordered_map<key_type, size_t>::iterator;
+
+public:
+    /**
+     * @param capacity The maximum number of key value pairs allowed in the cache.
+     * @param sample_size The number of key value pairs sampled per eviction, larger samples are
+     *                    closer to evicting the true lowest priority at a higher cost per eviction.
+     * @param max_load_factor The load factor for the hash map, generally 1 is a good default.
+     */
+    explicit hyperbolic_cache(size_t capacity, size_t sample_size = 16, float max_load_factor = 1.0f)
+        : m_sample_size(std::max(sample_size, size_t{1})),
+          m_elements(capacity),
+          m_open_list(capacity),
+          m_random_device(),
+          m_mt(m_random_device())
+    {
+        std::iota(m_open_list.begin(), m_open_list.end(), 0);
+
+        m_keyed_elements.max_load_factor(max_load_factor);
+        m_keyed_elements.reserve(capacity);
+    }
+
+    /**
+     * Inserts or updates the given key value pair with a cost of 1.
+     * @param key The key to store the value under.
+     * @param value The value of the data to store.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return True if the operation was successful based on `allow`.
+     */
+    auto insert(const key_type& key, value_type value, allow a = allow::insert_or_update) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        return do_insert_update(key, std::move(value), 1.0, a);
+    }
+
+    /**
+     * Inserts or updates the given key value pair with the cost of fetching it again on a miss,
+     * e.g. its size or its backend latency.  Expensive key value pairs are evicted later than
+     * cheap ones that are used as often.
+     * @param key The key to store the value under.
+     * @param value The value of the data to store.
+     * @param cost The relative cost of the key value pair, must be positive.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return True if the operation was successful based on `allow`.
+     */
+    auto insert_weighted(const key_type& key, value_type value, double cost, allow a = allow::insert_or_update)
+        -> bool
+    {
+        std::lock_guard guard{m_lock};
+        return do_insert_update(key, std::move(value), cost, a);
+    }
+
+    /**
+     * Inserts or updates a range of key value pairs with a cost of 1.  This expects a container
+     * that has 2 values in the {key_type, value_type} ordering.
+     * @tparam range_type A container with two items, key_type, value_type.
+     * @param key_value_range The elements to insert or update into the cache.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return The number of elements inserted based on `allow`.
+     */
+    template<typename range_type>
+    auto insert_range(range_type&& key_value_range, allow a = allow::insert_or_update) -> size_t
+    {
+        size_t inserted{0};
+
+        {
+            std::lock_guard guard{m_lock};
+            for (auto& [key, value] : key_value_range)
+            {
+                if (do_insert_update(key, std::move(value), 1.0, a))
+                {
+                    ++inserted;
+                }
+            }
+        }
+
+        return inserted;
+    }
+
+    /**
+     * Attempts to delete the given key.
+     * @param key The key to delete from the cache.
+     * @return True if the key was deleted, false if the key does not exist.
+     */
+    auto erase(const key_type& key) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        auto            keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            do_erase(keyed_position->second);
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    /**
+     * Attempts to delete all given keys.
+     * @tparam range_type A container with the set of keys to delete, e.g. vector<key_type>, set<key_type>.
+     * @param key_range The keys to delete from the cache.
+     * @return The number of items deleted from the cache.
+     */
+    template<typename range_type>
+    auto erase_range(const range_type& key_range) -> size_t
+    {
+        size_t deleted_elements{0};
+
+        std::lock_guard guard{m_lock};
+        for (auto& key : key_range)
+        {
+            auto keyed_position = m_keyed_elements.find(key);
+            if (keyed_position != m_keyed_elements.end())
+            {
+                ++deleted_elements;
+                do_erase(keyed_position->second);
+            }
+        }
+
+        return deleted_elements;
+    }
+
+    /**
+     * Attempts to find the given key's value.
+     * @param key The key to lookup its value.
+     * @return An optional with the key's value if it exists, or an empty optional if it does not.
+     */
+    auto find(const key_type& key) -> std::optional<value_type>
+    {
+        std::lock_guard guard{m_lock};
+        return do_find(key);
+    }
+
+    /**
+     * Attempts to find all the given keys values.
+     * @tparam range_type A container with the set of keys to find their values, e.g. vector<key_type>.
+     * @param key_range The keys to lookup their pairs.
+     * @return The full set of keys to std::nullopt if the key wasn't found, or the value if found.
+     */
+    template<typename range_type>
+    auto find_range(const range_type& key_range) -> std::vector<std::pair<key_type, std::optional<value_type>>>
+    {
+        std::vector<std::pair<key_type, std::optional<value_type>>> output;
+        output.reserve(std::size(key_range));
+
+        {
+            std::lock_guard guard{m_lock};
+            for (auto& key : key_range)
+            {
+                output.emplace_back(key, do_find(key));
+            }
+        }
+
+        return output;
+    }
+
+    /**
+     * Attempts to find all the given keys values.
+     *
+     * The user should initialize this container with the keys to lookup with the values as all
+     * empty optionals.  The keys that are found will have the optionals filled in with the
+     * appropriate values from the cache.
+     *
+     * @tparam range_type A container with a pair of optional items,
+     *                   e.g. vector<pair<key_type, optional<value_type>>>
+     *                   or map<key_type, optional<value_type>>
+     * @param key_optional_value_range The keys to optional values to fill out.
+     */
+    template<typename range_type>
+    auto find_range_fill(range_type& key_optional_value_range) -> void
+    {
+        std::lock_guard guard{m_lock};
+        for (auto& [key, optional_value] : key_optional_value_range)
+        {
+            optional_value = do_find(key);
+        }
+    }
+
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
+    /**
+     * @return If this cache is currenty empty.
+     */
+    auto empty() const -> bool { return (m_open_list_end == 0); }
+
+    /**
+     * @return The number of elements inside the cache.
+     */
+    auto size() const -> size_t { return m_open_list_end; }
+
+    /**
+     * @return The maximum capacity of this cache.
+     */
+    auto capacity() const -> size_t { return m_elements.size(); }
+
+    /**
+     * @return The number of key value pairs sampled per eviction.
+     */
+    auto sample_size() const -> size_t { return m_sample_size; }
+
+private:
+    struct element
+    {
+        keyed_iterator m_keyed_position;
+        size_t         m_open_list_position;
+        /// The cache operation tick this key value pair was inserted at.
+        uint64_t m_insert_tick{0};
+        /// The insert counts as the first hit.
+        uint64_t   m_hits{0};
+        double     m_cost{1.0};
+        value_type m_value;
+    };
+
+    auto do_insert_update(const key_type& key, value_type&& value, double cost, allow a) -> bool
+    {
+        ++m_tick;
+
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            if (update_allowed(a))
+            {
+                do_update(keyed_position, std::move(value), cost);
+                return true;
+            }
+        }
+        else
+        {
+            if (insert_allowed(a))
+            {
+                do_insert(key, std::move(value), cost);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    auto do_insert(const key_type& key, value_type&& value, double cost) -> void
+    {
+        if (m_open_list_end >= m_elements.size())
+        {
+            do_prune();
+        }
+
+        CAPPUCCINO_PROBE3(insert, "hyperbolic_cache", this, &key);
+
+        auto element_idx = m_open_list[m_open_list_end];
+
+        auto keyed_position = m_keyed_elements.emplace(key, element_idx).first;
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
+
+        element& e             = m_elements[element_idx];
+        e.m_value              = std::move(value);
+        e.m_open_list_position = m_open_list_end;
+        e.m_keyed_position     = keyed_position;
+        e.m_insert_tick        = m_tick;
+        e.m_hits               = 1;
+        e.m_cost               = cost;
+
+        ++m_open_list_end;
+    }
+
+    auto do_update(keyed_iterator keyed_position, value_type&& value, double cost) -> void
+    {
+        CAPPUCCINO_PROBE3(update, "hyperbolic_cache", this, &keyed_position->first);
+
+        element& e = m_elements[keyed_position->second];
+        e.m_value  = std::move(value);
+        e.m_cost   = cost;
+        ++e.m_hits;
+    }
+
+    auto do_erase(size_t element_idx) -> void
+    {
+        element& e = m_elements[element_idx];
+
+        // The open list stays dense, the last used slot moves into the erased slot's position so
+        // sampling can pick any position below the partition point.
+        auto last_position = m_open_list_end - 1;
+        if (e.m_open_list_position != last_position)
+        {
+            auto moved_idx                             = m_open_list[last_position];
+            m_open_list[e.m_open_list_position]        = moved_idx;
+            m_elements[moved_idx].m_open_list_position = e.m_open_list_position;
+            m_open_list[last_position]                 = element_idx;
+            e.m_open_list_position                     = last_position;
+        }
+        --m_open_list_end;
+
+        m_keyed_elements.erase(e.m_keyed_position);
+    }
+
+    auto do_find(const key_type& key) -> std::optional<value_type>
+    {
+        ++m_tick;
+
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            element& e = m_elements[keyed_position->second];
+            ++e.m_hits;
+            CAPPUCCINO_PROBE3(find_hit, "hyperbolic_cache", this, &key);
+            return {e.m_value};
+        }
+
+        CAPPUCCINO_PROBE3(find_miss, "hyperbolic_cache", this, &key);
+        return {};
+    }
+
+    /**
+     * @return The priority of the key value pair, the lowest priority is evicted first.
+     */
+    auto do_priority(const element& e) const -> double
+    {
+        // An element inserted on this tick has an age of 1 rather than 0.
+        auto age = static_cast<double>(m_tick - e.m_insert_tick + 1);
+        return e.m_cost * static_cast<double>(e.m_hits) / age;
+    }
+
+    auto do_prune() -> void
+    {
+        if (m_open_list_end == 0)
+        {
+            return;
+        }
+
+        size_t victim_idx = m_open_list[0];
+        if (m_open_list_end <= m_sample_size)
+        {
+            // The sample would cover (nearly) everything, consider every element exactly once.
+            for (size_t position = 1; position < m_open_list_end; ++position)
+            {
+                auto element_idx = m_open_list[position];
+                if (do_priority(m_elements[element_idx]) < do_priority(m_elements[victim_idx]))
+                {
+                    victim_idx = element_idx;
+                }
+            }
+        }
+        else
+        {
+            std::uniform_int_distribution<size_t> dist{0, m_open_list_end - 1};
+            victim_idx = m_open_list[dist(m_mt)];
+            for (size_t i = 1; i < m_sample_size; ++i)
+            {
+                auto element_idx = m_open_list[dist(m_mt)];
+                if (do_priority(m_elements[element_idx]) < do_priority(m_elements[victim_idx]))
+                {
+                    victim_idx = element_idx;
+                }
+            }
+        }
+
+        CAPPUCCINO_PROBE4(
+            evict,
+            "hyperbolic_cache",
+            this,
+            &m_elements[victim_idx].m_keyed_position->first,
+            static_cast<int>(evict_reason::capacity));
+        do_erase(victim_idx);
+    }
+
+    /// Cache lock for all mutations if thread_safe is enabled.
+    mutex<thread_safe_type> m_lock;
+
+    /// The number of key value pairs sampled per eviction.
+    size_t m_sample_size{16};
+    /// The logical clock, every insert and find is one tick.
+    uint64_t m_tick{0};
+
+    /// The main store for the key value pairs and metadata for each element.
+    std::vector<element> m_elements;
+    /// The keyed lookup data structure, this value is the index into 'm_elements'.
+    std::unordered_map<key_type, size_t> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
+    /// The open list of elements, used elements are densely packed before 'm_open_list_end'.
+    std::vector<size_t> m_open_list;
+    /// This is the partition point in the m_open_list, it is also the number of items in the cache.
+    size_t m_open_list_end{0};
+
+    /// Random device to seed mt19937.
+    std::random_device m_random_device;
+    /// Random number generator for the eviction samples.
+    std::mt19937 m_mt;
+};
+
+} // namespace cappuccino
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace cappuccino
+{
+/**
+ * A doubly linked list over the fixed range of slot indexes [0, capacity).  Each slot is either
+ * linked or not, the links are stored as indexes in a single pre-allocated vector so re-ordering
+ * a slot is the same as splicing a std::list node without any per node allocation.  The caches
+ * use this for their recency and ttl orderings, with a 32 bit index type each slot costs 8 bytes
+ * of links instead of a 32 byte std::list node.
+ *
+ * @tparam index_type The unsigned slot index type, the capacity must be less than its maximum.
+ */
+template<typename index_type>
+class index_list
+{
+    static_assert(std::is_unsigned_v<index_type>, "index_type must be an unsigned integer type");
+
+public:
+    /**
+     * @return The largest capacity an index_list with this index_type supports.
+     */
+    static constexpr auto max_capacity() -> size_t
+    {
+        // The last index is reserved for the sentinel.
+        return static_cast<size_t>(std::numeric_limits<index_type>::max());
+    }
+
+    /**
+     * @param capacity The number of slots, at most max_capacity().
+     */
+    explicit index_list(size_t capacity) : m_links(capacity + 1) { clear(); }
+
+    /**
+     * Unlinks every slot, O(capacity).
+     */
+    auto clear() -> void
+    {
+        for (size_t idx = 0; idx < m_links.size(); ++idx)
+        {
+            m_links[idx].m_prev = static_cast<index_type>(idx);
+            m_links[idx].m_next = static_cast<index_type>(idx);
+        }
+    }
+
+    /**
+     * @return True if no slots are linked.
+     */
+    auto empty() const -> bool { return m_links[sentinel()].m_next == sentinel(); }
+
+    /**
+     * @return The slot at the head of the list, undefined if the list is empty.
+     */
+    auto front() const -> index_type { return m_links[sentinel()].m_next; }
+
+    /**
+     * @return The slot at the tail of the list, undefined if the list is empty.
+     */
+    auto back() const -> index_type { return m_links[sentinel()].m_prev; }
+
+    /**
+     * @param idx A linked slot.
+     * @return The slot after idx, or end() if idx is the tail.
+     */
+    auto next(index_type idx) const -> index_type { return m_links[idx].m_next; }
+
+    /**
+     * @return The position one past the tail, returned by next() at the end of the list.
+     */
+    auto end() const -> index_type { return sentinel(); }
+
+    /**
+     * Links an unlinked slot at the head of the list.
+     */
+    auto push_front(index_type idx) -> void { link_after(sentinel(), idx); }
+
+    /**
+     * Links an unlinked slot at the tail of the list.
+     */
+    auto push_back(index_type idx) -> void { link_after(m_links[sentinel()].m_prev, idx); }
+
+    /**
+     * Unlinks a linked slot.
+     */
+    auto erase(index_type idx) -> void
+    {
+        detach(idx);
+        m_links[idx].m_prev = idx;
+        m_links[idx].m_next = idx;
+    }
+
+    /**
+     * @return True if the slot is linked, an unlinked slot links to itself.
+     */
+    auto linked(index_type idx) const -> bool { return m_links[idx].m_next != idx; }
+
+    /**
+     * Moves a linked slot to the head of the list.
+     */
+    auto move_to_front(index_type idx) -> void
+    {
+        if (front() != idx)
+        {
+            detach(idx);
+            push_front(idx);
+        }
+    }
+
+    /**
+     * Moves a linked slot to the tail of the list.
+     */
+    auto move_to_back(index_type idx) -> void
+    {
+        if (back() != idx)
+        {
+            detach(idx);
+            push_back(idx);
+        }
+    }
+
+private:
+    struct link
+    {
+        index_type m_prev;
+        index_type m_next;
+    };
+
+    auto sentinel() const -> index_type { return static_cast<index_type>(m_links.size() - 1); }
+
+    auto detach(index_type idx) -> void
+    {
+        auto& l                  = m_links[idx];
+        m_links[l.m_prev].m_next = l.m_next;
+        m_links[l.m_next].m_prev = l.m_prev;
+    }
+
+    auto link_after(index_type position, index_type idx) -> void
+    {
+        auto& l                  = m_links[idx];
+        l.m_prev                 = position;
+        l.m_next                 = m_links[position].m_next;
+        m_links[l.m_next].m_prev = idx;
+        m_links[position].m_next = idx;
+    }
+
+    /// The links for every slot plus the sentinel as the last element.
+    std::vector<link> m_links;
+};
+
+} // namespace cappuccino
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace cappuccino
+{
+/**
+ * Health of a cache's keyed lookup index, a std::unordered_map with chained buckets.  A long
+ * maximum or average chain length or a high collision ratio at a normal load factor points to a
+ * poor hash for the key type.  The chain lengths are sampled from a subset of the buckets so
+ * retrieving them is not O(n) under the cache's lock.
+ */
+struct index_stats
+{
+    /// The number of keys in the index.
+    size_t m_size{0};
+    /// The number of hash buckets.
+    size_t m_bucket_count{0};
+    /// The average number of keys per bucket.
+    float m_load_factor{0.0f};
+    /// The load factor at which the index rehashes.
+    float m_max_load_factor{0.0f};
+    /// The number of times the index has rehashed since the cache was created.
+    uint64_t m_rehash_count{0};
+    /// The number of buckets the chain lengths were sampled from.
+    size_t m_sampled_buckets{0};
+    /// The number of keys in the sampled buckets.
+    size_t m_sampled_elements{0};
+    /// The longest chain in the sampled buckets.
+    size_t m_max_chain_length{0};
+    /// The average chain length of the non empty sampled buckets, 1.0 is ideal.
+    double m_average_chain_length{0.0};
+    /// The fraction of the sampled keys that share their bucket with another key.
+    double m_collision_ratio{0.0};
+};
+
+/**
+ * Counts the rehashes of an index, a cache calls observe() after every insert into its index.
+ */
+class index_rehash_counter
+{
+public:
+    /**
+     * @param bucket_count The index's bucket count after an insert.
+     */
+    auto observe(size_t bucket_count) -> void
+    {
+        if (m_bucket_count != 0 && m_bucket_count != bucket_count)
+        {
+            ++m_rehash_count;
+        }
+        m_bucket_count = bucket_count;
+    }
+
+    /**
+     * @return The number of bucket count changes observed.
+     */
+    auto rehash_count() const -> uint64_t { return m_rehash_count; }
+
+    /**
+     * @return A different starting bucket for each sample so repeated calls cover the whole index.
+     */
+    auto next_sample_offset() -> size_t { return m_sample_offset++; }
+
+private:
+    /// The last observed bucket count, 0 until the first insert.
+    size_t m_bucket_count{0};
+    /// The number of rehashes observed.
+    uint64_t m_rehash_count{0};
+    /// Rotates the sampled buckets between calls.
+    size_t m_sample_offset{0};
+};
+
+/**
+ * Samples the chain lengths of evenly spaced buckets of the index, all buckets are visited if
+ * there are no more than sample_buckets of them.
+ * @tparam map_type A std::unordered_map.
+ * @param index The index to sample, the caller must hold the cache's lock.
+ * @param rehashes The index's rehash counter.
+ * @param sample_buckets The number of buckets to sample.
+ * @return The index's statistics.
+ */
+template<typename map_type>
+auto sample_index_stats(const map_type& index, index_rehash_counter& rehashes, size_t sample_buckets) -> index_stats
+{
+    index_stats stats{};
+    stats.m_size            = index.size();
+    stats.m_bucket_count    = index.bucket_count();
+    stats.m_load_factor     = index.load_factor();
+    stats.m_max_load_factor = index.max_load_factor();
+    stats.m_rehash_count    = rehashes.rehash_count();
+
+    if (stats.m_bucket_count == 0 || sample_buckets == 0)
+    {
+        return stats;
+    }
+
+    sample_buckets    = std::min(sample_buckets, stats.m_bucket_count);
+    size_t stride     = stats.m_bucket_count / sample_buckets;
+    size_t offset     = rehashes.next_sample_offset() % stride;
+    size_t non_empty  = 0;
+    size_t collisions = 0;
+    for (size_t i = 0; i < sample_buckets; ++i)
+    {
+        size_t chain_length = index.bucket_size(offset + i * stride);
+        stats.m_sampled_elements += chain_length;
+        stats.m_max_chain_length = std::max(stats.m_max_chain_length, chain_length);
+        if (chain_length > 0)
+        {
+            ++non_empty;
+        }
+        if (chain_length > 1)
+        {
+            collisions += chain_length;
+        }
+    }
+
+    stats.m_sampled_buckets = sample_buckets;
+    if (non_empty > 0)
+    {
+        stats.m_average_chain_length = static_cast<double>(stats.m_sampled_elements) / static_cast<double>(non_empty);
+        stats.m_collision_ratio      = static_cast<double>(collisions) / static_cast<double>(stats.m_sampled_elements);
+    }
+    return stats;
+}
+
+} // namespace cappuccino
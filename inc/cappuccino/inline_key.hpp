@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace cappuccino
+{
+/**
+ * A fixed capacity string key that is stored inline, use it as the key_type of any cache in place
+ * of std::string for short keys.  A std::string longer than its small string buffer (15 bytes with
+ * libstdc++) allocates on every insert and every lookup has to follow the pointer from the index
+ * node to the characters.  An inline_key is stored directly in the index node instead so inserting
+ * does not allocate for the key and comparing a key does not take another cache miss.
+ *
+ * The key's hash is computed once on construction and stored with it, equality compares the
+ * stored hashes as a fingerprint first and only then the full fixed size buffers with memcmp.
+ * The unused tail of the buffer is always zero so the compare is over a constant N bytes which
+ * the compiler turns into a few wide vector compares.
+ *
+ * The constructors are explicit and reject keys longer than N bytes rather than truncating them,
+ * two keys sharing their first N bytes would otherwise find each other's values.
+ *
+ * @tparam N The maximum key length in bytes, check a key with fits() before constructing it.
+ */
+template<size_t N>
+class inline_key
+{
+    static_assert(N > 0 && N <= UINT16_MAX, "inline_key capacity must be between 1 and 65535 bytes");
+
+public:
+    using size_type = std::conditional_t<(N <= UINT8_MAX), uint8_t, uint16_t>;
+
+    inline_key() : inline_key(std::string_view{}) {}
+
+    /**
+     * @param key The key characters, at most N bytes.
+     * @throw std::length_error If the key is longer than N bytes.
+     */
+    explicit inline_key(std::string_view key) : m_size(static_cast<size_type>(checked_size(key)))
+    {
+        std::memcpy(m_data.data(), key.data(), m_size);
+        m_hash = std::hash<std::string_view>{}(view());
+    }
+
+    explicit inline_key(const std::string& key) : inline_key(std::string_view{key}) {}
+    explicit inline_key(const char* key) : inline_key(std::string_view{key}) {}
+
+    /**
+     * @param key The key to check.
+     * @return True if the key is short enough to be stored.
+     */
+    static constexpr auto fits(std::string_view key) -> bool { return key.size() <= N; }
+
+    /**
+     * @return The maximum key length in bytes.
+     */
+    static constexpr auto capacity() -> size_t { return N; }
+
+    /**
+     * @return The key's characters.
+     */
+    auto view() const -> std::string_view { return std::string_view{m_data.data(), m_size}; }
+
+    /**
+     * @return A copy of the key's characters.
+     */
+    auto str() const -> std::string { return std::string{view()}; }
+
+    /**
+     * @return The key's length in bytes.
+     */
+    auto size() const -> size_t { return m_size; }
+
+    /**
+     * @return True if the key has no characters.
+     */
+    auto empty() const -> bool { return (m_size == 0); }
+
+    /**
+     * @return The key's hash, the same as std::hash<std::string_view> for view().
+     */
+    auto hash() const -> size_t { return m_hash; }
+
+    friend auto operator==(const inline_key& lhs, const inline_key& rhs) -> bool
+    {
+        return lhs.m_hash == rhs.m_hash && lhs.m_size == rhs.m_size &&
+               std::memcmp(lhs.m_data.data(), rhs.m_data.data(), N) == 0;
+    }
+
+    friend auto operator!=(const inline_key& lhs, const inline_key& rhs) -> bool { return !(lhs == rhs); }
+
+    friend auto operator<(const inline_key& lhs, const inline_key& rhs) -> bool { return lhs.view() < rhs.view(); }
+
+private:
+    static auto checked_size(std::string_view key) -> size_t
+    {
+        if (!fits(key))
+        {
+            throw std::length_error{"inline_key longer than its capacity"};
+        }
+        return key.size();
+    }
+
+    /// The key's hash, also used as a fingerprint when comparing.
+    size_t m_hash{0};
+    /// The key characters, zero filled past m_size.
+    std::array<char, N> m_data{};
+    /// The key's length in bytes.
+    size_type m_size{0};
+};
+
+} // namespace cappuccino
+
+namespace std
+{
+template<size_t N>
+struct hash<cappuccino::inline_key<N>>
+{
+    auto operator()(const cappuccino::inline_key<N>& key) const noexcept -> size_t { return key.hash(); }
+};
+
+} // namespace std
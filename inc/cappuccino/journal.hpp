@@ -0,0 +1,841 @@
+#pragma once
+
+#include "cappuccino/mutation_sink.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <unistd.h>
+#endif
+
+namespace cappuccino
+{
+/**
+ * The kind of mutation a journal record describes.
+ */
+enum class journal_op : uint8_t
+{
+    /// The key was inserted or updated with a value and an expire time.
+    insert = 0,
+    /// The key was erased.
+    erase = 1,
+    /// The key's expire time changed, its value did not.
+    touch = 2
+};
+
+auto to_string(journal_op op) -> const std::string&;
+
+/**
+ * How durable a group commit is.
+ */
+enum class journal_sync
+{
+    /// Written to the operating system, survives a crash of the process but not of the machine.
+    no = 0,
+    /// Also fsync'ed, survives a crash of the machine at the cost of a disk flush per commit.
+    yes = 1
+};
+
+auto to_string(journal_sync s) -> const std::string&;
+
+/**
+ * @return A checksum of the given bytes, detects a torn or corrupt record at the tail of a journal.
+ */
+auto journal_checksum(const char* data, size_t size) -> uint32_t;
+
+/**
+ * @return A process wide unique id for each journal instance.
+ */
+auto journal_next_id() -> uint64_t;
+
+/**
+ * Encodes keys and values into journal records, trivially copyable types are copied byte for
+ * byte and std::string by its characters.  Specialize it for other types.
+ */
+template<typename type>
+struct journal_codec
+{
+    static_assert(std::is_trivially_copyable_v<type>, "journal_codec<type> must be specialized for this type");
+
+    static auto encode(std::string& out, const type& value) -> void
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(type));
+    }
+
+    static auto decode(std::string_view in, type& value) -> bool
+    {
+        if (in.size() != sizeof(type))
+        {
+            return false;
+        }
+        std::memcpy(&value, in.data(), sizeof(type));
+        return true;
+    }
+};
+
+template<>
+struct journal_codec<std::string>
+{
+    static auto encode(std::string& out, const std::string& value) -> void { out.append(value); }
+
+    static auto decode(std::string_view in, std::string& value) -> bool
+    {
+        value.assign(in.data(), in.size());
+        return true;
+    }
+};
+
+/**
+ * A decoded journal record, the expire time is wall clock time so it is still meaningful after a
+ * restart, system_clock::time_point::max() if it never expires.
+ */
+template<typename key_type, typename value_type>
+struct journal_record
+{
+    uint64_t                              sequence{0};
+    journal_op                            op{journal_op::insert};
+    std::chrono::system_clock::time_point expire_time{};
+    key_type                              key{};
+    std::optional<value_type>             value{};
+};
+
+/**
+ * Record layout, native byte order:
+ *   uint32 body size | uint32 checksum of the body |
+ *   body: uint64 sequence | uint8 op | int64 expire ms since the unix epoch | uint32 key size | key | value
+ */
+namespace journal_format
+{
+constexpr size_t header_size{sizeof(uint32_t) * 2};
+constexpr size_t fixed_body_size{sizeof(uint64_t) + sizeof(uint8_t) + sizeof(int64_t) + sizeof(uint32_t)};
+/// The expire ms of a record that never expires.
+constexpr int64_t never_expires_ms{std::numeric_limits<int64_t>::max()};
+
+template<typename integer_type>
+auto put(std::string& out, integer_type value) -> void
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(integer_type));
+}
+
+template<typename integer_type>
+auto get(const char*& in) -> integer_type
+{
+    integer_type value{};
+    std::memcpy(&value, in, sizeof(integer_type));
+    in += sizeof(integer_type);
+    return value;
+}
+
+template<typename key_type, typename value_type>
+auto encode(
+    std::string&      out,
+    uint64_t          sequence,
+    journal_op        op,
+    int64_t           expire_ms,
+    const key_type&   key,
+    const value_type* value) -> void
+{
+    auto start = out.size();
+    out.append(header_size, '\0');
+    put<uint64_t>(out, sequence);
+    put<uint8_t>(out, static_cast<uint8_t>(op));
+    put<int64_t>(out, expire_ms);
+    auto key_size_position = out.size();
+    put<uint32_t>(out, 0);
+    journal_codec<key_type>::encode(out, key);
+    auto key_size = static_cast<uint32_t>(out.size() - key_size_position - sizeof(uint32_t));
+    std::memcpy(out.data() + key_size_position, &key_size, sizeof(uint32_t));
+    if (value != nullptr)
+    {
+        journal_codec<value_type>::encode(out, *value);
+    }
+
+    auto body_size = static_cast<uint32_t>(out.size() - start - header_size);
+    auto checksum  = journal_checksum(out.data() + start + header_size, body_size);
+    std::memcpy(out.data() + start, &body_size, sizeof(uint32_t));
+    std::memcpy(out.data() + start + sizeof(uint32_t), &checksum, sizeof(uint32_t));
+}
+
+/**
+ * @return The size of the complete record at the front of the bytes, or 0 if it is incomplete.
+ */
+inline auto record_size(std::string_view in) -> size_t
+{
+    if (in.size() < header_size)
+    {
+        return 0;
+    }
+    uint32_t body_size{0};
+    std::memcpy(&body_size, in.data(), sizeof(uint32_t));
+    return (in.size() < header_size + body_size) ? 0 : header_size + body_size;
+}
+
+/**
+ * @return The sequence number of a complete record.
+ */
+inline auto sequence(std::string_view record) -> uint64_t
+{
+    const char* in = record.data() + header_size;
+    return get<uint64_t>(in);
+}
+
+/**
+ * @param record A complete record, see record_size().
+ * @return False if the record is corrupt.
+ */
+template<typename key_type, typename value_type>
+auto decode(std::string_view record, journal_record<key_type, value_type>& out) -> bool
+{
+    const char* in        = record.data();
+    auto        body_size = get<uint32_t>(in);
+    auto        checksum  = get<uint32_t>(in);
+    if (body_size < fixed_body_size || journal_checksum(in, body_size) != checksum)
+    {
+        return false;
+    }
+
+    const char* end = in + body_size;
+    out.sequence    = get<uint64_t>(in);
+    out.op          = static_cast<journal_op>(get<uint8_t>(in));
+    auto expire_ms  = get<int64_t>(in);
+    out.expire_time = (expire_ms == never_expires_ms)
+                          ? std::chrono::system_clock::time_point::max()
+                          : std::chrono::system_clock::time_point{std::chrono::milliseconds{expire_ms}};
+    auto key_size   = get<uint32_t>(in);
+    if (key_size > static_cast<size_t>(end - in) || !journal_codec<key_type>::decode({in, key_size}, out.key))
+    {
+        return false;
+    }
+    in += key_size;
+
+    out.value.reset();
+    if (out.op == journal_op::insert)
+    {
+        out.value.emplace();
+        return journal_codec<value_type>::decode({in, static_cast<size_t>(end - in)}, out.value.value());
+    }
+    return true;
+}
+
+} // namespace journal_format
+
+/**
+ * An append-only mutation journal so a restarted process recovers a warm cache rather than an
+ * empty one.  Attach it to a tlru_cache or an lru_cache with set_mutation_sink() and the cache
+ * appends every insert, update, erase and touch, evictions and expirations are not recorded since
+ * a replayed cache evicts and expires by itself.  An lru_cache's values never expire.
+ *
+ * Appending only encodes the record into a buffer owned by the calling thread, the file is
+ * written by a background thread that group commits every commit interval: it collects every
+ * thread's buffer, orders the records by their sequence number and writes them with a single
+ * write, optionally followed by a single fsync.  A crash loses at most the last commit interval.
+ *
+ * compact() folds the journal into a snapshot of the cache so the journal does not grow without
+ * bound, replay() rebuilds a cache from the last snapshot and the journal since.  The files are
+ * the given path for the journal, path + ".snapshot" for the last snapshot and path + ".pending"
+ * for the journal being folded into a snapshot by a compact() that has not finished.
+ *
+ * @tparam key_type The key type, see journal_codec.
+ * @tparam value_type The value type, see journal_codec.
+ */
+template<typename key_type, typename value_type>
+class journal final : public mutation_sink<key_type, value_type>
+{
+public:
+    using record_type = journal_record<key_type, value_type>;
+
+    /**
+     * @param path The journal file, it is appended to if it exists.
+     * @param commit_interval How often the buffered records are written.
+     * @param sync Should each group commit be fsync'ed?
+     */
+    explicit journal(
+        std::string               path,
+        std::chrono::milliseconds commit_interval = std::chrono::milliseconds{5},
+        journal_sync              sync            = journal_sync::no)
+        : m_path(std::move(path)),
+          m_commit_interval(commit_interval),
+          m_sync(sync),
+          m_file(std::fopen(m_path.c_str(), "ab")),
+          m_clock_offset(
+              std::chrono::system_clock::now().time_since_epoch() -
+              std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                  std::chrono::steady_clock::now().time_since_epoch()))
+    {
+        m_committer = std::thread{[this]() { do_run_committer(); }};
+    }
+
+    journal(const journal&) = delete;
+    journal(journal&&)      = delete;
+    auto operator=(const journal&) -> journal& = delete;
+    auto operator=(journal&&) -> journal& = delete;
+
+    /**
+     * Commits every record appended so far and closes the journal.
+     */
+    ~journal() override
+    {
+        {
+            std::lock_guard guard{m_wake_lock};
+            m_stop = true;
+        }
+        m_wake.notify_one();
+        m_committer.join();
+
+        flush();
+        if (m_file != nullptr)
+        {
+            std::fclose(m_file);
+        }
+    }
+
+    /**
+     * @return True if the journal file is open, records appended while it is not are dropped.
+     */
+    auto is_open() const -> bool { return m_file != nullptr; }
+
+    /**
+     * @return The journal file.
+     */
+    auto path() const -> const std::string& { return m_path; }
+
+    /**
+     * Records an insert or update, the caller must serialize the appends for the same key, e.g.
+     * with the cache's lock.
+     * @param key The key.
+     * @param value The key's new value.
+     * @param expire_time The point in time the value expires, time_point::max() if it never does.
+     */
+    auto append_insert(const key_type& key, const value_type& value, std::chrono::steady_clock::time_point expire_time)
+        -> void override
+    {
+        do_append(journal_op::insert, key, &value, to_unix_ms(expire_time));
+    }
+
+    /**
+     * Records an erase.
+     * @param key The erased key.
+     */
+    auto append_erase(const key_type& key) -> void override { do_append(journal_op::erase, key, nullptr, 0); }
+
+    /**
+     * Records a new expire time for a key.
+     * @param key The key.
+     * @param expire_time The key's new expire time.
+     */
+    auto append_touch(const key_type& key, std::chrono::steady_clock::time_point expire_time) -> void override
+    {
+        do_append(journal_op::touch, key, nullptr, to_unix_ms(expire_time));
+    }
+
+    /**
+     * Commits every record appended before this call without waiting for the commit interval.
+     * @return False if the journal is not open or a write or fsync has ever failed, the failure
+     *         is sticky since the records it lost cannot be recovered.  Records the file did not
+     *         accept are kept and retried on the next commit.
+     */
+    auto flush() -> bool
+    {
+        std::lock_guard guard{m_commit_lock};
+        do_commit();
+        return m_file != nullptr && !m_failed;
+    }
+
+    /**
+     * Folds the journal into a new snapshot of the cache.  The journal is rotated first so new
+     * records go into a fresh journal while the snapshot is taken with cache.snapshot(), the
+     * cache stays available to readers and writers throughout.
+     * @tparam cache_type A cache with snapshot(), e.g. tlru_cache.
+     * @param cache The cache this journal is attached to.
+     * @param chunk_size See tlru_cache::snapshot().
+     * A successful compact() clears a failure flush() reported before it since the snapshot holds
+     * every record the journal lost.
+     * @return False if a file could not be written, the previous snapshot and journal are kept.
+     */
+    template<typename cache_type>
+    auto compact(cache_type& cache, size_t chunk_size = 256) -> bool
+    {
+        std::lock_guard compact_guard{m_compact_lock};
+
+        auto pending_path  = m_path + ".pending";
+        auto snapshot_path = m_path + ".snapshot";
+        auto temp_path     = snapshot_path + ".tmp";
+
+        bool failed_before{false};
+        auto restore_failed = [&]() {
+            std::lock_guard guard{m_commit_lock};
+            m_failed = m_failed || failed_before;
+            return false;
+        };
+        {
+            std::lock_guard guard{m_commit_lock};
+            do_commit();
+            // Records the old journal did not accept are superseded by the snapshot, a failure
+            // before the rotation is cleared once the snapshot is written.
+            m_commit_bytes.clear();
+            failed_before = m_failed;
+            m_failed      = false;
+            if (m_file != nullptr)
+            {
+                std::fclose(m_file);
+            }
+            // A previous compact() that did not finish left its journal pending, keep it in front.
+            bool rotated{false};
+            if (file_exists(pending_path))
+            {
+                rotated = append_file(m_path, pending_path) && std::remove(m_path.c_str()) == 0;
+            }
+            else
+            {
+                rotated = std::rename(m_path.c_str(), pending_path.c_str()) == 0;
+            }
+            m_file = std::fopen(m_path.c_str(), "ab");
+            if (!rotated || m_file == nullptr)
+            {
+                m_failed = failed_before;
+                return false;
+            }
+        }
+
+        std::FILE* out = std::fopen(temp_path.c_str(), "wb");
+        if (out == nullptr)
+        {
+            return restore_failed();
+        }
+
+        std::string batch{};
+        uint64_t    sequence{0};
+        bool        written{true};
+        auto        now = std::chrono::steady_clock::now();
+        cache.snapshot(
+            [&](const key_type& key, const std::optional<value_type>& value, std::chrono::milliseconds ttl) {
+                auto expire_ms = value.has_value() ? to_unix_ms(now + ttl) : 0;
+                auto op        = value.has_value() ? journal_op::insert : journal_op::erase;
+                journal_format::encode(batch, ++sequence, op, expire_ms, key, value.has_value() ? &*value : nullptr);
+                if (batch.size() >= write_batch_size)
+                {
+                    written = written && std::fwrite(batch.data(), 1, batch.size(), out) == batch.size();
+                    batch.clear();
+                }
+            },
+            chunk_size);
+        written = written && std::fwrite(batch.data(), 1, batch.size(), out) == batch.size();
+        written = written && sync_file(out, journal_sync::yes);
+        written = (std::fclose(out) == 0) && written;
+
+        if (!written || std::rename(temp_path.c_str(), snapshot_path.c_str()) != 0)
+        {
+            std::remove(temp_path.c_str());
+            return restore_failed();
+        }
+        std::remove(pending_path.c_str());
+        return true;
+    }
+
+    /**
+     * Rebuilds a cache from the last snapshot and the journal since, call it before attaching the
+     * journal to the cache.  Consecutive inserts are applied with insert_range() to take the
+     * cache's lock once per batch, expired records are skipped.  A cache with ttls is given the
+     * longest ttl it can represent for records that never expire.  A torn or corrupt record ends
+     * the replay of its file.
+     * @tparam cache_type A cache with insert_range() and erase(), plus touch() if it has ttls,
+     *                    e.g. tlru_cache or lru_cache.
+     * @param path The journal file.
+     * @param cache The cache to apply the records to.
+     * @return The number of records applied.
+     */
+    template<typename cache_type>
+    static auto replay(const std::string& path, cache_type& cache) -> size_t
+    {
+        size_t applied{0};
+        for (const auto& file : {path + ".snapshot", path + ".pending", path})
+        {
+            applied += do_replay_file(file, cache);
+        }
+        return applied;
+    }
+
+    /**
+     * Decodes every record of a single journal or snapshot file.
+     * @tparam functor A callable taking a const record_type&.
+     * @param path The file to read.
+     * @param f Called for each record in order.
+     * @return The number of records read.
+     */
+    template<typename functor>
+    static auto read(const std::string& path, functor&& f) -> size_t
+    {
+        std::FILE* in = std::fopen(path.c_str(), "rb");
+        if (in == nullptr)
+        {
+            return 0;
+        }
+
+        size_t      count{0};
+        record_type record{};
+        std::string buffer{};
+        size_t      position{0};
+        bool        corrupt{false};
+
+        std::vector<char> chunk(read_chunk_size);
+        while (!corrupt)
+        {
+            auto bytes = std::fread(chunk.data(), 1, chunk.size(), in);
+            if (bytes == 0)
+            {
+                break;
+            }
+            buffer.erase(0, position);
+            buffer.append(chunk.data(), bytes);
+            position = 0;
+
+            std::string_view view{buffer};
+            while (auto size = journal_format::record_size(view.substr(position)))
+            {
+                if (!journal_format::decode(view.substr(position, size), record))
+                {
+                    corrupt = true;
+                    break;
+                }
+                f(static_cast<const record_type&>(record));
+                ++count;
+                position += size;
+            }
+        }
+
+        std::fclose(in);
+        return count;
+    }
+
+private:
+    /// Snapshot writes are batched up to this many bytes.
+    static constexpr size_t write_batch_size{1 << 20};
+    /// Replay reads the files sequentially in chunks of this many bytes.
+    static constexpr size_t read_chunk_size{1 << 24};
+    /// Consecutive inserts are replayed in batches of up to this many records.
+    static constexpr size_t replay_batch_size{4096};
+
+    /**
+     * The records appended by one thread and not yet committed.
+     */
+    struct thread_buffer
+    {
+        std::mutex m_lock{};
+        /// The encoded records in sequence order.
+        std::string m_bytes{};
+    };
+
+    /// The journal file.
+    std::string m_path;
+    /// How often the committer wakes up.
+    std::chrono::milliseconds m_commit_interval;
+    /// Should a commit be fsync'ed?
+    journal_sync m_sync;
+    /// The open journal file, written only by a commit.
+    std::FILE* m_file{nullptr};
+    /// Converts steady clock expire times into wall clock expire times.
+    std::chrono::system_clock::duration m_clock_offset;
+    /// Identifies this journal's buffers in every thread's local buffers.
+    const uint64_t m_id{journal_next_id()};
+
+    /// The last sequence number handed out.
+    std::atomic<uint64_t> m_next_sequence{0};
+    /// Every thread's buffer, a thread registers its buffer on its first append.
+    std::vector<std::shared_ptr<thread_buffer>> m_buffers{};
+    /// Guards 'm_buffers'.
+    std::mutex m_buffers_lock{};
+
+    /// Serializes commits.
+    std::mutex m_commit_lock{};
+    /// The last sequence number moved into 'm_commit_bytes'.
+    uint64_t m_ordered_sequence{0};
+    /// Records collected by a commit that arrived ahead of an earlier sequence number still in flight.
+    std::vector<std::pair<uint64_t, std::string>> m_carry{};
+    /// The records in sequence order that the file has not accepted yet, retried by the next commit.
+    std::string m_commit_bytes{};
+    /// Set by the first failed write or fsync and never cleared.
+    bool m_failed{false};
+
+    /// Serializes compact() calls.
+    std::mutex m_compact_lock{};
+
+    /// Wakes the committer early to stop.
+    std::mutex              m_wake_lock{};
+    std::condition_variable m_wake{};
+    bool                    m_stop{false};
+    std::thread             m_committer{};
+
+    auto to_unix_ms(std::chrono::steady_clock::time_point expire_time) const -> int64_t
+    {
+        // Checked first, adding the clock offset to max() overflows.
+        if (expire_time == std::chrono::steady_clock::time_point::max())
+        {
+            return journal_format::never_expires_ms;
+        }
+        auto since_epoch =
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(expire_time.time_since_epoch()) +
+            m_clock_offset;
+        return std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch).count();
+    }
+
+    auto local_buffer() -> thread_buffer&
+    {
+        thread_local std::unordered_map<uint64_t, std::shared_ptr<thread_buffer>> buffers{};
+
+        auto& buffer = buffers[m_id];
+        if (buffer == nullptr)
+        {
+            buffer = std::make_shared<thread_buffer>();
+            std::lock_guard guard{m_buffers_lock};
+            m_buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    auto do_append(journal_op op, const key_type& key, const value_type* value, int64_t expire_ms) -> void
+    {
+        auto&           buffer = local_buffer();
+        std::lock_guard guard{buffer.m_lock};
+        // The sequence number is taken with the buffer locked so a commit that has seen it also
+        // finds the record once it locks this buffer.
+        auto sequence = m_next_sequence.fetch_add(1, std::memory_order_acq_rel) + 1;
+        journal_format::encode(buffer.m_bytes, sequence, op, expire_ms, key, value);
+    }
+
+    /**
+     * Collects every thread's buffered records and writes the longest run of consecutive sequence
+     * numbers after any records a failed commit left behind, the caller must hold 'm_commit_lock'.
+     * A sequence number is only taken with its thread's buffer locked so every record appended
+     * before the commit started is collected, a gap can only be left by an append racing with the
+     * commit and the records after it are carried over to the next commit.
+     */
+    auto do_commit() -> void
+    {
+        std::vector<std::shared_ptr<thread_buffer>> buffers{};
+        {
+            std::lock_guard guard{m_buffers_lock};
+            buffers = m_buffers;
+        }
+
+        std::vector<std::pair<uint64_t, std::string>> records = std::move(m_carry);
+        m_carry.clear();
+        for (auto& buffer : buffers)
+        {
+            std::string bytes{};
+            {
+                std::lock_guard guard{buffer->m_lock};
+                bytes.swap(buffer->m_bytes);
+            }
+
+            std::string_view view{bytes};
+            while (auto size = journal_format::record_size(view))
+            {
+                records.emplace_back(journal_format::sequence(view), std::string{view.substr(0, size)});
+                view.remove_prefix(size);
+            }
+        }
+        std::sort(records.begin(), records.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        auto next = records.begin();
+        for (; next != records.end() && next->first == m_ordered_sequence + 1; ++next)
+        {
+            m_commit_bytes.append(next->second);
+            ++m_ordered_sequence;
+        }
+        m_carry.assign(std::make_move_iterator(next), std::make_move_iterator(records.end()));
+
+        if (m_file == nullptr)
+        {
+            // Dropped, is_open() and flush() report it.
+            m_commit_bytes.clear();
+            return;
+        }
+        if (m_commit_bytes.empty())
+        {
+            return;
+        }
+
+        std::clearerr(m_file);
+        auto written = std::fwrite(m_commit_bytes.data(), 1, m_commit_bytes.size(), m_file);
+        m_commit_bytes.erase(0, written);
+        if (!m_commit_bytes.empty() || !sync_file(m_file, m_sync))
+        {
+            m_failed = true;
+        }
+    }
+
+    auto do_run_committer() -> void
+    {
+        while (true)
+        {
+            bool stop{false};
+            {
+                std::unique_lock guard{m_wake_lock};
+                m_wake.wait_for(guard, m_commit_interval, [this]() { return m_stop; });
+                stop = m_stop;
+            }
+
+            {
+                std::lock_guard guard{m_commit_lock};
+                do_commit();
+            }
+
+            if (stop)
+            {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @return True if the cache has per key ttls, detected by its touch(key, ttl).
+     */
+    template<typename cache_type>
+    static constexpr auto has_ttl(int) -> decltype(
+        std::declval<cache_type&>().touch(std::declval<const key_type&>(), std::chrono::milliseconds{}), bool())
+    {
+        return true;
+    }
+
+    template<typename cache_type>
+    static constexpr auto has_ttl(...) -> bool
+    {
+        return false;
+    }
+
+    template<typename cache_type>
+    static auto do_replay_file(const std::string& path, cache_type& cache) -> size_t
+    {
+        constexpr bool ttl_cache = has_ttl<cache_type>(0);
+        using insert_type        = std::conditional_t<
+            ttl_cache,
+            std::tuple<std::chrono::milliseconds, key_type, value_type>,
+            std::pair<key_type, value_type>>;
+
+        std::vector<insert_type> inserts{};
+        auto                     apply_inserts = [&]() {
+            cache.insert_range(inserts);
+            inserts.clear();
+        };
+
+        // Half of what is left of the steady clock so the cache's own now plus the ttl cannot overflow.
+        auto forever = std::chrono::floor<std::chrono::milliseconds>(
+            (std::chrono::steady_clock::time_point::max() - std::chrono::steady_clock::now()) / 2);
+        auto now   = std::chrono::system_clock::now();
+        auto count = read(path, [&](const record_type& record) {
+            auto ttl = (record.expire_time == std::chrono::system_clock::time_point::max())
+                           ? forever
+                           : std::chrono::ceil<std::chrono::milliseconds>(record.expire_time - now);
+            if (record.op == journal_op::insert && ttl.count() > 0)
+            {
+                if constexpr (ttl_cache)
+                {
+                    inserts.emplace_back(ttl, record.key, record.value.value());
+                }
+                else
+                {
+                    inserts.emplace_back(record.key, record.value.value());
+                }
+                if (inserts.size() >= replay_batch_size)
+                {
+                    apply_inserts();
+                }
+                return;
+            }
+
+            // Keep the records in order, the pending inserts might contain this key.
+            apply_inserts();
+            if (record.op == journal_op::touch && ttl.count() > 0)
+            {
+                if constexpr (ttl_cache)
+                {
+                    cache.touch(record.key, ttl);
+                }
+            }
+            else
+            {
+                // Erased or already expired.
+                cache.erase(record.key);
+            }
+        });
+        apply_inserts();
+        return count;
+    }
+
+    static auto sync_file(std::FILE* file, journal_sync sync) -> bool
+    {
+        if (std::fflush(file) != 0)
+        {
+            return false;
+        }
+#if defined(__unix__) || defined(__APPLE__)
+        if (sync == journal_sync::yes)
+        {
+            return fsync(fileno(file)) == 0;
+        }
+#else
+        (void)sync;
+#endif
+        return true;
+    }
+
+    static auto file_exists(const std::string& path) -> bool
+    {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+        std::fclose(file);
+        return true;
+    }
+
+    static auto append_file(const std::string& from, const std::string& to) -> bool
+    {
+        std::FILE* in  = std::fopen(from.c_str(), "rb");
+        std::FILE* out = std::fopen(to.c_str(), "ab");
+        bool       ok  = (in != nullptr && out != nullptr);
+
+        std::vector<char> chunk(write_batch_size);
+        while (ok)
+        {
+            auto bytes = std::fread(chunk.data(), 1, chunk.size(), in);
+            if (bytes == 0)
+            {
+                break;
+            }
+            ok = std::fwrite(chunk.data(), 1, bytes, out) == bytes;
+        }
+        ok = ok && sync_file(out, journal_sync::yes);
+
+        if (in != nullptr)
+        {
+            std::fclose(in);
+        }
+        if (out != nullptr)
+        {
+            ok = (std::fclose(out) == 0) && ok;
+        }
+        return ok;
+    }
+};
+
+} // namespace cappuccino
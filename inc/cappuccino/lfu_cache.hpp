@@ -1,7 +1,9 @@
 #pragma once
 
 #include "cappuccino/allow.hpp"
+#include "cappuccino/index_stats.hpp"
 #include "cappuccino/lock.hpp"
+#include "cappuccino/trace.hpp"
 
 #include <list>
 #include <map>
@@ -207,6 +209,18 @@ public:
         }
     }
 
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
     /**
      * @return If this cache is currenty empty.
      */
@@ -262,11 +276,15 @@ private:
             do_prune();
         }
 
+        CAPPUCCINO_PROBE3(insert, "lfu_cache", this, &key);
+
         element& e = *m_open_list_end;
 
         auto keyed_position = m_keyed_elements.emplace(key, m_open_list_end).first;
         auto lfu_position   = m_lfu_list.emplace(1, m_open_list_end);
 
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
+
         e.m_value          = std::move(value);
         e.m_keyed_position = keyed_position;
         e.m_lfu_position   = lfu_position;
@@ -278,6 +296,8 @@ private:
 
     auto do_update(keyed_iterator keyed_position, value_type&& value) -> void
     {
+        CAPPUCCINO_PROBE3(update, "lfu_cache", this, &keyed_position->first);
+
         element& e = *keyed_position->second;
         e.m_value  = std::move(value);
 
@@ -311,9 +331,11 @@ private:
             {
                 do_access(e);
             }
+            CAPPUCCINO_PROBE3(find_hit, "lfu_cache", this, &key);
             return {e.m_value};
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "lfu_cache", this, &key);
         return {};
     }
 
@@ -328,9 +350,11 @@ private:
             {
                 do_access(e);
             }
+            CAPPUCCINO_PROBE3(find_hit, "lfu_cache", this, &key);
             return {std::make_pair(e.m_value, e.m_lfu_position->first)};
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "lfu_cache", this, &key);
         return {};
     }
 
@@ -345,7 +369,10 @@ private:
     {
         if (m_used_size > 0)
         {
-            do_erase(m_lfu_list.begin()->second);
+            auto victim = m_lfu_list.begin()->second;
+            CAPPUCCINO_PROBE4(
+                evict, "lfu_cache", this, &victim->m_keyed_position->first, static_cast<int>(evict_reason::capacity));
+            do_erase(victim);
         }
     }
 
@@ -361,6 +388,8 @@ private:
     typename std::list<element>::iterator m_open_list_end;
     /// The keyed lookup data structure, the value is the index into 'm_elements'.
     std::unordered_map<key_type, open_list_iterator> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
     /// The lfu sorted map, the key is the number of times the element has been used,
     /// the value is the index into 'm_elements'.
     std::multimap<size_t, open_list_iterator> m_lfu_list;
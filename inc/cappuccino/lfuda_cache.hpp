@@ -1,7 +1,10 @@
 #pragma once
 
 #include "cappuccino/allow.hpp"
+#include "cappuccino/index_stats.hpp"
 #include "cappuccino/lock.hpp"
+#include "cappuccino/timestamp.hpp"
+#include "cappuccino/trace.hpp"
 
 #include <chrono>
 #include <list>
@@ -29,8 +32,14 @@ namespace cappuccino
  *                   structure value is large it is advisable to store in a shared ptr.
  * @tparam thread_safe_type By default this cache is thread safe, can be disabled for caches specific
  *                  to a single thread.
+ * @tparam timestamp_type How the dynamic age times are stored, see timestamp.hpp.  Use
+ *                        coarse_timestamp<> to store them as 32 bit millisecond offsets.
  */
-template<typename key_type, typename value_type, thread_safe thread_safe_type = thread_safe::yes>
+template<
+    typename key_type,
+    typename value_type,
+    thread_safe thread_safe_type = thread_safe::yes,
+    typename timestamp_type      = steady_timestamp>
 class lfuda_cache
 {
 private:
@@ -262,6 +271,18 @@ public:
         return do_dynamic_age(now);
     }
 
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
     /**
      * @return If this cache is currenty empty.
      */
@@ -285,7 +306,7 @@ private:
         /// The iterator into the lfu data structure.
         lfu_iterator m_lfu_position;
         /// The dynamic age timestamp.
-        std::chrono::steady_clock::time_point m_dynamic_age;
+        typename timestamp_type::stamp_type m_dynamic_age;
         /// The element's value.
         value_type m_value;
     };
@@ -321,15 +342,20 @@ private:
             do_prune(now);
         }
 
+        CAPPUCCINO_PROBE3(insert, "lfuda_cache", this, &key);
+
+        do_rebase(now);
         element& e = *m_open_list_end;
 
         auto keyed_position = m_keyed_elements.emplace(key, m_open_list_end).first;
         auto lfu_position   = m_lfu_list.emplace(1, m_open_list_end);
 
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
+
         e.m_value          = std::move(value);
         e.m_keyed_position = keyed_position;
         e.m_lfu_position   = lfu_position;
-        e.m_dynamic_age    = now;
+        e.m_dynamic_age    = m_timestamp.stamp(now);
 
         ++m_open_list_end;
 
@@ -338,6 +364,8 @@ private:
 
     auto do_update(keyed_iterator keyed_position, value_type&& value, std::chrono::steady_clock::time_point now) -> void
     {
+        CAPPUCCINO_PROBE3(update, "lfuda_cache", this, &keyed_position->first);
+
         element& e = *keyed_position->second;
         e.m_value  = std::move(value);
 
@@ -370,9 +398,11 @@ private:
             {
                 do_access(e, now);
             }
+            CAPPUCCINO_PROBE3(find_hit, "lfuda_cache", this, &key);
             return {e.m_value};
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "lfuda_cache", this, &key);
         return {};
     }
 
@@ -387,9 +417,11 @@ private:
             {
                 do_access(e, now);
             }
+            CAPPUCCINO_PROBE3(find_hit, "lfuda_cache", this, &key);
             return {std::make_pair(e.m_value, e.m_lfu_position->first)};
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "lfuda_cache", this, &key);
         return {};
     }
 
@@ -407,7 +439,8 @@ private:
         {
             m_dynamic_age_list.splice(last_aged_item, m_dynamic_age_list, e.m_keyed_position->second);
         }
-        e.m_dynamic_age = now;
+        do_rebase(now);
+        e.m_dynamic_age = m_timestamp.stamp(now);
     }
 
     auto do_prune(std::chrono::steady_clock::time_point now) -> void
@@ -417,7 +450,26 @@ private:
             do_dynamic_age(now);
 
             // Now delete the least frequently used item after dynamically aging.
-            do_erase(m_lfu_list.begin()->second);
+            auto victim = m_lfu_list.begin()->second;
+            CAPPUCCINO_PROBE4(
+                evict, "lfuda_cache", this, &victim->m_keyed_position->first, static_cast<int>(evict_reason::capacity));
+            do_erase(victim);
+        }
+    }
+
+    /**
+     * Moves the timestamp epoch forward if needed, this must happen before new dynamic age times
+     * are computed from the given point in time.
+     */
+    auto do_rebase(std::chrono::steady_clock::time_point now) -> void
+    {
+        auto shift = m_timestamp.rebase(now);
+        if (shift > 0)
+        {
+            for (auto& e : m_dynamic_age_list)
+            {
+                e.m_dynamic_age = timestamp_type::shifted(e.m_dynamic_age, shift);
+            }
         }
     }
 
@@ -425,10 +477,14 @@ private:
     {
         size_t aged{0};
 
+        do_rebase(now);
+        auto now_stamp = m_timestamp.stamp(now);
+
         // For all items in the DA list that are old enough and in use, DA them!
         auto da_start = m_dynamic_age_list.begin();
         auto da_last  = m_open_list_end; // need the item previous to the end to splice properly
-        while (da_start != m_open_list_end && (*da_start).m_dynamic_age + m_dynamic_age_tick < now)
+        while (da_start != m_open_list_end &&
+               m_timestamp.time_point((*da_start).m_dynamic_age) + m_dynamic_age_tick < now)
         {
             // swap to after the last item (if it isn't the last item..)
             if (da_start != da_last)
@@ -438,7 +494,7 @@ private:
 
             // Update its dynamic age time to now.
             element& e      = *da_start;
-            e.m_dynamic_age = now;
+            e.m_dynamic_age = now_stamp;
             // Now *= ratio its use count to actually age it.  This requires
             // deleting from and re-inserting into the lfu data structure.
             size_t use_count = e.m_lfu_position->first;
@@ -467,9 +523,13 @@ private:
     std::chrono::milliseconds m_dynamic_age_tick{std::chrono::minutes{1}};
     /// The ratio amount of 'uses' to remove when an element dynamically ages.
     float m_dynamic_age_ratio{0.5f};
+    /// The representation of the dynamic age times.
+    timestamp_type m_timestamp;
 
     /// The keyed lookup data structure, the value is the index into 'm_elements'.
     std::unordered_map<key_type, age_iterator> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
     /// The lfu sorted map, the key is the number of times the element has been used,
     /// the value is the index into 'm_elements'.
     std::multimap<size_t, age_iterator> m_lfu_list;
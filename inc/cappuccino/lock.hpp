@@ -1,7 +1,11 @@
 #pragma once
 
+#include "cappuccino/trace.hpp"
+
+#include <chrono>
 #include <mutex>
 #include <string>
+#include <thread>
 
 namespace cappuccino
 {
@@ -22,13 +26,27 @@ enum class thread_safe
 
 auto to_string(thread_safe ts) -> const std::string&;
 
+/**
+ * The outcome of trying to acquire a cache's lock without blocking, e.g. try_find().  A
+ * contended result means the operation was not attempted, not that the key is missing.
+ */
+enum class lock_status
+{
+    /// The lock was acquired and the operation ran.
+    acquired = 0,
+    /// The lock was held by another thread, the operation did not run.
+    contended = 1,
+};
+
+auto to_string(lock_status ls) -> const std::string&;
+
 /**
  * Creates a lock that based on the thread_safety will behave correctly.
  * thread_safe::yes => Uses a std::mutex
  * thread_safe::no => is a no-op.
  *
  * @tparam thread_safe_type The thread_safe type to use.
- * @tparam lock_type The underlying lock type to use.  Must support .lock() and .unlock().
+ * @tparam lock_type The underlying lock type to use.  Must support .lock(), .try_lock() and .unlock().
  */
 template<thread_safe thread_safe_type, typename lock_type = std::mutex>
 class mutex
@@ -38,8 +56,63 @@ public:
     {
         if constexpr (thread_safe_type == thread_safe::yes)
         {
-            m_lock.lock();
+            // Detecting contention costs an extra try_lock, only pay for it while a tracer is attached.
+            if (CAPPUCCINO_PROBE_ENABLED(lock_contended))
+            {
+                if (!m_lock.try_lock())
+                {
+                    CAPPUCCINO_PROBE1(lock_contended, this);
+                    m_lock.lock();
+                }
+            }
+            else
+            {
+                m_lock.lock();
+            }
+            CAPPUCCINO_PROBE1(lock_acquire, this);
+        }
+    }
+
+    /**
+     * @return True if the lock was acquired without blocking, always true for thread_safe::no.
+     */
+    constexpr auto try_lock() -> bool
+    {
+        if constexpr (thread_safe_type == thread_safe::yes)
+        {
+            if (!m_lock.try_lock())
+            {
+                CAPPUCCINO_PROBE1(lock_contended, this);
+                return false;
+            }
+            CAPPUCCINO_PROBE1(lock_acquire, this);
+        }
+        return true;
+    }
+
+    /**
+     * Spins on try_lock(), yielding between attempts, until the lock is acquired or the deadline
+     * passes.  The lock is always tried at least once.
+     * @param deadline The point in time to give up at.
+     * @return True if the lock was acquired, always true for thread_safe::no.
+     */
+    template<typename clock_type, typename duration_type>
+    auto try_lock_until(const std::chrono::time_point<clock_type, duration_type>& deadline) -> bool
+    {
+        if constexpr (thread_safe_type == thread_safe::yes)
+        {
+            while (!m_lock.try_lock())
+            {
+                if (clock_type::now() >= deadline)
+                {
+                    CAPPUCCINO_PROBE1(lock_contended, this);
+                    return false;
+                }
+                std::this_thread::yield();
+            }
+            CAPPUCCINO_PROBE1(lock_acquire, this);
         }
+        return true;
     }
 
     constexpr auto unlock() -> void
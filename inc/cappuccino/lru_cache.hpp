@@ -1,11 +1,19 @@
 #pragma once
 
 #include "cappuccino/allow.hpp"
+#include "cappuccino/eviction_stats.hpp"
+#include "cappuccino/index_list.hpp"
+#include "cappuccino/index_stats.hpp"
 #include "cappuccino/lock.hpp"
+#include "cappuccino/mutation_sink.hpp"
 #include "cappuccino/peek.hpp"
+#include "cappuccino/trace.hpp"
 
-#include <list>
+#include <algorithm>
+#include <chrono>
 #include <numeric>
+#include <optional>
+#include <utility>
 #include <unordered_map>
 #include <vector>
 
@@ -24,26 +32,37 @@ namespace cappuccino
  *                   structure value is large it is advisable to store in a shared ptr.
  * @tparam thread_safe_type By default this cache is thread safe, can be disabled for caches specific
  *                  to a single thread.
+ * @tparam index_type The slot index type used by the keyed lookup and the lru links.  Use uint32_t
+ *                    for a compact cache of up to 4 billion elements, it halves the per element
+ *                    index and link overhead.
  */
-template<typename key_type, typename value_type, thread_safe thread_safe_type = thread_safe::yes>
+template<
+    typename key_type,
+    typename value_type,
+    thread_safe thread_safe_type = thread_safe::yes,
+    typename index_type          = size_t>
 class lru_cache
 {
 private:
-    using keyed_iterator = typename std::unordered_map<key_type, size_t>::iterator;
-    using lru_iterator   = std::list<size_t>::iterator;
+    using keyed_iterator = typename std::unordered_map<key_type, index_type>::iterator;
 
 public:
     /**
-     * @param capacity The maximum number of key value pairs allowed in the cache.
+     * @param capacity The maximum number of key value pairs allowed in the cache, this is capped
+     *                 to the largest capacity `index_type` can address.
      * @param max_load_factor The load factor for the hash map, generally 1 is a good default.
      */
-    explicit lru_cache(size_t capacity, float max_load_factor = 1.0f) : m_elements(capacity), m_lru_list(capacity)
+    explicit lru_cache(size_t capacity, float max_load_factor = 1.0f)
+        : m_elements(std::min(capacity, index_list<index_type>::max_capacity())),
+          m_lru_list(m_elements.size()),
+          m_open_list(m_elements.size())
     {
-        std::iota(m_lru_list.begin(), m_lru_list.end(), 0);
-        m_lru_end = m_lru_list.begin();
+        std::iota(m_open_list.begin(), m_open_list.end(), 0);
+        m_high_watermark = m_elements.size();
+        m_low_watermark  = do_max_low_watermark();
 
         m_keyed_elements.max_load_factor(max_load_factor);
-        m_keyed_elements.reserve(capacity);
+        m_keyed_elements.reserve(m_elements.size());
     }
 
     /**
@@ -98,16 +117,7 @@ public:
     auto erase(const key_type& key) -> bool
     {
         std::lock_guard guard{m_lock};
-        auto            keyed_position = m_keyed_elements.find(key);
-        if (keyed_position != m_keyed_elements.end())
-        {
-            do_erase(keyed_position->second);
-            return true;
-        }
-        else
-        {
-            return false;
-        }
+        return do_erase_key(key);
     }
 
     /**
@@ -128,6 +138,10 @@ public:
             if (keyed_position != m_keyed_elements.end())
             {
                 ++deleted_elements;
+                if (m_mutation_sink != nullptr)
+                {
+                    m_mutation_sink->append_erase(keyed_position->first);
+                }
                 do_erase(keyed_position->second);
             }
         }
@@ -195,6 +209,284 @@ public:
         }
     }
 
+    /**
+     * Attempts to find the given key's value without blocking, a latency critical caller can treat
+     * a contended cache like a miss rather than wait behind a long operation.
+     * @param key The key to lookup its value.
+     * @param peek Should the find act like the item wasn't used?
+     * @return lock_status::contended with an empty optional if the lock is held by another thread,
+     *         otherwise lock_status::acquired with the result of find().
+     */
+    auto try_find(const key_type& key, peek peek = peek::no) -> std::pair<lock_status, std::optional<value_type>>
+    {
+        std::unique_lock guard{m_lock, std::try_to_lock};
+        if (!guard.owns_lock())
+        {
+            return {lock_status::contended, std::nullopt};
+        }
+        return {lock_status::acquired, do_find(key, peek)};
+    }
+
+    /**
+     * Attempts to find the given key's value, waiting for the lock until the deadline at most.
+     * @param deadline The point in time to give up waiting for the lock.
+     * @param key The key to lookup its value.
+     * @param peek Should the find act like the item wasn't used?
+     * @return See try_find().
+     */
+    auto try_find_until(std::chrono::steady_clock::time_point deadline, const key_type& key, peek peek = peek::no)
+        -> std::pair<lock_status, std::optional<value_type>>
+    {
+        std::unique_lock guard{m_lock, deadline};
+        if (!guard.owns_lock())
+        {
+            return {lock_status::contended, std::nullopt};
+        }
+        return {lock_status::acquired, do_find(key, peek)};
+    }
+
+    /**
+     * Attempts to insert or update the given key value pair without blocking.
+     * @param key The key to store the value under.
+     * @param value The value of the data to store.
+     * @param a Allowed methods of insertion | update.
+     * @return lock_status::contended and false if the lock is held by another thread, otherwise
+     *         lock_status::acquired with the result of insert().
+     */
+    auto try_insert(const key_type& key, value_type value, allow a = allow::insert_or_update)
+        -> std::pair<lock_status, bool>
+    {
+        std::unique_lock guard{m_lock, std::try_to_lock};
+        if (!guard.owns_lock())
+        {
+            return {lock_status::contended, false};
+        }
+        return {lock_status::acquired, do_insert_update(key, std::move(value), a)};
+    }
+
+    /**
+     * Attempts to insert or update the given key value pair, waiting for the lock until the
+     * deadline at most.
+     * @param deadline The point in time to give up waiting for the lock.
+     * @param key The key to store the value under.
+     * @param value The value of the data to store.
+     * @param a Allowed methods of insertion | update.
+     * @return See try_insert().
+     */
+    auto try_insert_until(
+        std::chrono::steady_clock::time_point deadline,
+        const key_type&                       key,
+        value_type                            value,
+        allow                                 a = allow::insert_or_update) -> std::pair<lock_status, bool>
+    {
+        std::unique_lock guard{m_lock, deadline};
+        if (!guard.owns_lock())
+        {
+            return {lock_status::contended, false};
+        }
+        return {lock_status::acquired, do_insert_update(key, std::move(value), a)};
+    }
+
+    /**
+     * The cache's operations without any locking, only handed out by with_lock() while the lock
+     * is held.  It must not be used after the with_lock() functor returns.
+     */
+    class locked_view
+    {
+    public:
+        locked_view(const locked_view&) = delete;
+        auto operator=(const locked_view&) -> locked_view& = delete;
+
+        /**
+         * Inserts or updates the given key value pair, see lru_cache::insert().
+         */
+        auto insert(const key_type& key, value_type value, allow a = allow::insert_or_update) -> bool
+        {
+            return m_cache.do_insert_update(key, std::move(value), a);
+        }
+
+        /**
+         * Attempts to delete the given key, see lru_cache::erase().
+         */
+        auto erase(const key_type& key) -> bool { return m_cache.do_erase_key(key); }
+
+        /**
+         * Attempts to find the given key's value, see lru_cache::find().
+         */
+        auto find(const key_type& key, peek peek = peek::no) -> std::optional<value_type>
+        {
+            return m_cache.do_find(key, peek);
+        }
+
+        /**
+         * Visits every key value pair from the most to the least recently used, the pairs must not
+         * be modified by the functor.
+         * @tparam functor_type A callable taking (const key_type&, const value_type&).
+         * @param f Called for each key value pair.
+         */
+        template<typename functor_type>
+        auto for_each(functor_type&& f) const -> void
+        {
+            const auto& lru_list = m_cache.m_lru_list;
+            for (auto idx = lru_list.front(); idx != lru_list.end(); idx = lru_list.next(idx))
+            {
+                const auto& e = m_cache.m_elements[idx];
+                f(e.m_keyed_position->first, e.m_value);
+            }
+        }
+
+        /**
+         * Visits the key value pairs stored in the slots [first, first + count) in storage order.
+         * A pair stays in its slot for as long as it is in the cache, so walking every slot in
+         * chunks across with_lock() calls visits each pair that is never erased exactly once
+         * without holding the lock for the whole walk.
+         * @tparam functor_type A callable taking (const key_type&, const value_type&).
+         * @param first The first slot to visit.
+         * @param count The number of slots to visit.
+         * @param f Called for each key value pair.
+         * @return The slot to continue from, capacity() once every slot has been visited.
+         */
+        template<typename functor_type>
+        auto for_each_slot(size_t first, size_t count, functor_type&& f) const -> size_t
+        {
+            auto last = std::min(first + count, m_cache.m_elements.size());
+            for (auto idx = first; idx < last; ++idx)
+            {
+                if (m_cache.m_lru_list.linked(static_cast<index_type>(idx)))
+                {
+                    const auto& e = m_cache.m_elements[idx];
+                    f(e.m_keyed_position->first, e.m_value);
+                }
+            }
+            return last;
+        }
+
+        /**
+         * @return If the cache is currenty empty.
+         */
+        auto empty() const -> bool { return m_cache.empty(); }
+
+        /**
+         * @return The number of elements inside the cache.
+         */
+        auto size() const -> size_t { return m_cache.size(); }
+
+        /**
+         * @return The maximum capacity of the cache.
+         */
+        auto capacity() const -> size_t { return m_cache.capacity(); }
+
+    private:
+        friend class lru_cache;
+
+        explicit locked_view(lru_cache& cache) : m_cache(cache) {}
+
+        /// The cache whose lock is held for the lifetime of this view.
+        lru_cache& m_cache;
+    };
+
+    /**
+     * Runs the functor with the cache's lock held for its whole duration.  The functor is given a
+     * locked_view to find, insert and erase any number of keys, so a mixed set of operations takes
+     * the lock once and is atomic with respect to every other operation on the cache.  The functor
+     * must not call the cache's own methods, they would take the lock again.
+     * @tparam functor_type A callable taking a locked_view&.
+     * @param f The operations to run under the lock.
+     * @return Whatever the functor returns.
+     */
+    template<typename functor_type>
+    auto with_lock(functor_type&& f) -> decltype(auto)
+    {
+        std::lock_guard guard{m_lock};
+        locked_view     view{*this};
+        return std::forward<functor_type>(f)(view);
+    }
+
+    /**
+     * Reports every insert, update, erase and eviction to the given sink from now on, e.g. a
+     * replication_primary, see replication.hpp, or a journal, see journal.hpp.
+     * @param sink The sink, it must outlive the cache or be detached with nullptr first.
+     */
+    auto set_mutation_sink(mutation_sink<key_type, value_type>* sink) -> void
+    {
+        std::lock_guard guard{m_lock};
+        m_mutation_sink = sink;
+    }
+
+    /**
+     * Starts recording statistics about evicted elements, see eviction_stats.  This adds per
+     * element bookkeeping of the insert time, last access time and hit count.  Peeking at an
+     * element does not count as an access.
+     */
+    auto enable_eviction_stats() -> void
+    {
+        std::lock_guard guard{m_lock};
+        if (m_eviction_metadata.empty())
+        {
+            auto now = std::chrono::steady_clock::now();
+            m_eviction_metadata.assign(m_elements.size(), eviction_metadata{now, now, 0});
+        }
+    }
+
+    /**
+     * @param reset Should the statistics be cleared after they are retrieved?
+     * @return The eviction statistics recorded since they were enabled or last reset.
+     */
+    auto eviction_stats(bool reset = false) -> cappuccino::eviction_stats
+    {
+        std::lock_guard            guard{m_lock};
+        cappuccino::eviction_stats stats = m_eviction_stats;
+        if (reset)
+        {
+            m_eviction_stats.clear();
+        }
+        return stats;
+    }
+
+    /**
+     * Sets the occupancy marks for batch eviction.  An insert into a full cache evicts down to the
+     * low watermark at once instead of a single element, and prune() evicts down to the low
+     * watermark once the cache holds at least the high watermark.  Calling prune() from a
+     * maintenance thread with the high watermark below the capacity keeps eviction work off the
+     * insert path.  By default the high watermark is the capacity and the low watermark is one
+     * less, which evicts a single element per insert into a full cache.
+     * @param high_watermark The size at which prune() evicts, capped to the capacity.
+     * @param low_watermark The size evictions stop at, capped below the high watermark and the capacity.
+     */
+    auto set_eviction_watermarks(size_t high_watermark, size_t low_watermark) -> void
+    {
+        std::lock_guard guard{m_lock};
+        m_high_watermark = std::min(high_watermark, m_elements.size());
+        m_low_watermark  = std::min({low_watermark, m_high_watermark, do_max_low_watermark()});
+    }
+
+    /**
+     * Evicts elements down to the low watermark if the cache holds at least the high watermark,
+     * see set_eviction_watermarks().
+     * @return The number of elements evicted.
+     */
+    auto prune() -> size_t
+    {
+        std::lock_guard guard{m_lock};
+        if (m_used_size < m_high_watermark || m_used_size == 0)
+        {
+            return 0;
+        }
+        return do_prune_to(m_low_watermark);
+    }
+
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
     /**
      * @return If this cache is currenty empty.
      */
@@ -211,12 +503,20 @@ public:
     auto capacity() const -> size_t { return m_elements.size(); }
 
 private:
+    struct eviction_metadata
+    {
+        /// The point in time the element was inserted.
+        std::chrono::steady_clock::time_point m_insert_time;
+        /// The point in time the element was last inserted, updated or found.
+        std::chrono::steady_clock::time_point m_access_time;
+        /// The number of find hits since the element was inserted.
+        uint64_t m_hits;
+    };
+
     struct element
     {
         /// The iterator into the keyed data structure.
         keyed_iterator m_keyed_position;
-        /// The iterator into the lru data structure.
-        lru_iterator m_lru_position;
         /// The element's value.
         value_type m_value;
     };
@@ -248,47 +548,75 @@ private:
     {
         if (m_used_size >= m_elements.size())
         {
-            do_prune();
+            do_prune_to(m_low_watermark);
         }
 
-        auto element_idx = *m_lru_end;
+        CAPPUCCINO_PROBE3(insert, "lru_cache", this, &key);
+
+        auto element_idx = m_open_list[m_used_size];
+        do_track_insert(element_idx);
 
         auto keyed_position = m_keyed_elements.emplace(key, element_idx).first;
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
 
         element& e         = m_elements[element_idx];
         e.m_value          = std::move(value);
-        e.m_lru_position   = m_lru_end;
         e.m_keyed_position = keyed_position;
 
-        ++m_lru_end;
-
         ++m_used_size;
 
         // This is the most recently used item, put it in the appropriate place.
-        do_access(e);
+        m_lru_list.push_front(element_idx);
+
+        if (m_mutation_sink != nullptr)
+        {
+            m_mutation_sink->append_insert(key, e.m_value, std::chrono::steady_clock::time_point::max());
+        }
     }
 
     auto do_update(keyed_iterator keyed_position, value_type&& value) -> void
     {
+        CAPPUCCINO_PROBE3(update, "lru_cache", this, &keyed_position->first);
+
         element& e = m_elements[keyed_position->second];
         e.m_value  = std::move(value);
+        do_track_access(keyed_position->second, false);
+
+        do_access(keyed_position->second);
 
-        do_access(e);
+        if (m_mutation_sink != nullptr)
+        {
+            m_mutation_sink->append_insert(
+                keyed_position->first, e.m_value, std::chrono::steady_clock::time_point::max());
+        }
     }
 
-    auto do_erase(size_t element_idx) -> void
+    auto do_erase(index_type element_idx) -> void
     {
         element& e = m_elements[element_idx];
 
-        if (e.m_lru_position != std::prev(m_lru_end))
-        {
-            m_lru_list.splice(m_lru_end, m_lru_list, e.m_lru_position);
-        }
-        --m_lru_end;
+        m_lru_list.erase(element_idx);
 
         m_keyed_elements.erase(e.m_keyed_position);
 
+        // Return the slot to the open list.
         --m_used_size;
+        m_open_list[m_used_size] = element_idx;
+    }
+
+    auto do_erase_key(const key_type& key) -> bool
+    {
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            if (m_mutation_sink != nullptr)
+            {
+                m_mutation_sink->append_erase(key);
+            }
+            do_erase(keyed_position->second);
+            return true;
+        }
+        return false;
     }
 
     auto do_find(const key_type& key, peek peek) -> std::optional<value_type>
@@ -296,30 +624,97 @@ private:
         auto keyed_position = m_keyed_elements.find(key);
         if (keyed_position != m_keyed_elements.end())
         {
-            size_t   element_idx = keyed_position->second;
-            element& e           = m_elements[element_idx];
+            index_type element_idx = keyed_position->second;
+            element&   e           = m_elements[element_idx];
             // Don't update the elements access in the LRU if peeking.
             if (peek == peek::no)
             {
-                do_access(e);
+                do_access(element_idx);
+                do_track_access(element_idx, true);
             }
+            CAPPUCCINO_PROBE3(find_hit, "lru_cache", this, &key);
             return {e.m_value};
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "lru_cache", this, &key);
         return {};
     }
 
-    auto do_access(element& e) -> void
+    auto do_access(index_type element_idx) -> void
     {
         // Put the accessed item at the front of the LRU list.
-        m_lru_list.splice(m_lru_list.begin(), m_lru_list, e.m_lru_position);
+        m_lru_list.move_to_front(element_idx);
     }
 
+    /**
+     * Evicts elements one by one in policy order until the cache holds at most target elements.
+     * @return The number of elements evicted.
+     */
+    auto do_prune_to(size_t target) -> size_t
+    {
+        size_t pruned{0};
+        while (m_used_size > target)
+        {
+            do_prune();
+            ++pruned;
+        }
+        return pruned;
+    }
+
+    /**
+     * @return The largest low watermark that still frees a slot for an insert into a full cache.
+     */
+    auto do_max_low_watermark() const -> size_t { return m_elements.empty() ? 0 : m_elements.size() - 1; }
+
     auto do_prune() -> void
     {
         if (m_used_size > 0)
         {
-            do_erase(m_lru_list.back());
+            index_type victim_idx = m_lru_list.back();
+            CAPPUCCINO_PROBE4(
+                evict,
+                "lru_cache",
+                this,
+                &m_elements[victim_idx].m_keyed_position->first,
+                static_cast<int>(evict_reason::capacity));
+            do_track_eviction(victim_idx);
+            if (m_mutation_sink != nullptr)
+            {
+                m_mutation_sink->append_evict(m_elements[victim_idx].m_keyed_position->first);
+            }
+            do_erase(victim_idx);
+        }
+    }
+
+    auto do_track_insert(size_t element_idx) -> void
+    {
+        if (!m_eviction_metadata.empty())
+        {
+            auto now                         = std::chrono::steady_clock::now();
+            m_eviction_metadata[element_idx] = eviction_metadata{now, now, 0};
+        }
+    }
+
+    auto do_track_access(size_t element_idx, bool hit) -> void
+    {
+        if (!m_eviction_metadata.empty())
+        {
+            auto& metadata         = m_eviction_metadata[element_idx];
+            metadata.m_access_time = std::chrono::steady_clock::now();
+            if (hit)
+            {
+                ++metadata.m_hits;
+            }
+        }
+    }
+
+    auto do_track_eviction(size_t element_idx) -> void
+    {
+        if (!m_eviction_metadata.empty())
+        {
+            auto  now      = std::chrono::steady_clock::now();
+            auto& metadata = m_eviction_metadata[element_idx];
+            m_eviction_stats.record(now - metadata.m_insert_time, metadata.m_hits, now - metadata.m_access_time);
         }
     }
 
@@ -332,18 +727,29 @@ private:
     /// The main store for the key value pairs and metadata for each e.
     std::vector<element> m_elements;
     /// The keyed lookup data structure, the value is the index into 'm_elements'.
-    std::unordered_map<key_type, size_t> m_keyed_elements;
-    /// The lru sorted list, the value is the index into 'm_elements'.
-    std::list<size_t> m_lru_list;
-
+    std::unordered_map<key_type, index_type> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
+    /// The lru sorted list of the used slots in 'm_elements', most recently used at the front.
+    index_list<index_type> m_lru_list;
     /**
-     * The current end of the lru list.  This list is special in that it is pre-allocated
-     * for the capacity of the entire size of 'm_elements' and this iterator is used
-     * to denote how many items are in use.  Each item in this list is pre-assigned an index
-     * into 'm_elements' and never has that index changed, this is how open slots into
-     * 'm_elements' are determined when inserting a new element.
+     * The open slots into 'm_elements'.  The partition point is 'm_used_size', every index at or
+     * past it is free and the next insert uses the index at the partition point.
      */
-    lru_iterator m_lru_end;
+    std::vector<index_type> m_open_list;
+
+    /// Per element eviction bookkeeping indexed like 'm_elements', empty unless eviction stats are enabled.
+    std::vector<eviction_metadata> m_eviction_metadata;
+    /// The statistics of all evicted elements since eviction stats were enabled.
+    cappuccino::eviction_stats m_eviction_stats;
+
+    /// The size at which prune() evicts, see set_eviction_watermarks().
+    size_t m_high_watermark{0};
+    /// The size batch evictions stop at, see set_eviction_watermarks().
+    size_t m_low_watermark{0};
+
+    /// Receives every insert, update, erase and eviction, null unless set with set_mutation_sink().
+    mutation_sink<key_type, value_type>* m_mutation_sink{nullptr};
 };
 
 } // namespace cappuccino
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "cappuccino/index_stats.hpp"
 #include "cappuccino/lock.hpp"
 #include "cappuccino/peek.hpp"
+#include "cappuccino/trace.hpp"
 
 #include <list>
 #include <mutex>
@@ -191,6 +193,18 @@ public:
         }
     }
 
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
     /**
      * @return If this cache is currenty empty.
      */
@@ -247,9 +261,12 @@ private:
             do_prune();
         }
 
+        CAPPUCCINO_PROBE3(insert, "mru_cache", this, &key);
+
         auto element_idx = *m_mru_end;
 
         auto keyed_position = m_keyed_elements.emplace(key, element_idx).first;
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
 
         element& e         = m_elements[element_idx];
         e.m_value          = std::move(value);
@@ -265,6 +282,8 @@ private:
 
     auto do_update(keyed_iterator keyed_position, value_type&& value) -> void
     {
+        CAPPUCCINO_PROBE3(update, "mru_cache", this, &keyed_position->first);
+
         element& e = m_elements[keyed_position->second];
         e.m_value  = std::move(value);
 
@@ -299,9 +318,11 @@ private:
             {
                 do_access(e);
             }
+            CAPPUCCINO_PROBE3(find_hit, "mru_cache", this, &key);
             return {e.m_value};
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "mru_cache", this, &key);
         return {};
     }
 
@@ -316,7 +337,14 @@ private:
     {
         if (m_used_size > 0)
         {
-            do_erase(m_mru_list.back());
+            size_t victim_idx = m_mru_list.back();
+            CAPPUCCINO_PROBE4(
+                evict,
+                "mru_cache",
+                this,
+                &m_elements[victim_idx].m_keyed_position->first,
+                static_cast<int>(evict_reason::capacity));
+            do_erase(victim_idx);
         }
     }
 
@@ -330,6 +358,8 @@ private:
     std::vector<element> m_elements;
     /// The keyed lookup data structure, the value is the index into 'm_elements'.
     std::unordered_map<key_type, size_t> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
     /// The mru sorted list, the value is the index into 'm_elements'.
     std::list<size_t> m_mru_list;
     /// The current end of the mru list.
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+
+namespace cappuccino
+{
+/**
+ * Receives the mutations of a cache, e.g. a journal, see journal.hpp.  The cache calls it with
+ * its lock held and in the order the mutations happen so an implementation must only record the
+ * mutation and do any slow work, like writing to a file, elsewhere.
+ *
+ * @tparam key_type The cache's key type.
+ * @tparam value_type The cache's value type.
+ */
+template<typename key_type, typename value_type>
+class mutation_sink
+{
+public:
+    virtual ~mutation_sink() = default;
+
+    /**
+     * An insert or update.
+     * @param key The key.
+     * @param value The key's new value.
+     * @param expire_time The point in time the value expires, time_point::max() if it never does.
+     */
+    virtual auto append_insert(
+        const key_type& key, const value_type& value, std::chrono::steady_clock::time_point expire_time) -> void = 0;
+
+    /**
+     * An erase, expirations are not reported.
+     * @param key The erased key.
+     */
+    virtual auto append_erase(const key_type& key) -> void = 0;
+
+    /**
+     * An eviction to make room for an insert, only reported by lru_cache so a replica evicts the
+     * same keys, see replication.hpp.  Ignored by default.
+     * @param key The evicted key.
+     */
+    virtual auto append_evict(const key_type& key) -> void { (void)key; }
+
+    /**
+     * A new expire time for a key, its value did not change.
+     * @param key The key.
+     * @param expire_time The key's new expire time.
+     */
+    virtual auto append_touch(const key_type& key, std::chrono::steady_clock::time_point expire_time) -> void = 0;
+};
+
+} // namespace cappuccino
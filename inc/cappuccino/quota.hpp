@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+namespace cappuccino
+{
+/**
+ * How a tenant's quota is enforced in the tenant partitioned caches.
+ */
+enum class quota
+{
+    /// The tenant may use free capacity beyond its quota, it is evicted from first once the cache is full.
+    soft = 0,
+    /// The tenant can never hold more elements than its quota, it evicts its own elements to make room.
+    hard = 1
+};
+
+auto to_string(quota q) -> const std::string&;
+
+} // namespace cappuccino
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+namespace cappuccino
+{
+/**
+ * Wraps a cache that is periodically rebuilt from its source of truth, e.g. a full refresh of
+ * a ut_map every hour.  Rather than clear() and insert_range() on the live cache, which leaves
+ * a cold or partially filled window and holds the cache's lock for the whole refresh, rebuild()
+ * populates a fresh instance off to the side and then publishes it with a single atomic pointer
+ * swap.  Readers see either the old cache or the new one, never a half built one.
+ *
+ * The instances are reference counted, a reader that grabbed the old instance with current()
+ * keeps it alive until it is done with it, the old instance is destroyed once the last reader
+ * lets go.  Writes made to the current instance while a rebuild is in progress are not carried
+ * over to the new instance.
+ *
+ * @tparam cache_type Any cappuccino cache or associative data structure.
+ */
+template<typename cache_type>
+class rebuildable
+{
+public:
+    /**
+     * @param cache_args The constructor arguments of the cache, every rebuilt instance is
+     *                   constructed with the same arguments.
+     */
+    template<typename... args_type>
+    explicit rebuildable(args_type&&... cache_args)
+        : m_make([args = std::make_tuple(std::forward<args_type>(cache_args)...)]() {
+              return std::apply([](const auto&... a) { return std::make_shared<cache_type>(a...); }, args);
+          }),
+          m_current(m_make())
+    {
+    }
+
+    rebuildable(const rebuildable&) = delete;
+    rebuildable(rebuildable&&)      = delete;
+    auto operator=(const rebuildable&) -> rebuildable& = delete;
+    auto operator=(rebuildable&&) -> rebuildable& = delete;
+
+    ~rebuildable() = default;
+
+    /**
+     * Populates a new instance of the cache and atomically replaces the current instance with it.
+     * Concurrent rebuilds are serialized, the last one to finish is the one that stays current.
+     * @tparam populate_functor A callable taking a cache_type&.
+     * @param populate Fills the new instance, e.g. with insert_range(), nothing else can see the
+     *                 instance while it runs.
+     */
+    template<typename populate_functor>
+    auto rebuild(populate_functor&& populate) -> void
+    {
+        std::lock_guard guard{m_rebuild_lock};
+        auto            fresh = m_make();
+        std::forward<populate_functor>(populate)(*fresh);
+        publish(std::move(fresh));
+    }
+
+    /**
+     * Atomically replaces the current instance with an instance built elsewhere.
+     * @param fresh The new instance, ignored if null.
+     */
+    auto publish(std::shared_ptr<cache_type> fresh) -> void
+    {
+        if (fresh != nullptr)
+        {
+            std::atomic_store_explicit(&m_current, std::move(fresh), std::memory_order_release);
+        }
+    }
+
+    /**
+     * Use this to run several operations against the same instance, the instance stays alive
+     * while the returned pointer is held even if a rebuild replaces it.
+     * @return The current instance of the cache.
+     */
+    auto current() const -> std::shared_ptr<cache_type>
+    {
+        return std::atomic_load_explicit(&m_current, std::memory_order_acquire);
+    }
+
+    /**
+     * Forwards to the current instance's find().
+     */
+    template<typename... args_type>
+    auto find(args_type&&... args) -> decltype(auto)
+    {
+        return current()->find(std::forward<args_type>(args)...);
+    }
+
+    /**
+     * Forwards to the current instance's insert(), the write is lost if a rebuild is in progress.
+     */
+    template<typename... args_type>
+    auto insert(args_type&&... args) -> decltype(auto)
+    {
+        return current()->insert(std::forward<args_type>(args)...);
+    }
+
+    /**
+     * Forwards to the current instance's erase(), the erase is lost if a rebuild is in progress.
+     */
+    template<typename... args_type>
+    auto erase(args_type&&... args) -> decltype(auto)
+    {
+        return current()->erase(std::forward<args_type>(args)...);
+    }
+
+    /**
+     * @return The number of elements inside the current instance.
+     */
+    auto size() const -> size_t { return current()->size(); }
+
+    /**
+     * @return If the current instance is empty.
+     */
+    auto empty() const -> bool { return current()->empty(); }
+
+private:
+    /// Constructs a new empty instance with the original constructor arguments.
+    std::function<std::shared_ptr<cache_type>()> m_make;
+    /// The published instance, only accessed through the std::atomic_* shared_ptr functions.
+    std::shared_ptr<cache_type> m_current;
+    /// Serializes rebuild() calls.
+    std::mutex m_rebuild_lock;
+};
+
+} // namespace cappuccino
@@ -0,0 +1,543 @@
+#pragma once
+
+#include "cappuccino/journal.hpp"
+#include "cappuccino/lru_cache.hpp"
+#include "cappuccino/mutation_sink.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace cappuccino
+{
+/**
+ * The outcome of a replication_follower::poll().
+ */
+enum class replication_status
+{
+    /// A batch or a snapshot from the primary was applied.
+    applied = 0,
+    /// Nothing arrived before the timeout.
+    idle = 1,
+    /// A gap in the stream was found, the follower is waiting for a snapshot from the primary.
+    resyncing = 2,
+    /// The channel to the primary is broken.
+    disconnected = 3
+};
+
+auto to_string(replication_status s) -> const std::string&;
+
+/**
+ * Carries whole frames between a replication_primary and a replication_follower in both
+ * directions, the primary sends batches and snapshots and the follower asks for a snapshot.
+ * Implement it over any transport, fd_channel covers pipes and unix sockets.
+ */
+class replication_channel
+{
+public:
+    virtual ~replication_channel() = default;
+
+    /**
+     * @param frame The frame to send.
+     * @return False if the channel is broken.
+     */
+    virtual auto send(std::string_view frame) -> bool = 0;
+
+    /**
+     * @param frame Set to the received frame.
+     * @param timeout How long to wait for a frame.
+     * @return False if no frame arrived before the timeout or the channel is broken.
+     */
+    virtual auto receive(std::string& frame, std::chrono::milliseconds timeout) -> bool = 0;
+
+    /**
+     * @return False once the channel is broken.
+     */
+    virtual auto is_open() const -> bool = 0;
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+/**
+ * A replication_channel over file descriptors, e.g. one end of a socketpair() or a unix socket
+ * for both directions or the two ends of a pair of pipes.  Frames are length prefixed.
+ */
+class fd_channel final : public replication_channel
+{
+public:
+    /**
+     * @param read_fd The descriptor frames are received from, -1 if this end only sends.
+     * @param write_fd The descriptor frames are sent to, may be the same as read_fd.
+     */
+    fd_channel(int read_fd, int write_fd) : m_read_fd(read_fd), m_write_fd(write_fd) {}
+
+    fd_channel(const fd_channel&) = delete;
+    fd_channel(fd_channel&&)      = delete;
+    auto operator=(const fd_channel&) -> fd_channel& = delete;
+    auto operator=(fd_channel&&) -> fd_channel& = delete;
+
+    /**
+     * Closes the descriptors.
+     */
+    ~fd_channel() override;
+
+    auto send(std::string_view frame) -> bool override;
+    auto receive(std::string& frame, std::chrono::milliseconds timeout) -> bool override;
+    auto is_open() const -> bool override { return m_open; }
+
+private:
+    int  m_read_fd{-1};
+    int  m_write_fd{-1};
+    bool m_open{true};
+};
+#endif
+
+/**
+ * The first byte of every replication frame.
+ */
+namespace replication_frame
+{
+/// Journal records in sequence order, see journal_format.
+constexpr char batch{1};
+/// uint64 sequence the snapshot is as of, starts a snapshot and the follower clears its cache.
+constexpr char snapshot{2};
+/// Sent by a follower that found a gap.
+constexpr char resync{3};
+/// Journal records of a chunk of the snapshot's key value pairs.
+constexpr char snapshot_chunk{4};
+/// Ends a snapshot.
+constexpr char snapshot_end{5};
+} // namespace replication_frame
+
+/**
+ * The primary side of a hot standby, it streams every mutation of an lru_cache to a follower so
+ * the follower's cache mirrors it and a failover finds a warm cache.
+ *
+ * The primary attaches itself to the cache as its mutation_sink, every insert, update, erase and
+ * eviction is numbered and encoded into a pending batch with the cache's lock already held, a
+ * write pays for nothing more than that enqueue.  A background thread sends the pending batch as
+ * one frame every batch interval.  If the channel cannot keep up and the pending batch exceeds
+ * its limit it is dropped, the follower sees the gap in the sequence numbers and resyncs.
+ *
+ * A resync is answered with a snapshot streamed alongside the batches, the cache's slots are
+ * walked a chunk at a time with the cache's lock only held to copy one chunk.  Each chunk is
+ * sent after every mutation made before it was copied and before every mutation made after, so
+ * the follower applying both in order never holds a pair the primary does not.
+ *
+ * @tparam key_type The key type, see journal_codec.
+ * @tparam value_type The value type, see journal_codec.
+ * @tparam cache_type The replicated cache, an lru_cache.
+ */
+template<typename key_type, typename value_type, typename cache_type = lru_cache<key_type, value_type>>
+class replication_primary final : public mutation_sink<key_type, value_type>
+{
+public:
+    /**
+     * @param cache The cache to replicate, it must outlive the primary.
+     * @param channel The channel to the follower, it must outlive the primary.
+     * @param batch_interval How often the pending batch is sent.
+     * @param max_pending_bytes The pending batch is dropped past this size.
+     * @param snapshot_chunk_size The number of slots a snapshot copies per lock of the cache.
+     */
+    replication_primary(
+        cache_type&               cache,
+        replication_channel&      channel,
+        std::chrono::milliseconds batch_interval      = std::chrono::milliseconds{1},
+        size_t                    max_pending_bytes   = 64 * 1024 * 1024,
+        size_t                    snapshot_chunk_size = 256)
+        : m_cache(cache),
+          m_channel(channel),
+          m_batch_interval(batch_interval),
+          m_max_pending_bytes(max_pending_bytes),
+          m_snapshot_chunk_size(std::max(snapshot_chunk_size, size_t{1}))
+    {
+        m_cache.set_mutation_sink(this);
+        m_sender = std::thread{[this]() { do_run_sender(); }};
+    }
+
+    replication_primary(const replication_primary&) = delete;
+    replication_primary(replication_primary&&)      = delete;
+    auto operator=(const replication_primary&) -> replication_primary& = delete;
+    auto operator=(replication_primary&&) -> replication_primary& = delete;
+
+    /**
+     * Detaches from the cache and sends the last pending batch.
+     */
+    ~replication_primary() override
+    {
+        m_cache.set_mutation_sink(nullptr);
+        {
+            std::lock_guard guard{m_wake_lock};
+            m_stop = true;
+        }
+        m_wake.notify_one();
+        m_sender.join();
+    }
+
+    /**
+     * @return The sequence number of the last mutation.
+     */
+    auto sequence() -> uint64_t
+    {
+        std::lock_guard guard{m_pending_lock};
+        return m_sequence;
+    }
+
+    auto append_insert(const key_type& key, const value_type& value, std::chrono::steady_clock::time_point)
+        -> void override
+    {
+        do_append(journal_op::insert, key, &value);
+    }
+
+    auto append_erase(const key_type& key) -> void override { do_append(journal_op::erase, key, nullptr); }
+
+    auto append_evict(const key_type& key) -> void override { do_append(journal_op::erase, key, nullptr); }
+
+    auto append_touch(const key_type&, std::chrono::steady_clock::time_point) -> void override {}
+
+private:
+    /// The sender is not walking the cache for a snapshot.
+    static constexpr size_t no_snapshot = std::numeric_limits<size_t>::max();
+
+    cache_type&               m_cache;
+    replication_channel&      m_channel;
+    std::chrono::milliseconds m_batch_interval;
+    size_t                    m_max_pending_bytes;
+    size_t                    m_snapshot_chunk_size;
+
+    /// Guards the sequence number and the pending batch.
+    std::mutex m_pending_lock{};
+    /// The sequence number of the last mutation.
+    uint64_t m_sequence{0};
+    /// The batch frame of the mutations not yet sent, empty if there are none.
+    std::string m_pending{};
+
+    std::mutex              m_wake_lock{};
+    std::condition_variable m_wake{};
+    bool                    m_stop{false};
+    std::thread             m_sender{};
+
+    auto do_append(journal_op op, const key_type& key, const value_type* value) -> void
+    {
+        std::lock_guard guard{m_pending_lock};
+        if (m_pending.size() >= m_max_pending_bytes)
+        {
+            // The follower finds the gap and resyncs from a snapshot.
+            m_pending.clear();
+        }
+        if (m_pending.empty())
+        {
+            m_pending.push_back(replication_frame::batch);
+        }
+        journal_format::encode(m_pending, ++m_sequence, op, 0, key, value);
+    }
+
+    /**
+     * Swaps the pending batch into 'batch', the caller must hold the cache's lock if the batch has
+     * to be ordered with a snapshot chunk.
+     */
+    auto do_take_pending(std::string& batch) -> uint64_t
+    {
+        batch.clear();
+        std::lock_guard guard{m_pending_lock};
+        batch.swap(m_pending);
+        return m_sequence;
+    }
+
+    auto do_run_sender() -> void
+    {
+        std::string frame{};
+        std::string batch{};
+        std::string chunk{};
+        size_t      snapshot_slot{no_snapshot};
+        while (true)
+        {
+            bool stop{false};
+            {
+                std::unique_lock guard{m_wake_lock};
+                // A snapshot in progress sends its chunks back to back.
+                if (snapshot_slot == no_snapshot)
+                {
+                    m_wake.wait_for(guard, m_batch_interval, [this]() { return m_stop; });
+                }
+                stop = m_stop;
+            }
+
+            if (m_channel.receive(frame, std::chrono::milliseconds{0}) && !frame.empty() &&
+                frame[0] == replication_frame::resync)
+            {
+                // Starts over if a snapshot is already in progress, the follower saw a gap in it.
+                snapshot_slot = do_send_snapshot_begin(batch, chunk);
+            }
+            if (snapshot_slot != no_snapshot)
+            {
+                snapshot_slot = do_send_snapshot_chunk(snapshot_slot, batch, chunk);
+            }
+            else
+            {
+                do_take_pending(batch);
+                do_send(batch);
+            }
+
+            if (stop)
+            {
+                return;
+            }
+        }
+    }
+
+    auto do_send(const std::string& frame) -> void
+    {
+        if (!frame.empty())
+        {
+            m_channel.send(frame);
+        }
+    }
+
+    auto do_send_snapshot_begin(std::string& batch, std::string& header) -> size_t
+    {
+        uint64_t as_of{0};
+        // Every mutation takes the cache's lock to append, so the sequence number is exactly the
+        // one the snapshot is as of and the batch holds everything up to it.
+        m_cache.with_lock([&](auto&) { as_of = do_take_pending(batch); });
+        do_send(batch);
+
+        header.assign(1, replication_frame::snapshot);
+        journal_format::put<uint64_t>(header, as_of);
+        do_send(header);
+        return 0;
+    }
+
+    auto do_send_snapshot_chunk(size_t slot, std::string& batch, std::string& chunk) -> size_t
+    {
+        chunk.assign(1, replication_frame::snapshot_chunk);
+        size_t next{0};
+        bool   done{false};
+        m_cache.with_lock([&](auto& view) {
+            next = view.for_each_slot(slot, m_snapshot_chunk_size, [&](const key_type& key, const value_type& value) {
+                journal_format::encode(chunk, 0, journal_op::insert, 0, key, &value);
+            });
+            done = (next >= view.capacity());
+            do_take_pending(batch);
+        });
+        do_send(batch);
+        if (chunk.size() > 1)
+        {
+            do_send(chunk);
+        }
+
+        if (done)
+        {
+            do_send(std::string(1, replication_frame::snapshot_end));
+            return no_snapshot;
+        }
+        return next;
+    }
+};
+
+/**
+ * The follower side of a hot standby, see replication_primary.  Call poll() in a loop on a
+ * dedicated thread, each batch or snapshot chunk is applied with a single with_lock() on the
+ * cache.  The follower expects consecutive sequence numbers, on a gap it asks the primary for a
+ * snapshot and discards batches until the snapshot starts.  The start of the snapshot clears the
+ * cache and the follower continues from the snapshot's sequence number, applying the snapshot's
+ * chunks in between the batches.  A new follower starts with a resync.
+ *
+ * The follower's cache should have the same capacity as the primary's, evictions are replicated
+ * and the follower does not need to evict on its own.  Finds on the primary are not replicated and
+ * a snapshot is applied in storage order, so the follower's LRU order only approximates the
+ * primary's.
+ *
+ * @tparam key_type The key type, see journal_codec.
+ * @tparam value_type The value type, see journal_codec.
+ * @tparam cache_type The replica, an lru_cache.
+ */
+template<typename key_type, typename value_type, typename cache_type = lru_cache<key_type, value_type>>
+class replication_follower
+{
+public:
+    using record_type = journal_record<key_type, value_type>;
+
+    /**
+     * @param cache The replica, it should only be written by the follower.
+     * @param channel The channel to the primary.
+     */
+    replication_follower(cache_type& cache, replication_channel& channel) : m_cache(cache), m_channel(channel)
+    {
+        // The primary's cache might not have been empty when it started replicating.
+        do_request_resync();
+    }
+
+    /**
+     * Waits for the next frame from the primary and applies it.
+     * @param timeout How long to wait for a frame.
+     * @return What happened.
+     */
+    auto poll(std::chrono::milliseconds timeout) -> replication_status
+    {
+        if (!m_channel.receive(m_frame, timeout))
+        {
+            return m_channel.is_open() ? (m_resyncing ? replication_status::resyncing : replication_status::idle)
+                                       : replication_status::disconnected;
+        }
+        if (m_frame.empty())
+        {
+            return replication_status::idle;
+        }
+
+        std::string_view payload{m_frame};
+        payload.remove_prefix(1);
+        // Until a snapshot starts the batches and the chunks of an abandoned snapshot are stale.
+        bool stale = m_resyncing && !m_snapshotting;
+        switch (m_frame[0])
+        {
+            case replication_frame::batch:
+                return stale ? replication_status::resyncing : do_apply_batch(payload);
+            case replication_frame::snapshot:
+                return m_resyncing ? do_begin_snapshot(payload) : replication_status::idle;
+            case replication_frame::snapshot_chunk:
+                return stale ? replication_status::resyncing : do_apply_snapshot_chunk(payload);
+            case replication_frame::snapshot_end:
+                if (!stale && m_snapshotting)
+                {
+                    m_resyncing    = false;
+                    m_snapshotting = false;
+                    return replication_status::applied;
+                }
+                return m_resyncing ? replication_status::resyncing : replication_status::idle;
+            default:
+                return replication_status::idle;
+        }
+    }
+
+    /**
+     * @return The sequence number of the last mutation applied.
+     */
+    auto sequence() const -> uint64_t { return m_next_sequence - 1; }
+
+    /**
+     * @return True while waiting for or applying a snapshot.
+     */
+    auto resyncing() const -> bool { return m_resyncing; }
+
+private:
+    cache_type&          m_cache;
+    replication_channel& m_channel;
+
+    /// The sequence number of the next mutation to apply.
+    uint64_t m_next_sequence{1};
+    /// Set after a gap until a snapshot has been applied.
+    bool m_resyncing{false};
+    /// Set while the chunks of a snapshot are applied.
+    bool m_snapshotting{false};
+    /// Reused between polls.
+    std::string              m_frame{};
+    std::vector<record_type> m_records{};
+
+    auto do_decode(std::string_view payload) -> bool
+    {
+        m_records.clear();
+        while (auto size = journal_format::record_size(payload))
+        {
+            if (!journal_format::decode(payload.substr(0, size), m_records.emplace_back()))
+            {
+                return false;
+            }
+            payload.remove_prefix(size);
+        }
+        return payload.empty();
+    }
+
+    auto do_apply_batch(std::string_view payload) -> replication_status
+    {
+        if (!do_decode(payload))
+        {
+            return do_request_resync();
+        }
+
+        bool gap{false};
+        m_cache.with_lock([&](auto& view) {
+            for (auto& record : m_records)
+            {
+                if (record.sequence < m_next_sequence)
+                {
+                    // Already part of the snapshot.
+                    continue;
+                }
+                if (record.sequence > m_next_sequence)
+                {
+                    gap = true;
+                    return;
+                }
+
+                if (record.op == journal_op::insert)
+                {
+                    view.insert(record.key, std::move(record.value.value()));
+                }
+                else if (record.op == journal_op::erase)
+                {
+                    view.erase(record.key);
+                }
+                ++m_next_sequence;
+            }
+        });
+
+        return gap ? do_request_resync() : replication_status::applied;
+    }
+
+    auto do_begin_snapshot(std::string_view payload) -> replication_status
+    {
+        if (payload.size() < sizeof(uint64_t))
+        {
+            return do_request_resync();
+        }
+        const char* in = payload.data();
+        auto as_of     = journal_format::get<uint64_t>(in);
+
+        m_cache.with_lock([&](auto& view) {
+            std::vector<key_type> keys{};
+            keys.reserve(view.size());
+            view.for_each([&](const key_type& key, const value_type&) { keys.push_back(key); });
+            for (const auto& key : keys)
+            {
+                view.erase(key);
+            }
+        });
+
+        m_next_sequence = as_of + 1;
+        m_snapshotting  = true;
+        return replication_status::resyncing;
+    }
+
+    auto do_apply_snapshot_chunk(std::string_view payload) -> replication_status
+    {
+        if (!do_decode(payload))
+        {
+            return do_request_resync();
+        }
+
+        m_cache.with_lock([&](auto& view) {
+            for (auto& record : m_records)
+            {
+                view.insert(record.key, std::move(record.value.value()));
+            }
+        });
+        return replication_status::resyncing;
+    }
+
+    auto do_request_resync() -> replication_status
+    {
+        m_resyncing    = true;
+        m_snapshotting = false;
+        return m_channel.send(std::string(1, replication_frame::resync)) ? replication_status::resyncing
+                                                                          : replication_status::disconnected;
+    }
+};
+
+} // namespace cappuccino
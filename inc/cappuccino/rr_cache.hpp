@@ -1,7 +1,9 @@
 #pragma once
 
 #include "cappuccino/allow.hpp"
+#include "cappuccino/index_stats.hpp"
 #include "cappuccino/lock.hpp"
+#include "cappuccino/trace.hpp"
 
 #include <random>
 #include <unordered_map>
@@ -190,6 +192,18 @@ public:
         }
     }
 
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
     /**
      * @return If this cache is currenty empty.
      */
@@ -242,9 +256,12 @@ private:
             do_prune();
         }
 
+        CAPPUCCINO_PROBE3(insert, "rr_cache", this, &key);
+
         auto element_idx = m_open_list[m_open_list_end];
 
         auto keyed_position = m_keyed_elements.emplace(key, element_idx).first;
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
 
         element& e             = m_elements[element_idx];
         e.m_value              = std::move(value);
@@ -256,6 +273,8 @@ private:
 
     auto do_update(keyed_iterator keyed_position, value_type&& value) -> void
     {
+        CAPPUCCINO_PROBE3(update, "rr_cache", this, &keyed_position->first);
+
         element& e = m_elements[keyed_position->second];
         e.m_value  = std::move(value);
     }
@@ -286,9 +305,11 @@ private:
         {
             size_t   element_idx = keyed_position->second;
             element& e           = m_elements[element_idx];
+            CAPPUCCINO_PROBE3(find_hit, "rr_cache", this, &key);
             return {e.m_value};
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "rr_cache", this, &key);
         return {};
     }
 
@@ -298,6 +319,12 @@ private:
         {
             std::uniform_int_distribution<size_t> dist{0, m_open_list_end - 1};
             size_t                                delete_idx = dist(m_mt);
+            CAPPUCCINO_PROBE4(
+                evict,
+                "rr_cache",
+                this,
+                &m_elements[delete_idx].m_keyed_position->first,
+                static_cast<int>(evict_reason::capacity));
             do_erase(delete_idx);
         }
     }
@@ -309,6 +336,8 @@ private:
     std::vector<element> m_elements;
     /// The keyed lookup data structure, this value is the index into 'm_elements'.
     std::unordered_map<key_type, size_t> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
     /// The open list of free elements to use, the value is the index into 'm_elements'.
     std::vector<size_t> m_open_list;
     /// This is the partition point in the m_open_list, it is also the number of items in the cache.
@@ -0,0 +1,555 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define CAPPUCCINO_STATIC_TABLE_MMAP 1
+#endif
+
+namespace cappuccino
+{
+/**
+ * Read only key value table stored in a file built offline with static_table::build() and
+ * memory mapped when opened.  This is meant for large immutable lookup tables that would
+ * otherwise be bulk inserted into a cache on every start up.  Opening the table is constant
+ * time regardless of its size, the pages are loaded on demand and shared between every process
+ * that maps the same file.
+ *
+ * The keys are placed with a minimal perfect hash in the style of PTHash, every key is hashed
+ * into a bucket and each bucket stores a 32 bit pilot that displaces its keys into distinct free
+ * slots of a table with exactly one slot per key.  A find reads the bucket's pilot and then the
+ * slot, each slot holds the key and value next to each other so a lookup is two memory accesses.
+ * The slot's key is compared so keys that were never built into the table are not found.
+ *
+ * The table never changes after it is opened so it has no locks and can be used concurrently
+ * from multiple threads safely.  On platforms without mmap the file is read into memory.
+ *
+ * The file is in the native byte order, a file built on a machine with a different byte order
+ * or with different key or value types fails to open.
+ *
+ * @tparam key_type The key type, must be trivially copyable without padding, e.g. uint32_t or
+ *                  a packed struct.  The key's bytes are hashed so equal keys must have equal bytes.
+ * @tparam value_type The value type, must be trivially copyable.
+ */
+template<typename key_type, typename value_type>
+class static_table
+{
+    static_assert(std::is_trivially_copyable_v<key_type>, "key_type must be trivially copyable");
+    static_assert(
+        std::has_unique_object_representations_v<key_type>, "key_type must not have padding or floating point members");
+    static_assert(std::is_trivially_copyable_v<value_type>, "value_type must be trivially copyable");
+
+public:
+    /**
+     * Writes a static table file containing the given key value pairs.  Building 50 million keys
+     * takes on the order of a minute and memory proportional to the size of the table.
+     * @param path The file to create or overwrite.
+     * @param elements The key value pairs, every key must be unique.
+     * @return True if the file was written, false if there are duplicate keys or the file could
+     *         not be written.
+     */
+    static auto build(const std::string& path, const std::vector<std::pair<key_type, value_type>>& elements) -> bool
+    {
+        const uint64_t n            = elements.size();
+        const uint64_t bucket_count = std::max(n / keys_per_bucket, uint64_t{1});
+
+        std::vector<uint32_t> pilots(bucket_count, 0);
+        std::vector<slot>     slots(n);
+
+        for (uint64_t seed = 0; n > 0; ++seed)
+        {
+            auto result = do_place(elements, seed, bucket_count, pilots, slots);
+            if (result == place_result::placed)
+            {
+                return do_write(path, seed, pilots, slots);
+            }
+            if (result == place_result::duplicate_key)
+            {
+                return false;
+            }
+        }
+
+        return do_write(path, 0, pilots, slots);
+    }
+
+    /**
+     * Opens a static table file, use is_open() to check if the file was a valid table.
+     * @param path The file created by build().
+     */
+    explicit static_table(const std::string& path) { do_open(path); }
+
+    static_table(const static_table&) = delete;
+    static_table(static_table&& other) noexcept { do_move(std::move(other)); }
+    auto operator=(const static_table&) -> static_table& = delete;
+    auto operator=(static_table&& other) noexcept -> static_table&
+    {
+        if (this != &other)
+        {
+            do_close();
+            do_move(std::move(other));
+        }
+        return *this;
+    }
+
+    ~static_table() { do_close(); }
+
+    /**
+     * @return True if the file was opened and is a valid table for this key and value type.
+     */
+    auto is_open() const -> bool { return m_data != nullptr; }
+
+    /**
+     * Attempts to find the given key's value.
+     * @param key The key to lookup its value.
+     * @return An optional with the key's value if it exists, or an empty optional if it does not.
+     */
+    auto find(const key_type& key) const -> std::optional<value_type>
+    {
+        if (m_size == 0)
+        {
+            return std::nullopt;
+        }
+
+        auto        key_hash = hash(key, m_seed);
+        auto        pilot    = m_pilots[bucket(key_hash, m_bucket_count)];
+        const auto& s        = m_slots[position(key_hash, pilot, m_size)];
+        if (std::memcmp(&s.m_key, &key, sizeof(key_type)) == 0)
+        {
+            return {s.m_value};
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * Attempts to find all the given keys values.
+     * @tparam range_type A container with the set of keys to find their values, e.g. vector<key_type>.
+     * @param key_range The keys to lookup their pairs.
+     * @return The full set of keys to std::nullopt if the key wasn't found, or the value if found.
+     */
+    template<typename range_type>
+    auto find_range(const range_type& key_range) const -> std::vector<std::pair<key_type, std::optional<value_type>>>
+    {
+        std::vector<std::pair<key_type, std::optional<value_type>>> output;
+        output.reserve(std::size(key_range));
+
+        for (auto& key : key_range)
+        {
+            output.emplace_back(key, find(key));
+        }
+
+        return output;
+    }
+
+    /**
+     * Attempts to find all the given keys values.
+     *
+     * The user should initialize this container with the keys to lookup with the values as all
+     * empty optionals.  The keys that are found will have the optionals filled in with the
+     * appropriate values from the table.
+     *
+     * @tparam range_type A container with a pair of optional items,
+     *                   e.g. vector<pair<key_type, optional<value_type>>>
+     *                   or map<key_type, optional<value_type>>
+     * @param key_optional_value_range The keys to optional values to fill out.
+     */
+    template<typename range_type>
+    auto find_range_fill(range_type& key_optional_value_range) const -> void
+    {
+        for (auto& [key, optional_value] : key_optional_value_range)
+        {
+            optional_value = find(key);
+        }
+    }
+
+    /**
+     * @return If this table is empty.
+     */
+    auto empty() const -> bool { return (m_size == 0); }
+
+    /**
+     * @return The number of elements inside the table.
+     */
+    auto size() const -> size_t { return static_cast<size_t>(m_size); }
+
+private:
+    /// The average number of keys per bucket, more keys per bucket is a smaller file but a slower build.
+    static constexpr uint64_t keys_per_bucket = 4;
+    /// The file format version, bumped on any layout change.
+    static constexpr uint32_t format_version  = 2;
+    static constexpr char     format_magic[8] = {'C', 'A', 'P', 'S', 'T', 'B', 'L', '\0'};
+
+    struct header
+    {
+        char     m_magic[8];
+        uint32_t m_version;
+        uint32_t m_key_size;
+        uint32_t m_value_size;
+        uint32_t m_slot_size;
+        uint64_t m_size;
+        uint64_t m_bucket_count;
+        uint64_t m_seed;
+        uint64_t m_slots_offset;
+    };
+
+    struct slot
+    {
+        key_type   m_key;
+        value_type m_value;
+    };
+
+    enum class place_result
+    {
+        placed,
+        retry,
+        duplicate_key
+    };
+
+    static auto mix(uint64_t x) -> uint64_t
+    {
+        // The murmur3 64 bit finalizer.
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    static auto hash(const key_type& key, uint64_t seed) -> uint64_t
+    {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(&key);
+        uint64_t    h     = mix(seed ^ 0x9e3779b97f4a7c15ull);
+        size_t      i     = 0;
+        for (; i + sizeof(uint64_t) <= sizeof(key_type); i += sizeof(uint64_t))
+        {
+            uint64_t chunk{0};
+            std::memcpy(&chunk, bytes + i, sizeof(uint64_t));
+            h = mix(h ^ chunk);
+        }
+        if (i < sizeof(key_type))
+        {
+            uint64_t chunk{0};
+            std::memcpy(&chunk, bytes + i, sizeof(key_type) - i);
+            h = mix(h ^ chunk);
+        }
+        return mix(h ^ sizeof(key_type));
+    }
+
+    static auto bucket(uint64_t key_hash, uint64_t bucket_count) -> uint64_t { return (key_hash >> 32) % bucket_count; }
+
+    static auto position(uint64_t key_hash, uint32_t pilot, uint64_t size) -> uint64_t
+    {
+        // Remixed after the xor, otherwise with a power of two size only the low bits of both
+        // sides are kept and two keys with equal low bits collide for every pilot.
+        return mix(key_hash ^ mix(pilot)) % size;
+    }
+
+    /**
+     * The number of pilots tried for a bucket before giving up on the seed.  The last buckets are
+     * placed into a nearly full table so the expected number of tries grows with the table size.
+     */
+    static auto max_pilots(uint64_t size) -> uint64_t
+    {
+        return std::min(std::max(size, uint64_t{1} << 12) * 32, uint64_t{UINT32_MAX} + 1);
+    }
+
+    /**
+     * Places every key into its own slot with the given seed.
+     * @return placed on success, retry if a pilot could not be found for some bucket with this
+     *         seed or duplicate_key if two keys are equal.
+     */
+    static auto do_place(
+        const std::vector<std::pair<key_type, value_type>>& elements,
+        uint64_t                                            seed,
+        uint64_t                                            bucket_count,
+        std::vector<uint32_t>&                              pilots,
+        std::vector<slot>&                                  slots) -> place_result
+    {
+        const uint64_t n = elements.size();
+
+        std::vector<uint64_t> hashes(n);
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            hashes[i] = hash(elements[i].first, seed);
+        }
+
+        // Group the element indexes by bucket with a counting sort.
+        std::vector<uint64_t> bucket_begin(bucket_count + 1, 0);
+        for (auto h : hashes)
+        {
+            ++bucket_begin[bucket(h, bucket_count) + 1];
+        }
+        for (uint64_t b = 0; b < bucket_count; ++b)
+        {
+            bucket_begin[b + 1] += bucket_begin[b];
+        }
+        std::vector<uint64_t> members(n);
+        {
+            auto next = bucket_begin;
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                members[next[bucket(hashes[i], bucket_count)]++] = i;
+            }
+        }
+
+        // Two keys in the same bucket with the same hash can never be separated by a pilot.
+        for (uint64_t b = 0; b < bucket_count; ++b)
+        {
+            for (auto i = bucket_begin[b]; i < bucket_begin[b + 1]; ++i)
+            {
+                for (auto j = i + 1; j < bucket_begin[b + 1]; ++j)
+                {
+                    if (hashes[members[i]] == hashes[members[j]])
+                    {
+                        const auto& a = elements[members[i]].first;
+                        const auto& c = elements[members[j]].first;
+                        return (std::memcmp(&a, &c, sizeof(key_type)) == 0) ? place_result::duplicate_key
+                                                                               : place_result::retry;
+                    }
+                }
+            }
+        }
+
+        // The largest buckets are placed first while the table is still mostly free.
+        std::vector<uint64_t> order(bucket_count);
+        for (uint64_t b = 0; b < bucket_count; ++b)
+        {
+            order[b] = b;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) {
+            return (bucket_begin[a + 1] - bucket_begin[a]) > (bucket_begin[b + 1] - bucket_begin[b]);
+        });
+
+        std::vector<bool>     taken(n, false);
+        std::vector<uint64_t> positions{};
+        for (auto b : order)
+        {
+            auto begin = bucket_begin[b];
+            auto end   = bucket_begin[b + 1];
+            if (begin == end)
+            {
+                pilots[b] = 0;
+                continue;
+            }
+
+            bool       found{false};
+            const auto pilot_limit = max_pilots(n);
+            for (uint64_t pilot = 0; pilot < pilot_limit && !found; ++pilot)
+            {
+                positions.clear();
+                found = true;
+                for (auto i = begin; i < end; ++i)
+                {
+                    auto p = position(hashes[members[i]], static_cast<uint32_t>(pilot), n);
+                    if (taken[p] || std::find(positions.begin(), positions.end(), p) != positions.end())
+                    {
+                        found = false;
+                        break;
+                    }
+                    positions.push_back(p);
+                }
+
+                if (found)
+                {
+                    pilots[b] = static_cast<uint32_t>(pilot);
+                    for (auto i = begin; i < end; ++i)
+                    {
+                        const auto& [key, value]            = elements[members[i]];
+                        taken[positions[i - begin]]         = true;
+                        slots[positions[i - begin]].m_key   = key;
+                        slots[positions[i - begin]].m_value = value;
+                    }
+                }
+            }
+
+            if (!found)
+            {
+                return place_result::retry;
+            }
+        }
+
+        return place_result::placed;
+    }
+
+    static auto do_write(
+        const std::string& path, uint64_t seed, const std::vector<uint32_t>& pilots, const std::vector<slot>& slots)
+        -> bool
+    {
+        header h{};
+        std::memcpy(h.m_magic, format_magic, sizeof(format_magic));
+        h.m_version      = format_version;
+        h.m_key_size     = sizeof(key_type);
+        h.m_value_size   = sizeof(value_type);
+        h.m_slot_size    = sizeof(slot);
+        h.m_size         = slots.size();
+        h.m_bucket_count = pilots.size();
+        h.m_seed         = seed;
+        h.m_slots_offset = slots_offset(pilots.size());
+
+        std::ofstream out{path, std::ios::binary | std::ios::trunc};
+        out.write(reinterpret_cast<const char*>(&h), sizeof(header));
+        out.write(reinterpret_cast<const char*>(pilots.data()), pilots.size() * sizeof(uint32_t));
+
+        const char padding[alignof(slot) + sizeof(uint64_t)] = {};
+        out.write(padding, h.m_slots_offset - sizeof(header) - pilots.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(slot));
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+    /**
+     * The slots follow the pilots, aligned for the slot type.  The file is mapped at a page
+     * boundary so the offset alignment is also the in memory alignment.
+     */
+    static auto slots_offset(uint64_t bucket_count) -> uint64_t
+    {
+        uint64_t offset    = sizeof(header) + bucket_count * sizeof(uint32_t);
+        uint64_t alignment = std::max(alignof(slot), alignof(uint64_t));
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    auto do_open(const std::string& path) -> void
+    {
+#if defined(CAPPUCCINO_STATIC_TABLE_MMAP)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            return;
+        }
+        struct stat st
+        {
+        };
+        if (::fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < sizeof(header))
+        {
+            ::close(fd);
+            return;
+        }
+        auto  length  = static_cast<size_t>(st.st_size);
+        void* address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        // The mapping holds its own reference to the file.
+        ::close(fd);
+        if (address == MAP_FAILED)
+        {
+            return;
+        }
+        m_mapping        = address;
+        m_mapping_length = length;
+        const auto* data = static_cast<const unsigned char*>(address);
+#else
+        std::ifstream in{path, std::ios::binary | std::ios::ate};
+        if (!in)
+        {
+            return;
+        }
+        auto length = static_cast<size_t>(in.tellg());
+        if (length < sizeof(header))
+        {
+            return;
+        }
+        m_buffer.resize((length + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+        in.seekg(0);
+        in.read(reinterpret_cast<char*>(m_buffer.data()), static_cast<std::streamsize>(length));
+        if (!in)
+        {
+            m_buffer.clear();
+            return;
+        }
+        const auto* data = reinterpret_cast<const unsigned char*>(m_buffer.data());
+#endif
+
+        header h{};
+        std::memcpy(&h, data, sizeof(header));
+        bool valid = std::memcmp(h.m_magic, format_magic, sizeof(format_magic)) == 0 &&
+                     h.m_version == format_version && h.m_key_size == sizeof(key_type) &&
+                     h.m_value_size == sizeof(value_type) && h.m_slot_size == sizeof(slot) &&
+                     h.m_bucket_count > 0 &&
+                     // Bounded before slots_offset() so a corrupt count cannot wrap the offset.
+                     h.m_bucket_count <= (length - sizeof(header)) / sizeof(uint32_t) &&
+                     h.m_slots_offset == slots_offset(h.m_bucket_count) &&
+                     h.m_slots_offset <= length && h.m_size <= (length - h.m_slots_offset) / sizeof(slot);
+        if (!valid)
+        {
+            do_close();
+            return;
+        }
+
+        m_data         = data;
+        m_size         = h.m_size;
+        m_bucket_count = h.m_bucket_count;
+        m_seed         = h.m_seed;
+        m_pilots       = reinterpret_cast<const uint32_t*>(data + sizeof(header));
+        m_slots        = reinterpret_cast<const slot*>(data + h.m_slots_offset);
+    }
+
+    auto do_close() -> void
+    {
+#if defined(CAPPUCCINO_STATIC_TABLE_MMAP)
+        if (m_mapping != nullptr)
+        {
+            ::munmap(m_mapping, m_mapping_length);
+        }
+        m_mapping        = nullptr;
+        m_mapping_length = 0;
+#else
+        m_buffer.clear();
+#endif
+        m_data         = nullptr;
+        m_size         = 0;
+        m_bucket_count = 0;
+        m_seed         = 0;
+        m_pilots       = nullptr;
+        m_slots        = nullptr;
+    }
+
+    auto do_move(static_table&& other) -> void
+    {
+#if defined(CAPPUCCINO_STATIC_TABLE_MMAP)
+        m_mapping        = std::exchange(other.m_mapping, nullptr);
+        m_mapping_length = std::exchange(other.m_mapping_length, 0);
+#else
+        m_buffer = std::move(other.m_buffer);
+#endif
+        m_data         = std::exchange(other.m_data, nullptr);
+        m_size         = std::exchange(other.m_size, 0);
+        m_bucket_count = std::exchange(other.m_bucket_count, 0);
+        m_seed         = std::exchange(other.m_seed, 0);
+        m_pilots       = std::exchange(other.m_pilots, nullptr);
+        m_slots        = std::exchange(other.m_slots, nullptr);
+    }
+
+#if defined(CAPPUCCINO_STATIC_TABLE_MMAP)
+    /// The read only mapping of the whole file.
+    void*  m_mapping{nullptr};
+    size_t m_mapping_length{0};
+#else
+    /// The whole file read into memory.
+    std::vector<std::max_align_t> m_buffer{};
+#endif
+    /// The start of the file, nullptr if the table is not open.
+    const unsigned char* m_data{nullptr};
+    /// The number of keys and slots.
+    uint64_t m_size{0};
+    /// The number of buckets and pilots.
+    uint64_t m_bucket_count{0};
+    /// The hash seed the table was built with.
+    uint64_t m_seed{0};
+    /// The displacement pilot per bucket.
+    const uint32_t* m_pilots{nullptr};
+    /// The key value slots, one per key.
+    const slot* m_slots{nullptr};
+};
+
+} // namespace cappuccino
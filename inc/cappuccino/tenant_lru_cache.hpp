@@ -0,0 +1,576 @@
+#pragma once
+
+#include "cappuccino/allow.hpp"
+#include "cappuccino/index_stats.hpp"
+#include "cappuccino/lock.hpp"
+#include "cappuccino/peek.hpp"
+#include "cappuccino/quota.hpp"
+#include "cappuccino/trace.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <numeric>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace cappuccino
+{
+/**
+ * A snapshot of a single tenant's usage of a tenant partitioned cache.
+ */
+struct tenant_stats
+{
+    /// The number of elements the tenant currently holds.
+    size_t m_size{0};
+    /// The tenant's quota in elements.
+    size_t m_limit{0};
+    /// How the tenant's quota is enforced.
+    quota m_mode{quota::soft};
+    /// The number of finds by the tenant that found a value.
+    uint64_t m_hits{0};
+    /// The number of finds by the tenant that did not find a value.
+    uint64_t m_misses{0};
+    /// The number of the tenant's elements evicted to make room.
+    uint64_t m_evictions{0};
+};
+
+/**
+ * Multi-tenant Least Recently Used (LRU) Cache.
+ * Several tenants share a single fixed size cache, every element is owned by the tenant that
+ * inserted it.  Each tenant has a quota which is either:
+ *   soft - the tenant can use free capacity beyond its quota, but when the cache is full the
+ *          tenant that is the furthest over its quota gives up its least recently used element.
+ *   hard - the tenant can never exceed its quota, inserting at the quota evicts the tenant's
+ *          own least recently used element.
+ * When no tenant is over its quota the least recently used element across all tenants is evicted.
+ * By default every tenant has a soft quota of an equal share of the capacity.
+ *
+ * All tenants share one index and one slot array so a lookup is a single hash lookup, the
+ * tenants only each have their own lru ordering.  Keys are unique across the whole cache, a
+ * tenant only finds the keys it owns, include the tenant in the key if tenants can use the same
+ * keys.
+ *
+ * This cache is thread_safe aware and can be used concurrently from multiple threads safely.
+ * To remove locks/synchronization use NO when creating the cache.
+ *
+ * @tparam key_type The key type.  Must support std::hash().
+ * @tparam value_type The value type.  This is returned by copy on a find, so if your data
+ *                   structure value is large it is advisable to store in a shared ptr.
+ * @tparam thread_safe_type By default this cache is thread safe, can be disabled for caches specific
+ *                  to a single thread.
+ */
+template<typename key_type, typename value_type, thread_safe thread_safe_type = thread_safe::yes>
+class tenant_lru_cache
+{
+private:
+    using keyed_iterator = typename std::unordered_map<key_type, size_t>::iterator;
+    using lru_iterator   = std::list<size_t>::iterator;
+
+public:
+    /**
+     * @param capacity The maximum number of key value pairs allowed in the cache across all tenants.
+     * @param tenant_count The number of tenants, tenants are identified by [0, tenant_count).
+     * @param max_load_factor The load factor for the hash map, generally 1 is a good default.
+     */
+    tenant_lru_cache(size_t capacity, size_t tenant_count, float max_load_factor = 1.0f)
+        : m_elements(capacity),
+          m_open_list(capacity),
+          m_tenants(std::max(tenant_count, size_t{1}))
+    {
+        std::iota(m_open_list.begin(), m_open_list.end(), 0);
+
+        auto fair_share = capacity / m_tenants.size();
+        for (auto& t : m_tenants)
+        {
+            t.m_limit = fair_share;
+        }
+
+        m_keyed_elements.max_load_factor(max_load_factor);
+        m_keyed_elements.reserve(capacity);
+    }
+
+    /**
+     * Sets a tenant's quota.  Lowering a hard quota below the tenant's current size immediately
+     * evicts the tenant's least recently used elements.
+     * @param tenant The tenant to set the quota for, must be less than tenant_count().
+     * @param limit The number of elements the tenant is entitled to.
+     * @param mode How the quota is enforced.
+     */
+    auto set_quota(size_t tenant, size_t limit, quota mode = quota::soft) -> void
+    {
+        std::lock_guard guard{m_lock};
+        auto&           t = m_tenants[tenant];
+        t.m_limit         = limit;
+        t.m_mode          = mode;
+
+        if (mode == quota::hard)
+        {
+            while (t.m_used_size > t.m_limit)
+            {
+                do_evict(t.m_lru_list.back());
+            }
+        }
+    }
+
+    /**
+     * Inserts or updates the given key value pair for the tenant.  Updating a key owned by
+     * another tenant transfers it to this tenant.
+     * @param tenant The tenant inserting the element, must be less than tenant_count().
+     * @param key The key to store the value under.
+     * @param value The value of the data to store.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return True if the operation was successful based on `allow`, always false for a
+     *         tenant with a hard quota of zero.
+     */
+    auto insert(size_t tenant, const key_type& key, value_type value, allow a = allow::insert_or_update) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        return do_insert_update(tenant, key, std::move(value), a);
+    }
+
+    /**
+     * Inserts or updates a range of tenant key value tuples.
+     * @tparam range_type A container with three items, size_t tenant, key_type, value_type.
+     * @param tenant_key_value_range The elements to insert or update into the cache.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return The number of elements inserted based on `allow`.
+     */
+    template<typename range_type>
+    auto insert_range(range_type&& tenant_key_value_range, allow a = allow::insert_or_update) -> size_t
+    {
+        size_t inserted{0};
+
+        {
+            std::lock_guard guard{m_lock};
+            for (auto& [tenant, key, value] : tenant_key_value_range)
+            {
+                if (do_insert_update(tenant, key, std::move(value), a))
+                {
+                    ++inserted;
+                }
+            }
+        }
+
+        return inserted;
+    }
+
+    /**
+     * Attempts to delete the given key regardless of which tenant owns it.
+     * @param key The key to delete from the cache.
+     * @return True if the key was deleted, false if the key does not exist.
+     */
+    auto erase(const key_type& key) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        auto            keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            do_erase(keyed_position->second);
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    /**
+     * Attempts to delete all given keys regardless of which tenants own them.
+     * @tparam range_type A container with the set of keys to delete, e.g. vector<key_type>, set<key_type>.
+     * @param key_range The keys to delete from the cache.
+     * @return The number of items deleted from the cache.
+     */
+    template<typename range_type>
+    auto erase_range(const range_type& key_range) -> size_t
+    {
+        size_t deleted_elements{0};
+
+        std::lock_guard guard{m_lock};
+        for (auto& key : key_range)
+        {
+            auto keyed_position = m_keyed_elements.find(key);
+            if (keyed_position != m_keyed_elements.end())
+            {
+                ++deleted_elements;
+                do_erase(keyed_position->second);
+            }
+        }
+
+        return deleted_elements;
+    }
+
+    /**
+     * Attempts to find the given key's value for the tenant.
+     * @param tenant The tenant looking up the key, must be less than tenant_count().
+     * @param key The key to lookup its value.
+     * @param peek Should the find act like the item wasn't used?  Peeks are not counted in the
+     *             tenant's hit and miss stats.
+     * @return An optional with the key's value if it exists and is owned by the tenant, or an
+     *         empty optional if it does not.
+     */
+    auto find(size_t tenant, const key_type& key, peek peek = peek::no) -> std::optional<value_type>
+    {
+        std::lock_guard guard{m_lock};
+        return do_find(tenant, key, peek);
+    }
+
+    /**
+     * Attempts to find all the given keys values for the tenant.
+     * @tparam range_type A container with the set of keys to find their values, e.g. vector<key_type>.
+     * @param tenant The tenant looking up the keys, must be less than tenant_count().
+     * @param key_range The keys to lookup their pairs.
+     * @param peek Should the find act like all the items were not used?
+     * @return The full set of keys to std::nullopt if the key wasn't found, or the value if found.
+     */
+    template<typename range_type>
+    auto find_range(size_t tenant, const range_type& key_range, peek peek = peek::no)
+        -> std::vector<std::pair<key_type, std::optional<value_type>>>
+    {
+        std::vector<std::pair<key_type, std::optional<value_type>>> output;
+        output.reserve(std::size(key_range));
+
+        {
+            std::lock_guard guard{m_lock};
+            for (auto& key : key_range)
+            {
+                output.emplace_back(key, do_find(tenant, key, peek));
+            }
+        }
+
+        return output;
+    }
+
+    /**
+     * Attempts to find all the given keys values for the tenant.
+     *
+     * The user should initialize this container with the keys to lookup with the values as all
+     * empty optionals.  The keys that are found will have the optionals filled in with the
+     * appropriate values from the cache.
+     *
+     * @tparam range_type A container with a pair of optional items,
+     *                   e.g. vector<pair<key_type, optional<value_type>>>
+     *                   or map<key_type, optional<value_type>>
+     * @param tenant The tenant looking up the keys, must be less than tenant_count().
+     * @param key_optional_value_range The keys to optional values to fill out.
+     * @param peek Should the find act like all the items were not used?
+     */
+    template<typename range_type>
+    auto find_range_fill(size_t tenant, range_type& key_optional_value_range, peek peek = peek::no) -> void
+    {
+        std::lock_guard guard{m_lock};
+        for (auto& [key, optional_value] : key_optional_value_range)
+        {
+            optional_value = do_find(tenant, key, peek);
+        }
+    }
+
+    /**
+     * @param tenant The tenant to retrieve the stats for, must be less than tenant_count().
+     * @param reset Should the tenant's hit, miss and eviction counters be cleared after they are retrieved?
+     * @return The tenant's current size, quota and counters.
+     */
+    auto tenant_stats(size_t tenant, bool reset = false) -> cappuccino::tenant_stats
+    {
+        std::lock_guard guard{m_lock};
+        auto&           t = m_tenants[tenant];
+
+        cappuccino::tenant_stats stats{t.m_used_size, t.m_limit, t.m_mode, t.m_hits, t.m_misses, t.m_evictions};
+        if (reset)
+        {
+            t.m_hits      = 0;
+            t.m_misses    = 0;
+            t.m_evictions = 0;
+        }
+        return stats;
+    }
+
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
+    /**
+     * @return If this cache is currenty empty.
+     */
+    auto empty() const -> bool { return (m_used_size == 0); }
+
+    /**
+     * @return The number of elements inside the cache across all tenants.
+     */
+    auto size() const -> size_t { return m_used_size; }
+
+    /**
+     * @return The maximum capacity of this cache.
+     */
+    auto capacity() const -> size_t { return m_elements.size(); }
+
+    /**
+     * @return The number of tenants sharing this cache.
+     */
+    auto tenant_count() const -> size_t { return m_tenants.size(); }
+
+private:
+    struct element
+    {
+        /// The iterator into the keyed data structure.
+        keyed_iterator m_keyed_position;
+        /// The iterator into the owning tenant's lru data structure.
+        lru_iterator m_lru_position;
+        /// The tenant that owns this element.
+        size_t m_tenant;
+        /// The cache wide access tick of the element's last use, used to find the global lru element.
+        uint64_t m_access_tick;
+        /// The element's value.
+        value_type m_value;
+    };
+
+    struct tenant
+    {
+        /// The tenant's lru sorted list, the value is the index into 'm_elements'.
+        std::list<size_t> m_lru_list{};
+        /// The number of elements the tenant owns.
+        size_t m_used_size{0};
+        /// The tenant's quota in elements.
+        size_t m_limit{0};
+        /// How the tenant's quota is enforced.
+        quota m_mode{quota::soft};
+        /// Find hits.
+        uint64_t m_hits{0};
+        /// Find misses.
+        uint64_t m_misses{0};
+        /// Elements evicted to make room.
+        uint64_t m_evictions{0};
+    };
+
+    auto do_insert_update(size_t tenant_idx, const key_type& key, value_type&& value, allow a) -> bool
+    {
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            if (update_allowed(a))
+            {
+                return do_update(tenant_idx, keyed_position, std::move(value));
+            }
+        }
+        else
+        {
+            if (insert_allowed(a))
+            {
+                return do_insert(tenant_idx, key, std::move(value));
+            }
+        }
+
+        return false;
+    }
+
+    auto do_insert(size_t tenant_idx, const key_type& key, value_type&& value) -> bool
+    {
+        if (!do_make_room(tenant_idx))
+        {
+            return false;
+        }
+
+        CAPPUCCINO_PROBE3(insert, "tenant_lru_cache", this, &key);
+
+        auto& t           = m_tenants[tenant_idx];
+        auto  element_idx = m_open_list.front();
+
+        auto keyed_position = m_keyed_elements.emplace(key, element_idx).first;
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
+
+        // Move the open slot to the front of the tenant's lru list, it is the most recently used.
+        t.m_lru_list.splice(t.m_lru_list.begin(), m_open_list, m_open_list.begin());
+
+        element& e         = m_elements[element_idx];
+        e.m_value          = std::move(value);
+        e.m_lru_position   = t.m_lru_list.begin();
+        e.m_keyed_position = keyed_position;
+        e.m_tenant         = tenant_idx;
+        e.m_access_tick    = ++m_access_tick;
+
+        ++t.m_used_size;
+        ++m_used_size;
+
+        return true;
+    }
+
+    auto do_update(size_t tenant_idx, keyed_iterator keyed_position, value_type&& value) -> bool
+    {
+        size_t   element_idx = keyed_position->second;
+        element& e           = m_elements[element_idx];
+
+        if (e.m_tenant != tenant_idx)
+        {
+            // The element changes owner, it must fit within the new owner's hard quota.
+            auto& to = m_tenants[tenant_idx];
+            if (to.m_mode == quota::hard && to.m_used_size >= to.m_limit)
+            {
+                if (to.m_used_size == 0)
+                {
+                    return false;
+                }
+                do_evict(to.m_lru_list.back());
+            }
+
+            auto& from = m_tenants[e.m_tenant];
+            to.m_lru_list.splice(to.m_lru_list.begin(), from.m_lru_list, e.m_lru_position);
+            --from.m_used_size;
+            ++to.m_used_size;
+            e.m_tenant = tenant_idx;
+        }
+
+        CAPPUCCINO_PROBE3(update, "tenant_lru_cache", this, &keyed_position->first);
+
+        e.m_value = std::move(value);
+        do_access(e);
+        return true;
+    }
+
+    auto do_erase(size_t element_idx) -> void
+    {
+        element& e = m_elements[element_idx];
+        auto&    t = m_tenants[e.m_tenant];
+
+        m_open_list.splice(m_open_list.begin(), t.m_lru_list, e.m_lru_position);
+        m_keyed_elements.erase(e.m_keyed_position);
+
+        --t.m_used_size;
+        --m_used_size;
+    }
+
+    auto do_find(size_t tenant_idx, const key_type& key, peek peek) -> std::optional<value_type>
+    {
+        auto& t              = m_tenants[tenant_idx];
+        auto  keyed_position = m_keyed_elements.find(key);
+        if (keyed_position != m_keyed_elements.end())
+        {
+            element& e = m_elements[keyed_position->second];
+            if (e.m_tenant == tenant_idx)
+            {
+                // Don't update the elements access in the LRU if peeking.
+                if (peek == peek::no)
+                {
+                    do_access(e);
+                    ++t.m_hits;
+                }
+                CAPPUCCINO_PROBE3(find_hit, "tenant_lru_cache", this, &key);
+                return {e.m_value};
+            }
+        }
+
+        if (peek == peek::no)
+        {
+            ++t.m_misses;
+        }
+        CAPPUCCINO_PROBE3(find_miss, "tenant_lru_cache", this, &key);
+        return {};
+    }
+
+    auto do_access(element& e) -> void
+    {
+        // Put the accessed item at the front of its tenant's LRU list.
+        auto& t = m_tenants[e.m_tenant];
+        t.m_lru_list.splice(t.m_lru_list.begin(), t.m_lru_list, e.m_lru_position);
+        e.m_access_tick = ++m_access_tick;
+    }
+
+    /**
+     * Evicts an element if the tenant is at its hard quota or the cache is full.
+     * @return False if the tenant cannot hold any elements.
+     */
+    auto do_make_room(size_t tenant_idx) -> bool
+    {
+        auto& t = m_tenants[tenant_idx];
+        if (t.m_mode == quota::hard && t.m_used_size >= t.m_limit)
+        {
+            if (t.m_used_size == 0)
+            {
+                return false;
+            }
+            do_evict(t.m_lru_list.back());
+        }
+        else if (m_used_size >= m_elements.size())
+        {
+            if (m_used_size == 0)
+            {
+                return false;
+            }
+            do_prune(tenant_idx);
+        }
+        return true;
+    }
+
+    auto do_prune(size_t inserting_tenant_idx) -> void
+    {
+        // The tenant furthest over its quota gives up its lru element, if every tenant is within
+        // its quota then the lru element across all tenants is evicted.  The inserting tenant is
+        // counted with the element it is about to insert so a tenant at its quota evicts itself.
+        size_t   over_quota_tenant{m_tenants.size()};
+        size_t   most_over{0};
+        size_t   lru_tenant{m_tenants.size()};
+        uint64_t oldest_tick{std::numeric_limits<uint64_t>::max()};
+
+        for (size_t i = 0; i < m_tenants.size(); ++i)
+        {
+            const auto& t    = m_tenants[i];
+            auto        used = t.m_used_size + ((i == inserting_tenant_idx) ? 1 : 0);
+            if (used > t.m_limit && used - t.m_limit > most_over && !t.m_lru_list.empty())
+            {
+                most_over         = used - t.m_limit;
+                over_quota_tenant = i;
+            }
+            if (!t.m_lru_list.empty() && m_elements[t.m_lru_list.back()].m_access_tick < oldest_tick)
+            {
+                oldest_tick = m_elements[t.m_lru_list.back()].m_access_tick;
+                lru_tenant  = i;
+            }
+        }
+
+        auto victim_tenant = (over_quota_tenant != m_tenants.size()) ? over_quota_tenant : lru_tenant;
+        do_evict(m_tenants[victim_tenant].m_lru_list.back());
+    }
+
+    auto do_evict(size_t element_idx) -> void
+    {
+        element& e = m_elements[element_idx];
+        CAPPUCCINO_PROBE4(
+            evict, "tenant_lru_cache", this, &e.m_keyed_position->first, static_cast<int>(evict_reason::capacity));
+        ++m_tenants[e.m_tenant].m_evictions;
+        do_erase(element_idx);
+    }
+
+    /// Cache lock for all mutations if thread_safe is enabled.
+    mutex<thread_safe_type> m_lock;
+
+    /// The current number of elements in the cache.
+    size_t m_used_size{0};
+    /// Incremented on every access, orders the elements across all tenants.
+    uint64_t m_access_tick{0};
+
+    /// The main store for the key value pairs and metadata for each element.
+    std::vector<element> m_elements;
+    /// The keyed lookup data structure shared by all tenants, the value is the index into 'm_elements'.
+    std::unordered_map<key_type, size_t> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
+    /**
+     * The indexes into 'm_elements' that are not in use.  List nodes are spliced between this
+     * list and the tenants' lru lists so inserting and erasing never allocates.
+     */
+    std::list<size_t> m_open_list;
+    /// The tenants' lru orderings, quotas and counters.
+    std::vector<tenant> m_tenants;
+};
+
+} // namespace cappuccino
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace cappuccino
+{
+/**
+ * The time representation used by the time aware caches for their per element timestamps, the
+ * expire times and the dynamic age times.  A time representation converts between
+ * std::chrono::steady_clock time points and the stored `stamp_type`:
+ *
+ *   stamp(time_point)       Rounds down, used for the current time and access times.
+ *   deadline(time_point)    Rounds up, used for expire times so an element never expires early.
+ *   time_point(stamp_type)  Converts back.
+ *   expired(now, stamp_type) If an expire time has passed at the given point in time.
+ *   rebase(now, latest)     Called by the cache before it computes new timestamps up to latest,
+ *                           a non zero shift means every stored timestamp must be passed through
+ *                           shifted().
+ *
+ * The steady_timestamp stores the full time point and is the default.
+ */
+class steady_timestamp
+{
+public:
+    using stamp_type = std::chrono::steady_clock::time_point;
+
+    auto stamp(std::chrono::steady_clock::time_point t) const -> stamp_type { return t; }
+    auto deadline(std::chrono::steady_clock::time_point t) const -> stamp_type { return t; }
+    auto time_point(stamp_type s) const -> std::chrono::steady_clock::time_point { return s; }
+    auto expired(std::chrono::steady_clock::time_point now, stamp_type s) const -> bool { return now >= s; }
+    auto rebase(std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point = {}) -> uint64_t
+    {
+        return 0;
+    }
+    static auto shifted(stamp_type s, uint64_t) -> stamp_type { return s; }
+};
+
+/**
+ * Stores timestamps as 32 bit (by default) tick offsets from a per cache epoch, at 1ms resolution
+ * this covers ~49 days before the epoch has to move.  The epoch is rebased once the current time
+ * reaches three quarters of the range, which shifts every stored timestamp down so the most recent
+ * quarter of the range keeps its exact values.  Older timestamps are clamped to the epoch, which is
+ * fine for expire times since they have already expired.  Past half of the range a new expire time
+ * that does not fit also rebases early, but only if it fits afterwards, so a rebase, which costs the
+ * cache a pass over its elements, happens at most once per quarter of the range.
+ *
+ * Expire times that do not fit saturate and never expire through the ttl, even once the current
+ * time itself saturates after a full range without a rebase, the element is still evicted by the
+ * cache's other policies.  Anything up to half of the range always fits.  A rebase after such a gap
+ * catches up in one step, every timestamp that is not saturated is clamped to the epoch.
+ *
+ * @tparam resolution_type The duration of one tick, e.g. std::chrono::milliseconds.
+ * @tparam storage_type The unsigned integer type of the stored ticks.
+ */
+template<typename resolution_type = std::chrono::milliseconds, typename storage_type = uint32_t>
+class coarse_timestamp
+{
+    static_assert(std::is_unsigned_v<storage_type>, "storage_type must be an unsigned integer type");
+
+public:
+    using stamp_type = storage_type;
+
+    /// The saturated timestamp, the furthest representable point in time.
+    static constexpr stamp_type max_stamp = std::numeric_limits<stamp_type>::max();
+
+    coarse_timestamp() : m_epoch(std::chrono::steady_clock::now()) {}
+
+    auto stamp(std::chrono::steady_clock::time_point t) const -> stamp_type
+    {
+        if (t <= m_epoch)
+        {
+            return 0;
+        }
+        return clamp(ticks(t));
+    }
+
+    auto deadline(std::chrono::steady_clock::time_point t) const -> stamp_type
+    {
+        if (t <= m_epoch)
+        {
+            return 0;
+        }
+        return clamp(deadline_ticks(t));
+    }
+
+    auto time_point(stamp_type s) const -> std::chrono::steady_clock::time_point
+    {
+        return m_epoch + resolution_type{s};
+    }
+
+    auto expired(std::chrono::steady_clock::time_point now, stamp_type s) const -> bool
+    {
+        return s != max_stamp && stamp(now) >= s;
+    }
+
+    auto rebase(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point latest = {})
+        -> uint64_t
+    {
+        // Unclamped so a rebase after more than a full range moves the epoch all the way to now.
+        uint64_t current = (now <= m_epoch) ? 0 : static_cast<uint64_t>(ticks(now));
+        if (current < max_stamp / 2)
+        {
+            return 0;
+        }
+
+        uint64_t shift = current - max_stamp / 4;
+        if (current < max_stamp / 4 * 3)
+        {
+            // Only rebase early for an expire time that saturates now but fits after the shift.
+            if (latest <= now)
+            {
+                return 0;
+            }
+            uint64_t ticks = static_cast<uint64_t>(deadline_ticks(latest));
+            if (ticks < max_stamp || ticks - shift >= max_stamp)
+            {
+                return 0;
+            }
+        }
+
+        m_epoch += resolution_type{static_cast<typename resolution_type::rep>(shift)};
+        return shift;
+    }
+
+    static auto shifted(stamp_type s, uint64_t shift) -> stamp_type
+    {
+        if (s == max_stamp)
+        {
+            return max_stamp;
+        }
+        return (s > shift) ? static_cast<stamp_type>(s - shift) : 0;
+    }
+
+private:
+    /**
+     * @return The unclamped number of ticks from the epoch to t rounded down, t must be after the epoch.
+     */
+    auto ticks(std::chrono::steady_clock::time_point t) const -> typename resolution_type::rep
+    {
+        return std::chrono::duration_cast<resolution_type>(t - m_epoch).count();
+    }
+
+    /**
+     * @return The unclamped number of ticks from the epoch to t rounded up, t must be after the epoch.
+     */
+    auto deadline_ticks(std::chrono::steady_clock::time_point t) const -> typename resolution_type::rep
+    {
+        auto ticks = std::chrono::duration_cast<resolution_type>(t - m_epoch);
+        if (ticks < t - m_epoch)
+        {
+            ++ticks;
+        }
+        return ticks.count();
+    }
+
+    template<typename rep_type>
+    static auto clamp(rep_type ticks) -> stamp_type
+    {
+        return (ticks >= static_cast<rep_type>(max_stamp)) ? max_stamp : static_cast<stamp_type>(ticks);
+    }
+
+    /// The point in time of stamp 0.
+    std::chrono::steady_clock::time_point m_epoch;
+};
+
+} // namespace cappuccino
@@ -1,15 +1,26 @@
 #pragma once
 
 #include "cappuccino/allow.hpp"
+#include "cappuccino/counting_bloom_filter.hpp"
+#include "cappuccino/eviction_stats.hpp"
+#include "cappuccino/index_list.hpp"
+#include "cappuccino/index_stats.hpp"
 #include "cappuccino/lock.hpp"
+#include "cappuccino/mutation_sink.hpp"
 #include "cappuccino/peek.hpp"
+#include "cappuccino/timestamp.hpp"
+#include "cappuccino/trace.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <list>
+#include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <numeric>
 #include <optional>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
@@ -29,26 +40,42 @@ namespace cappuccino
  *                   structure value is large it is advisable to store in a shared ptr.
  * @tparam thread_safe_type By default this cache is thread safe, can be disabled for caches specific
  *                  to a single thread.
+ * @tparam index_type The slot index type used by the keyed lookup, the lru links and the ttl
+ *                    ordering.  Use uint32_t for a compact cache of up to 4 billion elements, it
+ *                    halves the per element index and link overhead.
+ * @tparam timestamp_type How the expire times are stored, see timestamp.hpp.  Use coarse_timestamp<>
+ *                        to store them as 32 bit millisecond offsets.
  */
-template<typename key_type, typename value_type, thread_safe thread_safe_type = thread_safe::yes>
+template<
+    typename key_type,
+    typename value_type,
+    thread_safe thread_safe_type = thread_safe::yes,
+    typename index_type          = size_t,
+    typename timestamp_type      = steady_timestamp>
 class tlru_cache
 {
-    using keyed_iterator = typename std::unordered_map<key_type, size_t>::iterator;
-    using lru_iterator   = std::list<size_t>::iterator;
-    using ttl_iterator   = std::multimap<std::chrono::steady_clock::time_point, size_t>::iterator;
+    using stamp_type     = typename timestamp_type::stamp_type;
+    using keyed_iterator = typename std::unordered_map<key_type, index_type>::iterator;
+    using ttl_iterator   = typename std::multimap<stamp_type, index_type>::iterator;
 
 public:
     /**
-     * @param capacity The maximum number of key value pairs allowed in the cache.
+     * @param capacity The maximum number of key value pairs allowed in the cache, this is capped
+     *                 to the largest capacity `index_type` can address.
      * @param max_load_factor The load factor for the hash map, generally 1 is a good default.
      */
-    explicit tlru_cache(size_t capacity, float max_load_factor = 1.0f) : m_elements(capacity), m_lru_list(capacity)
+    explicit tlru_cache(size_t capacity, float max_load_factor = 1.0f)
+        : m_elements(std::min(capacity, index_list<index_type>::max_capacity())),
+          m_lru_list(m_elements.size()),
+          m_open_list(m_elements.size()),
+          m_live_slots(m_elements.size(), false)
     {
-        std::iota(m_lru_list.begin(), m_lru_list.end(), 0);
-        m_lru_end = m_lru_list.begin();
+        std::iota(m_open_list.begin(), m_open_list.end(), 0);
+        m_high_watermark = m_elements.size();
+        m_low_watermark  = do_max_low_watermark();
 
         m_keyed_elements.max_load_factor(max_load_factor);
-        m_keyed_elements.reserve(capacity);
+        m_keyed_elements.reserve(m_elements.size());
     }
 
     /**
@@ -70,6 +97,55 @@ public:
         return do_insert_update(key, std::move(value), now, expire_time, a);
     }
 
+    /**
+     * Attempts to insert or update the given key value pair with the new TTL without blocking.
+     * @param ttl The TTL for this key value pair.
+     * @param key The key to store the value under.
+     * @param value The value of data to store.
+     * @param a Allowed methods of insertion | update.
+     * @return lock_status::contended and false if the lock is held by another thread, otherwise
+     *         lock_status::acquired with the result of insert().
+     */
+    auto try_insert(
+        std::chrono::milliseconds ttl, const key_type& key, value_type value, allow a = allow::insert_or_update)
+        -> std::pair<lock_status, bool>
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        std::unique_lock guard{m_lock, std::try_to_lock};
+        if (!guard.owns_lock())
+        {
+            return {lock_status::contended, false};
+        }
+        return {lock_status::acquired, do_insert_update(key, std::move(value), now, now + ttl, a)};
+    }
+
+    /**
+     * Attempts to insert or update the given key value pair with the new TTL, waiting for the lock
+     * until the deadline at most.
+     * @param deadline The point in time to give up waiting for the lock.
+     * @param ttl The TTL for this key value pair, measured from when the lock is acquired.
+     * @param key The key to store the value under.
+     * @param value The value of data to store.
+     * @param a Allowed methods of insertion | update.
+     * @return See try_insert().
+     */
+    auto try_insert_until(
+        std::chrono::steady_clock::time_point deadline,
+        std::chrono::milliseconds             ttl,
+        const key_type&                       key,
+        value_type                            value,
+        allow                                 a = allow::insert_or_update) -> std::pair<lock_status, bool>
+    {
+        std::unique_lock guard{m_lock, deadline};
+        if (!guard.owns_lock())
+        {
+            return {lock_status::contended, false};
+        }
+        auto now = std::chrono::steady_clock::now();
+        return {lock_status::acquired, do_insert_update(key, std::move(value), now, now + ttl, a)};
+    }
+
     /**
      * Inserts or updates a range of key values pairs with their given TTL.  This expects a container
      * that has 3 values in the {std::chrono::milliseconds, key_type, value_type} ordering.
@@ -100,6 +176,47 @@ public:
         return inserted;
     }
 
+    /**
+     * Reschedules the given key's TTL without rewriting its value, the key also becomes the most
+     * recently used.  This is cheaper than an insert for keeping large values alive.
+     * @param key The key to reschedule.
+     * @param ttl The new TTL for the key, measured from now.
+     * @return True if the key was touched, false if it does not exist or has already expired.
+     */
+    auto touch(const key_type& key, std::chrono::milliseconds ttl) -> bool
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard guard{m_lock};
+        return do_touch(key, now, now + ttl);
+    }
+
+    /**
+     * Reschedules the TTL of all the given keys without rewriting their values, see touch().
+     * @tparam range_type A container with the set of keys to touch, e.g. vector<k> or set<k>.
+     * @param key_range The keys to reschedule.
+     * @param ttl The new TTL for every key, measured from now.
+     * @return The number of keys touched.
+     */
+    template<typename range_type>
+    auto touch_range(const range_type& key_range, std::chrono::milliseconds ttl) -> size_t
+    {
+        size_t touched{0};
+        auto   now         = std::chrono::steady_clock::now();
+        auto   expire_time = now + ttl;
+
+        std::lock_guard guard{m_lock};
+        for (auto& key : key_range)
+        {
+            if (do_touch(key, now, expire_time))
+            {
+                ++touched;
+            }
+        }
+
+        return touched;
+    }
+
     /**
      * Attempts to delete the given key.
      * @param key The key to remove from the lru cache.
@@ -111,6 +228,7 @@ public:
         auto            keyed_position = m_keyed_elements.find(key);
         if (keyed_position != m_keyed_elements.end())
         {
+            do_sink_erase(keyed_position->first);
             do_erase(keyed_position->second);
             return true;
         }
@@ -138,6 +256,7 @@ public:
             if (keyed_position != m_keyed_elements.end())
             {
                 ++deleted_elements;
+                do_sink_erase(keyed_position->first);
                 do_erase(keyed_position->second);
             }
         }
@@ -153,12 +272,58 @@ public:
      */
     auto find(const key_type& key, peek peek = peek::no) -> std::optional<value_type>
     {
+        // Definite misses are answered by the negative filter without taking the lock.
+        auto* negative_filter = m_negative_filter.load(std::memory_order_acquire);
+        if (negative_filter != nullptr && !negative_filter->may_contain(std::hash<key_type>{}(key)))
+        {
+            CAPPUCCINO_PROBE3(find_miss, "tlru_cache", this, &key);
+            return {};
+        }
+
         auto now = std::chrono::steady_clock::now();
 
         std::lock_guard guard{m_lock};
         return do_find(key, now, peek);
     }
 
+    /**
+     * Attempts to find the given key's value without blocking, a latency critical caller can treat
+     * a contended cache like a miss rather than wait behind a long operation.
+     * @param key The key to lookup its value.
+     * @param peek Should the find act like the item wasn't used?
+     * @return lock_status::contended with an empty optional if the lock is held by another thread,
+     *         otherwise lock_status::acquired with the result of find().
+     */
+    auto try_find(const key_type& key, peek peek = peek::no) -> std::pair<lock_status, std::optional<value_type>>
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        std::unique_lock guard{m_lock, std::try_to_lock};
+        if (!guard.owns_lock())
+        {
+            return {lock_status::contended, std::nullopt};
+        }
+        return {lock_status::acquired, do_find(key, now, peek)};
+    }
+
+    /**
+     * Attempts to find the given key's value, waiting for the lock until the deadline at most.
+     * @param deadline The point in time to give up waiting for the lock.
+     * @param key The key to lookup its value.
+     * @param peek Should the find act like the item wasn't used?
+     * @return See try_find().
+     */
+    auto try_find_until(std::chrono::steady_clock::time_point deadline, const key_type& key, peek peek = peek::no)
+        -> std::pair<lock_status, std::optional<value_type>>
+    {
+        std::unique_lock guard{m_lock, deadline};
+        if (!guard.owns_lock())
+        {
+            return {lock_status::contended, std::nullopt};
+        }
+        return {lock_status::acquired, do_find(key, std::chrono::steady_clock::now(), peek)};
+    }
+
     /**
      * Attempts to find all the given keys values.
      * @tparam range_type A container with the set of keys to find their values, e.g. vector<key_type>.
@@ -210,6 +375,107 @@ public:
         }
     }
 
+    /**
+     * Emits every live key value pair with its remaining TTL without holding the lock for the
+     * whole cache.  The slots are copied out in chunks of chunk_size, taking the lock once per
+     * chunk, and emitted with the lock released so writers only ever wait for a single chunk.
+     *
+     * Slots modified behind the scan and keys erased behind the scan are tracked while the
+     * snapshot is in progress and re-emitted afterwards, a re-emitted key that no longer exists is
+     * emitted with an empty value.  Applying the records in order, insert() for a value and
+     * erase() for an empty value, reproduces the cache as it was when the last chunk was copied.
+     * The LRU order and the eviction statistics are not part of the snapshot.
+     *
+     * Only one snapshot runs at a time, concurrent calls wait for the one in progress.
+     *
+     * @tparam emit_functor A callable taking (const key_type&, const std::optional<value_type>&,
+     *                      std::chrono::milliseconds ttl), it is called without the lock held.
+     * @param emit Receives each record.
+     * @param chunk_size The number of slots copied per lock acquisition.
+     * @return The number of records emitted.
+     */
+    template<typename emit_functor>
+    auto snapshot(emit_functor&& emit, size_t chunk_size = 256) -> size_t
+    {
+        chunk_size = std::max(chunk_size, size_t{1});
+
+        std::lock_guard snapshot_guard{m_snapshot_lock};
+
+        std::vector<bool> dirty(m_elements.size(), false);
+        {
+            std::lock_guard guard{m_lock};
+            m_snapshot_dirty.swap(dirty);
+            m_snapshot_cursor = 0;
+            m_snapshot_active = true;
+        }
+
+        std::vector<snapshot_record> batch;
+        batch.reserve(chunk_size);
+        size_t emitted{0};
+
+        for (size_t start = 0; start < m_elements.size(); start += chunk_size)
+        {
+            {
+                std::lock_guard guard{m_lock};
+                auto            now = std::chrono::steady_clock::now();
+                auto            end = std::min(start + chunk_size, m_elements.size());
+                for (size_t element_idx = start; element_idx < end; ++element_idx)
+                {
+                    if (m_live_slots[element_idx])
+                    {
+                        do_snapshot_copy_slot(static_cast<index_type>(element_idx), now, batch);
+                    }
+                }
+                m_snapshot_cursor = end;
+            }
+            emitted += do_snapshot_emit(batch, emit);
+        }
+
+        // Catch up on the changes made behind the cursor.  If writers keep up with the catch up
+        // the last pass copies everything left in one go so the snapshot always finishes.
+        size_t catch_up_passes = m_elements.size() / chunk_size + 1;
+        for (bool last = false; !last; --catch_up_passes)
+        {
+            {
+                std::lock_guard guard{m_lock};
+                auto            now     = std::chrono::steady_clock::now();
+                size_t          pending = m_snapshot_dirty_slots.size() + m_snapshot_erased_keys.size();
+                last                    = (pending <= chunk_size || catch_up_passes == 0);
+                size_t budget           = last ? pending : chunk_size;
+
+                while (budget > 0 && !m_snapshot_erased_keys.empty())
+                {
+                    do_snapshot_copy_key(m_snapshot_erased_keys.back(), now, batch);
+                    m_snapshot_erased_keys.pop_back();
+                    --budget;
+                }
+                while (budget > 0 && !m_snapshot_dirty_slots.empty())
+                {
+                    auto element_idx = m_snapshot_dirty_slots.back();
+                    m_snapshot_dirty_slots.pop_back();
+                    m_snapshot_dirty[element_idx] = false;
+                    if (m_live_slots[element_idx])
+                    {
+                        // By key so a slot that expired since it was copied is emitted as erased.
+                        do_snapshot_copy_key(m_elements[element_idx].m_keyed_position->first, now, batch);
+                    }
+                    --budget;
+                }
+
+                if (last)
+                {
+                    m_snapshot_active = false;
+                    m_snapshot_dirty_slots.clear();
+                    m_snapshot_erased_keys.clear();
+                    m_snapshot_dirty.swap(dirty);
+                }
+            }
+            emitted += do_snapshot_emit(batch, emit);
+        }
+
+        return emitted;
+    }
+
     /**
      * Trims the TTL list of items an expunges all expired elements.  This could be useful to use
      * on downtime to make inserts faster if the cache is full by pruning TTL'ed elements.
@@ -222,15 +488,128 @@ public:
 
         std::lock_guard guard{m_lock};
         // Loop through and delete all items that are expired.
-        while (m_used_size > 0 && now >= m_ttl_list.begin()->first)
+        while (m_used_size > 0 && m_timestamp.expired(now, m_ttl_list.begin()->first))
         {
-            do_erase(m_ttl_list.begin()->second);
+            index_type element_idx = m_ttl_list.begin()->second;
+            CAPPUCCINO_PROBE3(expire, "tlru_cache", this, &m_elements[element_idx].m_keyed_position->first);
+            do_track_eviction(element_idx);
+            do_erase(element_idx);
         }
 
         // return the number of items removed.
         return start_size - m_ttl_list.size();
     }
 
+    /**
+     * Starts recording statistics about evicted elements, see eviction_stats.  This adds per
+     * element bookkeeping of the insert time, last access time and hit count.  Peeking at an
+     * element does not count as an access.
+     */
+    auto enable_eviction_stats() -> void
+    {
+        std::lock_guard guard{m_lock};
+        if (m_eviction_metadata.empty())
+        {
+            auto now = std::chrono::steady_clock::now();
+            m_eviction_metadata.assign(m_elements.size(), eviction_metadata{now, now, 0});
+        }
+    }
+
+    /**
+     * Reports every insert, update, erase and touch to the given sink from now on, e.g. a
+     * journal<key_type, value_type>, see journal.hpp.
+     * @param sink The sink, it must outlive the cache or be detached with nullptr first.
+     */
+    auto set_mutation_sink(mutation_sink<key_type, value_type>* sink) -> void
+    {
+        std::lock_guard guard{m_lock};
+        m_mutation_sink = sink;
+    }
+
+    /**
+     * Starts maintaining a counting bloom filter of the keys in the cache.  find() consults it
+     * before taking the lock, so a key that is definitely not in the cache is a miss without any
+     * locking or index probe.  This is worthwhile for caches with a high miss rate, every insert
+     * and erase pays to update the filter.  The filter cannot be disabled once enabled.
+     * @param counters_per_element The filter size per element of capacity, 8 gives roughly a 3%
+     *                             false positive rate on a full cache.
+     */
+    auto enable_negative_filter(size_t counters_per_element = 8) -> void
+    {
+        std::lock_guard guard{m_lock};
+        if (m_negative_filter_storage == nullptr)
+        {
+            m_negative_filter_storage =
+                std::make_unique<counting_bloom_filter>(m_elements.size(), counters_per_element);
+            for (const auto& [key, element_idx] : m_keyed_elements)
+            {
+                m_negative_filter_storage->add(std::hash<key_type>{}(key));
+            }
+            m_negative_filter.store(m_negative_filter_storage.get(), std::memory_order_release);
+        }
+    }
+
+    /**
+     * @param reset Should the statistics be cleared after they are retrieved?
+     * @return The eviction statistics recorded since they were enabled or last reset.
+     */
+    auto eviction_stats(bool reset = false) -> cappuccino::eviction_stats
+    {
+        std::lock_guard            guard{m_lock};
+        cappuccino::eviction_stats stats = m_eviction_stats;
+        if (reset)
+        {
+            m_eviction_stats.clear();
+        }
+        return stats;
+    }
+
+    /**
+     * Sets the occupancy marks for batch eviction.  An insert into a full cache evicts down to the
+     * low watermark at once instead of a single element, and prune() evicts down to the low
+     * watermark once the cache holds at least the high watermark.  Calling prune() from a
+     * maintenance thread with the high watermark below the capacity keeps eviction work off the
+     * insert path.  By default the high watermark is the capacity and the low watermark is one
+     * less, which evicts a single element per insert into a full cache.
+     * @param high_watermark The size at which prune() evicts, capped to the capacity.
+     * @param low_watermark The size evictions stop at, capped below the high watermark and the capacity.
+     */
+    auto set_eviction_watermarks(size_t high_watermark, size_t low_watermark) -> void
+    {
+        std::lock_guard guard{m_lock};
+        m_high_watermark = std::min(high_watermark, m_elements.size());
+        m_low_watermark  = std::min({low_watermark, m_high_watermark, do_max_low_watermark()});
+    }
+
+    /**
+     * Evicts elements down to the low watermark if the cache holds at least the high watermark,
+     * see set_eviction_watermarks(). Expired elements are evicted first.
+     * @return The number of elements evicted.
+     */
+    auto prune() -> size_t
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard guard{m_lock};
+        if (m_used_size < m_high_watermark || m_used_size == 0)
+        {
+            return 0;
+        }
+        return do_prune_to(m_low_watermark, now);
+    }
+
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
     /**
      * @return If this cache is currenty empty.
      */
@@ -247,14 +626,25 @@ public:
     auto capacity() const -> size_t { return m_elements.size(); }
 
 private:
+    struct eviction_metadata
+    {
+        /// The point in time the element was inserted.
+        std::chrono::steady_clock::time_point m_insert_time;
+        /// The point in time the element was last inserted, updated or found.
+        std::chrono::steady_clock::time_point m_access_time;
+        /// The number of find hits since the element was inserted.
+        uint64_t m_hits;
+    };
+
+    /// A key with its value and remaining TTL, or an empty value if the key was erased.
+    using snapshot_record = std::tuple<key_type, std::optional<value_type>, std::chrono::milliseconds>;
+
     struct element
     {
         /// The point in time in which this element's value expires.
-        std::chrono::steady_clock::time_point m_expire_time;
+        stamp_type m_expire_time;
         /// The iterator into the keyed data structure.
         keyed_iterator m_keyed_position;
-        /// The iterator into the lru data structure.
-        lru_iterator m_lru_position;
         /// The iterator into the ttl data structure.
         ttl_iterator m_ttl_position;
         /// The element's value.
@@ -268,6 +658,8 @@ private:
         std::chrono::steady_clock::time_point expire_time,
         allow                                 a) -> bool
     {
+        do_rebase(now, expire_time);
+
         auto keyed_position = m_keyed_elements.find(key);
         if (keyed_position != m_keyed_elements.end())
         {
@@ -282,7 +674,7 @@ private:
                 // insert to proceed, this can just be an update in place.
                 const auto& [k, element_idx] = *keyed_position;
                 element& e                   = m_elements[element_idx];
-                if (now >= e.m_expire_time)
+                if (m_timestamp.expired(now, e.m_expire_time))
                 {
                     do_update(keyed_position, std::move(value), expire_time);
                     return true;
@@ -309,68 +701,129 @@ private:
         // Inserts might require an item to be pruned, check that first before inserting the new key/value.
         if (m_used_size >= m_elements.size())
         {
-            do_prune(now);
+            do_prune_to(m_low_watermark, now);
         }
 
-        auto element_idx = *m_lru_end;
+        CAPPUCCINO_PROBE3(insert, "tlru_cache", this, &key);
+
+        auto element_idx = m_open_list[m_used_size];
+        do_track_insert(element_idx);
 
         auto keyed_position = m_keyed_elements.emplace(key, element_idx).first;
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
+        if (m_negative_filter_storage != nullptr)
+        {
+            m_negative_filter_storage->add(std::hash<key_type>{}(key));
+        }
 
         // Insert the element_idx into the TTL list.
-        auto ttl_position = m_ttl_list.emplace(expire_time, element_idx);
+        auto expire_stamp = m_timestamp.deadline(expire_time);
+        auto ttl_position = m_ttl_list.emplace(expire_stamp, element_idx);
 
         // Update the element's appropriate fields across the datastructures.
         element& e         = m_elements[element_idx];
         e.m_value          = std::move(value);
-        e.m_expire_time    = expire_time;
-        e.m_lru_position   = m_lru_end;
+        e.m_expire_time    = expire_stamp;
         e.m_ttl_position   = ttl_position;
         e.m_keyed_position = keyed_position;
 
-        // Update the LRU position.
-        ++m_lru_end;
-
         ++m_used_size;
+        m_live_slots[element_idx] = true;
+        do_snapshot_modified(element_idx);
+        do_sink_insert(element_idx, expire_time);
 
-        do_access(e);
+        // Update the LRU position.
+        m_lru_list.push_front(element_idx);
     }
 
-    auto do_update(
-        typename std::unordered_map<key_type, size_t>::iterator keyed_position,
-        value_type&&                                            value,
-        std::chrono::steady_clock::time_point                   expire_time) -> void
+    auto do_update(keyed_iterator keyed_position, value_type&& value, std::chrono::steady_clock::time_point expire_time)
+        -> void
     {
-        size_t element_idx = keyed_position->second;
+        CAPPUCCINO_PROBE3(update, "tlru_cache", this, &keyed_position->first);
+
+        index_type element_idx = keyed_position->second;
 
         element& e      = m_elements[element_idx];
-        e.m_expire_time = expire_time;
+        e.m_expire_time = m_timestamp.deadline(expire_time);
         e.m_value       = std::move(value);
+        do_track_access(element_idx, false);
 
         // Reinsert into TTL list with the new TTL.
         m_ttl_list.erase(e.m_ttl_position);
-        e.m_ttl_position = m_ttl_list.emplace(expire_time, element_idx);
+        e.m_ttl_position = m_ttl_list.emplace(e.m_expire_time, element_idx);
 
-        do_access(e);
+        do_snapshot_modified(element_idx);
+        do_sink_insert(element_idx, expire_time);
+        do_access(element_idx);
     }
 
-    auto do_erase(size_t element_idx) -> void
+    auto do_touch(
+        const key_type&                       key,
+        std::chrono::steady_clock::time_point now,
+        std::chrono::steady_clock::time_point expire_time) -> bool
+    {
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position == m_keyed_elements.end())
+        {
+            return false;
+        }
+
+        index_type element_idx = keyed_position->second;
+        element&   e           = m_elements[element_idx];
+        if (m_timestamp.expired(now, e.m_expire_time))
+        {
+            // Its dead anyways, lets delete it now.
+            CAPPUCCINO_PROBE3(expire, "tlru_cache", this, &key);
+            do_track_eviction(element_idx);
+            do_erase(element_idx);
+            return false;
+        }
+
+        CAPPUCCINO_PROBE3(touch, "tlru_cache", this, &key);
+
+        do_rebase(now, expire_time);
+        e.m_expire_time = m_timestamp.deadline(expire_time);
+
+        // Re-key the existing ttl node rather than allocating a new one.
+        auto node        = m_ttl_list.extract(e.m_ttl_position);
+        node.key()       = e.m_expire_time;
+        e.m_ttl_position = m_ttl_list.insert(std::move(node));
+
+        do_snapshot_modified(element_idx);
+        if (m_mutation_sink != nullptr)
+        {
+            m_mutation_sink->append_touch(key, expire_time);
+        }
+        do_track_access(element_idx, false);
+        do_access(element_idx);
+        return true;
+    }
+
+    auto do_erase(index_type element_idx) -> void
     {
         element& e = m_elements[element_idx];
 
-        // splice into the end position of the LRU if it isn't the last item...
-        if (e.m_lru_position != std::prev(m_lru_end))
+        if (m_snapshot_active && element_idx < m_snapshot_cursor)
         {
-            m_lru_list.splice(m_lru_end, m_lru_list, e.m_lru_position);
+            m_snapshot_erased_keys.push_back(e.m_keyed_position->first);
         }
-        --m_lru_end;
+
+        m_lru_list.erase(element_idx);
 
         m_ttl_list.erase(e.m_ttl_position);
 
+        if (m_negative_filter_storage != nullptr)
+        {
+            m_negative_filter_storage->remove(std::hash<key_type>{}(e.m_keyed_position->first));
+        }
         m_keyed_elements.erase(e.m_keyed_position);
 
         // destruct e.m_value when re-assigned on an insert.
 
+        // Return the slot to the open list.
         --m_used_size;
+        m_open_list[m_used_size]  = element_idx;
+        m_live_slots[element_idx] = false;
     }
 
     auto do_find(const key_type& key, std::chrono::steady_clock::time_point now, peek peek) -> std::optional<value_type>
@@ -378,58 +831,237 @@ private:
         auto keyed_position = m_keyed_elements.find(key);
         if (keyed_position != m_keyed_elements.end())
         {
-            size_t   element_idx = keyed_position->second;
-            element& e           = m_elements[element_idx];
+            index_type element_idx = keyed_position->second;
+            element&   e           = m_elements[element_idx];
 
             // Has the element TTL'ed?
-            if (now < e.m_expire_time)
+            if (!m_timestamp.expired(now, e.m_expire_time))
             {
                 // Do not update the items access if peeking.
                 if (peek == peek::no)
                 {
-                    do_access(e);
+                    do_access(element_idx);
+                    do_track_access(element_idx, true);
                 }
+                CAPPUCCINO_PROBE3(find_hit, "tlru_cache", this, &key);
                 return {e.m_value};
             }
             else
             {
                 // Its dead anyways, lets delete it now.
+                CAPPUCCINO_PROBE3(expire, "tlru_cache", this, &key);
+                do_track_eviction(element_idx);
                 do_erase(element_idx);
             }
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "tlru_cache", this, &key);
         return {};
     }
 
-    auto do_access(element& e) -> void
+    auto do_sink_insert(index_type element_idx, std::chrono::steady_clock::time_point expire_time) -> void
+    {
+        if (m_mutation_sink != nullptr)
+        {
+            element& e = m_elements[element_idx];
+            m_mutation_sink->append_insert(e.m_keyed_position->first, e.m_value, expire_time);
+        }
+    }
+
+    auto do_sink_erase(const key_type& key) -> void
+    {
+        if (m_mutation_sink != nullptr)
+        {
+            m_mutation_sink->append_erase(key);
+        }
+    }
+
+    /**
+     * Marks a slot the snapshot in progress has already copied so it is copied again.
+     */
+    auto do_snapshot_modified(index_type element_idx) -> void
+    {
+        if (m_snapshot_active && element_idx < m_snapshot_cursor && !m_snapshot_dirty[element_idx])
+        {
+            m_snapshot_dirty[element_idx] = true;
+            m_snapshot_dirty_slots.push_back(element_idx);
+        }
+    }
+
+    auto do_snapshot_copy_slot(
+        index_type element_idx, std::chrono::steady_clock::time_point now, std::vector<snapshot_record>& batch) -> void
+    {
+        element& e = m_elements[element_idx];
+        if (m_timestamp.expired(now, e.m_expire_time))
+        {
+            return;
+        }
+
+        auto ttl = std::chrono::ceil<std::chrono::milliseconds>(m_timestamp.time_point(e.m_expire_time) - now);
+        if (ttl.count() <= 0)
+        {
+            // A saturated expire time the current time has run past, it still outlives the whole range.
+            ttl = std::chrono::ceil<std::chrono::milliseconds>(
+                m_timestamp.time_point(e.m_expire_time) - m_timestamp.time_point(stamp_type{}));
+        }
+        batch.emplace_back(e.m_keyed_position->first, e.m_value, ttl);
+    }
+
+    auto do_snapshot_copy_key(
+        const key_type& key, std::chrono::steady_clock::time_point now, std::vector<snapshot_record>& batch) -> void
+    {
+        auto keyed_position = m_keyed_elements.find(key);
+        if (keyed_position == m_keyed_elements.end())
+        {
+            batch.emplace_back(key, std::nullopt, std::chrono::milliseconds{0});
+            return;
+        }
+
+        auto before = batch.size();
+        do_snapshot_copy_slot(keyed_position->second, now, batch);
+        if (batch.size() == before)
+        {
+            // Expired, the restored copy must not keep the previously emitted value either.
+            batch.emplace_back(key, std::nullopt, std::chrono::milliseconds{0});
+        }
+    }
+
+    template<typename emit_functor>
+    static auto do_snapshot_emit(std::vector<snapshot_record>& batch, emit_functor& emit) -> size_t
+    {
+        for (const auto& [key, value, ttl] : batch)
+        {
+            emit(key, value, ttl);
+        }
+        auto emitted = batch.size();
+        batch.clear();
+        return emitted;
+    }
+
+    auto do_access(index_type element_idx) -> void
     {
         // This function will put the item at the most recently used side of the LRU list.
-        m_lru_list.splice(m_lru_list.begin(), m_lru_list, e.m_lru_position);
+        m_lru_list.move_to_front(element_idx);
+    }
+
+    /**
+     * Moves the timestamp epoch forward if needed so expire_time fits, this must happen before new
+     * expire times are computed from the given point in time.  The shift keeps the ttl ordering
+     * so the ttl list is re-keyed in order.
+     */
+    auto do_rebase(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point expire_time)
+        -> void
+    {
+        auto shift = m_timestamp.rebase(now, expire_time);
+        if (shift > 0)
+        {
+            for (auto ttl_position = m_ttl_list.begin(); ttl_position != m_ttl_list.end();)
+            {
+                auto next = std::next(ttl_position);
+                auto node = m_ttl_list.extract(ttl_position);
+
+                node.key()       = timestamp_type::shifted(node.key(), shift);
+                element& e       = m_elements[node.mapped()];
+                e.m_expire_time  = node.key();
+                e.m_ttl_position = m_ttl_list.insert(next, std::move(node));
+
+                ttl_position = next;
+            }
+        }
+    }
+
+    /**
+     * Evicts elements one by one in policy order until the cache holds at most target elements.
+     * @return The number of elements evicted.
+     */
+    auto do_prune_to(size_t target, std::chrono::steady_clock::time_point now) -> size_t
+    {
+        size_t pruned{0};
+        while (m_used_size > target)
+        {
+            do_prune(now);
+            ++pruned;
+        }
+        return pruned;
     }
 
+    /**
+     * @return The largest low watermark that still frees a slot for an insert into a full cache.
+     */
+    auto do_max_low_watermark() const -> size_t { return m_elements.empty() ? 0 : m_elements.size() - 1; }
+
     auto do_prune(std::chrono::steady_clock::time_point now) -> void
     {
         if (m_used_size > 0)
         {
             auto& [expire_time, element_idx] = *m_ttl_list.begin();
 
-            if (now >= expire_time)
+            if (m_timestamp.expired(now, expire_time))
             {
                 // If there is an expired item, prefer to remove that.
+                CAPPUCCINO_PROBE4(
+                    evict,
+                    "tlru_cache",
+                    this,
+                    &m_elements[element_idx].m_keyed_position->first,
+                    static_cast<int>(evict_reason::expired));
+                do_track_eviction(element_idx);
                 do_erase(element_idx);
             }
             else
             {
                 // Otherwise pick the least recently used item to prune.
-                size_t lru_idx = m_lru_list.back();
+                index_type lru_idx = m_lru_list.back();
+                CAPPUCCINO_PROBE4(
+                    evict,
+                    "tlru_cache",
+                    this,
+                    &m_elements[lru_idx].m_keyed_position->first,
+                    static_cast<int>(evict_reason::capacity));
+                do_track_eviction(lru_idx);
                 do_erase(lru_idx);
             }
         }
     }
 
+    auto do_track_insert(size_t element_idx) -> void
+    {
+        if (!m_eviction_metadata.empty())
+        {
+            auto now                         = std::chrono::steady_clock::now();
+            m_eviction_metadata[element_idx] = eviction_metadata{now, now, 0};
+        }
+    }
+
+    auto do_track_access(size_t element_idx, bool hit) -> void
+    {
+        if (!m_eviction_metadata.empty())
+        {
+            auto& metadata         = m_eviction_metadata[element_idx];
+            metadata.m_access_time = std::chrono::steady_clock::now();
+            if (hit)
+            {
+                ++metadata.m_hits;
+            }
+        }
+    }
+
+    auto do_track_eviction(size_t element_idx) -> void
+    {
+        if (!m_eviction_metadata.empty())
+        {
+            auto  now      = std::chrono::steady_clock::now();
+            auto& metadata = m_eviction_metadata[element_idx];
+            m_eviction_stats.record(now - metadata.m_insert_time, metadata.m_hits, now - metadata.m_access_time);
+        }
+    }
+
     /// Cache lock for all mutations if thread_safe is enabled.
     mutex<thread_safe_type> m_lock;
 
+    /// The representation of the expire times.
+    timestamp_type m_timestamp;
+
     /// The current number of elements in the cache.
     size_t m_used_size{0};
 
@@ -437,23 +1069,54 @@ private:
     std::vector<element> m_elements;
 
     /// The keyed lookup data structure, the value is the index into 'm_elements'.
-    std::unordered_map<key_type, size_t> m_keyed_elements;
-    /// The lru sorted list, the value is the index into 'm_elements'.
-    std::list<size_t> m_lru_list;
+    std::unordered_map<key_type, index_type> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
+    /// The lru sorted list of the used slots in 'm_elements', most recently used at the front.
+    index_list<index_type> m_lru_list;
     /**
      * The ttl sorted list, the value is the index into 'm_elements'.  Note that it is
      * important to use a multimap as two threads could timestamp the same!
      */
-    std::multimap<std::chrono::steady_clock::time_point, size_t> m_ttl_list;
-
+    std::multimap<stamp_type, index_type> m_ttl_list;
     /**
-     * The current end of the lru list.  This list is special in that it is pre-allocated
-     * for the capacity of the entire size of 'm_elements' and this iterator is used
-     * to denote how many items are in use.  Each item in this list is pre-assigned an index
-     * into 'm_elements' and never has that index changed, this is how open slots into
-     * 'm_elements' are determined when inserting a new element.
+     * The open slots into 'm_elements'.  The partition point is 'm_used_size', every index at or
+     * past it is free and the next insert uses the index at the partition point.
      */
-    lru_iterator m_lru_end;
+    std::vector<index_type> m_open_list;
+
+    /// Per element eviction bookkeeping indexed like 'm_elements', empty unless eviction stats are enabled.
+    std::vector<eviction_metadata> m_eviction_metadata;
+    /// The statistics of all evicted elements since eviction stats were enabled.
+    cappuccino::eviction_stats m_eviction_stats;
+
+    /// The size at which prune() evicts, see set_eviction_watermarks().
+    size_t m_high_watermark{0};
+    /// The size batch evictions stop at, see set_eviction_watermarks().
+    size_t m_low_watermark{0};
+
+    /// One bit per slot in 'm_elements', set while the slot holds an element.
+    std::vector<bool> m_live_slots;
+    /// Serializes snapshot() calls.
+    mutex<thread_safe_type> m_snapshot_lock;
+    /// True while a snapshot is in progress.
+    bool m_snapshot_active{false};
+    /// The slots below the cursor have been copied by the snapshot in progress.
+    size_t m_snapshot_cursor{0};
+    /// One bit per slot, set for a slot in 'm_snapshot_dirty_slots'.
+    std::vector<bool> m_snapshot_dirty;
+    /// The copied slots modified since they were copied.
+    std::vector<index_type> m_snapshot_dirty_slots;
+    /// The keys erased from copied slots since they were copied.
+    std::vector<key_type> m_snapshot_erased_keys;
+
+    /// Receives every insert, update, erase and touch, null unless set with set_mutation_sink().
+    mutation_sink<key_type, value_type>* m_mutation_sink{nullptr};
+
+    /// The negative lookup filter of every key in 'm_keyed_elements', null unless enabled.
+    std::unique_ptr<counting_bloom_filter> m_negative_filter_storage;
+    /// The filter read by find() without the lock, set once when enabled.
+    std::atomic<counting_bloom_filter*> m_negative_filter{nullptr};
 };
 
 } // namespace cappuccino
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Optional USDT (user statically defined tracing) probes on the cache hot paths.
+ *
+ * When the library is configured with -DCAPPUCCINO_USDT=ON and <sys/sdt.h> is available the
+ * probes are compiled into the binary as a single nop instruction plus an ELF note, they only
+ * cost a trap when a tracer like bpftrace or perf attaches to them.  Otherwise every probe
+ * expands to nothing.
+ *
+ * All probes use the 'cappuccino' provider, the cache probes always pass the cache type name,
+ * the cache instance address and the address of the key as their first three arguments:
+ *   find_hit(name, cache, key)
+ *   find_miss(name, cache, key)
+ *   insert(name, cache, key)
+ *   update(name, cache, key)
+ *   touch(name, cache, key)
+ *   evict(name, cache, key, evict_reason)
+ *   expire(name, cache, key)
+ *   expire_generation(name, cache, key_count)
+ *   lock_acquire(lock)
+ *   lock_contended(lock)
+ *
+ * e.g. bpftrace -e 'usdt:./app:cappuccino:evict { @[str(arg0), arg3] = count(); }'
+ *
+ * Every probe has an SDT semaphore which a tracer increments while it is attached, probe sites
+ * that need extra work to compute their arguments check CAPPUCCINO_PROBE_ENABLED(probe) first.
+ */
+#if defined(CAPPUCCINO_USDT_ENABLED) && defined(__has_include)
+    #if __has_include(<sys/sdt.h>)
+        #define _SDT_HAS_SEMAPHORES 1
+        #include <sys/sdt.h>
+        #define CAPPUCCINO_TRACE_ENABLED 1
+    #endif
+#endif
+
+#if defined(CAPPUCCINO_TRACE_ENABLED)
+// The semaphores are defined in src/trace.cpp, the probe notes refer to them by their C names.
+extern "C" {
+extern volatile unsigned short cappuccino_find_hit_semaphore;
+extern volatile unsigned short cappuccino_find_miss_semaphore;
+extern volatile unsigned short cappuccino_insert_semaphore;
+extern volatile unsigned short cappuccino_update_semaphore;
+extern volatile unsigned short cappuccino_touch_semaphore;
+extern volatile unsigned short cappuccino_evict_semaphore;
+extern volatile unsigned short cappuccino_expire_semaphore;
+extern volatile unsigned short cappuccino_expire_generation_semaphore;
+extern volatile unsigned short cappuccino_lock_acquire_semaphore;
+extern volatile unsigned short cappuccino_lock_contended_semaphore;
+}
+
+    #define CAPPUCCINO_PROBE_ENABLED(probe)          __builtin_expect(cappuccino_##probe##_semaphore != 0, 0)
+    #define CAPPUCCINO_PROBE1(probe, a1)             DTRACE_PROBE1(cappuccino, probe, a1)
+    #define CAPPUCCINO_PROBE3(probe, a1, a2, a3)     DTRACE_PROBE3(cappuccino, probe, a1, a2, a3)
+    #define CAPPUCCINO_PROBE4(probe, a1, a2, a3, a4) DTRACE_PROBE4(cappuccino, probe, a1, a2, a3, a4)
+#else
+    #define CAPPUCCINO_PROBE_ENABLED(probe) false
+    #define CAPPUCCINO_PROBE1(probe, a1)
+    #define CAPPUCCINO_PROBE3(probe, a1, a2, a3)
+    #define CAPPUCCINO_PROBE4(probe, a1, a2, a3, a4)
+#endif
+
+namespace cappuccino
+{
+/**
+ * The reason passed to the 'evict' probe for why a cache removed an element to make room.
+ */
+enum class evict_reason
+{
+    /// The element was chosen by the cache's eviction policy because the cache is full.
+    capacity = 0,
+    /// The element was chosen because its TTL had elapsed.
+    expired = 1
+};
+
+auto to_string(evict_reason r) -> const std::string&;
+
+} // namespace cappuccino
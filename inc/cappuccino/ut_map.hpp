@@ -2,6 +2,8 @@
 
 #include "cappuccino/allow.hpp"
 #include "cappuccino/lock.hpp"
+#include "cappuccino/timestamp.hpp"
+#include "cappuccino/trace.hpp"
 
 #include <atomic>
 #include <chrono>
@@ -33,8 +35,14 @@ namespace cappuccino
  * your data structure value is large it is advisable to store in a shared ptr.
  * @tparam thread_safe_type By default this map is thread safe, can be disabled for maps
  * specific to a single thread.
+ * @tparam timestamp_type How the expire times are stored, see timestamp.hpp.  Use
+ * coarse_timestamp<> to store them as 32 bit millisecond offsets.
  */
-template<typename key_type, typename value_type, thread_safe thread_safe_type = thread_safe::yes>
+template<
+    typename key_type,
+    typename value_type,
+    thread_safe thread_safe_type = thread_safe::yes,
+    typename timestamp_type      = steady_timestamp>
 class ut_map
 {
 public:
@@ -272,13 +280,13 @@ private:
 
     struct ttl_element
     {
-        ttl_element(std::chrono::steady_clock::time_point expire_time, keyed_iterator keyed_elements_position)
+        ttl_element(typename timestamp_type::stamp_type expire_time, keyed_iterator keyed_elements_position)
             : m_expire_time(expire_time),
               m_keyed_elements_position(keyed_elements_position)
         {
         }
         /// The point in time in  which this element's value expires.
-        std::chrono::steady_clock::time_point m_expire_time;
+        typename timestamp_type::stamp_type m_expire_time;
         /// The iterator to the Key in the data structure.
         keyed_iterator m_keyed_elements_position;
     };
@@ -311,9 +319,11 @@ private:
         keyed_element element;
         element.m_value = std::move(value);
 
+        CAPPUCCINO_PROBE3(insert, "ut_map", this, &key);
+
         auto keyed_position = m_keyed_elements.emplace(key, std::move(element)).first;
 
-        m_ttl_list.emplace_back(expire_time, keyed_position);
+        m_ttl_list.emplace_back(m_timestamp.deadline(expire_time), keyed_position);
 
         // Update the elements iterator to ttl_element.
         keyed_position->second.m_ttl_position = std::prev(m_ttl_list.end());
@@ -322,11 +332,13 @@ private:
     auto do_update(keyed_iterator keyed_position, value_type&& value, std::chrono::steady_clock::time_point expire_time)
         -> void
     {
+        CAPPUCCINO_PROBE3(update, "ut_map", this, &keyed_position->first);
+
         auto& element   = keyed_position->second;
         element.m_value = std::move(value);
 
         // Update the ttl_element's expire time.
-        element.m_ttl_position->m_expire_time = expire_time;
+        element.m_ttl_position->m_expire_time = m_timestamp.deadline(expire_time);
 
         // Push to the end of the Ttl list.
         m_ttl_list.splice(m_ttl_list.end(), m_ttl_list, element.m_ttl_position);
@@ -347,14 +359,26 @@ private:
         const auto keyed_position = m_keyed_elements.find(key);
         if (keyed_position != m_keyed_elements.end())
         {
+            CAPPUCCINO_PROBE3(find_hit, "ut_map", this, &key);
             return {keyed_position->second.m_value};
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "ut_map", this, &key);
         return {};
     }
 
     auto do_prune(std::chrono::steady_clock::time_point now) -> size_t
     {
+        // Every operation prunes first, so this is also where the timestamp epoch moves forward.
+        auto shift = m_timestamp.rebase(now, now + m_uniform_ttl);
+        if (shift > 0)
+        {
+            for (auto& ttl : m_ttl_list)
+            {
+                ttl.m_expire_time = timestamp_type::shifted(ttl.m_expire_time, shift);
+            }
+        }
+
         const auto   ttl_begin = m_ttl_list.begin();
         const auto   ttl_end   = m_ttl_list.end();
         ttl_iterator ttl_iter;
@@ -362,8 +386,9 @@ private:
 
         // Delete the keyed elements from the map. Not using do_erase to take
         // advantage of iterator range delete for TTLs.
-        for (ttl_iter = ttl_begin; ttl_iter != ttl_end && now >= ttl_iter->m_expire_time; ++ttl_iter)
+        for (ttl_iter = ttl_begin; ttl_iter != ttl_end && m_timestamp.expired(now, ttl_iter->m_expire_time); ++ttl_iter)
         {
+            CAPPUCCINO_PROBE3(expire, "ut_map", this, &ttl_iter->m_keyed_elements_position->first);
             m_keyed_elements.erase(ttl_iter->m_keyed_elements_position);
             ++deleted;
         }
@@ -390,6 +415,8 @@ private:
 
     /// The uniform TTL for every key value pair inserted into the map.
     std::chrono::milliseconds m_uniform_ttl;
+    /// The representation of the expire times.
+    timestamp_type m_timestamp;
 };
 
 } // namespace cappuccino
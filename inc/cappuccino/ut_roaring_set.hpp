@@ -0,0 +1,789 @@
+#pragma once
+
+#include "cappuccino/allow.hpp"
+#include "cappuccino/lock.hpp"
+#include "cappuccino/trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cappuccino
+{
+/**
+ * Uniform time aware set for unsigned integer keys backed by compressed roaring style bitmaps.
+ * This set offers the same interface as the ut_set but is designed for tracking very large
+ * amounts of "recently seen" integer identifiers.  Rather than a tree node and a list node
+ * per key the keys are stored in a series of time generations, each generation is a roaring
+ * bitmap partitioned on the high bits of the key into array, bitmap or run containers on the
+ * low 16 bits of the key.  Dense identifier ranges cost roughly a bit per key.
+ *
+ * Each key lives in exactly one generation.  A new generation is started every
+ * uniform_ttl / generation_count, inserts and updates always go into the newest generation
+ * and expiry drops entire generations at once.  This means a key will live for at least
+ * uniform_ttl and at most uniform_ttl + (uniform_ttl / generation_count).
+ *
+ * This set is thread_safe aware and can be used concurrently from multiple threads
+ * safely. To remove locks/synchronization use thread_safe::no when creating the set.
+ *
+ * @tparam key_type The key type.  Must be an unsigned integral type, e.g. uint32_t or uint64_t.
+ * @tparam thread_safe_type By default this set is thread safe, can be disabled for sets
+ * specific to a single thread.
+ */
+template<typename key_type, thread_safe thread_safe_type = thread_safe::yes>
+class ut_roaring_set
+{
+    static_assert(
+        std::is_integral_v<key_type> && std::is_unsigned_v<key_type>,
+        "ut_roaring_set key_type must be an unsigned integral type.");
+
+public:
+    /**
+     * @param uniform_ttl The uniform TTL of keys inserted into the set. 100ms default.
+     * @param generation_count The number of generations the TTL window is divided into, more
+     *                         generations tighten the expiration accuracy at the cost of more
+     *                         lookups per find.  8 default.
+     */
+    explicit ut_roaring_set(
+        std::chrono::milliseconds uniform_ttl = std::chrono::milliseconds{100}, size_t generation_count = 8)
+        : m_uniform_ttl(uniform_ttl),
+          m_generation_duration(std::max(
+              std::chrono::steady_clock::duration{1},
+              std::chrono::steady_clock::duration{m_uniform_ttl} /
+                  static_cast<std::chrono::steady_clock::rep>(std::max(generation_count, size_t{1}))))
+    {
+    }
+
+    /**
+     * Inserts or updates the given key.  On update will reset the TTL.
+     * @param key The key to store.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return True if the operation was successful based on `allow`.
+     */
+    auto insert(key_type key, allow a = allow::insert_or_update) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        const auto      now = std::chrono::steady_clock::now();
+
+        do_prune(now);
+
+        return do_insert_update(key, now, a);
+    }
+
+    /**
+     * Inserts or updates a range of keys with uniform TTL.
+     * @tparam range_type A container of key_types.
+     * @param key_range The elements to insert or update into the set.
+     * @param a Allowed methods of insertion | update.  Defaults to allowing
+     *              insertions and updates.
+     * @return The number of elements inserted based on `allow`.
+     */
+    template<typename range_type>
+    auto insert_range(range_type&& key_range, allow a = allow::insert_or_update) -> size_t
+    {
+        size_t          inserted{0};
+        std::lock_guard guard{m_lock};
+        const auto      now = std::chrono::steady_clock::now();
+
+        do_prune(now);
+
+        for (const auto& key : key_range)
+        {
+            if (do_insert_update(key, now, a))
+            {
+                ++inserted;
+            }
+        }
+
+        return inserted;
+    }
+
+    /**
+     * Attempts to delete the given key.
+     * @param key The key to remove from the set.
+     * @return True if the key was deleted, false if the key does not exist.
+     */
+    auto erase(key_type key) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        const auto      now = std::chrono::steady_clock::now();
+
+        do_prune(now);
+
+        return do_erase(key);
+    }
+
+    /**
+     * Attempts to delete all given keys.
+     * @tparam range_type A container with the set of keys to delete, e.g.
+     * vector<k> or set<k>.
+     * @param key_range The keys to delete from the set.
+     * @return The number of items deleted from the set.
+     */
+    template<typename range_type>
+    auto erase_range(const range_type& key_range) -> size_t
+    {
+        size_t          deleted{0};
+        std::lock_guard guard{m_lock};
+        const auto      now = std::chrono::steady_clock::now();
+
+        do_prune(now);
+
+        for (const auto& key : key_range)
+        {
+            if (do_erase(key))
+            {
+                ++deleted;
+            }
+        }
+
+        return deleted;
+    }
+
+    /**
+     * Attempts to find the given key.
+     * @param key The key to lookup.
+     * @return True if key exists, or false if it does not.
+     */
+    auto find(key_type key) -> bool
+    {
+        std::lock_guard guard{m_lock};
+        const auto      now = std::chrono::steady_clock::now();
+
+        do_prune(now);
+
+        if (do_find(key) != m_generations.end())
+        {
+            CAPPUCCINO_PROBE3(find_hit, "ut_roaring_set", this, &key);
+            return true;
+        }
+
+        CAPPUCCINO_PROBE3(find_miss, "ut_roaring_set", this, &key);
+        return false;
+    }
+
+    /**
+     * Attempts to find all the given keys presence.  The keys are looked up in key order
+     * so each bitmap container is only located once per batch rather than once per key.
+     * @tparam range_type A container with the set of keys to lookup, e.g.
+     * vector<key_type>.
+     * @param key_range A container with the set of keys to lookup.
+     * @return All input keys with a bool indicating if it exists.
+     */
+    template<typename range_type>
+    auto find_range(const range_type& key_range) -> std::vector<std::pair<key_type, bool>>
+    {
+        std::vector<std::pair<key_type, bool>> output;
+        output.reserve(std::size(key_range));
+        for (const auto& key : key_range)
+        {
+            output.emplace_back(key, false);
+        }
+
+        std::lock_guard guard{m_lock};
+        const auto      now = std::chrono::steady_clock::now();
+
+        do_prune(now);
+
+        do_find_batch(output);
+
+        return output;
+    }
+
+    /**
+     * Attempts to find all given keys presence.
+     *
+     * The user should initialize this container with the keys to lookup with the
+     * values all bools. The keys that are found will have the bools set
+     * indicating presence in the set.
+     *
+     * @tparam range_type A container with a pair of optional items,
+     *                   e.g. vector<pair<k, bool>> or map<k, bool>.
+     * @param key_bool_range The keys to bools to fill out.
+     */
+    template<typename range_type>
+    auto find_range_fill(range_type& key_bool_range) -> void
+    {
+        std::lock_guard guard{m_lock};
+        const auto      now = std::chrono::steady_clock::now();
+
+        do_prune(now);
+
+        for (auto& [key, boolean] : key_bool_range)
+        {
+            boolean = do_find(key) != m_generations.end();
+        }
+    }
+
+    /**
+     * Drops all expired generations.
+     * @return The number of elements pruned.
+     */
+    auto clean_expired_values() -> size_t
+    {
+        std::lock_guard guard{m_lock};
+        const auto      now = std::chrono::steady_clock::now();
+        return do_prune(now);
+    }
+
+    /**
+     * @return If this set is currently empty.
+     */
+    auto empty() const -> bool { return size() == 0ul; }
+
+    /**
+     * @return The number of elements inside the set.
+     */
+    auto size() const -> size_t
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_used_size;
+    }
+
+    /**
+     * @return The approximate number of bytes used by the bitmap containers of all generations.
+     */
+    auto memory_usage() -> size_t
+    {
+        std::lock_guard guard{m_lock};
+        size_t          bytes{0};
+        for (const auto& g : m_generations)
+        {
+            bytes += g.m_bitmap.memory_usage();
+        }
+        return bytes;
+    }
+
+private:
+    /// The low bits of every key are stored in a container, the high bits select the container.
+    using low_type = uint16_t;
+
+    /**
+     * A single 2^16 key range.  Sparse ranges are stored as a sorted array, dense ranges as a
+     * bitmap and ranges of consecutive keys can be compressed into runs.
+     */
+    class container
+    {
+    public:
+        enum class type
+        {
+            array,
+            bitmap,
+            run
+        };
+
+        /// Above this cardinality an array container uses more memory than a bitmap container.
+        static constexpr size_t array_max_cardinality = 4096;
+        /// A bitmap container converts back to an array at or below this cardinality, the gap
+        /// keeps a container hovering around array_max_cardinality from converting on every update.
+        static constexpr size_t array_min_cardinality = array_max_cardinality - 512;
+        /// The number of 64 bit words required to represent all 2^16 low values.
+        static constexpr size_t bitmap_words = 1024;
+
+        auto contains(low_type low) const -> bool
+        {
+            switch (m_type)
+            {
+                case type::array:
+                    return std::binary_search(m_array.begin(), m_array.end(), low);
+                case type::bitmap:
+                    return (m_bitmap[low >> 6] >> (low & 63)) & 1;
+                case type::run:
+                {
+                    auto position = find_run(low);
+                    return position != m_runs.end() && low <= position->m_start + position->m_length;
+                }
+            }
+            return false;
+        }
+
+        auto add(low_type low) -> bool
+        {
+            if (m_type == type::run)
+            {
+                // Runs are only built for sealed generations, expand before mutating.
+                if (contains(low))
+                {
+                    return false;
+                }
+                to_array_or_bitmap(m_cardinality + 1);
+            }
+
+            if (m_type == type::array)
+            {
+                auto position = std::lower_bound(m_array.begin(), m_array.end(), low);
+                if (position != m_array.end() && *position == low)
+                {
+                    return false;
+                }
+
+                if (m_array.size() >= array_max_cardinality)
+                {
+                    to_bitmap();
+                }
+                else
+                {
+                    m_array.insert(position, low);
+                    ++m_cardinality;
+                    return true;
+                }
+            }
+
+            uint64_t& word = m_bitmap[low >> 6];
+            uint64_t  bit  = uint64_t{1} << (low & 63);
+            if (word & bit)
+            {
+                return false;
+            }
+            word |= bit;
+            ++m_cardinality;
+            return true;
+        }
+
+        auto remove(low_type low) -> bool
+        {
+            switch (m_type)
+            {
+                case type::array:
+                {
+                    auto position = std::lower_bound(m_array.begin(), m_array.end(), low);
+                    if (position == m_array.end() || *position != low)
+                    {
+                        return false;
+                    }
+                    m_array.erase(position);
+                    --m_cardinality;
+                    return true;
+                }
+                case type::bitmap:
+                {
+                    uint64_t& word = m_bitmap[low >> 6];
+                    uint64_t  bit  = uint64_t{1} << (low & 63);
+                    if (!(word & bit))
+                    {
+                        return false;
+                    }
+                    word &= ~bit;
+                    --m_cardinality;
+                    if (m_cardinality <= array_min_cardinality)
+                    {
+                        to_array();
+                    }
+                    return true;
+                }
+                case type::run:
+                {
+                    auto position = find_run(low);
+                    if (position == m_runs.end() || low > position->m_start + position->m_length)
+                    {
+                        return false;
+                    }
+
+                    // Split the run around the removed value.
+                    uint32_t last = uint32_t{position->m_start} + position->m_length;
+                    if (position->m_start == low && last == low)
+                    {
+                        m_runs.erase(position);
+                    }
+                    else if (position->m_start == low)
+                    {
+                        ++position->m_start;
+                        --position->m_length;
+                    }
+                    else if (last == low)
+                    {
+                        --position->m_length;
+                    }
+                    else
+                    {
+                        position->m_length = static_cast<low_type>(low - position->m_start - 1);
+                        m_runs.insert(
+                            std::next(position),
+                            {static_cast<low_type>(low + 1), static_cast<low_type>(last - low - 1)});
+                    }
+                    --m_cardinality;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * Converts the container into runs if that is the smallest representation.
+         */
+        auto run_optimize() -> void
+        {
+            if (m_type == type::run)
+            {
+                return;
+            }
+
+            std::vector<run> runs;
+            for_each([&](low_type low) {
+                if (!runs.empty() && uint32_t{runs.back().m_start} + runs.back().m_length + 1 == low)
+                {
+                    ++runs.back().m_length;
+                }
+                else
+                {
+                    runs.push_back({low, 0});
+                }
+            });
+
+            if (runs.size() * sizeof(run) < memory_usage())
+            {
+                m_runs = std::move(runs);
+                m_runs.shrink_to_fit();
+                m_array  = std::vector<low_type>{};
+                m_bitmap = std::vector<uint64_t>{};
+                m_type   = type::run;
+            }
+        }
+
+        auto cardinality() const -> size_t { return m_cardinality; }
+
+        auto memory_usage() const -> size_t
+        {
+            return m_array.capacity() * sizeof(low_type) + m_bitmap.capacity() * sizeof(uint64_t) +
+                   m_runs.capacity() * sizeof(run);
+        }
+
+    private:
+        struct run
+        {
+            /// The first value in the run.
+            low_type m_start;
+            /// The number of values in the run after the first, a full container is a single run.
+            low_type m_length;
+        };
+
+        auto find_run(low_type low) const -> typename std::vector<run>::const_iterator
+        {
+            auto position = std::upper_bound(
+                m_runs.begin(), m_runs.end(), low, [](low_type l, const run& r) { return l < r.m_start; });
+            if (position == m_runs.begin())
+            {
+                return m_runs.end();
+            }
+            return std::prev(position);
+        }
+
+        auto find_run(low_type low) -> typename std::vector<run>::iterator
+        {
+            auto position = std::as_const(*this).find_run(low);
+            return m_runs.begin() + (position - m_runs.cbegin());
+        }
+
+        template<typename functor_type>
+        auto for_each(functor_type&& f) const -> void
+        {
+            switch (m_type)
+            {
+                case type::array:
+                    std::for_each(m_array.begin(), m_array.end(), f);
+                    break;
+                case type::bitmap:
+                    for (size_t i = 0; i < bitmap_words; ++i)
+                    {
+                        for (uint64_t word = m_bitmap[i]; word != 0; word &= (word - 1))
+                        {
+                            f(static_cast<low_type>((i << 6) + count_trailing_zeros(word)));
+                        }
+                    }
+                    break;
+                case type::run:
+                    for (const auto& r : m_runs)
+                    {
+                        for (uint32_t low = r.m_start; low <= uint32_t{r.m_start} + r.m_length; ++low)
+                        {
+                            f(static_cast<low_type>(low));
+                        }
+                    }
+                    break;
+            }
+        }
+
+        auto to_bitmap() -> void
+        {
+            std::vector<uint64_t> bitmap(bitmap_words, 0);
+            for_each([&](low_type low) { bitmap[low >> 6] |= uint64_t{1} << (low & 63); });
+            m_bitmap = std::move(bitmap);
+            m_array  = std::vector<low_type>{};
+            m_runs   = std::vector<run>{};
+            m_type   = type::bitmap;
+        }
+
+        auto to_array() -> void
+        {
+            std::vector<low_type> array;
+            array.reserve(m_cardinality);
+            for_each([&](low_type low) { array.push_back(low); });
+            m_array  = std::move(array);
+            m_bitmap = std::vector<uint64_t>{};
+            m_runs   = std::vector<run>{};
+            m_type   = type::array;
+        }
+
+        auto to_array_or_bitmap(size_t cardinality) -> void
+        {
+            if (cardinality > array_max_cardinality)
+            {
+                to_bitmap();
+            }
+            else
+            {
+                to_array();
+            }
+        }
+
+        static auto count_trailing_zeros(uint64_t word) -> size_t
+        {
+            size_t count{0};
+            while (!(word & 1))
+            {
+                word >>= 1;
+                ++count;
+            }
+            return count;
+        }
+
+        /// The current representation of this container.
+        type m_type{type::array};
+        /// The number of values stored in this container.
+        size_t m_cardinality{0};
+        /// Sorted low values when m_type is type::array.
+        std::vector<low_type> m_array{};
+        /// One bit per low value when m_type is type::bitmap.
+        std::vector<uint64_t> m_bitmap{};
+        /// Sorted non-overlapping runs when m_type is type::run.
+        std::vector<run> m_runs{};
+    };
+
+    /**
+     * A roaring bitmap, the high bits of the key select the container for the low 16 bits.
+     */
+    class bitmap
+    {
+    public:
+        auto contains(key_type key) const -> bool
+        {
+            auto position = m_containers.find(high(key));
+            return position != m_containers.end() && position->second.contains(low(key));
+        }
+
+        auto add(key_type key) -> bool { return m_containers[high(key)].add(low(key)); }
+
+        auto remove(key_type key) -> bool
+        {
+            auto position = m_containers.find(high(key));
+            if (position != m_containers.end() && position->second.remove(low(key)))
+            {
+                if (position->second.cardinality() == 0)
+                {
+                    m_containers.erase(position);
+                }
+                return true;
+            }
+            return false;
+        }
+
+        auto find_container(key_type key) const -> const container*
+        {
+            auto position = m_containers.find(high(key));
+            return (position != m_containers.end()) ? &position->second : nullptr;
+        }
+
+        auto run_optimize() -> void
+        {
+            for (auto& [h, c] : m_containers)
+            {
+                c.run_optimize();
+            }
+        }
+
+        auto memory_usage() const -> size_t
+        {
+            size_t bytes{0};
+            for (const auto& [h, c] : m_containers)
+            {
+                bytes += sizeof(h) + sizeof(c) + c.memory_usage();
+            }
+            return bytes;
+        }
+
+        static auto high(key_type key) -> key_type { return static_cast<key_type>(key >> 16); }
+        static auto low(key_type key) -> low_type { return static_cast<low_type>(key & 0xFFFF); }
+
+    private:
+        /// The high bits of the key to the container holding the low 16 bits.
+        std::map<key_type, container> m_containers{};
+    };
+
+    struct generation
+    {
+        /// The point in time in which this generation started accepting keys.
+        std::chrono::steady_clock::time_point m_start;
+        /// The number of keys currently in this generation.
+        size_t m_size{0};
+        /// The keys inserted or updated during this generation.
+        bitmap m_bitmap{};
+    };
+
+    using generation_iterator = typename std::deque<generation>::iterator;
+
+    auto do_insert_update(key_type key, std::chrono::steady_clock::time_point now, allow a) -> bool
+    {
+        auto position = do_find(key);
+        if (position != m_generations.end())
+        {
+            if (update_allowed(a))
+            {
+                auto& newest = do_current_generation(now);
+                // If the key is already in the newest generation there is nothing to move, the
+                // generation must be re-looked up as starting a new generation can invalidate it.
+                position = do_find(key);
+                if (&(*position) != &newest)
+                {
+                    position->m_bitmap.remove(key);
+                    --position->m_size;
+                    newest.m_bitmap.add(key);
+                    ++newest.m_size;
+                }
+                CAPPUCCINO_PROBE3(update, "ut_roaring_set", this, &key);
+                return true;
+            }
+        }
+        else
+        {
+            if (insert_allowed(a))
+            {
+                auto& newest = do_current_generation(now);
+                newest.m_bitmap.add(key);
+                ++newest.m_size;
+                ++m_used_size;
+                CAPPUCCINO_PROBE3(insert, "ut_roaring_set", this, &key);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    auto do_erase(key_type key) -> bool
+    {
+        auto position = do_find(key);
+        if (position != m_generations.end())
+        {
+            position->m_bitmap.remove(key);
+            --position->m_size;
+            --m_used_size;
+            return true;
+        }
+        return false;
+    }
+
+    auto do_find(key_type key) -> generation_iterator
+    {
+        // Recently touched keys are the most likely to be looked up, start with the newest.
+        for (auto position = m_generations.rbegin(); position != m_generations.rend(); ++position)
+        {
+            if (position->m_bitmap.contains(key))
+            {
+                return std::prev(position.base());
+            }
+        }
+        return m_generations.end();
+    }
+
+    auto do_find_batch(std::vector<std::pair<key_type, bool>>& output) -> void
+    {
+        std::vector<size_t> order(output.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(
+            order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return output[lhs].first < output[rhs].first; });
+
+        for (const auto& g : m_generations)
+        {
+            const container* c = nullptr;
+            key_type         current_high{0};
+            bool             have_high{false};
+
+            for (auto idx : order)
+            {
+                auto& [key, found] = output[idx];
+                if (found)
+                {
+                    continue;
+                }
+
+                auto h = bitmap::high(key);
+                if (!have_high || h != current_high)
+                {
+                    c            = g.m_bitmap.find_container(key);
+                    current_high = h;
+                    have_high    = true;
+                }
+
+                found = (c != nullptr && c->contains(bitmap::low(key)));
+            }
+        }
+    }
+
+    auto do_current_generation(std::chrono::steady_clock::time_point now) -> generation&
+    {
+        if (m_generations.empty() || now >= m_generations.back().m_start + m_generation_duration)
+        {
+            // The previous generation is sealed and will only ever shrink, compress it.
+            if (!m_generations.empty())
+            {
+                m_generations.back().m_bitmap.run_optimize();
+            }
+
+            m_generations.push_back(generation{now, 0, bitmap{}});
+        }
+        return m_generations.back();
+    }
+
+    auto do_prune(std::chrono::steady_clock::time_point now) -> size_t
+    {
+        size_t deleted{0};
+
+        // Every key in a generation was inserted before the generation's end, so the entire
+        // generation can be dropped once its end plus the TTL has passed.
+        while (!m_generations.empty() &&
+               now >= m_generations.front().m_start + m_generation_duration + m_uniform_ttl)
+        {
+            CAPPUCCINO_PROBE3(expire_generation, "ut_roaring_set", this, m_generations.front().m_size);
+            deleted += m_generations.front().m_size;
+            m_generations.pop_front();
+        }
+
+        m_used_size -= deleted;
+        return deleted;
+    }
+
+    /// Thread lock for all mutations.
+    mutex<thread_safe_type> m_lock;
+
+    /// The uniform TTL for every key inserted into the set.
+    std::chrono::milliseconds m_uniform_ttl;
+    /// The amount of time each generation accepts new keys for.
+    std::chrono::steady_clock::duration m_generation_duration;
+
+    /// The generations from oldest (front) to newest (back).
+    std::deque<generation> m_generations{};
+
+    /// The current number of elements in the set across all generations.
+    size_t m_used_size{0};
+};
+
+} // namespace cappuccino
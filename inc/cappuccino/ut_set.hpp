@@ -2,6 +2,7 @@
 
 #include "cappuccino/allow.hpp"
 #include "cappuccino/lock.hpp"
+#include "cappuccino/trace.hpp"
 
 #include <atomic>
 #include <chrono>
@@ -287,6 +288,8 @@ private:
     {
         keyed_element element;
 
+        CAPPUCCINO_PROBE3(insert, "ut_set", this, &key);
+
         auto keyed_position = m_keyed_elements.emplace(key, std::move(element)).first;
 
         m_ttl_list.emplace_back(expire_time, keyed_position);
@@ -297,6 +300,8 @@ private:
 
     auto do_update(keyed_iterator keyed_position, std::chrono::steady_clock::time_point expire_time) -> void
     {
+        CAPPUCCINO_PROBE3(update, "ut_set", this, &keyed_position->first);
+
         auto& element = keyed_position->second;
 
         // Update the ttl_element's expire time.
@@ -321,9 +326,11 @@ private:
         const auto keyed_position = m_keyed_elements.find(key);
         if (keyed_position != m_keyed_elements.end())
         {
+            CAPPUCCINO_PROBE3(find_hit, "ut_set", this, &key);
             return true;
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "ut_set", this, &key);
         return false;
     }
 
@@ -338,6 +345,7 @@ private:
         // advantage of iterator range delete for TTLs.
         for (ttl_iter = ttl_begin; ttl_iter != ttl_end && now >= ttl_iter->m_expire_time; ++ttl_iter)
         {
+            CAPPUCCINO_PROBE3(expire, "ut_set", this, &ttl_iter->m_keyed_elements_position->first);
             m_keyed_elements.erase(ttl_iter->m_keyed_elements_position);
             ++deleted;
         }
@@ -1,11 +1,16 @@
 #pragma once
 
 #include "cappuccino/allow.hpp"
+#include "cappuccino/eviction_stats.hpp"
+#include "cappuccino/index_list.hpp"
+#include "cappuccino/index_stats.hpp"
 #include "cappuccino/lock.hpp"
 #include "cappuccino/peek.hpp"
+#include "cappuccino/timestamp.hpp"
+#include "cappuccino/trace.hpp"
 
+#include <algorithm>
 #include <chrono>
-#include <list>
 #include <numeric>
 #include <optional>
 #include <unordered_map>
@@ -29,28 +34,42 @@ namespace cappuccino
  *                   structure value is large it is advisable to store in a shared ptr.
  * @tparam thread_safe_type By default this cache is thread safe, can be disabled for caches specific
  *                  to a single thread.
+ * @tparam index_type The slot index type used by the keyed lookup and the lru and ttl links.  Use
+ *                    uint32_t for a compact cache of up to 4 billion elements, it halves the per
+ *                    element index and link overhead.
+ * @tparam timestamp_type How the expire times are stored, see timestamp.hpp.  Use coarse_timestamp<>
+ *                        to store them as 32 bit millisecond offsets.
  */
-template<typename key_type, typename value_type, thread_safe thread_safe_type = thread_safe::yes>
+template<
+    typename key_type,
+    typename value_type,
+    thread_safe thread_safe_type = thread_safe::yes,
+    typename index_type          = size_t,
+    typename timestamp_type      = steady_timestamp>
 class utlru_cache
 {
-    using keyed_iterator = typename std::unordered_map<key_type, size_t>::iterator;
+    using keyed_iterator = typename std::unordered_map<key_type, index_type>::iterator;
 
 public:
     /**
      * @param ttl The uniform TTL of every key value inserted into the cache.
-     * @param capacity The maximum number of key value pairs allowed in the cache.
+     * @param capacity The maximum number of key value pairs allowed in the cache, this is capped
+     *                 to the largest capacity `index_type` can address.
      * @param max_load_factor The load factor for the hash map, generally 1 is a good default.
      */
     utlru_cache(std::chrono::milliseconds ttl, size_t capacity, float max_load_factor = 1.0f)
         : m_ttl(ttl),
-          m_elements(capacity),
-          m_lru_list(capacity)
+          m_elements(std::min(capacity, index_list<index_type>::max_capacity())),
+          m_lru_list(m_elements.size()),
+          m_ttl_list(m_elements.size()),
+          m_open_list(m_elements.size())
     {
-        std::iota(m_lru_list.begin(), m_lru_list.end(), 0);
-        m_lru_end = m_lru_list.begin();
+        std::iota(m_open_list.begin(), m_open_list.end(), 0);
+        m_high_watermark = m_elements.size();
+        m_low_watermark  = do_max_low_watermark();
 
         m_keyed_elements.max_load_factor(max_load_factor);
-        m_keyed_elements.reserve(capacity);
+        m_keyed_elements.reserve(m_elements.size());
     }
 
     /**
@@ -158,8 +177,8 @@ public:
             if (m_used_size > 0)
             {
                 const auto capacity = m_elements.capacity();
-                std::iota(m_lru_list.begin(), m_lru_list.end(), 0);
-                m_lru_end = m_lru_list.begin();
+                std::iota(m_open_list.begin(), m_open_list.end(), 0);
+                m_lru_list.clear();
                 m_keyed_elements.clear();
                 m_keyed_elements.reserve(capacity);
                 m_ttl_list.clear();
@@ -257,11 +276,13 @@ public:
 
             while (m_used_size > 0)
             {
-                size_t   ttl_idx = *m_ttl_list.begin();
-                element& e       = m_elements[ttl_idx];
-                if (now >= e.m_expire_time)
+                index_type ttl_idx = m_ttl_list.front();
+                element&   e       = m_elements[ttl_idx];
+                if (m_timestamp.expired(now, e.m_expire_time))
                 {
                     ++deleted_elements;
+                    CAPPUCCINO_PROBE3(expire, "utlru_cache", this, &e.m_keyed_position->first);
+                    do_track_eviction(ttl_idx);
                     do_erase(ttl_idx);
                 }
                 else
@@ -274,6 +295,82 @@ public:
         return deleted_elements;
     }
 
+    /**
+     * Starts recording statistics about evicted elements, see eviction_stats.  This adds per
+     * element bookkeeping of the insert time, last access time and hit count.  Peeking at an
+     * element does not count as an access.
+     */
+    auto enable_eviction_stats() -> void
+    {
+        std::lock_guard guard{m_lock};
+        if (m_eviction_metadata.empty())
+        {
+            auto now = std::chrono::steady_clock::now();
+            m_eviction_metadata.assign(m_elements.size(), eviction_metadata{now, now, 0});
+        }
+    }
+
+    /**
+     * @param reset Should the statistics be cleared after they are retrieved?
+     * @return The eviction statistics recorded since they were enabled or last reset.
+     */
+    auto eviction_stats(bool reset = false) -> cappuccino::eviction_stats
+    {
+        std::lock_guard            guard{m_lock};
+        cappuccino::eviction_stats stats = m_eviction_stats;
+        if (reset)
+        {
+            m_eviction_stats.clear();
+        }
+        return stats;
+    }
+
+    /**
+     * Sets the occupancy marks for batch eviction.  An insert into a full cache evicts down to the
+     * low watermark at once instead of a single element, and prune() evicts down to the low
+     * watermark once the cache holds at least the high watermark.  Calling prune() from a
+     * maintenance thread with the high watermark below the capacity keeps eviction work off the
+     * insert path.  By default the high watermark is the capacity and the low watermark is one
+     * less, which evicts a single element per insert into a full cache.
+     * @param high_watermark The size at which prune() evicts, capped to the capacity.
+     * @param low_watermark The size evictions stop at, capped below the high watermark and the capacity.
+     */
+    auto set_eviction_watermarks(size_t high_watermark, size_t low_watermark) -> void
+    {
+        std::lock_guard guard{m_lock};
+        m_high_watermark = std::min(high_watermark, m_elements.size());
+        m_low_watermark  = std::min({low_watermark, m_high_watermark, do_max_low_watermark()});
+    }
+
+    /**
+     * Evicts elements down to the low watermark if the cache holds at least the high watermark,
+     * see set_eviction_watermarks(). Expired elements are evicted first.
+     * @return The number of elements evicted.
+     */
+    auto prune() -> size_t
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard guard{m_lock};
+        if (m_used_size < m_high_watermark || m_used_size == 0)
+        {
+            return 0;
+        }
+        return do_prune_to(m_low_watermark, now);
+    }
+
+    /**
+     * Samples the health of the keyed lookup index, see index_stats.  Only sample_buckets buckets
+     * are visited so this is cheap enough to call periodically on a large cache.
+     * @param sample_buckets The number of hash buckets to sample the chain lengths from.
+     * @return The index's load factor, rehash count and sampled chain lengths.
+     */
+    auto index_stats(size_t sample_buckets = 64) -> cappuccino::index_stats
+    {
+        std::lock_guard guard{m_lock};
+        return sample_index_stats(m_keyed_elements, m_index_rehashes, sample_buckets);
+    }
+
     /**
      * @return If this cache is currenty empty.
      */
@@ -290,16 +387,22 @@ public:
     auto capacity() const -> size_t { return m_elements.size(); }
 
 private:
+    struct eviction_metadata
+    {
+        /// The point in time the element was inserted.
+        std::chrono::steady_clock::time_point m_insert_time;
+        /// The point in time the element was last inserted, updated or found.
+        std::chrono::steady_clock::time_point m_access_time;
+        /// The number of find hits since the element was inserted.
+        uint64_t m_hits;
+    };
+
     struct element
     {
         /// The point in time in  which this element's value expires.
-        std::chrono::steady_clock::time_point m_expire_time;
+        typename timestamp_type::stamp_type m_expire_time;
         /// The iterator into the keyed data structure.
         keyed_iterator m_keyed_position;
-        /// The iterator into the lru data structure.
-        std::list<size_t>::iterator m_lru_position;
-        /// The iterator into the ttl data structure.
-        std::list<size_t>::iterator m_ttl_position;
         /// The element's value.
         value_type m_value;
     };
@@ -311,6 +414,8 @@ private:
         std::chrono::steady_clock::time_point expire_time,
         allow                                 a) -> bool
     {
+        do_rebase(now, expire_time);
+
         auto keyed_position = m_keyed_elements.find(key);
         if (keyed_position != m_keyed_elements.end())
         {
@@ -325,7 +430,7 @@ private:
                 // insert to proceed, this can just be an update in place.
                 const auto& [k, element_idx] = *keyed_position;
                 element& e                   = m_elements[element_idx];
-                if (now >= e.m_expire_time)
+                if (m_timestamp.expired(now, e.m_expire_time))
                 {
                     do_update(keyed_position, std::move(value), expire_time);
                     return true;
@@ -351,58 +456,57 @@ private:
     {
         if (m_used_size >= m_elements.size())
         {
-            do_prune(now);
+            do_prune_to(m_low_watermark, now);
         }
-        auto element_idx = *m_lru_end;
+        CAPPUCCINO_PROBE3(insert, "utlru_cache", this, &key);
 
-        auto keyed_position = m_keyed_elements.emplace(key, element_idx).first;
+        auto element_idx = m_open_list[m_used_size];
+        do_track_insert(element_idx);
 
-        m_ttl_list.emplace_back(element_idx);
+        auto keyed_position = m_keyed_elements.emplace(key, element_idx).first;
+        m_index_rehashes.observe(m_keyed_elements.bucket_count());
 
         element& e         = m_elements[element_idx];
         e.m_value          = std::move(value);
-        e.m_expire_time    = expire_time;
-        e.m_lru_position   = m_lru_end;
-        e.m_ttl_position   = std::prev(m_ttl_list.end());
+        e.m_expire_time    = m_timestamp.deadline(expire_time);
         e.m_keyed_position = keyed_position;
 
-        ++m_lru_end;
-
         ++m_used_size;
 
-        do_access(e);
+        m_ttl_list.push_back(element_idx);
+        m_lru_list.push_front(element_idx);
     }
 
     auto do_update(keyed_iterator keyed_position, value_type&& value, std::chrono::steady_clock::time_point expire_time)
         -> void
     {
-        size_t element_idx = keyed_position->second;
+        CAPPUCCINO_PROBE3(update, "utlru_cache", this, &keyed_position->first);
+
+        index_type element_idx = keyed_position->second;
 
         element& e      = m_elements[element_idx];
-        e.m_expire_time = expire_time;
+        e.m_expire_time = m_timestamp.deadline(expire_time);
         e.m_value       = std::move(value);
+        do_track_access(element_idx, false);
 
         // push to the end of the ttl list
-        m_ttl_list.splice(m_ttl_list.end(), m_ttl_list, e.m_ttl_position);
+        m_ttl_list.move_to_back(element_idx);
 
-        do_access(e);
+        do_access(element_idx);
     }
 
-    auto do_erase(size_t element_idx) -> void
+    auto do_erase(index_type element_idx) -> void
     {
         element& e = m_elements[element_idx];
 
-        if (e.m_lru_position != std::prev(m_lru_end))
-        {
-            m_lru_list.splice(m_lru_end, m_lru_list, e.m_lru_position);
-        }
-        --m_lru_end;
-
-        m_ttl_list.erase(e.m_ttl_position);
+        m_lru_list.erase(element_idx);
+        m_ttl_list.erase(element_idx);
 
         m_keyed_elements.erase(e.m_keyed_position);
 
+        // Return the slot to the open list.
         --m_used_size;
+        m_open_list[m_used_size] = element_idx;
     }
 
     auto do_find(const key_type& key, std::chrono::steady_clock::time_point now, peek peek) -> std::optional<value_type>
@@ -410,54 +514,140 @@ private:
         auto keyed_position = m_keyed_elements.find(key);
         if (keyed_position != m_keyed_elements.end())
         {
-            size_t   element_idx = keyed_position->second;
-            element& e           = m_elements[element_idx];
+            index_type element_idx = keyed_position->second;
+            element&   e           = m_elements[element_idx];
 
             // Has the element TTL'ed?
-            if (now < e.m_expire_time)
+            if (!m_timestamp.expired(now, e.m_expire_time))
             {
                 // Do not update items access if peeking.
                 if (peek == peek::no)
                 {
-                    do_access(e);
+                    do_access(element_idx);
+                    do_track_access(element_idx, true);
                 }
+                CAPPUCCINO_PROBE3(find_hit, "utlru_cache", this, &key);
                 return {e.m_value};
             }
             else
             {
+                CAPPUCCINO_PROBE3(expire, "utlru_cache", this, &key);
+                do_track_eviction(element_idx);
                 do_erase(element_idx);
             }
         }
 
+        CAPPUCCINO_PROBE3(find_miss, "utlru_cache", this, &key);
         return {};
     }
 
-    auto do_access(element& e) -> void { m_lru_list.splice(m_lru_list.begin(), m_lru_list, e.m_lru_position); }
+    auto do_access(index_type element_idx) -> void { m_lru_list.move_to_front(element_idx); }
+
+    /**
+     * Moves the timestamp epoch forward if needed so expire_time fits, this must happen before new
+     * expire times are computed from the given point in time.
+     */
+    auto do_rebase(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point expire_time)
+        -> void
+    {
+        auto shift = m_timestamp.rebase(now, expire_time);
+        if (shift > 0)
+        {
+            for (auto& e : m_elements)
+            {
+                e.m_expire_time = timestamp_type::shifted(e.m_expire_time, shift);
+            }
+        }
+    }
+
+    /**
+     * Evicts elements one by one in policy order until the cache holds at most target elements.
+     * @return The number of elements evicted.
+     */
+    auto do_prune_to(size_t target, std::chrono::steady_clock::time_point now) -> size_t
+    {
+        size_t pruned{0};
+        while (m_used_size > target)
+        {
+            do_prune(now);
+            ++pruned;
+        }
+        return pruned;
+    }
+
+    /**
+     * @return The largest low watermark that still frees a slot for an insert into a full cache.
+     */
+    auto do_max_low_watermark() const -> size_t { return m_elements.empty() ? 0 : m_elements.size() - 1; }
 
     auto do_prune(std::chrono::steady_clock::time_point now) -> void
     {
         if (m_used_size > 0)
         {
-            size_t   ttl_idx = *m_ttl_list.begin();
-            element& e       = m_elements[ttl_idx];
+            index_type ttl_idx = m_ttl_list.front();
+            element&   e       = m_elements[ttl_idx];
 
-            if (now >= e.m_expire_time)
+            if (m_timestamp.expired(now, e.m_expire_time))
             {
+                CAPPUCCINO_PROBE4(
+                    evict, "utlru_cache", this, &e.m_keyed_position->first, static_cast<int>(evict_reason::expired));
+                do_track_eviction(ttl_idx);
                 do_erase(ttl_idx);
             }
             else
             {
-                size_t lru_idx = m_lru_list.back();
+                index_type lru_idx = m_lru_list.back();
+                CAPPUCCINO_PROBE4(
+                    evict,
+                    "utlru_cache",
+                    this,
+                    &m_elements[lru_idx].m_keyed_position->first,
+                    static_cast<int>(evict_reason::capacity));
+                do_track_eviction(lru_idx);
                 do_erase(lru_idx);
             }
         }
     }
 
+    auto do_track_insert(size_t element_idx) -> void
+    {
+        if (!m_eviction_metadata.empty())
+        {
+            auto now                         = std::chrono::steady_clock::now();
+            m_eviction_metadata[element_idx] = eviction_metadata{now, now, 0};
+        }
+    }
+
+    auto do_track_access(size_t element_idx, bool hit) -> void
+    {
+        if (!m_eviction_metadata.empty())
+        {
+            auto& metadata         = m_eviction_metadata[element_idx];
+            metadata.m_access_time = std::chrono::steady_clock::now();
+            if (hit)
+            {
+                ++metadata.m_hits;
+            }
+        }
+    }
+
+    auto do_track_eviction(size_t element_idx) -> void
+    {
+        if (!m_eviction_metadata.empty())
+        {
+            auto  now      = std::chrono::steady_clock::now();
+            auto& metadata = m_eviction_metadata[element_idx];
+            m_eviction_stats.record(now - metadata.m_insert_time, metadata.m_hits, now - metadata.m_access_time);
+        }
+    }
+
     /// Cache lock for all mutations.
     mutex<thread_safe_type> m_lock;
 
     /// The uniform TTL for every key value pair inserted into the cache.
     std::chrono::milliseconds m_ttl;
+    /// The representation of the expire times.
+    timestamp_type m_timestamp;
 
     /// The current number of elements in the cache.
     size_t m_used_size{0};
@@ -465,13 +655,25 @@ private:
     /// The main store for the key value pairs and metadata for each e.
     std::vector<element> m_elements;
     /// The keyed lookup data structure, the value is the index into 'm_elements'.
-    std::unordered_map<key_type, size_t> m_keyed_elements;
+    std::unordered_map<key_type, index_type> m_keyed_elements;
+    /// Counts the rehashes of 'm_keyed_elements' for index_stats().
+    index_rehash_counter m_index_rehashes{};
     /// The lru sorted list from most recently used (head) to least recently used (tail).
-    std::list<size_t> m_lru_list;
+    index_list<index_type> m_lru_list;
     /// The uniform ttl sorted list.
-    std::list<size_t> m_ttl_list;
-    /// The lru end/open list end.
-    std::list<size_t>::iterator m_lru_end;
+    index_list<index_type> m_ttl_list;
+    /// The open slots into 'm_elements', every index at or past 'm_used_size' is free.
+    std::vector<index_type> m_open_list;
+
+    /// Per element eviction bookkeeping indexed like 'm_elements', empty unless eviction stats are enabled.
+    std::vector<eviction_metadata> m_eviction_metadata;
+    /// The statistics of all evicted elements since eviction stats were enabled.
+    cappuccino::eviction_stats m_eviction_stats;
+
+    /// The size at which prune() evicts, see set_eviction_watermarks().
+    size_t m_high_watermark{0};
+    /// The size batch evictions stop at, see set_eviction_watermarks().
+    size_t m_low_watermark{0};
 };
 
 } // namespace cappuccino
@@ -0,0 +1,94 @@
+#include "cappuccino/counting_bloom_filter.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace cappuccino
+{
+static constexpr uint8_t counter_max = std::numeric_limits<uint8_t>::max();
+
+static auto mix(uint64_t x) -> uint64_t
+{
+    // The murmur3 64 bit finalizer, std::hash is the identity for integers.
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static auto counter_for(uint64_t hash, size_t probe) -> size_t
+{
+    // 6 bits per probe address one of the 64 counters in the block.
+    return static_cast<size_t>((hash >> (probe * 6)) & 63);
+}
+
+counting_bloom_filter::counting_bloom_filter(size_t expected_elements, size_t counters_per_element)
+    : m_blocks(std::max(std::max(expected_elements, size_t{1}) * counters_per_element / block_size, size_t{1}))
+{
+}
+
+auto counting_bloom_filter::add(uint64_t hash) -> void
+{
+    hash        = mix(hash);
+    auto& block = m_blocks[block_for(hash)];
+    for (size_t probe = 0; probe < probe_count; ++probe)
+    {
+        auto& counter = block.m_counters[counter_for(hash, probe)];
+        auto  value   = counter.load(std::memory_order_relaxed);
+        while (value != counter_max &&
+               !counter.compare_exchange_weak(value, static_cast<uint8_t>(value + 1), std::memory_order_release))
+        {
+        }
+    }
+}
+
+auto counting_bloom_filter::remove(uint64_t hash) -> void
+{
+    hash        = mix(hash);
+    auto& block = m_blocks[block_for(hash)];
+    for (size_t probe = 0; probe < probe_count; ++probe)
+    {
+        auto& counter = block.m_counters[counter_for(hash, probe)];
+        auto  value   = counter.load(std::memory_order_relaxed);
+        // A saturated counter has lost count of its elements, it is left saturated.
+        while (value != 0 && value != counter_max &&
+               !counter.compare_exchange_weak(value, static_cast<uint8_t>(value - 1), std::memory_order_release))
+        {
+        }
+    }
+}
+
+auto counting_bloom_filter::may_contain(uint64_t hash) const -> bool
+{
+    hash              = mix(hash);
+    const auto& block = m_blocks[block_for(hash)];
+    for (size_t probe = 0; probe < probe_count; ++probe)
+    {
+        if (block.m_counters[counter_for(hash, probe)].load(std::memory_order_acquire) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto counting_bloom_filter::clear() -> void
+{
+    for (auto& block : m_blocks)
+    {
+        for (auto& counter : block.m_counters)
+        {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+auto counting_bloom_filter::block_for(uint64_t hash) const -> size_t
+{
+    // The high bits pick the block, the low bits pick the counters within it.
+    return static_cast<size_t>((hash >> 32) % m_blocks.size());
+}
+
+} // namespace cappuccino
@@ -0,0 +1,25 @@
+#include "cappuccino/eviction_policy.hpp"
+
+namespace cappuccino
+{
+static const std::string eviction_policy_invalid_value{"invalid_value"};
+static const std::string eviction_policy_lru{"lru"};
+static const std::string eviction_policy_lfu{"lfu"};
+static const std::string eviction_policy_fifo{"fifo"};
+
+auto to_string(eviction_policy p) -> const std::string&
+{
+    switch (p)
+    {
+        case eviction_policy::lru:
+            return eviction_policy_lru;
+        case eviction_policy::lfu:
+            return eviction_policy_lfu;
+        case eviction_policy::fifo:
+            return eviction_policy_fifo;
+        default:
+            return eviction_policy_invalid_value;
+    }
+}
+
+} // namespace cappuccino
@@ -0,0 +1,100 @@
+#include "cappuccino/eviction_stats.hpp"
+
+#include <cmath>
+
+namespace cappuccino
+{
+static auto to_microseconds(std::chrono::steady_clock::duration d) -> uint64_t
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    return (us > 0) ? static_cast<uint64_t>(us) : 0;
+}
+
+auto log2_histogram::record(uint64_t value) -> void
+{
+    size_t idx{0};
+    while (value != 0)
+    {
+        value >>= 1;
+        ++idx;
+    }
+
+    ++m_buckets[idx];
+    ++m_count;
+}
+
+auto log2_histogram::merge(const log2_histogram& other) -> void
+{
+    for (size_t i = 0; i < bucket_count; ++i)
+    {
+        m_buckets[i] += other.m_buckets[i];
+    }
+    m_count += other.m_count;
+}
+
+auto log2_histogram::clear() -> void
+{
+    m_buckets.fill(0);
+    m_count = 0;
+}
+
+auto log2_histogram::bucket_lower_bound(size_t idx) -> uint64_t
+{
+    return (idx == 0) ? 0 : (uint64_t{1} << (idx - 1));
+}
+
+auto log2_histogram::bucket_upper_bound(size_t idx) -> uint64_t
+{
+    if (idx == 0)
+    {
+        return 0;
+    }
+    // The last bucket's upper bound is the largest 64 bit value, avoid shifting by 64.
+    return (idx == bucket_count - 1) ? UINT64_MAX : (uint64_t{1} << idx) - 1;
+}
+
+auto log2_histogram::percentile(double p) const -> uint64_t
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+
+    // The rank of the value at the percentile, at least the first recorded value.
+    auto     target = static_cast<uint64_t>(std::ceil(p * static_cast<double>(m_count)));
+    uint64_t seen{0};
+    for (size_t i = 0; i < bucket_count; ++i)
+    {
+        seen += m_buckets[i];
+        if (seen > 0 && seen >= target)
+        {
+            return bucket_upper_bound(i);
+        }
+    }
+
+    return bucket_upper_bound(bucket_count - 1);
+}
+
+auto eviction_stats::record(
+    std::chrono::steady_clock::duration residency, uint64_t hits, std::chrono::steady_clock::duration idle) -> void
+{
+    m_residency_us.record(to_microseconds(residency));
+    m_hits_before_eviction.record(hits);
+    m_idle_us.record(to_microseconds(idle));
+}
+
+auto eviction_stats::merge(const eviction_stats& other) -> void
+{
+    m_residency_us.merge(other.m_residency_us);
+    m_hits_before_eviction.merge(other.m_hits_before_eviction);
+    m_idle_us.merge(other.m_idle_us);
+}
+
+auto eviction_stats::clear() -> void
+{
+    m_residency_us.clear();
+    m_hits_before_eviction.clear();
+    m_idle_us.clear();
+}
+
+} // namespace cappuccino
@@ -0,0 +1,61 @@
+#include "cappuccino/journal.hpp"
+
+namespace cappuccino
+{
+static const std::string journal_op_invalid_value{"invalid_value"};
+static const std::string journal_op_insert{"insert"};
+static const std::string journal_op_erase{"erase"};
+static const std::string journal_op_touch{"touch"};
+
+auto to_string(journal_op op) -> const std::string&
+{
+    switch (op)
+    {
+        case journal_op::insert:
+            return journal_op_insert;
+        case journal_op::erase:
+            return journal_op_erase;
+        case journal_op::touch:
+            return journal_op_touch;
+        default:
+            return journal_op_invalid_value;
+    }
+}
+
+static const std::string journal_sync_invalid_value{"invalid_value"};
+static const std::string journal_sync_no{"no"};
+static const std::string journal_sync_yes{"yes"};
+
+auto to_string(journal_sync s) -> const std::string&
+{
+    switch (s)
+    {
+        case journal_sync::no:
+            return journal_sync_no;
+        case journal_sync::yes:
+            return journal_sync_yes;
+        default:
+            return journal_sync_invalid_value;
+    }
+}
+
+auto journal_checksum(const char* data, size_t size) -> uint32_t
+{
+    // FNV-1a, enough to tell a torn or partially written record apart from a whole one.
+    uint32_t hash{2166136261u};
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static std::atomic<uint64_t> journal_ids{0};
+
+auto journal_next_id() -> uint64_t
+{
+    return journal_ids.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+} // namespace cappuccino
@@ -8,6 +8,10 @@ static const std::string thread_safe_invalid_value = "invalid_value"s;
 static const std::string thread_safe_no            = "no"s;
 static const std::string thread_safe_yes           = "yes"s;
 
+static const std::string lock_status_invalid_value = "invalid_value"s;
+static const std::string lock_status_acquired      = "acquired"s;
+static const std::string lock_status_contended     = "contended"s;
+
 auto to_string(thread_safe ts) -> const std::string&
 {
     switch (ts)
@@ -21,4 +25,17 @@ auto to_string(thread_safe ts) -> const std::string&
     }
 }
 
+auto to_string(lock_status ls) -> const std::string&
+{
+    switch (ls)
+    {
+        case lock_status::acquired:
+            return lock_status_acquired;
+        case lock_status::contended:
+            return lock_status_contended;
+        default:
+            return lock_status_invalid_value;
+    }
+}
+
 } // namespace cappuccino
@@ -0,0 +1,22 @@
+#include "cappuccino/quota.hpp"
+
+namespace cappuccino
+{
+static const std::string quota_invalid_value{"invalid_value"};
+static const std::string quota_soft{"soft"};
+static const std::string quota_hard{"hard"};
+
+auto to_string(quota q) -> const std::string&
+{
+    switch (q)
+    {
+        case quota::soft:
+            return quota_soft;
+        case quota::hard:
+            return quota_hard;
+        default:
+            return quota_invalid_value;
+    }
+}
+
+} // namespace cappuccino
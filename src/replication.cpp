@@ -0,0 +1,143 @@
+#include "cappuccino/replication.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <cerrno>
+    #include <cstring>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+namespace cappuccino
+{
+static const std::string replication_status_invalid_value{"invalid_value"};
+static const std::string replication_status_applied{"applied"};
+static const std::string replication_status_idle{"idle"};
+static const std::string replication_status_resyncing{"resyncing"};
+static const std::string replication_status_disconnected{"disconnected"};
+
+auto to_string(replication_status s) -> const std::string&
+{
+    switch (s)
+    {
+        case replication_status::applied:
+            return replication_status_applied;
+        case replication_status::idle:
+            return replication_status_idle;
+        case replication_status::resyncing:
+            return replication_status_resyncing;
+        case replication_status::disconnected:
+            return replication_status_disconnected;
+        default:
+            return replication_status_invalid_value;
+    }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+fd_channel::~fd_channel()
+{
+    if (m_read_fd >= 0)
+    {
+        close(m_read_fd);
+    }
+    if (m_write_fd >= 0 && m_write_fd != m_read_fd)
+    {
+        close(m_write_fd);
+    }
+}
+
+/**
+ * Writes all the bytes, sockets are written with MSG_NOSIGNAL so a closed peer is an error
+ * rather than a SIGPIPE.
+ */
+static auto write_all(int fd, const char* data, size_t size) -> bool
+{
+    while (size > 0)
+    {
+    #if defined(MSG_NOSIGNAL)
+        auto written = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == ENOTSOCK)
+        {
+            written = ::write(fd, data, size);
+        }
+    #else
+        auto written = ::write(fd, data, size);
+    #endif
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+static auto read_all(int fd, char* data, size_t size) -> bool
+{
+    while (size > 0)
+    {
+        auto bytes = ::read(fd, data, size);
+        if (bytes < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (bytes <= 0)
+        {
+            return false;
+        }
+        data += bytes;
+        size -= static_cast<size_t>(bytes);
+    }
+    return true;
+}
+
+auto fd_channel::send(std::string_view frame) -> bool
+{
+    if (!m_open || m_write_fd < 0)
+    {
+        return false;
+    }
+
+    auto size = static_cast<uint32_t>(frame.size());
+    char header[sizeof(uint32_t)];
+    std::memcpy(header, &size, sizeof(uint32_t));
+    m_open = write_all(m_write_fd, header, sizeof(header)) && write_all(m_write_fd, frame.data(), frame.size());
+    return m_open;
+}
+
+auto fd_channel::receive(std::string& frame, std::chrono::milliseconds timeout) -> bool
+{
+    if (!m_open || m_read_fd < 0)
+    {
+        return false;
+    }
+
+    pollfd descriptor{};
+    descriptor.fd     = m_read_fd;
+    descriptor.events = POLLIN;
+    if (::poll(&descriptor, 1, static_cast<int>(timeout.count())) <= 0)
+    {
+        return false;
+    }
+
+    // Once a frame has started the rest of it is already on its way, read it whole.
+    char header[sizeof(uint32_t)];
+    if (!read_all(m_read_fd, header, sizeof(header)))
+    {
+        m_open = false;
+        return false;
+    }
+    uint32_t size{0};
+    std::memcpy(&size, header, sizeof(uint32_t));
+    frame.resize(size);
+    m_open = read_all(m_read_fd, frame.data(), size);
+    return m_open;
+}
+#endif
+
+} // namespace cappuccino
@@ -0,0 +1,42 @@
+#include "cappuccino/trace.hpp"
+
+#if defined(CAPPUCCINO_TRACE_ENABLED)
+    // A tracer locates the semaphores through the .probes section and the probe notes.
+    #define CAPPUCCINO_SEMAPHORE(probe)                                                                 \
+        volatile unsigned short cappuccino_##probe##_semaphore __attribute__((unused))                 \
+        __attribute__((section(".probes"))) = 0
+
+extern "C" {
+CAPPUCCINO_SEMAPHORE(find_hit);
+CAPPUCCINO_SEMAPHORE(find_miss);
+CAPPUCCINO_SEMAPHORE(insert);
+CAPPUCCINO_SEMAPHORE(update);
+CAPPUCCINO_SEMAPHORE(touch);
+CAPPUCCINO_SEMAPHORE(evict);
+CAPPUCCINO_SEMAPHORE(expire);
+CAPPUCCINO_SEMAPHORE(expire_generation);
+CAPPUCCINO_SEMAPHORE(lock_acquire);
+CAPPUCCINO_SEMAPHORE(lock_contended);
+}
+#endif
+
+namespace cappuccino
+{
+static const std::string evict_reason_invalid_value{"invalid_value"};
+static const std::string evict_reason_capacity{"capacity"};
+static const std::string evict_reason_expired{"expired"};
+
+auto to_string(evict_reason r) -> const std::string&
+{
+    switch (r)
+    {
+        case evict_reason::capacity:
+            return evict_reason_capacity;
+        case evict_reason::expired:
+            return evict_reason_expired;
+        default:
+            return evict_reason_invalid_value;
+    }
+}
+
+} // namespace cappuccino
@@ -20,9 +20,250 @@ TEST_CASE("syncImpl to_string()")
     REQUIRE(to_string(static_cast<cappuccino::thread_safe>(5000)) == "invalid_value");
 }
 
+TEST_CASE("evict_reason to_string()")
+{
+    REQUIRE(to_string(evict_reason::capacity) == "capacity");
+    REQUIRE(to_string(evict_reason::expired) == "expired");
+    REQUIRE(to_string(static_cast<evict_reason>(5000)) == "invalid_value");
+}
+
+TEST_CASE("journal_op to_string()")
+{
+    REQUIRE(to_string(journal_op::insert) == "insert");
+    REQUIRE(to_string(journal_op::erase) == "erase");
+    REQUIRE(to_string(journal_op::touch) == "touch");
+    REQUIRE(to_string(static_cast<journal_op>(200)) == "invalid_value");
+}
+
+TEST_CASE("journal_sync to_string()")
+{
+    REQUIRE(to_string(journal_sync::no) == "no");
+    REQUIRE(to_string(journal_sync::yes) == "yes");
+    REQUIRE(to_string(static_cast<journal_sync>(5000)) == "invalid_value");
+}
+
+TEST_CASE("replication_status to_string()")
+{
+    REQUIRE(to_string(replication_status::applied) == "applied");
+    REQUIRE(to_string(replication_status::idle) == "idle");
+    REQUIRE(to_string(replication_status::resyncing) == "resyncing");
+    REQUIRE(to_string(replication_status::disconnected) == "disconnected");
+    REQUIRE(to_string(static_cast<replication_status>(5000)) == "invalid_value");
+}
+
+TEST_CASE("lock_status to_string()")
+{
+    REQUIRE(to_string(lock_status::acquired) == "acquired");
+    REQUIRE(to_string(lock_status::contended) == "contended");
+    REQUIRE(to_string(static_cast<lock_status>(5000)) == "invalid_value");
+}
+
+TEST_CASE("mutex try_lock and try_lock_until")
+{
+    using namespace std::chrono_literals;
+
+    mutex<thread_safe::yes> m{};
+    REQUIRE(m.try_lock());
+    REQUIRE_FALSE(m.try_lock());
+
+    // Gives up once the deadline has passed.
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE_FALSE(m.try_lock_until(start + 5ms));
+    REQUIRE(std::chrono::steady_clock::now() - start >= 5ms);
+    m.unlock();
+    REQUIRE(m.try_lock_until(std::chrono::steady_clock::now() + 5ms));
+    m.unlock();
+
+    mutex<thread_safe::no> none{};
+    REQUIRE(none.try_lock());
+    REQUIRE(none.try_lock());
+    REQUIRE(none.try_lock_until(std::chrono::steady_clock::now()));
+}
+
 TEST_CASE("peek to_string()")
 {
     REQUIRE(to_string(peek::yes) == "yes");
     REQUIRE(to_string(peek::no) == "no");
     REQUIRE(to_string(static_cast<peek>(5000)) == "invalid_value");
 }
+
+TEST_CASE("log2_histogram buckets and percentiles")
+{
+    log2_histogram h{};
+    REQUIRE(h.count() == 0);
+    REQUIRE(h.percentile(0.5) == 0);
+
+    h.record(0);
+    h.record(1);
+    h.record(2);
+    h.record(3);
+    h.record(1000);
+
+    REQUIRE(h.count() == 5);
+    REQUIRE(h.bucket(0) == 1);
+    REQUIRE(h.bucket(1) == 1);
+    REQUIRE(h.bucket(2) == 2);
+    REQUIRE(h.bucket(10) == 1);
+
+    REQUIRE(log2_histogram::bucket_lower_bound(10) == 512);
+    REQUIRE(log2_histogram::bucket_upper_bound(10) == 1023);
+    REQUIRE(log2_histogram::bucket_upper_bound(log2_histogram::bucket_count - 1) == UINT64_MAX);
+
+    REQUIRE(h.percentile(0.5) == 3);
+    REQUIRE(h.percentile(1.0) == 1023);
+
+    log2_histogram other{};
+    other.record(UINT64_MAX);
+    h.merge(other);
+    REQUIRE(h.count() == 6);
+    REQUIRE(h.bucket(log2_histogram::bucket_count - 1) == 1);
+
+    h.clear();
+    REQUIRE(h.count() == 0);
+    REQUIRE(h.bucket(2) == 0);
+}
+
+TEST_CASE("coarse_timestamp rounding, saturation and rebasing")
+{
+    using namespace std::chrono_literals;
+
+    coarse_timestamp<std::chrono::milliseconds> ts{};
+    auto                                        epoch = ts.time_point(0);
+
+    // Stamps round down, deadlines round up so nothing expires early.
+    REQUIRE(ts.stamp(epoch + 1500us) == 1);
+    REQUIRE(ts.deadline(epoch + 1500us) == 2);
+    REQUIRE(ts.deadline(epoch + 2ms) == 2);
+    REQUIRE(ts.stamp(epoch - 1s) == 0);
+    REQUIRE(ts.time_point(5) == epoch + 5ms);
+    REQUIRE(ts.stamp(epoch + std::chrono::hours{24 * 365}) == coarse_timestamp<>::max_stamp);
+
+    coarse_timestamp<std::chrono::milliseconds, uint8_t> small{};
+    epoch = small.time_point(0);
+
+    // Nothing to do until three quarters of the 255ms range are used.
+    REQUIRE(small.rebase(epoch + 100ms) == 0);
+    REQUIRE(small.rebase(epoch + 60ms, epoch + 300ms) == 0);
+    REQUIRE(small.stamp(epoch + 200ms) == 200);
+
+    // Now maps to a quarter of the range after rebasing.
+    auto shift = small.rebase(epoch + 200ms);
+    REQUIRE(shift == 137);
+    REQUIRE(small.stamp(epoch + 200ms) == 63);
+    REQUIRE(small.time_point(63) == epoch + 200ms);
+    REQUIRE(small.shifted(150, shift) == 13);
+    REQUIRE(small.shifted(10, shift) == 0);
+    REQUIRE(small.shifted(255, shift) == 255);
+
+    // A deadline past the end of the range also moves the epoch once half of the range is used.
+    epoch = small.time_point(0);
+    REQUIRE(small.rebase(epoch + 100ms, epoch + 280ms) == 0);
+    REQUIRE(small.deadline(epoch + 280ms) == 255);
+    // A deadline that would still saturate after rebasing does not move it.
+    REQUIRE(small.rebase(epoch + 130ms, epoch + 400ms) == 0);
+    REQUIRE(small.rebase(epoch + 130ms, epoch + 300ms) == 67);
+    REQUIRE(small.deadline(epoch + 300ms) == 233);
+
+    // Saturated expire times never expire, even once the current time saturates as well.
+    epoch = small.time_point(0);
+    REQUIRE(small.expired(epoch + 10ms, 10));
+    REQUIRE_FALSE(small.expired(epoch + 9ms, 10));
+    REQUIRE_FALSE(small.expired(epoch + 1000ms, 255));
+
+    // A rebase after more than a full range catches up in one step.
+    REQUIRE(small.rebase(epoch + 1000ms) == 1000 - 63);
+    REQUIRE(small.stamp(epoch + 1000ms) == 63);
+
+    steady_timestamp steady{};
+    auto             now = std::chrono::steady_clock::now();
+    REQUIRE(steady.stamp(now) == now);
+    REQUIRE(steady.rebase(now) == 0);
+    REQUIRE(steady.expired(now, now));
+    REQUIRE_FALSE(steady.expired(now, now + 1ms));
+}
+
+TEST_CASE("counting_bloom_filter add, remove and saturation")
+{
+    counting_bloom_filter filter{1000};
+    REQUIRE(filter.block_count() == 1000 * 8 / counting_bloom_filter::block_size);
+
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        filter.add(i);
+    }
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        REQUIRE(filter.may_contain(i));
+    }
+
+    size_t false_positives{0};
+    for (uint64_t i = 1000; i < 11000; ++i)
+    {
+        false_positives += filter.may_contain(i) ? 1 : 0;
+    }
+    REQUIRE(false_positives < 1000);
+
+    // Removing every element empties the filter.
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        filter.remove(i);
+    }
+    for (uint64_t i = 0; i < 11000; ++i)
+    {
+        REQUIRE_FALSE(filter.may_contain(i));
+    }
+
+    // Saturated counters are never decremented, so the element stays present.
+    for (size_t i = 0; i < 300; ++i)
+    {
+        filter.add(42);
+    }
+    for (size_t i = 0; i < 300; ++i)
+    {
+        filter.remove(42);
+    }
+    REQUIRE(filter.may_contain(42));
+
+    filter.clear();
+    REQUIRE_FALSE(filter.may_contain(42));
+}
+
+TEST_CASE("index_rehash_counter counts bucket count changes")
+{
+    index_rehash_counter counter{};
+    counter.observe(16);
+    counter.observe(16);
+    REQUIRE(counter.rehash_count() == 0);
+    counter.observe(32);
+    counter.observe(32);
+    counter.observe(64);
+    REQUIRE(counter.rehash_count() == 2);
+
+    // A map that grows from empty rehashes as it is filled.
+    std::unordered_map<uint64_t, uint64_t> map{};
+    index_rehash_counter                   rehashes{};
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        map.emplace(i, i);
+        rehashes.observe(map.bucket_count());
+    }
+    auto stats = sample_index_stats(map, rehashes, 64);
+    REQUIRE(stats.m_rehash_count > 0);
+    REQUIRE(stats.m_size == 1000);
+    REQUIRE(stats.m_sampled_buckets == 64);
+}
+
+TEST_CASE("quota to_string()")
+{
+    REQUIRE(to_string(quota::soft) == "soft");
+    REQUIRE(to_string(quota::hard) == "hard");
+    REQUIRE(to_string(static_cast<quota>(5000)) == "invalid_value");
+}
+
+TEST_CASE("eviction_policy to_string()")
+{
+    REQUIRE(to_string(eviction_policy::lru) == "lru");
+    REQUIRE(to_string(eviction_policy::lfu) == "lfu");
+    REQUIRE(to_string(eviction_policy::fifo) == "fifo");
+    REQUIRE(to_string(static_cast<eviction_policy>(5000)) == "invalid_value");
+}
@@ -0,0 +1,137 @@
+#include "catch.hpp"
+#include <cappuccino/cappuccino.hpp>
+
+using namespace cappuccino;
+
+/**
+ * Read through access, find and insert on a miss.
+ */
+template<typename cache_type>
+static auto access(cache_type& cache, uint64_t key) -> bool
+{
+    if (cache.find(key).has_value())
+    {
+        return true;
+    }
+    cache.insert(key, key);
+    return false;
+}
+
+TEST_CASE("Adaptive example")
+{
+    adaptive_cache<uint64_t, std::string> cache{2};
+    REQUIRE(cache.policy() == eviction_policy::lru);
+
+    cache.insert(1, "Hello");
+    cache.insert(2, "World");
+    REQUIRE(cache.find(1).value() == "Hello");
+
+    // Evicts 2 under lru.
+    cache.insert(3, "Hola");
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.find(1).has_value());
+    REQUIRE_FALSE(cache.find(2).has_value());
+    REQUIRE(cache.find(3).has_value());
+
+    REQUIRE(cache.erase(1));
+    REQUIRE_FALSE(cache.erase(1));
+    REQUIRE(cache.size() == 1);
+}
+
+TEST_CASE("Adaptive Insert Only and Update Only")
+{
+    adaptive_cache<uint64_t, std::string> cache{4};
+
+    REQUIRE(cache.insert(1, "test", allow::insert));
+    REQUIRE_FALSE(cache.insert(1, "test2", allow::insert));
+    REQUIRE(cache.find(1).value() == "test");
+
+    REQUIRE_FALSE(cache.insert(2, "test", allow::update));
+    REQUIRE(cache.insert(1, "test3", allow::update));
+    REQUIRE(cache.find(1).value() == "test3");
+}
+
+TEST_CASE("Adaptive switches to lfu when scans pollute lru")
+{
+    adaptive_cache<uint64_t, uint64_t> cache{10, 100};
+
+    uint64_t scan_key{1000};
+    for (size_t round = 0; round < 50; ++round)
+    {
+        // Each hot key is used a few times per round, the scan keys are only ever used once.
+        for (uint64_t hot = 0; hot < 5; ++hot)
+        {
+            access(cache, hot);
+            access(cache, hot);
+            access(cache, hot);
+        }
+        for (size_t i = 0; i < 20; ++i)
+        {
+            access(cache, scan_key++);
+        }
+    }
+
+    REQUIRE(cache.policy() == eviction_policy::lfu);
+    REQUIRE(cache.policy_switches() == 1);
+
+    // The resident ordering is now lfu, another scan keeps the hot keys.
+    for (size_t i = 0; i < 20; ++i)
+    {
+        access(cache, scan_key++);
+    }
+    for (uint64_t hot = 0; hot < 5; ++hot)
+    {
+        REQUIRE(cache.find(hot, peek::yes).has_value());
+    }
+}
+
+TEST_CASE("Adaptive switches to lru when lfu holds on to stale keys")
+{
+    adaptive_cache<uint64_t, uint64_t> cache{10, 100, eviction_policy::lfu};
+
+    // An old working set builds up large use counts.
+    for (size_t round = 0; round < 50; ++round)
+    {
+        for (uint64_t key = 0; key < 10; ++key)
+        {
+            access(cache, key);
+        }
+    }
+    REQUIRE(cache.policy() == eviction_policy::lfu);
+
+    // The traffic moves on to a new working set that fits in the cache.
+    size_t hits{0};
+    for (size_t round = 0; round < 50; ++round)
+    {
+        for (uint64_t key = 100; key < 110; ++key)
+        {
+            if (access(cache, key))
+            {
+                ++hits;
+            }
+        }
+    }
+
+    REQUIRE(cache.policy() == eviction_policy::lru);
+    // Once switched the new working set stays resident.
+    REQUIRE(hits > 300);
+}
+
+TEST_CASE("Adaptive find_range and erase_range")
+{
+    adaptive_cache<uint64_t, uint64_t> cache{4};
+
+    std::vector<std::pair<uint64_t, uint64_t>> elements{{1, 1}, {2, 2}, {3, 3}};
+    REQUIRE(cache.insert_range(elements) == 3);
+
+    auto found = cache.find_range(std::vector<uint64_t>{1, 4});
+    REQUIRE(found[0].second.value() == 1);
+    REQUIRE_FALSE(found[1].second.has_value());
+
+    std::vector<std::pair<uint64_t, std::optional<uint64_t>>> fill{{2, std::nullopt}};
+    cache.find_range_fill(fill);
+    REQUIRE(fill[0].second.value() == 2);
+
+    REQUIRE(cache.erase_range(std::vector<uint64_t>{1, 2, 5}) == 2);
+    REQUIRE(cache.size() == 1);
+}
@@ -0,0 +1,324 @@
+#include "catch.hpp"
+#include <cappuccino/cappuccino.hpp>
+
+using namespace cappuccino;
+
+TEST_CASE("ClockPro example")
+{
+    // Create a cache with 2 items.
+    clockpro_cache<uint64_t, std::string> cache{2};
+
+    // Insert hello and world.
+    cache.insert(1, "Hello");
+    cache.insert(2, "World");
+
+    {
+        // Grab hello, this sets its reference bit.
+        auto hello = cache.find(1);
+        REQUIRE(hello.has_value());
+        REQUIRE(hello.value() == "Hello");
+    }
+
+    // Insert hola, this will evict "World" since it was never referenced.
+    cache.insert(3, "Hola");
+
+    {
+        auto hola  = cache.find(3);
+        auto hello = cache.find(1);
+        auto world = cache.find(2);
+
+        REQUIRE(hola.has_value());
+        REQUIRE(hola.value() == "Hola");
+        REQUIRE(hello.has_value());
+        REQUIRE(hello.value() == "Hello");
+        REQUIRE_FALSE(world.has_value());
+    }
+}
+
+TEST_CASE("ClockPro Find doesn't exist")
+{
+    clockpro_cache<uint64_t, std::string> cache{4};
+    REQUIRE_FALSE(cache.find(100).has_value());
+}
+
+TEST_CASE("ClockPro Insert Only")
+{
+    clockpro_cache<uint64_t, std::string> cache{4};
+
+    REQUIRE(cache.insert(1, "test", allow::insert));
+    auto value = cache.find(1);
+    REQUIRE(value.has_value());
+    REQUIRE(value.value() == "test");
+
+    REQUIRE_FALSE(cache.insert(1, "test2", allow::insert));
+    value = cache.find(1);
+    REQUIRE(value.has_value());
+    REQUIRE(value.value() == "test");
+}
+
+TEST_CASE("ClockPro Update Only")
+{
+    clockpro_cache<uint64_t, std::string> cache{4};
+
+    REQUIRE_FALSE(cache.insert(1, "test", allow::update));
+    auto value = cache.find(1);
+    REQUIRE_FALSE(value.has_value());
+}
+
+TEST_CASE("ClockPro Insert Or Update")
+{
+    clockpro_cache<uint64_t, std::string> cache{4};
+
+    REQUIRE(cache.insert(1, "test"));
+    auto value = cache.find(1);
+    REQUIRE(value.has_value());
+    REQUIRE(value.value() == "test");
+
+    REQUIRE(cache.insert(1, "test2"));
+    value = cache.find(1);
+    REQUIRE(value.has_value());
+    REQUIRE(value.value() == "test2");
+}
+
+TEST_CASE("ClockPro insert_range Insert Or Update")
+{
+    clockpro_cache<uint64_t, std::string> cache{4};
+
+    {
+        std::vector<std::pair<uint64_t, std::string>> inserts{{1, "test1"}, {2, "test2"}, {3, "test3"}};
+
+        auto inserted = cache.insert_range(std::move(inserts));
+        REQUIRE(inserted == 3);
+    }
+
+    REQUIRE(cache.size() == 3);
+
+    {
+        std::vector<std::pair<uint64_t, std::string>> inserts{
+            {1, "test1"},
+            {2, "test2"},
+            {4, "test4"}, // new
+            {5, "test5"}, // new
+        };
+
+        auto inserted = cache.insert_range(std::move(inserts), allow::insert);
+        REQUIRE(inserted == 2);
+    }
+
+    REQUIRE(cache.size() == 4);
+
+    size_t count{0};
+    for (uint64_t key = 1; key <= 5; ++key)
+    {
+        count += cache.find(key).has_value() ? 1 : 0;
+    }
+    REQUIRE(count == 4);
+}
+
+TEST_CASE("ClockPro erase_range")
+{
+    clockpro_cache<uint64_t, std::string> cache{4};
+
+    {
+        std::vector<std::pair<uint64_t, std::string>> inserts{{1, "test1"}, {2, "test2"}, {3, "test3"}};
+
+        auto inserted = cache.insert_range(std::move(inserts));
+        REQUIRE(inserted == 3);
+    }
+
+    {
+        std::vector<uint64_t> delete_keys{1, 3, 4, 5};
+
+        auto deleted = cache.erase_range(delete_keys);
+        REQUIRE(deleted == 2);
+    }
+
+    REQUIRE(cache.size() == 1);
+    REQUIRE_FALSE(cache.find(1).has_value());
+    REQUIRE(cache.find(2).has_value());
+    REQUIRE(cache.find(2).value() == "test2");
+    REQUIRE_FALSE(cache.find(3).has_value());
+
+    REQUIRE(cache.erase(2));
+    REQUIRE(cache.empty());
+    REQUIRE_FALSE(cache.erase(2));
+}
+
+TEST_CASE("ClockPro find_range_fill")
+{
+    clockpro_cache<uint64_t, std::string> cache{4};
+
+    {
+        std::vector<std::pair<uint64_t, std::string>> inserts{{1, "test1"}, {2, "test2"}, {3, "test3"}};
+
+        auto inserted = cache.insert_range(std::move(inserts));
+        REQUIRE(inserted == 3);
+    }
+
+    std::vector<std::pair<uint64_t, std::optional<std::string>>> items{
+        {1, std::nullopt},
+        {3, std::nullopt},
+        {4, std::nullopt},
+    };
+    cache.find_range_fill(items);
+
+    REQUIRE(items[0].second.has_value());
+    REQUIRE(items[0].second.value() == "test1");
+    REQUIRE(items[1].second.has_value());
+    REQUIRE(items[1].second.value() == "test3");
+    REQUIRE_FALSE(items[2].second.has_value());
+
+    auto found = cache.find_range(std::vector<uint64_t>{2, 5});
+    REQUIRE(found[0].second.has_value());
+    REQUIRE(found[0].second.value() == "test2");
+    REQUIRE_FALSE(found[1].second.has_value());
+}
+
+TEST_CASE("ClockPro size + capacity")
+{
+    clockpro_cache<uint64_t, std::string> cache{4};
+
+    REQUIRE(cache.capacity() == 4);
+
+    for (uint64_t key = 1; key <= 16; ++key)
+    {
+        REQUIRE(cache.insert(key, "test" + std::to_string(key)));
+        REQUIRE(cache.size() == std::min(key, uint64_t{4}));
+    }
+
+    REQUIRE(cache.capacity() == 4);
+}
+
+TEST_CASE("ClockPro capacity 1")
+{
+    clockpro_cache<int, int> cache{1};
+
+    // The only page is promoted to hot, the next insert must still be able to evict it.
+    REQUIRE(cache.insert(1, 1));
+    REQUIRE(cache.find(1).value() == 1);
+    REQUIRE(cache.insert(2, 2));
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.find(2).value() == 2);
+    REQUIRE_FALSE(cache.find(1).has_value());
+
+    // Key 1 is a test page and comes back as a hot page.
+    REQUIRE(cache.insert(1, 1));
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.find(1).value() == 1);
+    REQUIRE(cache.insert(3, 3));
+    REQUIRE(cache.find(3).value() == 3);
+    REQUIRE(cache.size() == 1);
+}
+
+TEST_CASE("ClockPro small capacities random operations")
+{
+    for (size_t capacity = 1; capacity <= 4; ++capacity)
+    {
+        clockpro_cache<uint64_t, uint64_t, thread_safe::no> cache{capacity};
+
+        uint64_t state{capacity};
+        for (size_t i = 0; i < 10'000; ++i)
+        {
+            state         = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            uint64_t key  = (state >> 33) % (capacity * 3);
+            switch ((state >> 60) % 4)
+            {
+                case 0:
+                case 1:
+                    REQUIRE(cache.insert(key, key));
+                    REQUIRE(cache.find(key).value() == key);
+                    break;
+                case 2:
+                {
+                    auto value = cache.find(key);
+                    REQUIRE((!value.has_value() || value.value() == key));
+                }
+                break;
+                case 3:
+                    cache.erase(key);
+                    REQUIRE_FALSE(cache.find(key).has_value());
+                    break;
+            }
+            REQUIRE(cache.size() <= capacity);
+        }
+    }
+}
+
+TEST_CASE("ClockPro evicted keys that come back are promoted")
+{
+    clockpro_cache<uint64_t, uint64_t> cache{4};
+
+    for (uint64_t key = 1; key <= 4; ++key)
+    {
+        cache.insert(key, key);
+    }
+
+    // Key 5 evicts an unreferenced cold page which is remembered as a test page.
+    cache.insert(5, 5);
+    uint64_t evicted{0};
+    for (uint64_t key = 1; key <= 4; ++key)
+    {
+        if (!cache.find(key).has_value())
+        {
+            evicted = key;
+        }
+    }
+    REQUIRE(evicted != 0);
+
+    // A test page is not a member of the cache.
+    REQUIRE_FALSE(cache.erase(evicted + 100));
+    REQUIRE(cache.size() == 4);
+
+    // Re-inserting it is allowed as an insert and not as an update.
+    REQUIRE_FALSE(cache.insert(evicted, evicted, allow::update));
+    REQUIRE(cache.insert(evicted, evicted, allow::insert));
+    REQUIRE(cache.find(evicted).value() == evicted);
+    REQUIRE(cache.size() == 4);
+}
+
+TEST_CASE("ClockPro is scan resistant")
+{
+    clockpro_cache<uint64_t, uint64_t, thread_safe::no> clockpro{100};
+    lru_cache<uint64_t, uint64_t, thread_safe::no>      lru{100};
+
+    size_t   clockpro_hits{0};
+    size_t   lru_hits{0};
+    uint64_t scan_key{1'000'000};
+    for (size_t round = 0; round < 100; ++round)
+    {
+        // A small hot set re-used every round followed by a scan larger than the cache.
+        std::vector<uint64_t> keys{};
+        for (uint64_t hot = 0; hot < 50; ++hot)
+        {
+            keys.push_back(hot);
+        }
+        for (size_t i = 0; i < 150; ++i)
+        {
+            keys.push_back(scan_key++);
+        }
+
+        for (auto key : keys)
+        {
+            if (clockpro.find(key).has_value())
+            {
+                ++clockpro_hits;
+            }
+            else
+            {
+                clockpro.insert(key, key);
+            }
+
+            if (lru.find(key).has_value())
+            {
+                ++lru_hits;
+            }
+            else
+            {
+                lru.insert(key, key);
+            }
+        }
+    }
+
+    REQUIRE(lru_hits == 0);
+    REQUIRE(clockpro_hits > 50 * 100 / 2);
+}
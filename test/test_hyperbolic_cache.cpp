@@ -0,0 +1,190 @@
+#include "catch.hpp"
+#include <cappuccino/cappuccino.hpp>
+
+using namespace cappuccino;
+
+TEST_CASE("Hyperbolic example")
+{
+    // Create a cache with 2 items.
+    hyperbolic_cache<uint64_t, std::string> cache{2};
+
+    // Insert hello and world.
+    cache.insert(1, "Hello");
+    cache.insert(2, "World");
+
+    {
+        // Grab hello twice, it now has the higher hits per age.
+        REQUIRE(cache.find(1).value() == "Hello");
+        REQUIRE(cache.find(1).value() == "Hello");
+    }
+
+    // Insert hola, this will evict "World" since it has the lowest priority.
+    cache.insert(3, "Hola");
+
+    {
+        auto hola  = cache.find(3);
+        auto hello = cache.find(1);
+        auto world = cache.find(2);
+
+        REQUIRE(hola.has_value());
+        REQUIRE(hola.value() == "Hola");
+        REQUIRE(hello.has_value());
+        REQUIRE(hello.value() == "Hello");
+        REQUIRE_FALSE(world.has_value());
+    }
+}
+
+TEST_CASE("Hyperbolic Find doesn't exist")
+{
+    hyperbolic_cache<uint64_t, std::string> cache{4};
+    REQUIRE_FALSE(cache.find(100).has_value());
+}
+
+TEST_CASE("Hyperbolic Insert Only")
+{
+    hyperbolic_cache<uint64_t, std::string> cache{4};
+
+    REQUIRE(cache.insert(1, "test", allow::insert));
+    auto value = cache.find(1);
+    REQUIRE(value.has_value());
+    REQUIRE(value.value() == "test");
+
+    REQUIRE_FALSE(cache.insert(1, "test2", allow::insert));
+    value = cache.find(1);
+    REQUIRE(value.has_value());
+    REQUIRE(value.value() == "test");
+}
+
+TEST_CASE("Hyperbolic Update Only")
+{
+    hyperbolic_cache<uint64_t, std::string> cache{4};
+
+    REQUIRE_FALSE(cache.insert(1, "test", allow::update));
+    REQUIRE_FALSE(cache.find(1).has_value());
+
+    REQUIRE(cache.insert(1, "test"));
+    REQUIRE(cache.insert(1, "test2", allow::update));
+    REQUIRE(cache.find(1).value() == "test2");
+}
+
+TEST_CASE("Hyperbolic insert_range + erase_range")
+{
+    hyperbolic_cache<uint64_t, std::string> cache{4};
+
+    {
+        std::vector<std::pair<uint64_t, std::string>> inserts{{1, "test1"}, {2, "test2"}, {3, "test3"}};
+
+        auto inserted = cache.insert_range(std::move(inserts));
+        REQUIRE(inserted == 3);
+    }
+
+    REQUIRE(cache.size() == 3);
+
+    {
+        std::vector<uint64_t> delete_keys{1, 3, 4, 5};
+
+        auto deleted = cache.erase_range(delete_keys);
+        REQUIRE(deleted == 2);
+    }
+
+    REQUIRE(cache.size() == 1);
+    REQUIRE_FALSE(cache.find(1).has_value());
+    REQUIRE(cache.find(2).has_value());
+    REQUIRE(cache.find(2).value() == "test2");
+    REQUIRE_FALSE(cache.find(3).has_value());
+
+    REQUIRE(cache.erase(2));
+    REQUIRE(cache.empty());
+    REQUIRE_FALSE(cache.erase(2));
+}
+
+TEST_CASE("Hyperbolic find_range + find_range_fill")
+{
+    hyperbolic_cache<uint64_t, std::string> cache{4};
+
+    {
+        std::vector<std::pair<uint64_t, std::string>> inserts{{1, "test1"}, {2, "test2"}, {3, "test3"}};
+        cache.insert_range(std::move(inserts));
+    }
+
+    auto found = cache.find_range(std::vector<uint64_t>{2, 5});
+    REQUIRE(found[0].first == 2);
+    REQUIRE(found[0].second.value() == "test2");
+    REQUIRE(found[1].first == 5);
+    REQUIRE_FALSE(found[1].second.has_value());
+
+    std::vector<std::pair<uint64_t, std::optional<std::string>>> items{
+        {1, std::nullopt},
+        {3, std::nullopt},
+        {4, std::nullopt},
+    };
+    cache.find_range_fill(items);
+
+    REQUIRE(items[0].second.value() == "test1");
+    REQUIRE(items[1].second.value() == "test3");
+    REQUIRE_FALSE(items[2].second.has_value());
+}
+
+TEST_CASE("Hyperbolic size + capacity")
+{
+    hyperbolic_cache<uint64_t, std::string> cache{4, 2};
+
+    REQUIRE(cache.capacity() == 4);
+    REQUIRE(cache.sample_size() == 2);
+
+    for (uint64_t key = 1; key <= 64; ++key)
+    {
+        REQUIRE(cache.insert(key, "test" + std::to_string(key)));
+        REQUIRE(cache.size() == std::min(key, uint64_t{4}));
+    }
+
+    // Every key still in the cache must be reachable.
+    size_t count{0};
+    for (uint64_t key = 1; key <= 64; ++key)
+    {
+        count += cache.find(key).has_value() ? 1 : 0;
+    }
+    REQUIRE(count == 4);
+}
+
+TEST_CASE("Hyperbolic old popularity decays")
+{
+    hyperbolic_cache<uint64_t, uint64_t> cache{2};
+
+    // Key 1 is very popular early on.
+    cache.insert(1, 1);
+    for (size_t i = 0; i < 50; ++i)
+    {
+        cache.find(1);
+    }
+
+    // Key 2 is less popular in total but recently.
+    cache.insert(2, 2);
+    for (size_t i = 0; i < 20; ++i)
+    {
+        cache.find(2);
+    }
+
+    // An lfu cache would evict key 2, its hits per age are higher though.
+    cache.insert(3, 3);
+    REQUIRE_FALSE(cache.find(1).has_value());
+    REQUIRE(cache.find(2).has_value());
+    REQUIRE(cache.find(3).has_value());
+}
+
+TEST_CASE("Hyperbolic cost weighted")
+{
+    hyperbolic_cache<uint64_t, uint64_t> cache{2};
+
+    REQUIRE(cache.insert_weighted(1, 1, 10.0));
+    REQUIRE(cache.insert(2, 2));
+
+    // Both keys have the same hits, the expensive key 1 stays.
+    cache.insert(3, 3);
+    REQUIRE(cache.find(1).has_value());
+    REQUIRE_FALSE(cache.find(2).has_value());
+    REQUIRE(cache.find(3).has_value());
+
+    REQUIRE_FALSE(cache.insert_weighted(1, 1, 1.0, allow::insert));
+    REQUIRE(cache.insert_weighted(1, 1, 1.0, allow::update));
+}
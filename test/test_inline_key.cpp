@@ -0,0 +1,85 @@
+#include "catch.hpp"
+#include <cappuccino/cappuccino.hpp>
+
+#include <chrono>
+#include <unordered_set>
+
+using namespace cappuccino;
+using namespace std::chrono_literals;
+
+TEST_CASE("Inline key basics")
+{
+    inline_key<48> key{"user:1234:session:abcdef0123456789"};
+    REQUIRE(key.size() == 34);
+    REQUIRE(key.view() == "user:1234:session:abcdef0123456789");
+    REQUIRE(key.str() == "user:1234:session:abcdef0123456789");
+    REQUIRE(key.hash() == std::hash<std::string_view>{}("user:1234:session:abcdef0123456789"));
+    REQUIRE(std::hash<inline_key<48>>{}(key) == key.hash());
+    REQUIRE(inline_key<48>::capacity() == 48);
+
+    REQUIRE(key == inline_key<48>{std::string{"user:1234:session:abcdef0123456789"}});
+    REQUIRE(key != inline_key<48>{"user:1234:session:abcdef0123456780"});
+    REQUIRE(key != inline_key<48>{"user:1234:session"});
+    REQUIRE(inline_key<48>{"a"} < inline_key<48>{"b"});
+
+    inline_key<48> empty{};
+    REQUIRE(empty.empty());
+    REQUIRE(empty == inline_key<48>{""});
+
+    // An embedded zero byte is part of the key, not the end of it.
+    using namespace std::string_view_literals;
+    REQUIRE(inline_key<8>{"ab\0"sv} != inline_key<8>{"ab"sv});
+}
+
+TEST_CASE("Inline key rejects keys longer than its capacity")
+{
+    REQUIRE(inline_key<4>::fits("abcd"));
+    REQUIRE_FALSE(inline_key<4>::fits("abcde"));
+
+    REQUIRE(inline_key<4>{"abcd"}.view() == "abcd");
+    // Truncating would make "abcdef" and "abcdxy" the same key.
+    REQUIRE_THROWS_AS(inline_key<4>{"abcdef"}, std::length_error);
+    REQUIRE_THROWS_AS(inline_key<4>{std::string{"abcdxy"}}, std::length_error);
+    REQUIRE_FALSE(std::is_convertible_v<std::string, inline_key<4>>);
+    REQUIRE_FALSE(std::is_convertible_v<const char*, inline_key<4>>);
+}
+
+TEST_CASE("Inline key unordered_set")
+{
+    std::unordered_set<inline_key<32>> keys{};
+    REQUIRE(keys.emplace("tenant-a/object-00000000000001").second);
+    REQUIRE(keys.emplace("tenant-a/object-00000000000002").second);
+    REQUIRE_FALSE(keys.emplace("tenant-a/object-00000000000001").second);
+    REQUIRE(keys.count(inline_key<32>{"tenant-a/object-00000000000002"}) == 1);
+    REQUIRE(keys.count(inline_key<32>{"tenant-a/object-00000000000003"}) == 0);
+}
+
+TEST_CASE("Inline key lru_cache")
+{
+    using key = inline_key<48>;
+    lru_cache<key, uint64_t> cache{2};
+
+    REQUIRE(cache.insert(key{"device/0b6c2f0e-7c4b-4a53-9f11-000000000001"}, 1));
+    REQUIRE(cache.insert(key{"device/0b6c2f0e-7c4b-4a53-9f11-000000000002"}, 2));
+    REQUIRE(cache.find(key{"device/0b6c2f0e-7c4b-4a53-9f11-000000000001"}).value() == 1);
+
+    // Evicts the least recently used second key.
+    REQUIRE(cache.insert(key{"device/0b6c2f0e-7c4b-4a53-9f11-000000000003"}, 3));
+    REQUIRE_FALSE(cache.find(key{"device/0b6c2f0e-7c4b-4a53-9f11-000000000002"}).has_value());
+    REQUIRE(cache.find(key{"device/0b6c2f0e-7c4b-4a53-9f11-000000000003"}).value() == 3);
+
+    REQUIRE(cache.erase(key{"device/0b6c2f0e-7c4b-4a53-9f11-000000000001"}));
+    REQUIRE(cache.size() == 1);
+}
+
+TEST_CASE("Inline key tlru_cache")
+{
+    using key = inline_key<48>;
+    tlru_cache<key, std::string> cache{4};
+
+    REQUIRE(cache.insert(1h, key{"session/000000000000000000000000000000000001"}, "alice"));
+    REQUIRE(cache.insert(1h, key{"session/000000000000000000000000000000000002"}, "bob"));
+    REQUIRE(cache.find(key{"session/000000000000000000000000000000000001"}).value() == "alice");
+    REQUIRE(cache.find(key{"session/000000000000000000000000000000000002"}).value() == "bob");
+    REQUIRE_FALSE(cache.find(key{"session/000000000000000000000000000000000003"}).has_value());
+}
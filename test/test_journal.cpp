@@ -0,0 +1,269 @@
+#include "catch.hpp"
+#include <cappuccino/cappuccino.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+using namespace cappuccino;
+using namespace std::chrono_literals;
+
+static auto journal_path(const std::string& name) -> std::string
+{
+    auto path = (std::filesystem::temp_directory_path() / ("cappuccino_" + name + ".journal")).string();
+    for (const auto& file : {path, path + ".snapshot", path + ".pending"})
+    {
+        std::remove(file.c_str());
+    }
+    return path;
+}
+
+static auto remove_journal(const std::string& path) -> void
+{
+    for (const auto& file : {path, path + ".snapshot", path + ".pending"})
+    {
+        std::remove(file.c_str());
+    }
+}
+
+TEST_CASE("Journal example")
+{
+    auto path = journal_path("example");
+
+    {
+        tlru_cache<uint64_t, std::string> cache{16};
+        journal<uint64_t, std::string>    j{path};
+        REQUIRE(j.is_open());
+        cache.set_mutation_sink(&j);
+
+        cache.insert(1h, 1, "one");
+        cache.insert(1h, 2, "two");
+        cache.insert(1h, 3, "three");
+        cache.insert(1h, 2, "deux");
+        cache.erase(3);
+        cache.touch(1, 2h);
+        cache.insert(1ms, 4, "expires");
+
+        cache.set_mutation_sink(nullptr);
+        // The journal commits everything on destruction.
+    }
+
+    std::vector<journal_op> ops{};
+    REQUIRE(journal<uint64_t, std::string>::read(path, [&](const auto& record) { ops.push_back(record.op); }) == 7);
+    REQUIRE(
+        ops ==
+        std::vector<journal_op>{
+            journal_op::insert,
+            journal_op::insert,
+            journal_op::insert,
+            journal_op::insert,
+            journal_op::erase,
+            journal_op::touch,
+            journal_op::insert});
+
+    std::this_thread::sleep_for(5ms);
+    tlru_cache<uint64_t, std::string> recovered{16};
+    REQUIRE(journal<uint64_t, std::string>::replay(path, recovered) == 7);
+    REQUIRE(recovered.size() == 2);
+    REQUIRE(recovered.find(1).value() == "one");
+    REQUIRE(recovered.find(2).value() == "deux");
+    REQUIRE_FALSE(recovered.find(3).has_value());
+    REQUIRE_FALSE(recovered.find(4).has_value());
+
+    remove_journal(path);
+}
+
+TEST_CASE("Journal flush and sequence order across threads")
+{
+    auto path = journal_path("threads");
+
+    tlru_cache<uint64_t, uint64_t> cache{10'000};
+    journal<uint64_t, uint64_t>    j{path, 1ms, journal_sync::yes};
+    cache.set_mutation_sink(&j);
+
+    std::vector<std::thread> threads{};
+    for (uint64_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            for (uint64_t i = 0; i < 1000; ++i)
+            {
+                cache.insert(1h, t * 1000 + i, i);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    REQUIRE(j.flush());
+
+    uint64_t expected_sequence{1};
+    bool     in_order{true};
+    auto     count = journal<uint64_t, uint64_t>::read(path, [&](const auto& record) {
+        in_order = in_order && record.sequence == expected_sequence++;
+    });
+    REQUIRE(count == 4000);
+    REQUIRE(in_order);
+
+    tlru_cache<uint64_t, uint64_t> recovered{10'000};
+    journal<uint64_t, uint64_t>::replay(path, recovered);
+    REQUIRE(recovered.size() == 4000);
+    REQUIRE(recovered.find(3999).value() == 999);
+
+    cache.set_mutation_sink(nullptr);
+    remove_journal(path);
+}
+
+TEST_CASE("Journal compact")
+{
+    auto path = journal_path("compact");
+
+    tlru_cache<uint64_t, uint64_t> cache{128};
+    {
+        journal<uint64_t, uint64_t> j{path};
+        cache.set_mutation_sink(&j);
+
+        for (uint64_t i = 0; i < 100; ++i)
+        {
+            cache.insert(1h, i % 10, i);
+        }
+
+        REQUIRE(j.compact(cache, 4));
+        REQUIRE(std::filesystem::exists(path + ".snapshot"));
+        REQUIRE_FALSE(std::filesystem::exists(path + ".pending"));
+        // The snapshot holds one record per live key, the journal was emptied.
+        REQUIRE(journal<uint64_t, uint64_t>::read(path + ".snapshot", [](const auto&) {}) == 10);
+        REQUIRE(std::filesystem::file_size(path) == 0);
+
+        cache.insert(1h, 20, 20);
+        cache.erase(0);
+        cache.set_mutation_sink(nullptr);
+    }
+
+    tlru_cache<uint64_t, uint64_t> recovered{128};
+    journal<uint64_t, uint64_t>::replay(path, recovered);
+    REQUIRE(recovered.size() == cache.size());
+    for (uint64_t k = 0; k < 21; ++k)
+    {
+        REQUIRE(recovered.find(k, peek::yes) == cache.find(k, peek::yes));
+    }
+
+    remove_journal(path);
+}
+
+#if defined(__linux__)
+TEST_CASE("Journal write errors are sticky")
+{
+    // Every write to /dev/full fails with ENOSPC.
+    tlru_cache<uint64_t, uint64_t> cache{16};
+    journal<uint64_t, uint64_t>    j{"/dev/full", 1h, journal_sync::yes};
+    REQUIRE(j.is_open());
+    REQUIRE(j.flush());
+    cache.set_mutation_sink(&j);
+
+    cache.insert(1h, 1, 1);
+    REQUIRE_FALSE(j.flush());
+    // Nothing new to write, the journal still reports the lost record.
+    REQUIRE_FALSE(j.flush());
+
+    cache.set_mutation_sink(nullptr);
+}
+#endif
+
+TEST_CASE("Journal replay stops at a torn record")
+{
+    auto path = journal_path("torn");
+
+    {
+        tlru_cache<std::string, std::string> cache{16};
+        journal<std::string, std::string>    j{path};
+        cache.set_mutation_sink(&j);
+        cache.insert(1h, "a", "1");
+        cache.insert(1h, "b", "2");
+        cache.set_mutation_sink(nullptr);
+    }
+
+    // Cut the last record in half as a crash in the middle of a write would.
+    auto size = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, size - 3);
+
+    tlru_cache<std::string, std::string> recovered{16};
+    REQUIRE(journal<std::string, std::string>::replay(path, recovered) == 1);
+    REQUIRE(recovered.find("a").value() == "1");
+    REQUIRE_FALSE(recovered.find("b").has_value());
+
+    // A corrupt record is rejected by its checksum, flip a byte in the first record's body.
+    {
+        std::fstream file{path, std::ios::in | std::ios::out | std::ios::binary};
+        file.seekp(12);
+        file.put('x');
+    }
+    tlru_cache<std::string, std::string> corrupt{16};
+    REQUIRE(journal<std::string, std::string>::replay(path, corrupt) == 0);
+
+    remove_journal(path);
+}
+
+TEST_CASE("Journal records that never expire")
+{
+    auto path = journal_path("never_expires");
+
+    {
+        journal<uint64_t, std::string> j{path};
+        j.append_insert(1, "forever", std::chrono::steady_clock::time_point::max());
+        j.append_insert(2, "expires", std::chrono::steady_clock::now() + 1ms);
+        j.append_touch(3, std::chrono::steady_clock::time_point::max());
+    }
+
+    std::vector<bool> never{};
+    REQUIRE(journal<uint64_t, std::string>::read(path, [&](const auto& record) {
+                never.push_back(record.expire_time == std::chrono::system_clock::time_point::max());
+            }) == 3);
+    REQUIRE(never == std::vector<bool>{true, false, true});
+
+    std::this_thread::sleep_for(5ms);
+    tlru_cache<uint64_t, std::string> recovered{16};
+    REQUIRE(journal<uint64_t, std::string>::replay(path, recovered) == 3);
+    REQUIRE(recovered.size() == 1);
+    REQUIRE(recovered.find(1).value() == "forever");
+    REQUIRE_FALSE(recovered.find(2).has_value());
+
+    remove_journal(path);
+}
+
+TEST_CASE("Journal lru_cache round trip")
+{
+    auto path = journal_path("lru");
+
+    {
+        lru_cache<uint64_t, std::string> cache{16};
+        journal<uint64_t, std::string>   j{path};
+        cache.set_mutation_sink(&j);
+
+        cache.insert(1, "one");
+        cache.insert(2, "two");
+        cache.insert(3, "three");
+        cache.insert(2, "deux");
+        cache.erase(3);
+
+        cache.set_mutation_sink(nullptr);
+    }
+
+    // Every lru insert and update never expires.
+    size_t never{0};
+    REQUIRE(journal<uint64_t, std::string>::read(path, [&](const auto& record) {
+                never += (record.expire_time == std::chrono::system_clock::time_point::max()) ? 1 : 0;
+            }) == 5);
+    REQUIRE(never == 4);
+
+    lru_cache<uint64_t, std::string> recovered{16};
+    REQUIRE(journal<uint64_t, std::string>::replay(path, recovered) == 5);
+    REQUIRE(recovered.size() == 2);
+    REQUIRE(recovered.find(1).value() == "one");
+    REQUIRE(recovered.find(2).value() == "deux");
+    REQUIRE_FALSE(recovered.find(3).has_value());
+
+    remove_journal(path);
+}
@@ -411,4 +411,24 @@ TEST_CASE("Lfuda size + capacity")
     REQUIRE(cache.size() == 4);
 
     REQUIRE(cache.capacity() == 4);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Lfuda coarse timestamps")
+{
+    lfuda_cache<uint64_t, std::string, thread_safe::no, coarse_timestamp<>> cache{2, 10ms, 0.5f};
+
+    cache.insert(1, "Hello");
+    cache.insert(2, "World");
+    for (size_t i = 1; i < 20; ++i)
+    {
+        cache.find(1);
+    }
+
+    // Nothing is old enough yet.
+    REQUIRE(cache.dynamically_age() == 0);
+
+    std::this_thread::sleep_for(50ms);
+    REQUIRE(cache.dynamically_age() == 2);
+    REQUIRE(cache.find_with_use_count(1).value().second == 11); // dynamic age 20 => 10 + 1 find
+    REQUIRE(cache.find_with_use_count(2).value().second == 1);  // dynamic age 1 => 0 + 1 find
+}
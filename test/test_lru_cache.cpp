@@ -1,7 +1,12 @@
 #include "catch.hpp"
 #include <cappuccino/cappuccino.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 using namespace cappuccino;
+using namespace std::chrono_literals;
 
 TEST_CASE("Lru example")
 {
@@ -395,4 +400,354 @@ TEST_CASE("Lru Find with peek")
     REQUIRE_FALSE(cache.find(1).has_value());
     REQUIRE(cache.insert(6, "another one bites the dust2"));
     REQUIRE_FALSE(cache.find(3).has_value());
-}
\ No newline at end of file
+}
+
+TEST_CASE("Lru eviction stats")
+{
+    lru_cache<uint64_t, uint64_t> cache{2};
+
+    // Nothing is recorded until enabled.
+    cache.insert(1, 1);
+    cache.insert(2, 2);
+    cache.insert(3, 3);
+    REQUIRE(cache.eviction_stats().residency_us().count() == 0);
+
+    cache.enable_eviction_stats();
+
+    // 2 is found twice, peeks are not counted.
+    REQUIRE(cache.find(2).has_value());
+    REQUIRE(cache.find(2).has_value());
+    REQUIRE(cache.find(2, peek::yes).has_value());
+    // 3 is evicted with no hits.
+    cache.insert(4, 4);
+    // 2 is evicted with its hits.
+    cache.insert(5, 5);
+    // Explicit erases are not evictions.
+    REQUIRE(cache.erase(4));
+
+    auto stats = cache.eviction_stats(true);
+    REQUIRE(stats.residency_us().count() == 2);
+    REQUIRE(stats.idle_us().count() == 2);
+    REQUIRE(stats.hits_before_eviction().count() == 2);
+    REQUIRE(stats.hits_before_eviction().bucket(0) == 1);
+    REQUIRE(stats.hits_before_eviction().bucket(2) == 1);
+
+    REQUIRE(cache.eviction_stats().residency_us().count() == 0);
+}
+
+TEST_CASE("Lru compact index")
+{
+    lru_cache<uint64_t, std::string, thread_safe::no, uint32_t> cache{3};
+
+    REQUIRE(cache.insert(1, "test1"));
+    REQUIRE(cache.insert(2, "test2"));
+    REQUIRE(cache.insert(3, "test3"));
+
+    // 1 is now the most recently used, 2 is the least.
+    REQUIRE(cache.find(1).has_value());
+    REQUIRE(cache.insert(4, "test4"));
+    REQUIRE_FALSE(cache.find(2).has_value());
+
+    // An erased slot is reused without evicting.
+    REQUIRE(cache.erase(3));
+    REQUIRE(cache.insert(5, "test5"));
+    REQUIRE(cache.size() == 3);
+    REQUIRE(cache.find(1).value() == "test1");
+    REQUIRE(cache.find(4).value() == "test4");
+    REQUIRE(cache.find(5).value() == "test5");
+
+    // Cycle through every slot a few times.
+    for (uint64_t key = 10; key < 100; ++key)
+    {
+        REQUIRE(cache.insert(key, "test"));
+    }
+    REQUIRE(cache.size() == 3);
+    REQUIRE(cache.find(97).has_value());
+    REQUIRE(cache.find(98).has_value());
+    REQUIRE(cache.find(99).has_value());
+}
+
+TEST_CASE("Lru compact index capacity is capped")
+{
+    lru_cache<uint64_t, uint64_t, thread_safe::no, uint8_t> cache{1000};
+    REQUIRE(cache.capacity() == 255);
+
+    for (uint64_t key = 0; key < 1000; ++key)
+    {
+        cache.insert(key, key);
+    }
+    REQUIRE(cache.size() == 255);
+    REQUIRE(cache.find(999).has_value());
+    REQUIRE_FALSE(cache.find(744).has_value());
+    REQUIRE(cache.find(745).has_value());
+}
+
+TEST_CASE("Lru eviction watermarks")
+{
+    lru_cache<uint64_t, uint64_t> cache{10};
+    cache.set_eviction_watermarks(8, 5);
+
+    for (uint64_t key = 0; key < 10; ++key)
+    {
+        REQUIRE(cache.insert(key, key));
+    }
+    REQUIRE(cache.size() == 10);
+
+    // Inserting into the full cache evicts the 5 least recently used at once.
+    REQUIRE(cache.insert(10, 10));
+    REQUIRE(cache.size() == 6);
+    for (uint64_t key = 0; key < 5; ++key)
+    {
+        REQUIRE_FALSE(cache.find(key).has_value());
+    }
+    for (uint64_t key = 5; key <= 10; ++key)
+    {
+        REQUIRE(cache.find(key).has_value());
+    }
+
+    // Below the high watermark prune() has nothing to do.
+    REQUIRE(cache.prune() == 0);
+    REQUIRE(cache.insert(11, 11));
+    REQUIRE(cache.insert(12, 12));
+    REQUIRE(cache.size() == 8);
+
+    // Keep 12 and 5 recently used, prune() evicts down to the low watermark.
+    REQUIRE(cache.find(5).has_value());
+    REQUIRE(cache.prune() == 3);
+    REQUIRE(cache.size() == 5);
+    REQUIRE(cache.find(5).has_value());
+    REQUIRE(cache.find(12).has_value());
+    REQUIRE_FALSE(cache.find(6).has_value());
+}
+
+TEST_CASE("Lru eviction watermarks are capped")
+{
+    lru_cache<uint64_t, uint64_t> cache{4};
+
+    // The low watermark must leave room for the insert that triggered the eviction.
+    cache.set_eviction_watermarks(100, 100);
+    for (uint64_t key = 0; key < 5; ++key)
+    {
+        REQUIRE(cache.insert(key, key));
+    }
+    REQUIRE(cache.size() == 4);
+    REQUIRE_FALSE(cache.find(0).has_value());
+    REQUIRE(cache.prune() == 1);
+    REQUIRE(cache.size() == 3);
+
+    // Everything is evicted with a zero low watermark.
+    cache.set_eviction_watermarks(2, 0);
+    REQUIRE(cache.prune() == 3);
+    REQUIRE(cache.empty());
+}
+
+TEST_CASE("Lru with_lock")
+{
+    lru_cache<uint64_t, std::string> cache{4};
+    REQUIRE(cache.insert(1, "one"));
+    REQUIRE(cache.insert(2, "two"));
+
+    // Move the value of 1 to 3 and drop 2 under a single lock acquisition.
+    auto moved = cache.with_lock([](auto& view) {
+        auto value = view.find(1);
+        if (!value.has_value())
+        {
+            return false;
+        }
+        view.erase(1);
+        view.erase(2);
+        return view.insert(3, std::move(value.value()));
+    });
+
+    REQUIRE(moved);
+    REQUIRE(cache.size() == 1);
+    REQUIRE_FALSE(cache.find(1).has_value());
+    REQUIRE_FALSE(cache.find(2).has_value());
+    REQUIRE(cache.find(3).value() == "one");
+
+    // A void functor and the read only parts of the view.
+    cache.with_lock([](auto& view) {
+        REQUIRE(view.size() == 1);
+        REQUIRE(view.capacity() == 4);
+        REQUIRE_FALSE(view.empty());
+        REQUIRE_FALSE(view.insert(4, "four", allow::update));
+        REQUIRE(view.find(4, peek::yes) == std::nullopt);
+    });
+}
+
+TEST_CASE("Lru with_lock for_each")
+{
+    lru_cache<uint64_t, std::string> cache{4};
+    cache.insert(1, "one");
+    cache.insert(2, "two");
+    cache.insert(3, "three");
+    REQUIRE(cache.find(1).has_value());
+
+    // Most to least recently used.
+    std::vector<uint64_t> keys{};
+    cache.with_lock([&](auto& view) {
+        view.for_each([&](const uint64_t& key, const std::string& value) {
+            REQUIRE_FALSE(value.empty());
+            keys.push_back(key);
+        });
+    });
+    REQUIRE(keys == std::vector<uint64_t>{1, 3, 2});
+}
+
+TEST_CASE("Lru with_lock for_each_slot")
+{
+    lru_cache<uint64_t, uint64_t> cache{8};
+    for (uint64_t i = 0; i < 8; ++i)
+    {
+        cache.insert(i, i);
+    }
+    cache.erase(3);
+    cache.erase(5);
+
+    // Walk in chunks of 3 slots, a pair that stays in the cache keeps its slot between them.
+    std::vector<uint64_t> keys{};
+    size_t                slot{0};
+    while (slot < cache.capacity())
+    {
+        slot = cache.with_lock([&](auto& view) {
+            return view.for_each_slot(slot, 3, [&](const uint64_t& key, const uint64_t& value) {
+                REQUIRE(key == value);
+                keys.push_back(key);
+            });
+        });
+        REQUIRE(cache.find(0).has_value());
+    }
+    REQUIRE(slot == 8);
+    std::sort(keys.begin(), keys.end());
+    REQUIRE(keys == std::vector<uint64_t>{0, 1, 2, 4, 6, 7});
+}
+
+TEST_CASE("Lru with_lock is atomic")
+{
+    // Two counters are moved between under the lock, their sum must always be seen as constant.
+    lru_cache<uint64_t, uint64_t> cache{2};
+    cache.insert(0, 1000);
+    cache.insert(1, 0);
+
+    std::atomic<bool> done{false};
+    std::thread       mover{[&]() {
+        for (size_t i = 0; i < 10000; ++i)
+        {
+            cache.with_lock([i](auto& view) {
+                uint64_t from = i % 2;
+                uint64_t to   = 1 - from;
+                auto     a    = view.find(from).value();
+                auto     b    = view.find(to).value();
+                view.insert(from, a - 1);
+                view.insert(to, b + 1);
+            });
+        }
+        done = true;
+    }};
+
+    while (!done)
+    {
+        auto sum = cache.with_lock([](auto& view) { return view.find(0).value() + view.find(1).value(); });
+        REQUIRE(sum == 1000);
+    }
+    mover.join();
+}
+
+namespace
+{
+struct bad_key
+{
+    uint64_t m_id;
+    auto     operator==(const bad_key& other) const -> bool { return m_id == other.m_id; }
+};
+} // namespace
+
+template<>
+struct std::hash<bad_key>
+{
+    auto operator()(const bad_key&) const -> size_t { return 7; }
+};
+
+TEST_CASE("Lru index stats")
+{
+    lru_cache<uint64_t, uint64_t> cache{1000};
+    for (uint64_t key = 0; key < 1000; ++key)
+    {
+        cache.insert(key, key);
+    }
+
+    // Every bucket is visited when there are fewer buckets than samples.
+    auto stats = cache.index_stats(1'000'000);
+    REQUIRE(stats.m_size == 1000);
+    REQUIRE(stats.m_bucket_count >= 1000);
+    REQUIRE(stats.m_load_factor <= stats.m_max_load_factor);
+    REQUIRE(stats.m_rehash_count == 0);
+    REQUIRE(stats.m_sampled_buckets == stats.m_bucket_count);
+    REQUIRE(stats.m_sampled_elements == 1000);
+    REQUIRE(stats.m_max_chain_length <= 2);
+    REQUIRE(stats.m_average_chain_length < 1.5);
+
+    stats = cache.index_stats(16);
+    REQUIRE(stats.m_sampled_buckets == 16);
+    REQUIRE(stats.m_sampled_elements <= 32);
+
+    // A hash that maps every key to the same bucket shows up as one long chain.
+    lru_cache<bad_key, uint64_t> bad{100};
+    for (uint64_t key = 0; key < 100; ++key)
+    {
+        bad.insert(bad_key{key}, key);
+    }
+    stats = bad.index_stats(1'000'000);
+    REQUIRE(stats.m_max_chain_length == 100);
+    REQUIRE(stats.m_average_chain_length == 100.0);
+    REQUIRE(stats.m_collision_ratio == 1.0);
+}
+
+TEST_CASE("Lru try_find and try_insert")
+{
+    lru_cache<uint64_t, std::string> cache{4};
+
+    REQUIRE(cache.try_insert(1, "one") == std::pair{lock_status::acquired, true});
+    REQUIRE(cache.try_insert(1, "uno", allow::insert) == std::pair{lock_status::acquired, false});
+
+    auto [status, value] = cache.try_find(1);
+    REQUIRE(status == lock_status::acquired);
+    REQUIRE(value.value() == "one");
+
+    auto [miss_status, miss] = cache.try_find(2);
+    REQUIRE(miss_status == lock_status::acquired);
+    REQUIRE_FALSE(miss.has_value());
+
+    // Hold the lock on another thread, the try operations report contention instead of blocking.
+    std::atomic<bool> locked{false};
+    std::atomic<bool> release{false};
+    std::thread       holder{[&]() {
+        cache.with_lock([&](auto&) {
+            locked = true;
+            while (!release)
+            {
+                std::this_thread::yield();
+            }
+        });
+    }};
+    while (!locked)
+    {
+        std::this_thread::yield();
+    }
+
+    auto contended = cache.try_find(1);
+    REQUIRE(contended.first == lock_status::contended);
+    REQUIRE_FALSE(contended.second.has_value());
+    REQUIRE(cache.try_insert(2, "two").first == lock_status::contended);
+
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(cache.try_find_until(start + 5ms, 1).first == lock_status::contended);
+    REQUIRE(cache.try_insert_until(start + 5ms, 2, "two").first == lock_status::contended);
+    REQUIRE(std::chrono::steady_clock::now() - start >= 5ms);
+
+    release = true;
+    holder.join();
+
+    REQUIRE(cache.try_insert_until(std::chrono::steady_clock::now() + 5ms, 2, "two").second);
+    REQUIRE(cache.try_find_until(std::chrono::steady_clock::now() + 5ms, 2).second.value() == "two");
+}
@@ -0,0 +1,93 @@
+#include "catch.hpp"
+#include <cappuccino/cappuccino.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace cappuccino;
+using namespace std::chrono_literals;
+
+TEST_CASE("Rebuildable example")
+{
+    rebuildable<ut_map<uint64_t, std::string>> map{1h};
+    REQUIRE(map.insert(1, "stale"));
+    REQUIRE(map.insert(2, "removed at source"));
+
+    map.rebuild([](auto& fresh) {
+        fresh.insert(1, "one");
+        fresh.insert(3, "three");
+    });
+
+    REQUIRE(map.size() == 2);
+    REQUIRE(map.find(1).value() == "one");
+    REQUIRE_FALSE(map.find(2).has_value());
+    REQUIRE(map.find(3).value() == "three");
+    REQUIRE(map.erase(3));
+    REQUIRE_FALSE(map.empty());
+}
+
+TEST_CASE("Rebuildable keeps the old instance alive for its readers")
+{
+    rebuildable<lru_cache<uint64_t, uint64_t>> cache{16};
+    cache.insert(1, 1);
+
+    auto old = cache.current();
+    cache.rebuild([](auto& fresh) { fresh.insert(1, 2); });
+
+    REQUIRE(old->find(1).value() == 1);
+    REQUIRE(cache.find(1).value() == 2);
+    REQUIRE(cache.current()->capacity() == 16);
+
+    auto external = std::make_shared<lru_cache<uint64_t, uint64_t>>(4);
+    external->insert(1, 3);
+    cache.publish(external);
+    REQUIRE(cache.find(1).value() == 3);
+    cache.publish(nullptr);
+    REQUIRE(cache.find(1).value() == 3);
+}
+
+TEST_CASE("Rebuildable readers never see a partial rebuild")
+{
+    constexpr uint64_t key_count = 100;
+
+    rebuildable<utlru_cache<uint64_t, uint64_t>> cache{1h, key_count};
+    cache.rebuild([&](auto& fresh) {
+        for (uint64_t key = 0; key < key_count; ++key)
+        {
+            fresh.insert(key, 0);
+        }
+    });
+
+    std::atomic<bool> done{false};
+    std::thread       rebuilder{[&]() {
+        for (uint64_t generation = 1; generation <= 100; ++generation)
+        {
+            cache.rebuild([&](auto& fresh) {
+                for (uint64_t key = 0; key < key_count; ++key)
+                {
+                    fresh.insert(key, generation);
+                    if (key == key_count / 2)
+                    {
+                        std::this_thread::sleep_for(1ms);
+                    }
+                }
+            });
+        }
+        done = true;
+    }};
+
+    while (!done)
+    {
+        // Every key of one instance must be from the same generation.
+        auto snapshot   = cache.current();
+        auto generation = snapshot->find(0, peek::yes).value();
+        for (uint64_t key = 1; key < key_count; ++key)
+        {
+            REQUIRE(snapshot->find(key, peek::yes).value() == generation);
+        }
+    }
+    rebuilder.join();
+
+    REQUIRE(cache.find(key_count - 1).value() == 100);
+}
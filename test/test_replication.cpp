@@ -0,0 +1,219 @@
+#include "catch.hpp"
+#include <cappuccino/cappuccino.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/socket.h>
+#endif
+
+using namespace cappuccino;
+using namespace std::chrono_literals;
+
+#if defined(__unix__) || defined(__APPLE__)
+
+/**
+ * Both ends of a unix socketpair.
+ */
+static auto make_channels() -> std::pair<std::unique_ptr<fd_channel>, std::unique_ptr<fd_channel>>
+{
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    return {std::make_unique<fd_channel>(fds[0], fds[0]), std::make_unique<fd_channel>(fds[1], fds[1])};
+}
+
+template<typename primary_type, typename follower_type>
+static auto catch_up(primary_type& primary, follower_type& follower) -> bool
+{
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        if (follower.poll(10ms) == replication_status::disconnected)
+        {
+            return false;
+        }
+        if (!follower.resyncing() && follower.sequence() == primary.sequence())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * The key value pairs sorted by key, a resynced follower's recency order differs from the primary's.
+ */
+template<typename cache_type>
+static auto contents(cache_type& cache) -> std::vector<std::pair<uint64_t, std::string>>
+{
+    std::vector<std::pair<uint64_t, std::string>> output{};
+    cache.with_lock([&](auto& view) {
+        view.for_each([&](const uint64_t& key, const std::string& value) { output.emplace_back(key, value); });
+    });
+    std::sort(output.begin(), output.end());
+    return output;
+}
+
+TEST_CASE("Replication example")
+{
+    auto [primary_channel, follower_channel] = make_channels();
+
+    lru_cache<uint64_t, std::string> primary_cache{4};
+    lru_cache<uint64_t, std::string> follower_cache{4};
+
+    replication_primary<uint64_t, std::string>  primary{primary_cache, *primary_channel};
+    replication_follower<uint64_t, std::string> follower{follower_cache, *follower_channel};
+
+    primary_cache.insert(1, "one");
+    primary_cache.insert(2, "two");
+    primary_cache.insert(3, "three");
+    primary_cache.insert(2, "deux");
+    primary_cache.erase(3);
+    primary_cache.insert(4, "four");
+    primary_cache.insert(5, "five");
+    // Evicts 1, the follower evicts it too.
+    primary_cache.insert(6, "six");
+
+    REQUIRE(catch_up(primary, follower));
+    REQUIRE(primary.sequence() == 9);
+    REQUIRE(follower_cache.size() == 4);
+    REQUIRE_FALSE(follower_cache.find(1, peek::yes).has_value());
+    REQUIRE(follower_cache.find(2, peek::yes).value() == "deux");
+    REQUIRE_FALSE(follower_cache.find(3, peek::yes).has_value());
+    REQUIRE(contents(follower_cache) == contents(primary_cache));
+}
+
+TEST_CASE("Replication late follower resyncs from a snapshot")
+{
+    auto [primary_channel, follower_channel] = make_channels();
+
+    lru_cache<uint64_t, std::string>           primary_cache{64};
+    lru_cache<uint64_t, std::string>           follower_cache{64};
+    replication_primary<uint64_t, std::string> primary{primary_cache, *primary_channel};
+
+    for (uint64_t i = 0; i < 100; ++i)
+    {
+        primary_cache.insert(i, std::to_string(i));
+    }
+    // Let the first batches go out before the follower exists, it starts mid stream.
+    std::this_thread::sleep_for(20ms);
+
+    // Stale contents on the follower are replaced by the snapshot.
+    follower_cache.insert(1000, "stale");
+    replication_follower<uint64_t, std::string> follower{follower_cache, *follower_channel};
+
+    for (uint64_t i = 100; i < 120; ++i)
+    {
+        primary_cache.insert(i, std::to_string(i));
+    }
+
+    REQUIRE(catch_up(primary, follower));
+    REQUIRE_FALSE(follower_cache.find(1000, peek::yes).has_value());
+    REQUIRE(contents(follower_cache) == contents(primary_cache));
+}
+
+TEST_CASE("Replication primary over a filled cache")
+{
+    auto [primary_channel, follower_channel] = make_channels();
+
+    lru_cache<uint64_t, std::string> primary_cache{64};
+    lru_cache<uint64_t, std::string> follower_cache{64};
+    for (uint64_t i = 0; i < 50; ++i)
+    {
+        primary_cache.insert(i, std::to_string(i));
+    }
+
+    // Nothing is written after the primary starts, the follower still gets every pair.
+    replication_primary<uint64_t, std::string>  primary{primary_cache, *primary_channel};
+    replication_follower<uint64_t, std::string> follower{follower_cache, *follower_channel};
+
+    REQUIRE(catch_up(primary, follower));
+    REQUIRE(primary.sequence() == 0);
+    REQUIRE(follower_cache.size() == 50);
+    REQUIRE(contents(follower_cache) == contents(primary_cache));
+}
+
+TEST_CASE("Replication dropped batch resyncs")
+{
+    auto [primary_channel, follower_channel] = make_channels();
+
+    lru_cache<uint64_t, std::string> primary_cache{256};
+    lru_cache<uint64_t, std::string> follower_cache{256};
+
+    // A tiny pending limit and a long batch interval drop mutations before they are sent.
+    replication_primary<uint64_t, std::string>  primary{primary_cache, *primary_channel, 50ms, 64};
+    replication_follower<uint64_t, std::string> follower{follower_cache, *follower_channel};
+
+    for (uint64_t i = 0; i < 200; ++i)
+    {
+        primary_cache.insert(i, std::to_string(i));
+    }
+
+    REQUIRE(catch_up(primary, follower));
+    REQUIRE(contents(follower_cache) == contents(primary_cache));
+}
+
+TEST_CASE("Replication snapshot is chunked while the primary keeps writing")
+{
+    auto [primary_channel, follower_channel] = make_channels();
+
+    lru_cache<uint64_t, std::string> primary_cache{1000};
+    lru_cache<uint64_t, std::string> follower_cache{1000};
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        primary_cache.insert(i, std::to_string(i));
+    }
+
+    // Chunks of 16 slots so the snapshot interleaves with the writer's batches.
+    replication_primary<uint64_t, std::string>  primary{primary_cache, *primary_channel, 1ms, 64 * 1024 * 1024, 16};
+    replication_follower<uint64_t, std::string> follower{follower_cache, *follower_channel};
+
+    std::atomic<bool> done{false};
+    std::thread       writer{[&]() {
+        for (uint64_t i = 0; i < 200'000; ++i)
+        {
+            auto key = (i * 7919) % 1500;
+            if (i % 5 == 0)
+            {
+                primary_cache.erase(key);
+            }
+            else
+            {
+                primary_cache.insert(key, std::to_string(i));
+            }
+        }
+        done = true;
+    }};
+
+    // The follower never holds more than the primary, it must not evict on its own.
+    while (!done)
+    {
+        follower.poll(1ms);
+        REQUIRE(follower_cache.size() <= follower_cache.capacity());
+    }
+    writer.join();
+
+    REQUIRE(catch_up(primary, follower));
+    REQUIRE(contents(follower_cache) == contents(primary_cache));
+}
+
+TEST_CASE("Replication follower disconnected")
+{
+    auto [primary_channel, follower_channel] = make_channels();
+
+    lru_cache<uint64_t, std::string>            follower_cache{4};
+    replication_follower<uint64_t, std::string> follower{follower_cache, *follower_channel};
+
+    // A new follower waits for its first snapshot.
+    REQUIRE(follower.poll(1ms) == replication_status::resyncing);
+    REQUIRE(follower.resyncing());
+    primary_channel.reset();
+    REQUIRE(follower.poll(100ms) == replication_status::disconnected);
+}
+
+#endif
@@ -0,0 +1,209 @@
+#include "catch.hpp"
+#include <cappuccino/cappuccino.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <map>
+
+using namespace cappuccino;
+
+static auto static_table_path(const std::string& name) -> std::string
+{
+    return (std::filesystem::temp_directory_path() / ("cappuccino_" + name + ".table")).string();
+}
+
+TEST_CASE("Static table example")
+{
+    auto path = static_table_path("example");
+
+    // Build the table offline, it is immutable once written.
+    REQUIRE(static_table<uint32_t, uint64_t>::build(path, {{1, 100}, {2, 200}, {3, 300}}));
+
+    // Opening maps the file, no elements are inserted.
+    static_table<uint32_t, uint64_t> table{path};
+    REQUIRE(table.is_open());
+    REQUIRE(table.size() == 3);
+    REQUIRE_FALSE(table.empty());
+
+    REQUIRE(table.find(1).value() == 100);
+    REQUIRE(table.find(2).value() == 200);
+    REQUIRE(table.find(3).value() == 300);
+    REQUIRE_FALSE(table.find(4).has_value());
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Static table many keys")
+{
+    auto path = static_table_path("many");
+
+    std::vector<std::pair<uint64_t, uint32_t>> elements{};
+    for (uint64_t i = 0; i < 100'000; ++i)
+    {
+        elements.emplace_back(i * 7919, static_cast<uint32_t>(i));
+    }
+    REQUIRE(static_table<uint64_t, uint32_t>::build(path, elements));
+
+    static_table<uint64_t, uint32_t> table{path};
+    REQUIRE(table.is_open());
+    REQUIRE(table.size() == elements.size());
+
+    for (const auto& [key, value] : elements)
+    {
+        auto found = table.find(key);
+        REQUIRE(found.has_value());
+        REQUIRE(found.value() == value);
+    }
+
+    // Keys that were not built into the table land on some slot but are not found.
+    for (uint64_t i = 0; i < 1'000; ++i)
+    {
+        REQUIRE_FALSE(table.find(i * 7919 + 1).has_value());
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Static table power of two sizes")
+{
+    // A power of two table size keeps only the low bits of the slot hash.
+    for (uint64_t count : {uint64_t{4}, uint64_t{1024}})
+    {
+        auto path = static_table_path("power_of_two_" + std::to_string(count));
+
+        std::vector<std::pair<uint64_t, uint64_t>> elements{};
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            elements.emplace_back(i, i * 10);
+        }
+        REQUIRE(static_table<uint64_t, uint64_t>::build(path, elements));
+
+        static_table<uint64_t, uint64_t> table{path};
+        REQUIRE(table.is_open());
+        REQUIRE(table.size() == count);
+        for (const auto& [key, value] : elements)
+        {
+            REQUIRE(table.find(key).value() == value);
+        }
+        REQUIRE_FALSE(table.find(count).has_value());
+
+        std::remove(path.c_str());
+    }
+}
+
+TEST_CASE("Static table find_range")
+{
+    auto path = static_table_path("find_range");
+    REQUIRE(static_table<uint32_t, uint32_t>::build(path, {{1, 10}, {2, 20}, {3, 30}}));
+    static_table<uint32_t, uint32_t> table{path};
+    REQUIRE(table.is_open());
+
+    std::vector<uint32_t> keys{1, 2, 5};
+    auto                  found = table.find_range(keys);
+    REQUIRE(found.size() == 3);
+    REQUIRE(found[0].second.value() == 10);
+    REQUIRE(found[1].second.value() == 20);
+    REQUIRE_FALSE(found[2].second.has_value());
+
+    std::map<uint32_t, std::optional<uint32_t>> fill{{3, std::nullopt}, {4, std::nullopt}};
+    table.find_range_fill(fill);
+    REQUIRE(fill[3].value() == 30);
+    REQUIRE_FALSE(fill[4].has_value());
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Static table struct key")
+{
+    struct ip_range
+    {
+        uint32_t m_address;
+        uint32_t m_prefix;
+    };
+
+    auto path = static_table_path("struct_key");
+    REQUIRE(static_table<ip_range, uint16_t>::build(path, {{{0x0a000000, 8}, 1}, {{0x0a000000, 16}, 2}}));
+    static_table<ip_range, uint16_t> table{path};
+    REQUIRE(table.is_open());
+    REQUIRE(table.find({0x0a000000, 8}).value() == 1);
+    REQUIRE(table.find({0x0a000000, 16}).value() == 2);
+    REQUIRE_FALSE(table.find({0x0a000000, 24}).has_value());
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Static table duplicate keys fail to build")
+{
+    auto path = static_table_path("duplicate");
+    REQUIRE_FALSE(static_table<uint32_t, uint32_t>::build(path, {{1, 10}, {2, 20}, {1, 30}}));
+}
+
+TEST_CASE("Static table empty")
+{
+    auto path = static_table_path("empty");
+    REQUIRE(static_table<uint32_t, uint32_t>::build(path, {}));
+    static_table<uint32_t, uint32_t> table{path};
+    REQUIRE(table.is_open());
+    REQUIRE(table.empty());
+    REQUIRE(table.size() == 0);
+    REQUIRE_FALSE(table.find(1).has_value());
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Static table invalid files fail to open")
+{
+    static_table<uint32_t, uint32_t> missing{static_table_path("does_not_exist")};
+    REQUIRE_FALSE(missing.is_open());
+    REQUIRE_FALSE(missing.find(1).has_value());
+
+    // A table built for other key or value types is rejected.
+    auto path = static_table_path("types");
+    REQUIRE(static_table<uint64_t, uint32_t>::build(path, {{1, 10}}));
+    static_table<uint32_t, uint32_t> wrong_key{path};
+    REQUIRE_FALSE(wrong_key.is_open());
+    static_table<uint64_t, uint64_t> wrong_value{path};
+    REQUIRE_FALSE(wrong_value.is_open());
+    std::remove(path.c_str());
+
+    path = static_table_path("garbage");
+    {
+        std::ofstream out{path, std::ios::binary};
+        out << "not a static table, just some bytes that are long enough for a header";
+    }
+    static_table<uint32_t, uint32_t> garbage{path};
+    REQUIRE_FALSE(garbage.is_open());
+    std::remove(path.c_str());
+
+    // A corrupt bucket count that wraps the slots offset to the offset for a single bucket is rejected.
+    path = static_table_path("bucket_count");
+    REQUIRE(static_table<uint32_t, uint32_t>::build(path, {{1, 10}, {2, 20}}));
+    {
+        std::fstream file{path, std::ios::binary | std::ios::in | std::ios::out};
+        // The bucket count follows the magic, four uint32_t fields and the uint64_t size.
+        uint64_t bucket_count = (uint64_t{1} << 62) + 1;
+        file.seekp(8 + 4 * sizeof(uint32_t) + sizeof(uint64_t));
+        file.write(reinterpret_cast<const char*>(&bucket_count), sizeof(bucket_count));
+    }
+    static_table<uint32_t, uint32_t> corrupt{path};
+    REQUIRE_FALSE(corrupt.is_open());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Static table move")
+{
+    auto path = static_table_path("move");
+    REQUIRE(static_table<uint32_t, uint32_t>::build(path, {{1, 10}}));
+
+    static_table<uint32_t, uint32_t> table{path};
+    static_table<uint32_t, uint32_t> moved{std::move(table)};
+    REQUIRE_FALSE(table.is_open());
+    REQUIRE(moved.is_open());
+    REQUIRE(moved.find(1).value() == 10);
+
+    static_table<uint32_t, uint32_t> assigned{static_table_path("does_not_exist")};
+    assigned = std::move(moved);
+    REQUIRE(assigned.find(1).value() == 10);
+
+    std::remove(path.c_str());
+}
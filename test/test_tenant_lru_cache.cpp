@@ -0,0 +1,169 @@
+#include "catch.hpp"
+#include <cappuccino/cappuccino.hpp>
+
+using namespace cappuccino;
+
+TEST_CASE("TenantLru example")
+{
+    // Two tenants share 4 slots, each is entitled to 2.
+    tenant_lru_cache<uint64_t, std::string> cache{4, 2};
+
+    REQUIRE(cache.insert(0, 1, "a1"));
+    REQUIRE(cache.insert(0, 2, "a2"));
+    REQUIRE(cache.insert(1, 3, "b1"));
+
+    // Tenant 0 can use the free slot beyond its soft quota.
+    REQUIRE(cache.insert(0, 4, "a3"));
+    REQUIRE(cache.size() == 4);
+
+    // Tenant 1 inserting into a full cache evicts from tenant 0 since it is over its quota,
+    // even though tenant 1's element is the least recently used.
+    REQUIRE(cache.insert(1, 5, "b2"));
+    REQUIRE_FALSE(cache.find(0, 1).has_value());
+    REQUIRE(cache.find(0, 2).has_value());
+    REQUIRE(cache.find(0, 4).has_value());
+    REQUIRE(cache.find(1, 3).has_value());
+    REQUIRE(cache.find(1, 5).has_value());
+}
+
+TEST_CASE("TenantLru noisy tenant only evicts itself once over quota")
+{
+    tenant_lru_cache<uint64_t, uint64_t> cache{10, 2};
+
+    for (uint64_t i = 0; i < 5; ++i)
+    {
+        REQUIRE(cache.insert(0, i, i));
+    }
+
+    // Tenant 1 floods the cache.
+    for (uint64_t i = 100; i < 1000; ++i)
+    {
+        REQUIRE(cache.insert(1, i, i));
+    }
+
+    // Tenant 0 kept its fair share.
+    for (uint64_t i = 0; i < 5; ++i)
+    {
+        REQUIRE(cache.find(0, i).has_value());
+    }
+
+    auto noisy = cache.tenant_stats(1);
+    REQUIRE(noisy.m_size == 5);
+    REQUIRE(noisy.m_evictions == 895);
+    REQUIRE(cache.tenant_stats(0).m_evictions == 0);
+}
+
+TEST_CASE("TenantLru evicts the global lru when no tenant is over quota")
+{
+    // Generous soft quotas so that no tenant is ever over quota.
+    tenant_lru_cache<uint64_t, uint64_t> cache{4, 2};
+    cache.set_quota(0, 4);
+    cache.set_quota(1, 4);
+
+    REQUIRE(cache.insert(0, 1, 1));
+    REQUIRE(cache.insert(1, 2, 2));
+    REQUIRE(cache.insert(0, 3, 3));
+    REQUIRE(cache.insert(1, 4, 4));
+
+    // Touch tenant 0's elements, tenant 1's element 2 is now the global lru.
+    REQUIRE(cache.find(0, 1).has_value());
+    REQUIRE(cache.find(0, 3).has_value());
+
+    // Neither tenant is over quota, the global lru is evicted.
+    REQUIRE(cache.insert(0, 5, 5));
+    REQUIRE_FALSE(cache.find(1, 2).has_value());
+    REQUIRE(cache.tenant_stats(1).m_evictions == 1);
+}
+
+TEST_CASE("TenantLru hard quota")
+{
+    tenant_lru_cache<uint64_t, uint64_t> cache{10, 2};
+    cache.set_quota(0, 2, quota::hard);
+
+    REQUIRE(cache.insert(0, 1, 1));
+    REQUIRE(cache.insert(0, 2, 2));
+    // Plenty of free space but the hard quota evicts tenant 0's own lru element.
+    REQUIRE(cache.insert(0, 3, 3));
+
+    REQUIRE(cache.size() == 2);
+    REQUIRE_FALSE(cache.find(0, 1).has_value());
+    REQUIRE(cache.find(0, 2).has_value());
+    REQUIRE(cache.find(0, 3).has_value());
+
+    auto stats = cache.tenant_stats(0);
+    REQUIRE(stats.m_mode == quota::hard);
+    REQUIRE(stats.m_limit == 2);
+    REQUIRE(stats.m_evictions == 1);
+
+    // Lowering the hard quota trims immediately.
+    cache.set_quota(0, 1, quota::hard);
+    REQUIRE(cache.tenant_stats(0).m_size == 1);
+    REQUIRE(cache.find(0, 3).has_value());
+
+    // A hard quota of zero rejects every insert.
+    cache.set_quota(0, 0, quota::hard);
+    REQUIRE(cache.empty());
+    REQUIRE_FALSE(cache.insert(0, 4, 4));
+}
+
+TEST_CASE("TenantLru keys are owned by a single tenant")
+{
+    tenant_lru_cache<uint64_t, uint64_t> cache{4, 2};
+
+    REQUIRE(cache.insert(0, 1, 10));
+    REQUIRE_FALSE(cache.find(1, 1).has_value());
+    REQUIRE_FALSE(cache.insert(1, 1, 11, allow::insert));
+
+    // An update transfers ownership.
+    REQUIRE(cache.insert(1, 1, 12));
+    REQUIRE_FALSE(cache.find(0, 1).has_value());
+    REQUIRE(cache.find(1, 1).value() == 12);
+    REQUIRE(cache.tenant_stats(0).m_size == 0);
+    REQUIRE(cache.tenant_stats(1).m_size == 1);
+    REQUIRE(cache.size() == 1);
+
+    REQUIRE(cache.erase(1));
+    REQUIRE(cache.empty());
+    REQUIRE(cache.tenant_stats(1).m_size == 0);
+}
+
+TEST_CASE("TenantLru hit and miss stats")
+{
+    tenant_lru_cache<uint64_t, uint64_t> cache{4, 2};
+
+    REQUIRE(cache.insert(0, 1, 1));
+    REQUIRE(cache.find(0, 1).has_value());
+    REQUIRE(cache.find(0, 1, peek::yes).has_value());
+    REQUIRE_FALSE(cache.find(0, 2).has_value());
+    REQUIRE_FALSE(cache.find(1, 1).has_value());
+
+    auto stats = cache.tenant_stats(0, true);
+    REQUIRE(stats.m_hits == 1);
+    REQUIRE(stats.m_misses == 1);
+    REQUIRE(cache.tenant_stats(1).m_misses == 1);
+
+    stats = cache.tenant_stats(0);
+    REQUIRE(stats.m_hits == 0);
+    REQUIRE(stats.m_misses == 0);
+    REQUIRE(stats.m_size == 1);
+}
+
+TEST_CASE("TenantLru ranges")
+{
+    tenant_lru_cache<uint64_t, uint64_t> cache{8, 2};
+
+    std::vector<std::tuple<size_t, uint64_t, uint64_t>> elements{{0, 1, 1}, {0, 2, 2}, {1, 3, 3}};
+    REQUIRE(cache.insert_range(elements) == 3);
+
+    auto found = cache.find_range(0, std::vector<uint64_t>{1, 2, 3});
+    REQUIRE(found[0].second.has_value());
+    REQUIRE(found[1].second.has_value());
+    REQUIRE_FALSE(found[2].second.has_value());
+
+    std::vector<std::pair<uint64_t, std::optional<uint64_t>>> fill{{3, std::nullopt}};
+    cache.find_range_fill(1, fill);
+    REQUIRE(fill[0].second.value() == 3);
+
+    REQUIRE(cache.erase_range(std::vector<uint64_t>{1, 3, 4}) == 2);
+    REQUIRE(cache.size() == 1);
+}
@@ -1,8 +1,11 @@
 #include "catch.hpp"
 #include <cappuccino/cappuccino.hpp>
 
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <map>
+#include <random>
 #include <thread>
 #include <variant>
 
@@ -490,3 +493,336 @@ TEST_CASE("tlru_cache Insert only long running test.")
     REQUIRE(blocked > inserted);
     REQUIRE(elapsed >= std::chrono::milliseconds{200});
 }
+
+TEST_CASE("Tlru eviction stats records expired elements")
+{
+    tlru_cache<uint64_t, uint64_t> cache{4};
+    cache.enable_eviction_stats();
+
+    cache.insert(10ms, 1, 1);
+    cache.insert(1h, 2, 2);
+    std::this_thread::sleep_for(20ms);
+
+    REQUIRE(cache.clean_expired_values() == 1);
+
+    auto stats = cache.eviction_stats();
+    REQUIRE(stats.residency_us().count() == 1);
+    REQUIRE(stats.residency_us().percentile(1.0) >= 10000);
+    REQUIRE(stats.hits_before_eviction().bucket(0) == 1);
+}
+
+TEST_CASE("Tlru compact index")
+{
+    tlru_cache<uint64_t, std::string, thread_safe::no, uint32_t> cache{3};
+
+    REQUIRE(cache.insert(1h, 1, "test1"));
+    REQUIRE(cache.insert(1h, 2, "test2"));
+    REQUIRE(cache.insert(10ms, 3, "test3"));
+
+    // 2 is the least recently used but 3 expires first.
+    REQUIRE(cache.find(1).has_value());
+    std::this_thread::sleep_for(20ms);
+    REQUIRE(cache.insert(1h, 4, "test4"));
+    REQUIRE(cache.find(2).has_value());
+    REQUIRE_FALSE(cache.find(3).has_value());
+
+    // Nothing is expired, 1 is now the least recently used.
+    REQUIRE(cache.insert(1h, 5, "test5"));
+    REQUIRE_FALSE(cache.find(1).has_value());
+    REQUIRE(cache.find(2).value() == "test2");
+    REQUIRE(cache.find(4).value() == "test4");
+    REQUIRE(cache.find(5).value() == "test5");
+
+    REQUIRE(cache.erase(4));
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.insert(1h, 6, "test6"));
+    REQUIRE(cache.size() == 3);
+}
+
+TEST_CASE("Tlru coarse timestamps")
+{
+    // A 255ms range forces the timestamp epoch to be rebased a few times.
+    using timestamp = coarse_timestamp<std::chrono::milliseconds, uint8_t>;
+    tlru_cache<uint64_t, std::string, thread_safe::no, size_t, timestamp> cache{4};
+
+    // Too far out to be represented, this never expires through its ttl.
+    REQUIRE(cache.insert(1h, 0, "forever"));
+
+    for (uint64_t key = 1; key <= 6; ++key)
+    {
+        REQUIRE(cache.insert(60ms, key, "test"));
+        REQUIRE(cache.find(key).has_value());
+        std::this_thread::sleep_for(80ms);
+        REQUIRE_FALSE(cache.find(key).has_value());
+        REQUIRE(cache.find(0).value() == "forever");
+    }
+}
+
+TEST_CASE("Tlru coarse timestamps idle past the range")
+{
+    using timestamp = coarse_timestamp<std::chrono::milliseconds, uint8_t>;
+    tlru_cache<uint64_t, std::string, thread_safe::yes, size_t, timestamp> cache{4};
+
+    // The current time also saturates without any writes, the saturated expire time still holds.
+    REQUIRE(cache.insert(1h, 1, "forever"));
+    std::this_thread::sleep_for(400ms);
+    REQUIRE(cache.find(1).value() == "forever");
+
+    // The next write catches the epoch up in one rebase.
+    REQUIRE(cache.insert(60ms, 2, "test"));
+    REQUIRE(cache.find(2).has_value());
+    std::this_thread::sleep_for(80ms);
+    REQUIRE_FALSE(cache.find(2).has_value());
+    REQUIRE(cache.find(1).value() == "forever");
+}
+
+TEST_CASE("Tlru negative filter")
+{
+    tlru_cache<uint64_t, std::string> cache{4};
+
+    // Keys inserted before the filter is enabled are added to it.
+    REQUIRE(cache.insert(1h, 1, "one"));
+    cache.enable_negative_filter();
+    REQUIRE(cache.insert(1h, 2, "two"));
+
+    REQUIRE(cache.find(1).value() == "one");
+    REQUIRE(cache.find(2).value() == "two");
+    REQUIRE_FALSE(cache.find(3).has_value());
+
+    // Erased, evicted and expired keys are removed from the filter and not found.
+    REQUIRE(cache.erase(1));
+    REQUIRE_FALSE(cache.find(1).has_value());
+
+    REQUIRE(cache.insert(20ms, 3, "three"));
+    std::this_thread::sleep_for(40ms);
+    REQUIRE_FALSE(cache.find(3).has_value());
+
+    for (uint64_t key = 10; key < 100; ++key)
+    {
+        REQUIRE(cache.insert(1h, key, "test"));
+        REQUIRE(cache.find(key).value() == "test");
+    }
+    REQUIRE(cache.size() == 4);
+    for (uint64_t key = 10; key < 96; ++key)
+    {
+        REQUIRE_FALSE(cache.find(key).has_value());
+    }
+    REQUIRE_FALSE(cache.find(2).has_value());
+
+    // Re-inserting an evicted key is found again.
+    REQUIRE(cache.insert(1h, 1, "one"));
+    REQUIRE(cache.find(1).value() == "one");
+}
+
+TEST_CASE("Tlru negative filter concurrent")
+{
+    tlru_cache<uint64_t, uint64_t> cache{1000};
+    cache.enable_negative_filter();
+
+    std::atomic<bool> done{false};
+    std::thread       writer{[&]() {
+        for (uint64_t i = 0; i < 20000; ++i)
+        {
+            cache.insert(1h, i % 2000, i);
+            cache.erase((i + 1000) % 2000);
+        }
+        done = true;
+    }};
+
+    while (!done)
+    {
+        for (uint64_t key = 0; key < 2000; ++key)
+        {
+            // Values are always the key modulo 2000 plus a multiple of 2000.
+            auto value = cache.find(key);
+            if (value.has_value())
+            {
+                REQUIRE(value.value() % 2000 == key);
+            }
+        }
+    }
+    writer.join();
+
+    // The writer's last insert must be visible.
+    REQUIRE(cache.find(1999).value() == 19999);
+    REQUIRE_FALSE(cache.find(0).has_value());
+}
+
+TEST_CASE("Tlru eviction watermarks")
+{
+    tlru_cache<uint64_t, uint64_t> cache{6};
+    cache.set_eviction_watermarks(6, 3);
+
+    REQUIRE(cache.insert(1h, 0, 0));
+    REQUIRE(cache.insert(20ms, 1, 1));
+    REQUIRE(cache.insert(1h, 2, 2));
+    REQUIRE(cache.insert(20ms, 3, 3));
+    REQUIRE(cache.insert(1h, 4, 4));
+    REQUIRE(cache.insert(1h, 5, 5));
+    std::this_thread::sleep_for(40ms);
+
+    // Expired elements go first, then the least recently used.
+    REQUIRE(cache.prune() == 3);
+    REQUIRE(cache.size() == 3);
+    REQUIRE_FALSE(cache.find(0).has_value());
+    REQUIRE_FALSE(cache.find(1).has_value());
+    REQUIRE_FALSE(cache.find(3).has_value());
+    REQUIRE(cache.find(2).has_value());
+    REQUIRE(cache.find(4).has_value());
+    REQUIRE(cache.find(5).has_value());
+}
+
+TEST_CASE("Tlru touch")
+{
+    tlru_cache<uint64_t, std::string> cache{3};
+
+    REQUIRE(cache.insert(50ms, 1, "session"));
+    REQUIRE(cache.insert(50ms, 2, "other"));
+    REQUIRE(cache.insert(1h, 3, "forever"));
+
+    // Extend 1, shorten 3, 2 expires as scheduled.
+    REQUIRE(cache.touch(1, 1h));
+    REQUIRE(cache.touch(3, 10ms));
+    REQUIRE_FALSE(cache.touch(4, 1h));
+    std::this_thread::sleep_for(80ms);
+
+    REQUIRE(cache.find(1).value() == "session");
+    REQUIRE_FALSE(cache.find(2).has_value());
+    REQUIRE_FALSE(cache.find(3).has_value());
+
+    // An expired key is not revived.
+    REQUIRE(cache.insert(10ms, 5, "expired"));
+    std::this_thread::sleep_for(20ms);
+    REQUIRE_FALSE(cache.touch(5, 1h));
+    REQUIRE_FALSE(cache.find(5).has_value());
+}
+
+TEST_CASE("Tlru touch updates the lru position")
+{
+    tlru_cache<uint64_t, uint64_t> cache{2};
+    REQUIRE(cache.insert(1h, 1, 1));
+    REQUIRE(cache.insert(1h, 2, 2));
+
+    // 1 becomes the most recently used so 2 is evicted.
+    REQUIRE(cache.touch(1, 1h));
+    REQUIRE(cache.insert(1h, 3, 3));
+    REQUIRE(cache.find(1).has_value());
+    REQUIRE_FALSE(cache.find(2).has_value());
+}
+
+TEST_CASE("Tlru touch_range")
+{
+    tlru_cache<uint64_t, uint64_t> cache{8};
+    for (uint64_t key = 0; key < 4; ++key)
+    {
+        REQUIRE(cache.insert(50ms, key, key));
+    }
+
+    std::vector<uint64_t> keys{0, 2, 7};
+    REQUIRE(cache.touch_range(keys, 1h) == 2);
+    std::this_thread::sleep_for(80ms);
+
+    REQUIRE(cache.find(0).has_value());
+    REQUIRE_FALSE(cache.find(1).has_value());
+    REQUIRE(cache.find(2).has_value());
+    REQUIRE_FALSE(cache.find(3).has_value());
+}
+
+TEST_CASE("Tlru try_find and try_insert")
+{
+    tlru_cache<uint64_t, std::string> cache{4};
+
+    REQUIRE(cache.try_insert(1h, 1, "one") == std::pair{lock_status::acquired, true});
+    REQUIRE(cache.try_insert_until(std::chrono::steady_clock::now() + 1ms, 10ms, 2, "two").second);
+
+    auto [status, value] = cache.try_find(1);
+    REQUIRE(status == lock_status::acquired);
+    REQUIRE(value.value() == "one");
+
+    std::this_thread::sleep_for(20ms);
+    auto expired = cache.try_find_until(std::chrono::steady_clock::now() + 1ms, 2);
+    REQUIRE(expired.first == lock_status::acquired);
+    REQUIRE_FALSE(expired.second.has_value());
+}
+
+TEST_CASE("Tlru snapshot")
+{
+    tlru_cache<uint64_t, std::string> cache{16};
+    for (uint64_t i = 0; i < 10; ++i)
+    {
+        cache.insert(std::chrono::minutes{i + 1}, i, std::to_string(i));
+    }
+    cache.insert(1ms, 100, "expires");
+    std::this_thread::sleep_for(5ms);
+
+    std::map<uint64_t, std::pair<std::string, std::chrono::milliseconds>> records{};
+    auto emitted = cache.snapshot(
+        [&](const uint64_t& key, const std::optional<std::string>& value, std::chrono::milliseconds ttl) {
+            REQUIRE(value.has_value());
+            records[key] = {value.value(), ttl};
+        },
+        3);
+
+    REQUIRE(emitted == 10);
+    REQUIRE(records.size() == 10);
+    for (uint64_t i = 0; i < 10; ++i)
+    {
+        REQUIRE(records[i].first == std::to_string(i));
+        REQUIRE(records[i].second <= std::chrono::minutes{i + 1});
+        REQUIRE(records[i].second > std::chrono::minutes{i + 1} - 1s);
+    }
+}
+
+TEST_CASE("Tlru snapshot with concurrent modifications")
+{
+    constexpr uint64_t                              universe{200};
+    tlru_cache<uint64_t, uint64_t>                  cache{256};
+    tlru_cache<uint64_t, uint64_t, thread_safe::no> restored{256};
+    std::mt19937_64                                 rng{42};
+    std::uniform_int_distribution<uint64_t>         keys{0, universe - 1};
+    std::uniform_int_distribution<int>              operations{0, 2};
+
+    for (uint64_t i = 0; i < universe; i += 2)
+    {
+        cache.insert(1h, i, i);
+    }
+
+    // The emit callback runs without the lock so it can modify the cache mid scan, every record
+    // before the scan finishes is followed by a write into a slot the scan may have passed.
+    size_t calls{0};
+    cache.snapshot(
+        [&](const uint64_t& key, const std::optional<uint64_t>& value, std::chrono::milliseconds ttl) {
+            if (value.has_value())
+            {
+                restored.insert(ttl, key, value.value());
+            }
+            else
+            {
+                restored.erase(key);
+            }
+
+            if (++calls <= 50)
+            {
+                auto k = keys(rng);
+                switch (operations(rng))
+                {
+                    case 0:
+                        cache.insert(1h, k, k + 1000);
+                        break;
+                    case 1:
+                        cache.erase(k);
+                        break;
+                    default:
+                        cache.touch(k, 2h);
+                        break;
+                }
+            }
+        },
+        8);
+
+    REQUIRE(restored.size() == cache.size());
+    for (uint64_t k = 0; k < universe; ++k)
+    {
+        REQUIRE(restored.find(k, peek::yes) == cache.find(k, peek::yes));
+    }
+}
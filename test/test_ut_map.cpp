@@ -622,4 +622,22 @@ TEST_CASE("ut_map clear cache.")
     cache.clear();
     REQUIRE(cache.empty());
     REQUIRE(cache.size() == 0);
-}
\ No newline at end of file
+}
+
+TEST_CASE("ut_map coarse timestamps")
+{
+    // A 255ms range forces the timestamp epoch to be rebased a few times.
+    using timestamp = coarse_timestamp<std::chrono::milliseconds, uint8_t>;
+    ut_map<uint64_t, std::string, thread_safe::no, timestamp> map{100ms};
+
+    REQUIRE(map.insert(0, "refreshed"));
+    for (uint64_t key = 1; key <= 6; ++key)
+    {
+        REQUIRE(map.insert(key, "test"));
+        std::this_thread::sleep_for(60ms);
+        REQUIRE(map.insert(0, "refreshed"));
+        std::this_thread::sleep_for(60ms);
+        REQUIRE_FALSE(map.find(key).has_value());
+        REQUIRE(map.find(0).value() == "refreshed");
+    }
+}
@@ -0,0 +1,191 @@
+#include "catch.hpp"
+#include <cappuccino/cappuccino.hpp>
+
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+using namespace cappuccino;
+using namespace std::chrono_literals;
+
+TEST_CASE("ut_roaring_set example")
+{
+    ut_roaring_set<uint32_t> set{20ms};
+
+    set.insert(1);
+    set.insert(100000);
+
+    REQUIRE(set.find(1));
+    REQUIRE(set.find(100000));
+    REQUIRE_FALSE(set.find(2));
+
+    // Sleep for an ~order of magnitude longer than the TTL.
+    std::this_thread::sleep_for(100ms);
+
+    auto cleaned_count = set.clean_expired_values();
+    REQUIRE(cleaned_count == 2);
+    REQUIRE(set.empty());
+}
+
+TEST_CASE("ut_roaring_set Insert, Update, Insert Or Update")
+{
+    ut_roaring_set<uint64_t> set{50ms};
+
+    REQUIRE_FALSE(set.insert(1, allow::update));
+    REQUIRE(set.insert(1, allow::insert));
+    REQUIRE_FALSE(set.insert(1, allow::insert));
+    REQUIRE(set.insert(1, allow::update));
+    REQUIRE(set.insert(1));
+    REQUIRE(set.find(1));
+    REQUIRE(set.size() == 1);
+}
+
+TEST_CASE("ut_roaring_set Delete and DeleteRange")
+{
+    ut_roaring_set<uint32_t> set{1min};
+
+    REQUIRE(set.insert_range(std::vector<uint32_t>{1, 2, 3, 4, 5}) == 5);
+    REQUIRE(set.erase(3));
+    REQUIRE_FALSE(set.erase(3));
+    REQUIRE_FALSE(set.find(3));
+    REQUIRE(set.size() == 4);
+
+    REQUIRE(set.erase_range(std::vector<uint32_t>{1, 3, 5, 7}) == 2);
+    REQUIRE(set.size() == 2);
+    REQUIRE(set.find(2));
+    REQUIRE(set.find(4));
+}
+
+TEST_CASE("ut_roaring_set FindRange and FindRangeFill")
+{
+    ut_roaring_set<uint64_t> set{1min};
+
+    std::vector<uint64_t> inserts{5, 1ull << 40, 70000};
+    REQUIRE(set.insert_range(inserts) == 3);
+
+    auto output = set.find_range(std::vector<uint64_t>{70000, 6, 5, 1ull << 40});
+    REQUIRE(output.size() == 4);
+    REQUIRE(output[0] == std::make_pair(uint64_t{70000}, true));
+    REQUIRE(output[1] == std::make_pair(uint64_t{6}, false));
+    REQUIRE(output[2] == std::make_pair(uint64_t{5}, true));
+    REQUIRE(output[3] == std::make_pair(uint64_t{1ull << 40}, true));
+
+    std::vector<std::pair<uint64_t, bool>> fill{{5, false}, {6, false}};
+    set.find_range_fill(fill);
+    REQUIRE(fill[0].second);
+    REQUIRE_FALSE(fill[1].second);
+}
+
+TEST_CASE("ut_roaring_set dense keys use bitmap containers")
+{
+    ut_roaring_set<uint32_t, thread_safe::no> set{1min};
+
+    std::vector<uint32_t> keys(65536 * 4);
+    std::iota(keys.begin(), keys.end(), 0);
+    REQUIRE(set.insert_range(keys) == keys.size());
+    REQUIRE(set.size() == keys.size());
+
+    // 4 full containers as bitmaps are 8KB each, far less than a node per key.
+    REQUIRE(set.memory_usage() < keys.size());
+
+    // Remove enough keys from a container to convert it back to an array.
+    for (uint32_t i = 0; i < 65536 - 100; ++i)
+    {
+        REQUIRE(set.erase(i));
+    }
+    REQUIRE(set.size() == keys.size() - (65536 - 100));
+    for (uint32_t i = 65536 - 100; i < 65536 + 10; ++i)
+    {
+        REQUIRE(set.find(i));
+    }
+    REQUIRE_FALSE(set.find(0));
+}
+
+TEST_CASE("ut_roaring_set bitmap containers convert back to arrays with hysteresis")
+{
+    ut_roaring_set<uint32_t, thread_safe::no> set{1min};
+
+    std::vector<uint32_t> keys(4097);
+    std::iota(keys.begin(), keys.end(), 0);
+    REQUIRE(set.insert_range(keys) == keys.size());
+    // The container is now an 8KB bitmap.
+    REQUIRE(set.memory_usage() >= 8192);
+
+    // Hovering around the array limit keeps the bitmap.
+    for (size_t i = 0; i < 100; ++i)
+    {
+        REQUIRE(set.erase(4096));
+        REQUIRE(set.erase(4095));
+        REQUIRE(set.insert(4095));
+        REQUIRE(set.insert(4096));
+    }
+    for (uint32_t i = 4096; i >= 4096 - 512 + 1; --i)
+    {
+        REQUIRE(set.erase(i));
+    }
+    REQUIRE(set.memory_usage() >= 8192);
+
+    // Dropping below the lower threshold converts back to an array.
+    REQUIRE(set.erase(4096 - 512));
+    REQUIRE(set.memory_usage() < 8192);
+    for (uint32_t i = 0; i < 4096 - 512; ++i)
+    {
+        REQUIRE(set.find(i));
+    }
+    REQUIRE_FALSE(set.find(4096 - 512));
+}
+
+TEST_CASE("ut_roaring_set sealed generations are run compressed")
+{
+    ut_roaring_set<uint32_t, thread_safe::no> set{100ms, 10};
+
+    std::vector<uint32_t> keys(10000);
+    std::iota(keys.begin(), keys.end(), 1000);
+    REQUIRE(set.insert_range(keys) == keys.size());
+
+    // Move into the next generation so the first one is sealed and compressed.
+    std::this_thread::sleep_for(20ms);
+    REQUIRE(set.insert(1));
+    REQUIRE(set.memory_usage() < 1000);
+
+    // Erasing from the middle of a run splits it.
+    REQUIRE(set.erase(5000));
+    REQUIRE_FALSE(set.find(5000));
+    REQUIRE(set.find(4999));
+    REQUIRE(set.find(5001));
+    REQUIRE(set.find(1000));
+    REQUIRE(set.find(10999));
+    REQUIRE_FALSE(set.find(11000));
+
+    // Updating a key moves it out of the sealed generation.
+    REQUIRE(set.insert(1000, allow::update));
+    REQUIRE(set.find(1000));
+    REQUIRE(set.size() == keys.size());
+}
+
+TEST_CASE("ut_roaring_set update TTLs some expire")
+{
+    ut_roaring_set<uint32_t> set{100ms, 10};
+
+    REQUIRE(set.insert(1));
+    REQUIRE(set.insert(2));
+
+    std::this_thread::sleep_for(80ms);
+
+    // Update 1's TTL, but not 2.
+    REQUIRE(set.insert(1, allow::update));
+    REQUIRE_FALSE(set.insert(2, allow::insert));
+
+    // Total of ~140ms, 2 should expire.
+    std::this_thread::sleep_for(60ms);
+
+    REQUIRE(set.find(1));
+    REQUIRE_FALSE(set.find(2));
+    REQUIRE(set.size() == 1);
+
+    // Total of ~220ms, 1 should expire.
+    std::this_thread::sleep_for(80ms);
+
+    REQUIRE_FALSE(set.find(1));
+    REQUIRE(set.empty());
+}
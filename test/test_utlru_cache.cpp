@@ -517,3 +517,85 @@ TEST_CASE("Utlru clear cache.")
     REQUIRE(cache.empty());
     REQUIRE(cache.size() == 0);
 }
+
+TEST_CASE("Utlru compact index")
+{
+    utlru_cache<uint64_t, std::string, thread_safe::no, uint32_t> cache{50ms, 3};
+
+    REQUIRE(cache.insert(1, "test1"));
+    REQUIRE(cache.insert(2, "test2"));
+    REQUIRE(cache.insert(3, "test3"));
+
+    // 1 is now the most recently used, 2 is the least.
+    REQUIRE(cache.find(1).has_value());
+    REQUIRE(cache.insert(4, "test4"));
+    REQUIRE_FALSE(cache.find(2).has_value());
+
+    // Refresh 3 and let the rest expire.
+    std::this_thread::sleep_for(30ms);
+    REQUIRE(cache.insert(3, "test3"));
+    std::this_thread::sleep_for(30ms);
+    REQUIRE(cache.clean_expired_values() == 2);
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.find(3).value() == "test3");
+
+    cache.clear();
+    REQUIRE(cache.empty());
+    REQUIRE(cache.insert(5, "test5"));
+    REQUIRE(cache.find(5).value() == "test5");
+}
+
+TEST_CASE("Utlru coarse timestamps")
+{
+    // A 255ms range forces the timestamp epoch to be rebased a few times.
+    using timestamp = coarse_timestamp<std::chrono::milliseconds, uint8_t>;
+    utlru_cache<uint64_t, std::string, thread_safe::no, size_t, timestamp> cache{100ms, 4};
+
+    REQUIRE(cache.insert(0, "refreshed"));
+    for (uint64_t key = 1; key <= 6; ++key)
+    {
+        REQUIRE(cache.insert(key, "test"));
+        std::this_thread::sleep_for(60ms);
+        REQUIRE(cache.insert(0, "refreshed"));
+        std::this_thread::sleep_for(60ms);
+        REQUIRE_FALSE(cache.find(key).has_value());
+        REQUIRE(cache.find(0).value() == "refreshed");
+    }
+}
+
+TEST_CASE("Utlru coarse timestamps idle past the range")
+{
+    // The uniform ttl saturates, it stays saturated even once the current time does too.
+    using timestamp = coarse_timestamp<std::chrono::milliseconds, uint8_t>;
+    utlru_cache<uint64_t, std::string, thread_safe::yes, size_t, timestamp> cache{1h, 4};
+
+    REQUIRE(cache.insert(1, "forever"));
+    std::this_thread::sleep_for(400ms);
+    REQUIRE(cache.find(1).value() == "forever");
+}
+
+TEST_CASE("Utlru eviction watermarks")
+{
+    utlru_cache<uint64_t, uint64_t> cache{1h, 8};
+    cache.set_eviction_watermarks(6, 2);
+
+    for (uint64_t key = 0; key < 5; ++key)
+    {
+        REQUIRE(cache.insert(key, key));
+    }
+    REQUIRE(cache.prune() == 0);
+
+    REQUIRE(cache.insert(5, 5));
+    REQUIRE(cache.prune() == 4);
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.find(4).has_value());
+    REQUIRE(cache.find(5).has_value());
+
+    // Filling up evicts down to the low watermark inline.
+    for (uint64_t key = 6; key < 13; ++key)
+    {
+        REQUIRE(cache.insert(key, key));
+    }
+    REQUIRE(cache.size() == 3);
+    REQUIRE(cache.find(12).has_value());
+}